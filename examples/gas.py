@@ -87,15 +87,11 @@ while True:
     # Update all positions
     pos = pos+(p/m)*dt
 
-    r = pos-pos[:,newaxis] # all pairs of atom-to-atom vectors
-    rmag = sqrt(sum(square(r),-1)) # atom-to-atom scalar distances
-    hit = less_equal(rmag,radius+radius[:,None])-identity(Natoms)
-    hitlist = sort(nonzero(hit.flat)[0]).tolist() # i,j encoded as i*Natoms+j
+    # All pairs of overlapping atoms, found without comparing every pair
+    hitlist = sphere_intercollisions(pos, radius)
 
     # If any collisions took place:
-    for ij in hitlist:
-        i, j = divmod(ij,Natoms) # decode atom pair
-        hitlist.remove(j*Natoms+i) # remove symmetric j,i pair from list
+    for i, j in hitlist:
         ptot = p[i]+p[j]
         mi = m[i,0]
         mj = m[j,0]
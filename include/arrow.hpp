@@ -68,7 +68,7 @@ class arrow : public primitive
 	double get_length();
 	
  protected:
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void gl_render( const view&);
 
 	virtual void grow_extent( extent&);
@@ -8,9 +8,12 @@
 
 #include "rectangular.hpp"
 #include "util/displaylist.hpp"
+#include "util/mesh.hpp"
 
 namespace cvisual {
 
+namespace python { class particles; }
+
 class box : public rectangular
 {
  private:
@@ -18,15 +21,22 @@ class box : public rectangular
 	bool degenerate();
 	static displaylist model;
 	static void init_model(displaylist& model, bool skip_right_face);
+	static mesh batch_model;
+	static void init_mesh();
 	friend class arrow;
+	friend class python::particles;
 	
  protected:
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void gl_render( const view&);
+	virtual bool add_to_batch( const view&, instance_batch&);
+	virtual bool culled( const view&);
+	virtual bool cullable() { return true; }
 	virtual void grow_extent( extent& );
 	virtual void get_material_matrix( const view&, tmatrix& out );
 
 	PRIMITIVE_TYPEINFO_DECL;
+	PRIMITIVE_SNAPSHOT_DECL;
 };
 
 } // !namespace cvisual
@@ -14,7 +14,10 @@ class cylinder : public axial
 {
  private:
 	static void init_model();
+	static void init_mesh();
 	bool degenerate();
+	/** Choose a level of detail based on the size of the body on the screen. */
+	int get_lod( const view&);
 	
  public:
 	cylinder();
@@ -25,11 +28,13 @@ class cylinder : public axial
 	double get_length();
 	
  protected:
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void gl_render( const view&);
+	virtual bool add_to_batch( const view&, instance_batch&);
 	virtual void grow_extent( extent&);
 	virtual vector get_center() const;
 	PRIMITIVE_TYPEINFO_DECL;
+	PRIMITIVE_SNAPSHOT_DECL;
 };
 
 } // !namespace cvisual
@@ -11,9 +11,14 @@
 #include "util/rgba.hpp"
 #include "util/extent.hpp"
 #include "util/timer.hpp"
+#include "util/frame_stats.hpp"
 #include "util/thread.hpp"
 #include "util/gl_extensions.hpp"
 #include "util/atomic_queue.hpp"
+#include "util/instance_batch.hpp"
+#include "util/blended_transparency.hpp"
+#include "util/frame_readback.hpp"
+#include "util/frame_sink.hpp"
 #include "mouse_manager.hpp"
 #include "mouseobject.hpp"
 #include <list>
@@ -53,6 +58,30 @@ class display_kernel
 
  private:
 	timer render_timer;	// for timing the render pulse
+	/** The timings of the cycle in progress, completed by end_frame(). */
+	frame_stats current_frame;
+	/** True from the end of render_scene() until end_frame(). */
+	bool frame_pending;
+	frame_stats_log stats;
+
+	// Frames read back for capture() and record().  Each frame read is
+	// numbered, counting from 0; since frame_readback hands them over in
+	// order, the count delivered is the number of the next one.
+	frame_readback readback;
+	mutex capture_barrier;
+	condition capture_changed;
+	unsigned long frames_read;
+	unsigned long frames_delivered;
+	bool capturing; ///< True while capture() waits for a frame.
+	unsigned long capture_from; ///< The first frame capture() will take.
+	shared_ptr<frame_image> captured;
+	shared_ptr<frame_writer> recorder;
+	/** The frames sent to recorder are those from record_from until
+		record_until, which stop_recording() sets. */
+	unsigned long record_from, record_until;
+
+	// Passed to readback by read_frame() and flush_frames().
+	void deliver_frame( const unsigned char* rgba, int width, int height);
 
 	shared_vector center; ///< The observed center of the display, in world space.
 	shared_vector forward; ///< The direction of the camera, in world space.
@@ -121,6 +150,7 @@ class display_kernel
 			desaturation or grayscaling.
 		@param scene_geometry.coloranaglyph  True if colors must be grayscaled, false if colors
 			must be desaturated.
+		Works from the frame snapshot and may be called without the GIL.
 	*/
 	bool draw( view&, int eye=0);
 
@@ -134,6 +164,72 @@ class display_kernel
 	std::vector<shared_ptr<renderable> > layer_world_transparent;
 	typedef indirect_iterator<std::vector<shared_ptr<renderable> >::iterator> world_trans_iterator;
 
+	/** One entry of the per-frame snapshot of the world.  The owner keeps the
+		object alive until the next snapshot is taken; state is the object's
+		own copy of its render state (see renderable::snapshot()), or NULL if
+		the object must be rendered with the GIL held.
+	*/
+	struct frame_object
+	{
+		shared_ptr<renderable> owner;
+		renderable* state;
+		double depth; ///< Sorting key for the transparent layer.
+		frame_object( const shared_ptr<renderable>& o, renderable* s)
+			: owner(o), state(s), depth(0) {}
+	};
+	/** The snapshot of layer_world and layer_world_transparent that draw() and
+		pick() work from.  Only modified with the GIL held.
+	*/
+	std::vector<frame_object> frame_world;
+	std::vector<frame_object> frame_world_transparent;
+	/** The bodies of frame_world_transparent that have opaque parts, which
+		draw() draws with the opaque layer when it blends the transparent
+		layer; see view::parts.  Empty when the transparent layer is sorted.
+	*/
+	std::vector<frame_object> frame_world_mixed;
+	/** Scratch space for sorting frame_world_transparent. */
+	std::vector<double> transparent_depth;
+	std::vector<size_t> transparent_order;
+
+	/** Copies the render state of every object in the world into the frame
+		snapshot.  Must be called with the GIL held.
+	*/
+	void take_snapshot();
+	/** Render one object from the snapshot, acquiring the GIL only when the
+		object could not provide a copy of its state.
+	*/
+	static void render_frame_object( const frame_object&, const view&);
+	/** Opaque primitives that are copies of a shared mesh are queued here by
+		draw() and drawn together once the rest of the opaque layer is done.
+	*/
+	instance_batch batch;
+	/** Draws the transparent layer without sorting it, when
+		transparency_mode is BLENDED_TRANSPARENCY.
+	*/
+	blended_transparency blend;
+	/** True if draw() should use blend, in which case take_snapshot() does
+		not sort the transparent layer.
+	*/
+	bool use_blend() const;
+
+	/** The modelview and projection matrices of the most recent frame,
+		without any stereo offset, used to cast rays from the cursor.
+	*/
+	tmatrix pick_modelview;
+	tmatrix pick_projection;
+	/** The ray under the pixel at (x, y), in world coordinates, and the
+		position of the cursor in the plane through center.
+	*/
+	pick_ray get_pick_ray( int x, int y, float d_pixels, vector& mousepos);
+	/** The pick_engine for the bodies in the frame snapshot, which is the
+		same one from frame to frame, so that its hierarchy can be reused.
+		The last frame's pick is found first if a mouse event still holds it,
+		since the engine no longer knows that frame's bodies afterward.
+		Must be called with the GIL held.
+	*/
+	shared_ptr<pick_engine> make_pick_engine();
+	shared_ptr<pick_engine> picker;
+
 	// Computes the extent of the scene and takes action for autozoom and
 	// autoscaling.
 	void recalc_extent();
@@ -146,6 +242,17 @@ class display_kernel
 	void implicit_activate();
 
 protected:
+	/** Read back the frame just drawn, if capture() or record() wants it.
+		Called by render_scene() with the OpenGL context current. */
+	void read_frame();
+	/** Hand over every frame still being read back.  Must be called with the
+		OpenGL context current. */
+	void flush_frames();
+	/** Ask for the next frame read, and return it once it has been read, for
+		subclasses that draw it themselves in the meantime. */
+	void request_capture();
+	shared_ptr<frame_image> take_capture();
+
 	// Mouse and keyboard objects
 	cursor_object cursor;
 	mouse_manager mouse;
@@ -170,6 +277,9 @@ protected:
 	bool explicitly_invisible;  ///< true iff scene.visible has ever been set to 0 by the program, or by the user closing a window
 	bool fullscreen; ///< True when the display is in fullscreen mode.
 	bool show_toolbar; ///< True when toolbar is displayed (pan, etc).
+	/** True for displays with no window for the user to close, which
+		waitWhileAnyDisplayVisible() does not wait for. */
+	bool windowless;
 	std::string title;
 
 public: // Public Data.
@@ -180,6 +290,12 @@ public: // Public Data.
 	enum stereo_mode_t { NO_STEREO, PASSIVE_STEREO, ACTIVE_STEREO, CROSSEYED_STEREO,
 		REDBLUE_STEREO, REDCYAN_STEREO, YELLOWBLUE_STEREO, GREENMAGENTA_STEREO
 	} stereo_mode;
+	/** How the transparent layer is drawn: sorted from back to front, or
+		blended in any order (see blended_transparency).  Blending falls back
+		to sorting where OpenGL cannot support it.
+	*/
+	enum transparency_mode_t { SORTED_TRANSPARENCY, BLENDED_TRANSPARENCY
+	} transparency_mode;
 
 	/** Older machines should set this to some number between -6 and 0.  All of
 		the tesselated models choose a lower level of detail based on this value
@@ -187,6 +303,12 @@ public: // Public Data.
 	*/
 	int lod_adjust;
 
+	/** True to draw every opaque sphere without a material as an impostor,
+		a square shaded to look like a sphere, rather than only those that are
+		a few pixels across, in frames or not.  See instance_batch::add_sphere().
+	*/
+	bool impostors;
+
 	/** Add a normal renderable object to the list of objects to be rendered into
 	 *  world space.
 	 */
@@ -204,12 +326,21 @@ public: // Public Data.
 	virtual ~display_kernel();
 
 	/** Renders the scene once.  The enveloping widget is resposible for calling
-		 this function appropriately.
+		 this function appropriately.  The GIL is acquired only while the
+		 frame snapshot is taken and the mouse is updated; it does not matter
+		 whether or not the caller already holds it.
  		@return If false, something catastrophic has happened and the
  		application should probably exit.
 	*/
 	bool render_scene();
 
+	/** Complete the timings of the cycle drawn by the last render_scene() and
+		add them to the log read by get_stats().  Called by render_manager once
+		the buffers have been swapped; does nothing if nothing was drawn.
+		@param swap_time How long the buffer swap took.
+	*/
+	void end_frame( double swap_time);
+
 	/** Inform this object that the window has been closed (is no longer physically
 	    visible)
 	*/
@@ -240,6 +371,8 @@ public: // Public Data.
 			the position of the mouse cursor on the near clipping plane.
            retval.get<0>() may be NULL if nothing was hit, in which case the
            positions are undefined.
+		Works from the most recent frame snapshot, and must be called with the
+		GIL held.
 	*/
 	boost::tuple<shared_ptr<renderable>, vector, vector>
 	pick( int x, int y, float d_pixels = 2.0);
@@ -305,6 +438,32 @@ public: // Public Data.
 	void set_show_rendertime( bool);
 	bool is_showing_rendertime();
 
+	void set_impostors( bool);
+	bool get_impostors();
+
+	/** The timings of the most recent rendering cycles, oldest first. */
+	std::vector<frame_stats> get_stats() const;
+	void clear_stats();
+
+	/** Wait for the next frame to be drawn and read back, and return it.  The
+		frame is read through a pixel buffer object, so drawing does not wait
+		for it; it arrives a couple of frames later.  Releases the GIL while it
+		waits.  Throws std::runtime_error if the display is not visible, or does not
+		draw a frame within a second.
+	*/
+	virtual shared_ptr<frame_image> capture();
+	/** Send every frame drawn from now on to sink, through a frame_writer, so
+		that it is written in a thread of its own.  Any recording already in
+		progress is stopped first.
+	*/
+	void record( shared_ptr<frame_sink> sink);
+	/** Send the frames drawn before the call, but still being read back or
+		written, to the sink given to record(), and close it.  Throws the
+		error, if writing any of them failed.  Releases the GIL while it
+		waits, since a sink may need it to write the frames.
+	*/
+	virtual void stop_recording();
+
 	void set_range_d( double);
 	void set_range( const vector&);
 	vector get_range();
@@ -323,6 +482,10 @@ public: // Public Data.
 	void set_stereomode( std::string mode);
 	std::string get_stereomode();
 
+	// "sorted" or "blended"; see transparency_mode.
+	void set_transparency( std::string mode);
+	std::string get_transparency();
+
 	// A list of all objects rendered into this display_kernel.  Modifying it
 	// does not propogate to the owning display_kernel.
 	std::vector<shared_ptr<renderable> > get_objects() const;
@@ -358,6 +521,13 @@ public: // Public Data.
 
 	static bool enable_shaders;
 
+	/** When true, each display is painted and swapped by a thread of its own,
+		all of them in step, instead of one after another.  At present only
+		the GTK driver does this, and it must be set before the first display
+		is made visible.
+	*/
+	static bool render_threads;
+
 	cursor_object* get_cursor();
 	mouse_t* get_mouse();
 	atomic_queue<std::string>* get_kb();
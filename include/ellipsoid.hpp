@@ -39,6 +39,7 @@ class ellipsoid : public sphere
 	virtual void grow_extent( extent&);
 	virtual bool degenerate();
 	PRIMITIVE_TYPEINFO_DECL;
+	PRIMITIVE_SNAPSHOT_DECL;
 };
 
 } // !namespace cvisual
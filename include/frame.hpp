@@ -8,6 +8,7 @@
 
 #include "renderable.hpp"
 #include "util/tmatrix.hpp"
+#include "util/instance_batch.hpp"
 
 #include <boost/iterator/indirect_iterator.hpp>
 #include <vector>
@@ -22,13 +23,23 @@ Operations on frame objects include:
 get_center() : Use the average of all its children.
 update_z_sort() : Never called.  Always re-sort this body's translucent children
 	in gl_render().
-gl_render() : Calls gl_render() on all its children.
+gl_render() : Calls gl_render() on all its children that are not culled, or
+	queues them in a batch of its own, as display_kernel::draw() does.  A
+	frame with any translucent children is drawn with the transparent layer.
+	When that layer is blended, the frame is also drawn with the opaque
+	layer, and each pass draws only the children that belong to it (see
+	view::parts); the translucent children are then not sorted.
 grow_extent() : Calls grow_extent() for each of its children, then transforms
-	the vertexes of the bounding box and uses those as its bounds.
-gl_pick_render() : PushName() on to the Name Stack, and renders its children.
-	When looking up names later, the render_core calls lookup_name() with a
-	vector<uint>, which the frame uses to recursively look through frames to
-	find the right object.
+	the vertexes of the bounding box and uses those as its bounds.  The
+	children are also measured in the frame's coordinates, for culling.
+culled() : True if the sphere around the children's bounding box is out of
+	sight, so that a frame full of objects costs one test.  Never true when
+	any child is not cullable(), since it may reach beyond that box.
+extent_version() : Changes when the frame moves or any child's does, so the
+	children of a frame that is at rest are only measured when they change.
+ray_intersect() : Transforms the ray into the frame's coordinates and tests
+	each of its children, reporting the child (or the nearest object within a
+	child frame) that was hit.
 
 oolie case: When the frame is scaled up to a superhuge universe and the
 	child is very small, the frame_world_transform may overflow OpenGL.  The
@@ -65,6 +76,20 @@ class frame : public renderable
 	typedef indirect_iterator<std::vector<shared_ptr<renderable> >::const_iterator>
 		const_trans_child_iterator;
 
+	// The frame's placement and the sum of its children's extent_version()s
+	// at the last call to extent_version().
+	vector extent_pos, extent_axis, extent_up;
+	unsigned long extent_children;
+
+	// The extent of the children in the frame's coordinates, found by the
+	// last call to grow_extent(), and whether every child was cullable() then.
+	shared_ptr<extent_data> child_extent;
+	bool children_cullable;
+
+	// The opaque children that are copies of a shared mesh, queued by
+	// gl_render() and drawn together in the frame's coordinates.
+	instance_batch batch;
+
  public:
 	frame();
 	frame( const frame& other);
@@ -99,18 +124,18 @@ class frame : public renderable
 	// void set_scale( const vector& n_scale);
 	// shared_vector& get_scale();
 
-	// Lookup the target that belongs to this name.
-	shared_ptr<renderable> lookup_name(
-		const unsigned int* name_top, const unsigned int* name_end);
-
 	virtual void get_children( std::vector< boost::shared_ptr<renderable> >& all );
 
  protected:
 	virtual vector get_center() const;
 	virtual void outer_render( const view&);
 	virtual void gl_render( const view&);
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void grow_extent( extent&);
+	virtual unsigned long extent_version();
+	virtual bool culled( const view&);
+	virtual bool cullable();
+	virtual bool mixed_opacity();
 	virtual void render_lights( view& );
 };
 
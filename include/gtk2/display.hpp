@@ -108,6 +108,9 @@ class gui_main : public sigc::trackable
 	static void thread_proc(void);
 	static void init_thread(void);
 
+	// The value of display::render_threads when the gui thread started.
+	static bool render_threads_started;
+
  public:
 	// Force all displays to close and exit the Gtk event loop.
 	static void shutdown();
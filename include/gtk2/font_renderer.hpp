@@ -22,7 +22,11 @@ class font_renderer {
 	bool ok();
 	
 	// Render text and call tx.set_image()
-	void gl_render_to_texture( const struct view&, const std::wstring& text, layout_texture& tx );
+	void gl_render_to_texture( const struct view&, const std::wstring& text, text_image& tx );
+
+	// True if the image of a single character spans its advance and the
+	// height of a line, so that text can be composed from such images.
+	bool composable();
 
  private:
 	Glib::RefPtr<Pango::Context> ft2_context;
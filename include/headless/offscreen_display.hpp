@@ -0,0 +1,68 @@
+#ifndef VPYTHON_HEADLESS_OFFSCREEN_DISPLAY_HPP
+#define VPYTHON_HEADLESS_OFFSCREEN_DISPLAY_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "display_kernel.hpp"
+
+#include <string>
+
+namespace cvisual {
+
+/** A display with no window, which draws into an EGL pbuffer of
+	window_width by window_height pixels, for rendering batches of frames on
+	machines without a screen.  Nothing is drawn on its own: the program calls
+	render() for each frame, in its own thread, which may also send the frame
+	to an output (see set_output()).  Frames are read back as for
+	display_kernel::record(), so each one reaches the output a couple of
+	frames late, and close_output() must be called to get the last of them.
+
+	All of the offscreen displays in a program share one EGL context, which
+	lives until the program exits.  Since the models of the primitives are
+	shared by every display, offscreen displays cannot be used in the same
+	program as windows.
+*/
+class offscreen_display : public display_kernel
+{
+ private:
+	// An EGLSurface.
+	void* surface;
+
+	// Make the shared context current on this display's surface.
+	void make_current();
+	// Draw a frame, without the GIL.
+	void draw();
+
+ public:
+	offscreen_display();
+	virtual ~offscreen_display();
+
+	/** Creates the pbuffer and draws the first frame when active, or destroys
+		it. */
+	virtual void activate( bool active);
+	virtual EXTENSION_FUNCTION getProcAddress( const char* name);
+
+	/** Draw one frame, making the display visible if it isn't already, and
+		pass it on to the output, if there is one.  Throws std::runtime_error
+		if the frame cannot be drawn.
+	*/
+	void render();
+
+	/** Draws a frame, rather than waiting for one, and returns it. */
+	virtual shared_ptr<frame_image> capture();
+	virtual void stop_recording();
+
+	/** Send the frames drawn from now on to a frame_sink of the given kind
+		and target; see frame_sink::create() and record().
+	*/
+	void set_output( const std::string& kind, const std::string& target);
+	/** Write the frames still being read back or queued, and close the
+		output; see stop_recording(). */
+	void close_output();
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_HEADLESS_OFFSCREEN_DISPLAY_HPP
@@ -13,6 +13,35 @@
 
 namespace cvisual {
 
+/** What is needed to draw a label in screen space, after the rest of the
+	scene.  label::gl_render() fills one in and queues it in
+	view::screen_objects, and display_kernel::draw() draws them all from back
+	to front in a single pass that sets up the screen space transforms once.
+	A label reuses its record from frame to frame, so queuing it neither
+	allocates nor compiles a display list.
+*/
+struct screen_label
+{
+	vector origin; ///< The position of the label in clip coordinates, on a pixel.
+	vector space_offset; ///< From origin to the start of the line, in pixels.
+	vector line_end; ///< From the start of the line to its end.
+	vector corner; ///< From the start of the line to the box's lower left corner.
+	double width; ///< The size of the box, in pixels.
+	double height;
+	vector text_pos; ///< The text's lower left corner, from the box's corner.
+	bool line_enabled;
+	bool box_enabled;
+	float opacity;
+	rgb background;
+	rgb linecolor;
+	rgb color;
+	shared_ptr<layout> text_layout;
+
+	void gl_render( const view&) const;
+	/** Draw the labels in v.screen_objects, in order. */
+	static void gl_render_all( const view& v, const view::screen_objects_t&);
+};
+
 class label : public renderable
 {
  public:
@@ -109,6 +138,14 @@ class label : public renderable
 	bool text_changed;
 	boost::shared_ptr<layout> text_layout;
 
+	/// True when the size of the box must be found again from the text_layout.
+	bool box_changed;
+	double halfwidth; ///< Half the size of the box, in whole pixels.
+	double halfheight;
+	vector text_pos; ///< The text's lower left corner, from the box's corner.
+	/// Queued in view::screen_objects by gl_render().
+	shared_ptr<screen_label> queued;
+
 	virtual void gl_render( const view&);
 	virtual vector get_center() const;
 	virtual void grow_extent( extent& );
@@ -6,6 +6,7 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "renderable.hpp"
+#include "pick_engine.hpp"
 #include "util/atomic_queue.hpp"
 
 #include <queue>
@@ -32,10 +33,9 @@ class mousebase
 	vector position;
 	// The position of the camera in the scene.
 	vector cam;
-	// The object nearest to the cursor when this event happened.
-	shared_ptr<renderable> pick;
-	// The position on the object that intersects with ray.
-	vector pickpos;
+	// The object nearest to the cursor when this event happened, and the
+	// position on the object that intersects with ray, found on demand.
+	shared_ptr<lazy_pick> picked;
 
 	/* 'buttonstate' contains the following state flags as defined by 'button'.
 	 */
@@ -61,7 +61,7 @@ class mousebase
 	inline vector get_pos() const { return position; }
 	inline vector get_camera() const { return cam; }
 	inline vector get_ray() const { return (position - cam).norm(); }
-	inline vector get_pickpos() const { return pickpos; }
+	vector get_pickpos();
 	shared_ptr<renderable> get_pick();
 
 	inline void set_shift( bool _shift) { modifiers.set( shift, _shift); }
@@ -0,0 +1,176 @@
+#ifndef VPYTHON_PICK_ENGINE_HPP
+#define VPYTHON_PICK_ENGINE_HPP
+
+// Copyright (c) 2000, 2001, 2002, 2003 by David Scherer and others.
+// Copyright (c) 2003, 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vector.hpp"
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace cvisual {
+
+using boost::shared_ptr;
+class renderable;
+
+/** A ray cast from the mouse into the scene, in world coordinates (or in the
+	coordinates of a frame, once frame::ray_intersect() has transformed it).
+*/
+struct pick_ray
+{
+	vector origin;
+	/** A unit vector in world space.  Primitives that transform the ray into
+		a scaled model space leave it unnormalized there, so that the distance
+		along the ray is the same in both spaces.
+	*/
+	vector dir;
+	/** How far an object may be from the ray, per unit of distance along it,
+		and still be picked.  Used for objects too thin to hit exactly, like
+		points.
+	*/
+	double tolerance;
+	/** The size of one pixel on the screen, per unit of distance along the
+		ray.  Used for objects sized in pixels.
+	*/
+	double pixel;
+
+	pick_ray() : tolerance(0), pixel(0) {}
+	pick_ray( const vector& o, const vector& d, double tol, double pix)
+		: origin(o), dir(d), tolerance(tol), pixel(pix) {}
+	vector at( double t) const { return origin + dir*t; }
+};
+
+/** The nearest intersection found so far while casting a pick_ray. */
+struct pick_hit
+{
+	/** The distance along the ray; intersections farther than this are
+		ignored.
+	*/
+	double t;
+	/** Filled in by composites (frame) with the child that was hit.  Left
+		empty by simple bodies, which are reported as themselves.
+	*/
+	shared_ptr<renderable> object;
+
+	pick_hit();
+};
+
+// Intersection tests used by renderable::ray_intersect().  Each returns true
+// and updates t if the shape is hit at a distance in [0, t).  The ray
+// direction need not be normalized.
+
+/** The unit sphere at the origin. */
+bool ray_unit_sphere( const vector& origin, const vector& dir, double& t);
+/** The axis-aligned box from mins to maxs. */
+bool ray_box( const vector& origin, const vector& dir,
+	const vector& mins, const vector& maxs, double& t);
+/** A cylinder of radius 1 from the origin to (1,0,0), including its ends. */
+bool ray_unit_cylinder( const vector& origin, const vector& dir, double& t);
+/** A cone with a base of radius 1 at the origin and its tip at (1,0,0). */
+bool ray_unit_cone( const vector& origin, const vector& dir, double& t);
+/** A triangle, hit from either side. */
+bool ray_triangle( const vector& origin, const vector& dir,
+	const vector& a, const vector& b, const vector& c, double& t);
+/** A sphere of radius r around center.  dir must be normalized. */
+bool ray_sphere( const vector& origin, const vector& dir,
+	const vector& center, double r, double& t);
+
+/** Finds the object under the mouse by casting a ray against the analytic
+	shapes of the bodies in the scene, rather than by rendering them again in
+	GL_SELECT mode.  The bodies are sorted into a bounding volume hierarchy
+	built from the bounds that they report through grow_extent(), so a pick
+	costs O(log n) intersection tests.
+
+	The hierarchy is built on the first call to pick(), so an engine that is
+	never asked costs only the list of references.  An engine is kept from
+	frame to frame: if the same bodies are added again, only those whose
+	extent_version() has changed are measured again, and the hierarchy is
+	refit around them rather than rebuilt.  All functions must be called with
+	the GIL held, since they work on the live objects.
+*/
+class pick_engine
+{
+ public:
+	pick_engine();
+	~pick_engine();
+
+	/** Forget the bodies added so far, to add those of another frame. */
+	void clear();
+	/** Add a top-level body to be considered.  Must be called before pick(). */
+	void add( const shared_ptr<renderable>& obj);
+
+	/** Find the nearest body that ray hits, if any.  If one is found, it is
+		returned and pickpos is set to the point where it was hit.
+	*/
+	shared_ptr<renderable> pick( const pick_ray& ray, vector& pickpos);
+
+ private:
+	struct node
+	{
+		vector mins, maxs;
+		/** For a leaf, the range of indexes into bodies.  For an inner node,
+			first is the index of the second child; the first child
+			immediately follows this node.
+		*/
+		size_t first, count;
+	};
+	struct body
+	{
+		shared_ptr<renderable> obj;
+		unsigned long version; ///< obj->extent_version() when measured
+		vector mins, maxs;
+		bool empty;
+	};
+
+	// The bodies added since the last call to clear().
+	std::vector<shared_ptr<renderable> > objects;
+	// The bodies that the hierarchy was built from.
+	std::vector<body> bodies;
+	// The nonempty bodies, as indexes into bodies, in the order of the leaves.
+	std::vector<size_t> leaves;
+	std::vector<node> nodes;
+
+	// Measure b if its extent has changed (or always, if force), and return
+	// true if it was measured.
+	static bool measure( body& b, bool force);
+	// Bring the hierarchy up to date with objects.
+	void update();
+	void build();
+	void build_node( size_t begin, size_t end);
+	void refit();
+	static bool hit_node( const node&, const pick_ray&, double t);
+};
+
+/** The answer to "what is under the mouse" for one frame, computed the first
+	time that Python asks for it through mouse.pick or mouse.pickpos.  Shared by
+	the mouse and by the events generated before the next frame.
+*/
+class lazy_pick
+{
+ public:
+	lazy_pick( const shared_ptr<pick_engine>& engine, const pick_ray& ray);
+
+	/** Must be called with the GIL held. */
+	shared_ptr<renderable> get_pick();
+	/** Must be called with the GIL held. */
+	vector get_pickpos();
+
+	/** Find the pick now, if it hasn't been found yet, while the engine still
+		holds the bodies of this frame.  Must be called with the GIL held.
+	*/
+	void evaluate();
+
+ private:
+
+	shared_ptr<pick_engine> engine; ///< Released once evaluated.
+	pick_ray ray;
+	shared_ptr<renderable> pick;
+	vector pickpos;
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_PICK_ENGINE_HPP
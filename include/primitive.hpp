@@ -17,6 +17,8 @@ namespace cvisual {
 
 using boost::python::object;
 
+namespace python { class arrayprim; }
+
 // All primitive subclasses should use this pair of macros to help with standard
 // error messages.  This allows functions to use the exact name of a virtual class.
 #define PRIMITIVE_TYPEINFO_DECL virtual const std::type_info& get_typeid() const
@@ -25,6 +27,21 @@ using boost::python::object;
 	base::get_typeid() const \
 	{ return typeid(*this); }
 
+// Primitives whose render state is entirely contained in their data members
+// (no per-object GL or Python resources) use this pair of macros to implement
+// renderable::snapshot() by copy assignment into a persistent private copy.
+#define PRIMITIVE_SNAPSHOT_DECL virtual renderable* snapshot()
+#define PRIMITIVE_SNAPSHOT_IMPL(base) \
+	renderable* \
+	base::snapshot() \
+	{ \
+		if (!frame_copy) \
+			frame_copy.reset( new base(*this)); \
+		else \
+			*static_cast<base*>(frame_copy.get()) = *this; \
+		return frame_copy.get(); \
+	}
+
 class primitive : public renderable
 {
  protected:
@@ -33,17 +50,40 @@ class primitive : public renderable
 	shared_vector up;
 	shared_vector pos;
 
-	bool make_trail, trail_initialized, obj_initialized;
-	boost::python::object primitive_object;
+	bool make_trail;
+	// The curve or points that make_trail appends pos to, and the Python
+	// object that owns it; see set_trail_object().  The trail is kept here,
+	// rather than by Python, so that moving an object with a trail costs no
+	// call back into Python.
+	python::arrayprim* trail;
+	boost::python::object trail_object;
+	int trail_retain;   // As for arrayprim::append(); -1 keeps every point.
+	int trail_interval; // Append every trail_interval'th position.
+	int trail_count;    // Positions set since the last one appended.
+
+	// Called whenever pos changes.
+	void update_trail();
+
+	// The copy of this object that is rendered without the GIL; see
+	// PRIMITIVE_SNAPSHOT_IMPL.  Never copied or assigned.
+	shared_ptr<renderable> frame_copy;
 
 	// Returns a tmatrix that performs reorientation of the object from model
 	// orientation to world (and view) orientation.
 	tmatrix model_world_transform( double world_scale = 0.0, const vector& object_scale = vector(1,1,1) ) const;
+
+	// Transforms ray into the model space of model_world_transform( 1.0, object_scale),
+	// for use by ray_intersect().  Distances along the ray are unchanged, so dir
+	// is not normalized.  Returns false if object_scale is degenerate.
+	bool model_ray( const pick_ray& ray, const vector& object_scale,
+		vector& origin, vector& dir) const;
  
 	// Generate a displayobject at the origin, with up pointing along +y and
 	// an axis = vector(1, 0, 0).
 	primitive();
 	primitive( const primitive& other);
+	// Copies only the render state, like the copy constructor.
+	primitive& operator=( const primitive& other);
 	
 	// See above for PRIMITIVE_TYPEINFO_DECL/IMPL.
 	virtual const std::type_info& get_typeid() const;
@@ -93,8 +133,16 @@ class primitive : public renderable
 	void set_make_trail( bool x);
 	bool get_make_trail();
 
-	void set_primitive_object( boost::python::object x);
-	boost::python::object get_primitive_object();
+	// Set the curve or points object to append to, which owns trail.  A
+	// null trail stops the trail.
+	void set_trail_object( python::arrayprim* trail, boost::python::object owner);
+	boost::python::object get_trail_object();
+
+	void set_retain( int n);
+	int get_retain();
+
+	void set_interval( int n);
+	int get_interval();
 };
 
 } // !namespace cvisual
@@ -8,6 +8,7 @@
 
 #include "rectangular.hpp"
 #include "util/displaylist.hpp"
+#include "util/mesh.hpp"
 
 #include <boost/scoped_ptr.hpp>
 
@@ -20,16 +21,22 @@ class pyramid : public rectangular
  private:
 	static displaylist model;
 	static void init_model();
+	static mesh batch_model;
+	static void init_mesh();
+	// Intersect a ray with the unit model, in the coordinates of init_model().
+	static bool ray_intersect_model( const vector& origin, const vector& dir, double& t);
 	friend class arrow;
 	
  protected:
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void gl_render( const view&);
+	virtual bool add_to_batch( const view&, instance_batch&);
 	virtual void grow_extent( extent&);
 	virtual vector get_center() const;
 	virtual void get_material_matrix( const view&, tmatrix& out );
 
 	PRIMITIVE_TYPEINFO_DECL;
+	PRIMITIVE_SNAPSHOT_DECL;
 };
 
 } // !namespace cvisual
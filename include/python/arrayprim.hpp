@@ -8,32 +8,102 @@
 #include "renderable.hpp"
 #include "python/num_util.hpp"
 #include "python/slice.hpp"
+#include "util/vertex_buffer.hpp"
+
+#include <algorithm>
 
 namespace cvisual { namespace python {
 
+// A range of points [begin, end) that have changed, for renderers that keep a
+// copy of an array (e.g. in a vertex buffer).  Empty when begin >= end.
+struct dirty_range {
+	size_t begin, end;
+
+	dirty_range() : begin(0), end(0) {}
+	dirty_range( size_t b, size_t e ) : begin(b), end(e) {}
+
+	void add( size_t b, size_t e ) {
+		if (b >= e) return;
+		if (begin >= end) { begin = b; end = e; return; }
+		begin = std::min( begin, b );
+		end = std::max( end, e );
+	}
+	// Get the range, clipped to [0, limit), and forget it.  Returns false if
+	// there is nothing left.
+	bool take( size_t& b, size_t& e, size_t limit ) {
+		b = begin;
+		e = std::min( end, limit );
+		begin = end = 0;
+		return b < e;
+	}
+};
+
 // An Nx3 array of CTYPES, specialized for use in array primitives.  This class
 // should not go anywhere except inside an array primitive, not even as a return
-// value for primitive.pos or whatever.
+// value for primitive.pos or whatever.  Per-point scalars (e.g. a radius for
+// each point) are kept in an Nx1 array, made by passing 1 for columns.
+//
+// The array is a view of the rows [start, allocated) of a larger storage
+// array.  Dropping points from the front (for retain) just moves start
+// forward; the points are only moved back to the beginning of the storage
+// when the array has to grow past its end, which happens at most once for
+// every allocated/2 points added.
 template <class CTYPE>
 class arrayprim_array : public array, private boost::noncopyable {
 protected:
+	array storage;
+	size_t columns;    // values per point, usually 3
+	size_t start;      // the row of storage where the points begin
 	size_t length;     // number of points in the array primitive
-	size_t allocated;  // == shape(*this)[0]
+	size_t allocated;  // == shape(storage)[0]
+	dirty_range dirty; // rows of storage changed since the last take_dirty()
+
+	void set_start( size_t new_start );
 
 public:
-	arrayprim_array();
-	arrayprim_array( const arrayprim_array& r )  //< Actually copies, to avoid aliasing between array primitives
-		: array(object(r)) {}
+	explicit arrayprim_array( size_t columns = 3 );
+	arrayprim_array( const arrayprim_array& r ); //< Actually copies, to avoid aliasing between array primitives
 
 	void set_length( size_t new_len );
-
-	CTYPE* data(int index=0) { return (CTYPE*)cvisual::python::data(*this) + index*3; }
+	size_t size() const { return length; }
+	// The row of the storage where point 0 is kept.  Renderers that keep a copy
+	// of the whole storage find the points there.
+	size_t offset() const { return start; }
+
+	// True if Python may hold a view of the array, through which it can be
+	// changed in place.  Depending on the version of numpy, such a view refers
+	// either to this array or to its storage.
+	bool exposed() const { return Py_REFCNT( ptr()) > 1 || Py_REFCNT( storage.ptr()) > 2; }
+
+	// Record that points [begin, end) have changed, for renderers that keep a
+	// copy of the array (e.g. in a vertex buffer).  The callers of data() are
+	// responsible for this; set_length() does it for the points it moves.
+	void mark_dirty( size_t begin, size_t end ) { dirty.add( start+begin, start+end ); }
+	void mark_dirty() { mark_dirty( 0, length ? length : 1 ); }
+	// Get the range of rows of the storage (not points; see offset()) changed
+	// since the last call, and forget it.  Returns false if nothing has
+	// changed.  While Python holds a view of the array it may have been
+	// changed in place, so all of it is reported.
+	bool take_dirty( size_t& begin, size_t& end );
+
+	CTYPE* data(int index=0) { return (CTYPE*)cvisual::python::data(*this) + index*columns; }
 	CTYPE* end() { return data(length); }
 
-	const CTYPE* data(int index=0) const { return (const CTYPE*)cvisual::python::data(*this) + index*3; }
+	const CTYPE* data(int index=0) const { return (const CTYPE*)cvisual::python::data(*this) + index*columns; }
 	const CTYPE* end() const { return data(length); }
 };
 
+// Copy rows [begin, end) of the storage of array into buffer, as floats, so
+// that the buffer mirrors the storage and point 0 is at array.offset().  If the
+// buffer has to grow, all of the points are copied instead.
+void upload_points( const view& v, const arrayprim_array<double>& array,
+	size_t begin, size_t end, vertex_buffer& buffer );
+// Where to find point 0 of array in a buffer filled by upload_points(), as the
+// pointer argument for glVertexPointer() and friends.
+inline const GLvoid* buffer_offset( const arrayprim_array<double>& array ) {
+	return (const GLvoid*)(array.offset() * 3 * sizeof(float));
+}
+
 class arrayprim : public renderable {
 protected:
 	size_t count;
@@ -43,9 +113,15 @@ protected:
 
 	arrayprim_array<double> pos;
 
+	// True if get_pos() has been called since the last call to
+	// extent_version(), through which pos may have been modified in place.
+	bool pos_exposed;
+
 public:
 	arrayprim();
 
+	virtual unsigned long extent_version();
+
 	boost::python::object get_pos(void);
 
 	void set_pos( const double_array& pos );    // An Nx3 array of doubles
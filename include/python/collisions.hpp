@@ -0,0 +1,33 @@
+#ifndef VPYTHON_PYTHON_COLLISIONS_HPP
+#define VPYTHON_PYTHON_COLLISIONS_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "python/num_util.hpp"
+
+namespace cvisual { namespace python {
+
+/** Find every pair of overlapping spheres, for simulations like
+	examples/gas.py.  The spheres are sorted into a uniform grid of cells as
+	wide as the largest sphere, so only the spheres in neighboring cells are
+	compared, and the time taken is roughly proportional to the number of
+	spheres plus the number of collisions rather than to its square.
+
+	@param pos An Nx3 array of the centers of the spheres.
+	@param radius An array of N radii, or a single radius for all of them.
+	@param threads The number of parts to divide the work into.  They run
+		at once on the worker threads of parallel_for().
+	@return An Mx2 array of integer indexes into pos, one row (i, j) with
+		i < j for each pair of spheres no farther apart than the sum of
+		their radii,
+		in increasing order.
+*/
+array
+sphere_intercollisions( const double_array& pos, const double_array& radius,
+	int threads = 1);
+
+} } // !namespace cvisual::python
+
+#endif // !defined VPYTHON_PYTHON_COLLISIONS_HPP
@@ -7,8 +7,8 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "renderable.hpp"
-#include "util/sorted_model.hpp"
 #include "python/arrayprim.hpp"
+#include "util/quickhull.hpp"
 
 #include <vector>
 
@@ -17,36 +17,6 @@ namespace cvisual { namespace python {
 class convex : public arrayprim
 {
  private:
-	struct face : triangle
-	{
-		double d;
-		inline face( const vector& v1, const vector& v2, const vector& v3)
-			: triangle( v1, v2, v3), d( normal.dot(corner[0]))
-		{
-		}
-		
-		inline bool visible_from( const vector& p)
-		{ return normal.dot(p) > d; }
-	};
-	
-	struct edge
-	{
-		vector v[2];
-		inline edge( vector a, vector b)
-		{ v[0]=a; v[1]=b; }
-
-		inline bool
-		operator==( const edge& b) const
-		{
-			// There are two cases where a pair of edges are equal, the first is
-			// occurs when the endpoints are both the same, while the other occurs 
-			// when the edge have the same endpoints in opposite directions.  
-			// Since the first case never happens when we construct the hull, we
-			// only test for the second case here.
-			return (v[0] == b.v[1] && v[1] == b.v[0]);
-		}
-	};
-	
 	struct jitter_table
 	{
 		enum { mask = 1023 };
@@ -61,14 +31,28 @@ class convex : public arrayprim
 	}; 
 	static jitter_table jitter;  // Use default construction for initialization.
 	
+	// Python can change pos in place through a view of it without marking it
+	// dirty, so while it holds one, changes are detected by checksum.
 	long last_checksum;
 	long checksum() const;
 	bool degenerate() const;
 	
-	// Hull construction routines.
+	// Hull construction routines.  The hull is rebuilt when points change,
+	// and only extended when points are appended.
+	void update();
 	void recalc();
-	void add_point( size_t, vector);
-	std::vector<face> hull;
+	void append_points();
+	vector jittered( size_t) const;
+	void build_mesh();
+
+	quickhull hull; ///< Of the jittered points, as of the last update.
+	size_t hull_start; ///< pos.offset() as of the last update.
+
+	// The triangles of the hull, drawn with vertex arrays: for each corner,
+	// the normal of its face and its position.  The corners are repeated for
+	// each face, so that every face can have its own normal.
+	std::vector<float> mesh;
+	vector center;
 	vector min_extent, max_extent;
 	
  public:
@@ -80,7 +64,7 @@ class convex : public arrayprim
  protected:
 	virtual void gl_render( const view&);
 	virtual vector get_center() const;
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void grow_extent( extent&);
 	virtual void get_material_matrix( const view&, tmatrix& out );
 };
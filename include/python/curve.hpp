@@ -10,6 +10,8 @@
 #include "util/displaylist.hpp"
 #include "python/num_util.hpp"
 #include "python/arrayprim.hpp"
+#include "util/vertex_buffer.hpp"
+#include <deque>
 
 namespace cvisual { namespace python {
 
@@ -25,20 +27,19 @@ class curve : public arrayprim_color
 	// in the array.  This is simmilar to many implementations of std::vector<>.
 	bool antialias;
 	double radius;
+	// The distance in pixels that the displayed curve may stray from the
+	// true one when it is simplified for display.  0 displays every point.
+	double simplify;
 
 	static const int MAX_SIDES = 20;
 	size_t sides;
-	int curve_slice[512];
 	float curve_sc[2*MAX_SIDES];
 
-	// Returns true if the object is single-colored.
-	bool monochrome(float* tcolor, size_t pcount);
-
 	virtual void outer_render( const view&);
 	virtual void gl_render( const view&);
 	virtual vector get_center() const;
-	virtual void gl_pick_render( const view&);
 	virtual void grow_extent( extent&);
+	virtual void set_length( size_t);
 	void get_material_matrix( const view& v, tmatrix& out );
 
 	// Returns true if the object is degenarate and should not be rendered.
@@ -49,13 +50,81 @@ class curve : public arrayprim_color
 
 	inline bool get_antialias( void) { return antialias; }
 	inline double get_radius( void) { return radius; }
+	inline double get_simplify( void) { return simplify; }
 
 	void set_antialias( bool);
 	void set_radius( const double& r);
+	void set_simplify( const double& pixels);
 
  private:
-	bool adjust_colors( const view& scene, float* tcolor, size_t pcount);
-	void thickline( const view&, double* spos, float* tcolor, size_t pcount, double scaled_radius);
+	// Everything below is derived from pos and color, and kept between frames
+	// so that a frame only does work for the points that changed.
+
+	// Changes not yet seen by the line (in rows of the storage of pos and
+	// color) and by the tube (in points).
+	dirty_range line_pos_dirty, line_color_dirty, tube_dirty;
+	// True if every point has the same color, so that no color array is
+	// needed.
+	bool mono;
+
+	// For simplify: the largest tolerance at which each point survives
+	// Douglas-Peucker simplification, and the bounds of the points.
+	std::vector<float> importance;
+	bool importance_valid;
+	vector bounds_min, bounds_max;
+	// The points kept at a tolerance of 2**selected_level, or empty to use
+	// them all.
+	std::vector<GLuint> selected;
+	int selected_level;
+
+	// The thin line (radius == 0), drawn straight from copies of pos and color.
+	vertex_buffer line_pos_buffer, line_color_buffer;
+
+	// The tessellated tube (radius != 0).  Each corner of the path has a ring
+	// of sides vertices ending the segment before it and another starting the
+	// segment after it, plus a cap at each end of an open curve.  Dropping
+	// points from the front (for retain) drops their corners from the front of
+	// the deques, and skips their rings in the vertex arrays, so that only
+	// the new corners at the end are tessellated.
+	size_t tube_corners; ///< The corners tessellated so far; 0 forces a rebuild.
+	size_t tube_dropped; ///< Points dropped from the front since the last frame.
+	bool tube_closed;
+	std::deque<vector> tube_start; ///< The ring starting each segment...
+	std::deque<vector> tube_start_normal; ///< ...and its unsmoothed normals.
+	std::deque<vector> tube_dir; ///< The direction of each segment.
+	// The joint at each corner, found by walking the path before the rings
+	// are built.
+	std::deque<vector> tube_bisector; ///< The normal to the plane of the joint.
+	std::deque<double> tube_sectheta; ///< 1/cos of the angle of the joint, or 0.
+	std::deque<double> tube_adot; ///< The length of the segment after the corner.
+	std::vector<float> tube_pos, tube_normal, tube_color; ///< 3 floats per vertex.
+	// The vertices of dropped corners at the start of the vertex arrays, which
+	// are compacted away once they outnumber the rest.
+	size_t tube_skip;
+	// Vertices changed by dropping corners (the new cap, or everything when
+	// the arrays are compacted) that have not been uploaded.
+	dirty_range tube_moved;
+	std::vector<GLuint> tube_indices;
+	vertex_buffer tube_pos_buffer, tube_normal_buffer, tube_color_buffer;
+	vertex_buffer tube_index_buffer;
+
+	void update_mono( size_t begin, size_t end);
+	void update_importance();
+	bool update_selection( const view&);
+	void gl_set_color( const view&);
+	size_t corner( size_t k) const;
+
+	void render_line( const view&);
+	void render_tube( const view&, bool reselected);
+	void drop_corners( size_t dropped);
+	bool tessellate( size_t first, size_t n, size_t& first_ring);
+	// The parts of tessellate() that run on worker threads.  Each ring vertex
+	// follows the same vertex of the ring before it, so the rings are built
+	// a side at a time; the joints and triangles are divided along the path.
+	void tessellate_rings( size_t first, size_t n, vector x, vector y,
+		size_t begin, size_t end);
+	void smooth_joints( size_t first, size_t begin, size_t end);
+	void tessellate_indices( size_t first, size_t begin, size_t end);
 };
 
 } } // !namespace cvisual::python
@@ -10,6 +10,7 @@
 #include "util/displaylist.hpp"
 #include "python/num_util.hpp"
 #include "python/arrayprim.hpp"
+#include "util/vertex_buffer.hpp"
 
 namespace cvisual { namespace python {
 
@@ -47,15 +48,38 @@ class extrusion : public arrayprim_color
 
 	bool antialias;
 
-	// Returns true if the object is single-colored.
-	bool monochrome(double* tcolor, size_t pcount);
+	// The extruded surface, as triangles in world coordinates.  It is kept
+	// from frame to frame, and extruded again only when the geometry changes.
+	std::vector<vector> mesh_pos, mesh_normals, mesh_colors;
+	// Where the triangles made at each point of the path begin in the mesh, or
+	// (size_t)-1 if none begin there.  Points appended to the path only require
+	// extruding again from the previous last point onward.
+	std::vector<size_t> mesh_corner;
+	bool mesh_changed; // set by anything but pos, color and scale that changes the geometry
+	bool mesh_closed; // true if the path was closed when the mesh was extruded
+	size_t mesh_count; // the number of points extruded
+	size_t mesh_offset; // pos.offset() when the mesh was extruded
+	// Copies of the mesh in GPU memory, used where the driver supports vertex
+	// buffers.  Only the vertices added since the last frame are uploaded.
+	vertex_buffer mesh_pos_buffer, mesh_normal_buffer, mesh_color_buffer;
+	size_t mesh_uploaded; // vertices of the mesh held by the buffers
+
+	// Extrude as much of the mesh as has changed since the last call.
+	void update_mesh();
+	void gl_render_buffers( const view&);
+	void gl_render_arrays( const view&);
 
 	virtual void outer_render( const view&);
 	virtual void gl_render( const view&);
 	virtual vector get_center() const;
-	virtual void gl_pick_render( const view&);
+	// Hit tests the triangles of the mesh.
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	void get_material_matrix( const view& v, tmatrix& out );
 	virtual void grow_extent( extent&);
+	// The extent also depends on the contours, scale, twist, start and end,
+	// and grow_extent() recomputes maxextent, so it is measured every frame
+	// to see whether it has changed, rather than tracking pos alone.
+	virtual unsigned long extent_version() { return renderable::extent_version(); }
 
 	// Returns true if the object is degenerate and should not be rendered.
  	bool degenerate() const;
@@ -125,11 +149,34 @@ class extrusion : public arrayprim_color
 	void set_antialias( bool);
 
  private:
-	bool adjust_colors( const view& scene, double* tcolor, size_t pcount);
-	void extrude(const view& scene,
-			std::vector<vector>& faces_pos,
+	// The joints at both ends of one segment of the path, found while walking
+	// the path, from which the sides of the segment are made.
+	struct segment {
+		vector prev, current; // the ends of the segment
+		vector prevxrot, prevy, xrot, y; // the axes of the joints
+		vector prevxaxis, prevyaxis, xaxis, yaxis, nextxaxis, nextyaxis;
+		vector prev_color, current_color;
+		double prevc11, prevc12, prevc21, prevc22; // rotation coefficients at the joints
+		double c11, c12, c21, c22;
+		float prevscalex, prevscaley, scalex, scaley;
+		size_t offset; // where its triangles go in the arrays
+	};
+
+	// Make the sides of segments [begin, end), into the places they were
+	// given in the arrays.  Segments may be made in parallel.
+	void extrude_sides(const std::vector<segment>& segments,
+			std::vector<vector>* faces_pos,
+			std::vector<vector>* faces_normals,
+			std::vector<vector>* faces_colors, bool make_faces, size_t begin, size_t end);
+
+	// Extrude the path into triangles, one-sided if make_faces, else
+	// two-sided if twosided.  Unless make_faces, this updates mesh_corner,
+	// and if resume is not 0 only the triangles from point resume onward are
+	// made again, replacing those at the end of the arrays.  Returns the number
+	// of vertices kept at the beginning of the arrays.
+	size_t extrude(std::vector<vector>& faces_pos,
 			std::vector<vector>& faces_normals,
-			std::vector<vector>& faces_colors, bool make_faces);
+			std::vector<vector>& faces_colors, bool make_faces, size_t resume = 0);
 	void render_end(const vector V, const vector current,
 			const double c11, const double c12, const double c21, const double c22,
 			const vector xrot, const vector y, const vector current_color, bool show_first,
@@ -7,6 +7,7 @@
 
 #include "renderable.hpp"
 #include "python/arrayprim.hpp"
+#include "util/vertex_buffer.hpp"
 
 #include <boost/python/object.hpp>
 
@@ -17,11 +18,21 @@ class faces : public arrayprim_color
  protected:
 	arrayprim_array<double> normal; // An array of normal vectors for the faces.
 
+	// Copies of pos, normal and color in GPU memory, used where the driver
+	// supports vertex buffers.  Only the points that changed since the last
+	// frame are uploaded again.
+	vertex_buffer pos_buffer;
+	vertex_buffer normal_buffer;
+	vertex_buffer color_buffer;
+
+	void gl_render_buffers( const view&);
+	void gl_render_arrays( const view&);
+
 	virtual void set_length(size_t);
 
 	bool degenerate() const;
 	virtual void gl_render( const view&);
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual vector get_center() const;
 	virtual void grow_extent( extent&);
 	virtual void get_material_matrix( const view&, tmatrix& );
@@ -0,0 +1,87 @@
+#ifndef VPYTHON_PYTHON_PARTICLES_HPP
+#define VPYTHON_PYTHON_PARTICLES_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "python/arrayprim.hpp"
+#include "util/instance_batch.hpp"
+
+#include <string>
+
+namespace cvisual { namespace python {
+
+/** Many spheres or boxes, drawn and picked as one body, with the position,
+	radius, color, axis and opacity of each one kept in arrays.  A program
+	animates all of them with one assignment to a slice of an array (e.g.
+	p.pos[:] = new_pos), rather than by setting an attribute of each of as
+	many primitives.
+
+	A sphere's radius is its radius; a box is a cube with sides of twice its
+	radius, so that it just contains the sphere of the same radius, turned so
+	that its x axis lies along its axis.  Only the direction of an axis
+	matters, and spheres ignore it.  Materials are ignored.
+
+	Opaque shapes are drawn through an instance_batch, small spheres (or all
+	of them, with scene.impostors) as impostors.  If any of them are
+	translucent, the body is drawn with the translucent objects, and those
+	shapes are drawn one at a time from back to front.  When the transparent
+	layer is blended, the opaque shapes are drawn with the opaque layer
+	instead, and the translucent ones in any order (see view::parts).
+*/
+class particles : public arrayprim_color
+{
+ private:
+	enum { SPHERE, BOX } particle_shape;
+
+	arrayprim_array<double> radius;  ///< Nx1
+	arrayprim_array<double> opacity; ///< Nx1
+	arrayprim_array<double> axis;    ///< Nx3
+
+	// True if get_radius() has been called since the last call to
+	// extent_version(); see arrayprim::pos_exposed.
+	bool radius_exposed;
+
+	instance_batch batch;
+	std::vector<double> depth;
+	std::vector<size_t> order;
+
+	bool degenerate() const;
+	// The rotation (for boxes) and translation of shape i, without its scale.
+	tmatrix placement( size_t i, double gcf) const;
+
+	virtual void set_length( size_t);
+
+	virtual void outer_render( const view&);
+	virtual void gl_render( const view&);
+	virtual vector get_center() const;
+	virtual bool translucent();
+	virtual bool mixed_opacity();
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
+	virtual void grow_extent( extent&);
+
+ public:
+	particles();
+	particles( const particles& other);
+
+	virtual unsigned long extent_version();
+
+	void set_shape( const std::string& n_shape);
+	std::string get_shape();
+
+	boost::python::object get_radius();
+	void set_radius( const double_array& radius);   // An array of N radii
+	void set_radius_d( double radius);               // The same for all
+
+	boost::python::object get_opacity();
+	void set_opacity( const double_array& opacity); // An array of N opacities
+	void set_opacity_d( double opacity);             // The same for all
+
+	boost::python::object get_axis();
+	void set_axis( const double_array& axis);       // Nx3, or one for all
+};
+
+} } // !namespace cvisual::python
+
+#endif // !defined VPYTHON_PYTHON_PARTICLES_HPP
@@ -26,7 +26,7 @@ class points : public arrayprim_color
 	virtual void outer_render( const view&);
 	virtual void gl_render( const view&);
 	virtual vector get_center() const;
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void grow_extent( extent&);
 	
  public:
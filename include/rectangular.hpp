@@ -14,6 +14,10 @@ class rectangular : public primitive
 	rectangular( const rectangular& other);
 
 	void apply_transform( const view& );
+	/** The transform applied by apply_transform(). */
+	tmatrix get_transform( const view& );
+	/** The scale used by get_transform(), which is never singular. */
+	vector get_render_size() const;
 
  public:
 	virtual ~rectangular();
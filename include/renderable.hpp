@@ -12,6 +12,7 @@
 #include "util/displaylist.hpp"
 #include "util/texture.hpp"
 #include "util/gl_extensions.hpp"
+#include "util/frustum.hpp"
 #include <boost/shared_ptr.hpp>
 
 #include <map>
@@ -20,6 +21,10 @@ namespace cvisual {
 
 using boost::shared_ptr;
 class renderable;
+class instance_batch;
+struct screen_label;
+struct pick_ray;
+struct pick_hit;
 
 const int N_LIGHT_TYPES = 1;
 
@@ -103,14 +108,41 @@ struct view
 	gl_extensions& glext;
 
 	tmatrix camera_world;
+	/** The projection times the modelview transform of this coordinate system,
+		found once per eye so that objects in screen space can be placed without
+		reading the matrices back from OpenGL.
+	*/
+	tmatrix world_clip;
+	/** What can be seen, in the coordinates of this view, for culling objects
+		that are out of sight (see renderable::culled()).  Contains everything
+		when objects must not be culled.
+	*/
+	frustum visible;
+	/** The number of objects (or whole frames) skipped by culling while
+		drawing with this view.
+	*/
+	mutable int culled_objects;
 
 	int light_count[N_LIGHT_TYPES];
 	std::vector<float> light_pos, light_color; // in eye coordinates!
 
-	typedef std::multimap<vector, displaylist, z_comparator> screen_objects_t;
+	/// Labels to be drawn after the rest of the scene, by depth.  See
+	/// screen_label.
+	typedef std::multimap<vector, shared_ptr<screen_label>, z_comparator>
+		screen_objects_t;
 	mutable screen_objects_t screen_objects;
 
 	bool enable_shaders;
+	/// True to draw every opaque sphere as an impostor; see sphere::impostor().
+	bool impostors;
+	/** Which parts of a body with renderable::mixed_opacity() to draw.  When
+		the transparent layer is blended (see blended_transparency), such a
+		body is drawn twice: its opaque parts with the opaque layer, and then
+		its translucent parts, in any order, with the transparent layer.
+		Otherwise it is drawn whole with the transparent layer, its
+		translucent parts sorted from back to front.
+	*/
+	enum parts_t { ALL_PARTS, OPAQUE_PARTS, TRANSLUCENT_PARTS } parts;
 
 	view( vector n_forward, vector n_center, int n_width,
 		int n_height, bool n_forward_changed,
@@ -148,16 +180,38 @@ public:
 	virtual void outer_render(const view&);
 
 
-	/** Called when rendering for mouse hit testing.  Since the result is not
-	 *  visible, subclasses should not perform texture mapping or blending,
-	 * and should use the lowest-quality level of detail that covers the
-	 * geometry.
+	/** Called for mouse hit testing (see pick_engine).  If ray hits this
+	 * object closer than hit.t, set hit.t to the distance along the ray and
+	 * return true.  The ray is in the coordinates that grow_extent() reports
+	 * in.  The default is not to be pickable.
 	 */
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray& ray, pick_hit& hit);
 
 	/** Report the total extent of the object. */
 	virtual void grow_extent( extent&);
 
+	/** Add the extent of this object to world, which must be a top-level
+	 * extent (see extent::add_extent()).  grow_extent() is only called if
+	 * extent_version() has changed since the last call, so that objects
+	 * with many vertices are not measured again every frame.
+	 */
+	void grow_extent_cached( extent& world);
+
+	/** Returns a number that changes whenever the extent reported by
+	 * grow_extent() may have changed.  The default, for objects that are
+	 * cheap to measure, calls grow_extent() and changes only when the result
+	 * differs from the last call's, so that it also sees attributes changed
+	 * in place from Python.  Must be called with the GIL held.
+	 */
+	virtual unsigned long extent_version();
+
+	/** The extent that the default extent_version() measured at its last
+	 * call, in this object's own coordinates, or null if extent_version() is
+	 * overridden and measures nothing.  Lets a caller that has just checked
+	 * the version use the extent without measuring it again.
+	 */
+	const extent_data* measured_extent() const;
+
 	/** Report the approximate center of the object.  This is used for depth
 	 * sorting of the transparent models.  */
 	virtual vector get_center() const = 0;
@@ -169,12 +223,47 @@ public:
 
 	virtual bool translucent();
 
+	/** True if this translucent body also has opaque parts, which must be
+	 * drawn with the opaque layer when the transparent layer is blended; see
+	 * view::parts.  The default is false: a translucent object is
+	 * translucent throughout.
+	 */
+	virtual bool mixed_opacity() { return false; }
+
 	virtual void render_lights( view& ) {}
 
 	virtual bool is_light() { return false; }
 
 	virtual void get_children( std::vector< boost::shared_ptr<renderable> >& all ) {}
 
+	/** Copy the state used by outer_render() into a
+	 * private copy of this object, which is returned.  Called once per frame
+	 * with the GIL held; the returned object is then rendered without the GIL.
+	 * The default returns NULL, meaning that this object must be rendered
+	 * with the GIL held.
+	 */
+	virtual renderable* snapshot() { return 0; }
+
+	/** Queue this object in batch instead of drawing it, if it is simply a
+	 * transformed, colored copy of a shared mesh.  Called in place of
+	 * outer_render() for opaque objects only.  The default returns false,
+	 * meaning that the object must be drawn with outer_render().
+	 */
+	virtual bool add_to_batch( const view&, instance_batch& ) { return false; }
+
+	/** True if the object is certainly out of sight in the view, so that it
+	 * need not be drawn; see view::visible.  Called on the same object as
+	 * outer_render() or add_to_batch(), just before them.  The default never
+	 * culls, since some objects (labels, points sized in pixels) reach
+	 * beyond the extent that they report.
+	 */
+	virtual bool culled( const view& ) { return false; }
+	/** True if culled() tests the whole of what the object draws against its
+	 * extent, so that a frame may be culled by the extent of its children
+	 * when all of them are cullable.  False by default, like culled().
+	 */
+	virtual bool cullable() { return false; }
+
 protected:
 	renderable();
 
@@ -190,6 +279,25 @@ protected:
 	 * is to do nothing.
 	 */
 	virtual void gl_render(const view&);
+
+	/** Incremented by extent_changed(). */
+	unsigned long extent_serial;
+	/** For subclasses that override extent_version() to return
+	 * extent_serial: call this whenever the extent may have changed.
+	 */
+	void extent_changed() { ++extent_serial; }
+
+private:
+	/** The result of the last call to grow_extent() from
+	 * grow_extent_cached(), in world space, and the extent_version() that it
+	 * was measured at.
+	 */
+	shared_ptr<extent_data> extent_cache;
+	unsigned long extent_cache_version;
+	/** What the default extent_version() measured at its last call. */
+	extent_data extent_measured;
+	/** True once the default extent_version() has run. */
+	bool extent_measured_valid;
 };
 
 inline bool
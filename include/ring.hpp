@@ -55,7 +55,7 @@ class ring : public axial
 	double get_thickness();
 
  protected:
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	virtual void gl_render( const view&);
 	virtual void grow_extent( extent&);
 	void get_material_matrix(const view&, tmatrix& out);
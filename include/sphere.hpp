@@ -8,9 +8,12 @@
 
 #include "axial.hpp"
 #include "util/displaylist.hpp"
+#include "util/mesh.hpp"
 
 namespace cvisual {
 
+namespace python { class particles; }
+
 /** A simple monochrome sphere. 
  */
 class sphere : public axial
@@ -24,6 +27,21 @@ class sphere : public axial
  	static displaylist lod_cache[6];
 	/// True until the first sphere is rendered, then false.
 	static void init_model();
+	/** The same levels of detail as lod_cache, for batched rendering. */
+	static mesh lod_mesh[6];
+	static void init_mesh();
+	/** Choose an entry in the level-of-detail cache based on the size of
+		the sphere on the screen.
+	*/
+	int get_lod( const view&);
+	/** The level of detail for a sphere whose radius covers coverage pixels. */
+	static int get_lod( const view&, double coverage);
+	/** True if an opaque sphere whose radius covers coverage pixels should be
+		batched as an impostor rather than a mesh: when view::impostors is set,
+		or when it is too small for even the coarsest mesh to look round.
+	*/
+	static bool impostor( const view&, double coverage);
+	friend class python::particles;
  
  public:
 	/** Construct a unit sphere at the origin. */
@@ -36,11 +54,16 @@ class sphere : public axial
 	virtual double get_max_dimension();
 
 	/** Renders a simple sphere with the #2 level of detail.  */
-	virtual void gl_pick_render( const view&);
+	virtual bool ray_intersect( const pick_ray&, pick_hit&);
 	/** Renders the sphere.  All of the spheres share the same basic set of 
 	 * models, and then use matrix transforms to shape and position them.
 	 */
 	virtual void gl_render( const view&);
+	/** Opaque spheres and ellipsoids without a material are batched. */
+	virtual bool add_to_batch( const view&, instance_batch&);
+	/** Culled by the sphere of radius get_max_dimension(). */
+	virtual bool culled( const view&);
+	virtual bool cullable() { return true; }
 	/** Extent reported using extent::add_sphere(). */
 	virtual void grow_extent( extent&);
 	
@@ -56,6 +79,7 @@ class sphere : public axial
 	virtual void get_material_matrix( const view&, tmatrix& out );
 	
 	PRIMITIVE_TYPEINFO_DECL;
+	PRIMITIVE_SNAPSHOT_DECL;
 };
 
 } // !namespace cvisual
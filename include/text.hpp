@@ -12,6 +12,14 @@
 	On all platforms, text rendering is expected to work in essentially the same 
 	way: an entire text string is rendered by the platform's text renderer into a
 	texture (layout), which is then rendered as many times as called for.
+
+	Where the platform's renderer allows it (font_renderer::composable()), each
+	character is instead rendered once per font into a shared texture atlas,
+	and a layout is a run of quads that refer to it.  Changing the text of a
+	label then only lays out new quads, unless it uses new characters.  Strings
+	with characters that cannot be composed this way, such as combining marks,
+	are still rendered whole.  Fonts and layouts are kept in bounded caches,
+	least recently used first out.
 	
 	Each platform needs to provide {platform}/font_renderer.hpp with the following
 	public interface (in namespace cvisual):
@@ -28,26 +36,42 @@
 		bool ok();
 		
 		// Render text and call tx.set_image()
-		void gl_render_to_texture( const struct view&, const std::wstring& text, layout_texture& tx );
+		void gl_render_to_texture( const struct view&, const std::wstring& text, text_image& tx );
+
+		// True if the image of a single character spans its advance and the
+		// height of a line, so that text can be composed from such images.
+		bool composable();
 	};
 */
 
 #include "util/texture.hpp"
 #include "util/vector.hpp"
+#include "util/lru_cache.hpp"
+#include "util/thread.hpp"
+#include <vector>
 
 namespace cvisual {
 
 class font;
 class layout;
+class glyph_atlas;
 
-class layout_texture : texture {
+/** The destination of font_renderer::gl_render_to_texture(). */
+class text_image {
  public: // But only for use by font_renderer!
- 
 	// Takes similar parameters to glTexImage2D, but always accepts rectangular textures.
 	// Pass a negative height if the image is bottom-up.
 	// alignment is GL_UNPACK_ALIGNMENT
 	// Typically the format should be either GL_ALPHA (for simple antialiasing) or 
 	//   GL_RGB or GL_BGR_EXT (for color antialiasing e.g. ClearType)
+	virtual void set_image( int width, int height, int gl_internal_format, int gl_format, int gl_type, int alignment, void* data ) = 0;
+
+ protected:
+	virtual ~text_image() {}
+};
+
+class layout_texture : texture, public text_image {
+ public: // But only for use by font_renderer!
 	void set_image( int width, int height, int gl_internal_format, int gl_format, int gl_type, int alignment, void* data );
 
  private:
@@ -66,8 +90,20 @@ class layout_texture : texture {
  	int internal_format;
 };
 
+/** How well the text caches have worked, summed over all fonts. */
+struct text_cache_stats {
+	unsigned long font_hits, font_misses;
+	unsigned long layout_hits, layout_misses;
+	unsigned long glyph_hits, glyph_misses;
+	size_t fonts; ///< Fonts held by the cache.
+	size_t glyphs; ///< Characters held by the atlases.
+	size_t atlas_pages; ///< Textures holding glyphs.
+};
+
 class font {
  public:
+	~font();
+
 	// Call this to get a font.  If possible, call only when the font changes.
 	static boost::shared_ptr<font> 
 	find_font( const std::wstring& desc = std::wstring(), int height = -1);
@@ -78,11 +114,17 @@ class font {
 	boost::shared_ptr<layout> 
 	lay_out( const std::wstring& text );
 
+	static text_cache_stats get_cache_stats();
+
  private:
 	friend class layout_texture;
+	friend class layout;
 	font( class font_renderer* );
 	boost::weak_ptr<font> self;
 	boost::scoped_ptr< class font_renderer > renderer;
+	/// The characters of this font, or null if they cannot be composed.
+	boost::scoped_ptr< glyph_atlas > atlas;
+	lru_cache< std::wstring, boost::shared_ptr<layout> > layouts;
 };
 
 class layout {
@@ -98,8 +140,25 @@ class layout {
 	friend class font;
 
 	layout( const boost::shared_ptr<font>& font, const std::wstring& text );
+	void compose( const view& );
+	void draw( const view& );
 	void draw_quad();
 
+	// The quads of the characters, if the text was composed from its
+	// font's atlas.  Each run of quads is in one page of the atlas.
+	struct run {
+		size_t page;
+		int first; ///< The first vertex.
+		int count; ///< The number of vertices.
+	};
+	bool composed; ///< True once compose() has been tried.
+	bool from_atlas; ///< True if the text is drawn from its font's atlas.
+	std::vector<run> runs;
+	std::vector<float> vertices; ///< x, y of each vertex
+	std::vector<float> tcoords; ///< s, t of each vertex
+	vector size;
+
+	/// The whole text in one texture, if it could not be composed.
 	layout_texture tx;
 };
 
@@ -0,0 +1,76 @@
+#ifndef VPYTHON_UTIL_BLENDED_TRANSPARENCY_HPP
+#define VPYTHON_UTIL_BLENDED_TRANSPARENCY_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/gl_extensions.hpp"
+#include <boost/scoped_ptr.hpp>
+
+namespace cvisual {
+
+struct view;
+class shader_program;
+
+/** Order independent transparency by weighted blending: the transparent layer
+	is drawn in any order, twice, into two offscreen buffers.  The first pass
+	sums the colors weighted by their opacities, and the second multiplies
+	together how much of the background each surface lets through.  The
+	weighted average color is then blended over the opaque layer by that
+	much.  This is exact for a single layer of transparency and a close
+	approximation for several surfaces of similar opacity.
+
+	The usage for each eye is:
+		if (t.begin_accumulation( v)) {
+			draw the transparent layer;
+			t.begin_revealage( v);
+			draw the transparent layer again;
+			t.composite( v);
+		}
+		else
+			sort and draw the transparent layer as usual;
+*/
+class blended_transparency
+{
+ public:
+	blended_transparency();
+	~blended_transparency();
+
+	/** True if the OpenGL implementation supports this, and it has not failed
+		before.
+	*/
+	bool available( const gl_extensions& glext, bool enable_shaders) const;
+
+	/** Begin the first pass over the current viewport, whose opaque layer has
+		already been drawn.  Returns false, having changed nothing, if this
+		cannot be done.
+	*/
+	bool begin_accumulation( const view& v);
+	/** Begin the second pass. */
+	void begin_revealage( const view& v);
+	/** Blend the result over the frame buffer, and restore the OpenGL state
+		changed by begin_accumulation().
+	*/
+	void composite( const view& v);
+
+ private:
+	int width, height; ///< The size of the buffers.
+	GLuint framebuffer;
+	GLuint depth_texture; ///< A copy of the opaque layer's depth buffer.
+	GLuint accum_texture; ///< The sums of color*alpha and of alpha.
+	GLuint reveal_texture; ///< The product of (1-alpha), in alpha.
+	GLint viewport[4]; ///< The viewport to composite into.
+	GLfloat clear_color[4]; ///< Restored by composite().
+	bool failed;
+	boost::scoped_ptr<shader_program> program;
+	PFNGLDELETEFRAMEBUFFERSEXTPROC glDeleteFramebuffersEXT;
+
+	bool realize( const view& v, int width, int height);
+	static void gl_free( PFNGLDELETEFRAMEBUFFERSEXTPROC, GLuint framebuffer,
+		GLuint depth, GLuint accum, GLuint reveal);
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_BLENDED_TRANSPARENCY_HPP
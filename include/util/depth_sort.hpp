@@ -0,0 +1,23 @@
+#ifndef VPYTHON_UTIL_DEPTH_SORT_HPP
+#define VPYTHON_UTIL_DEPTH_SORT_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include <vector>
+#include <cstddef>
+
+namespace cvisual {
+
+/** Find the order in which to draw items from back to front.  depth[i] is the
+	distance of item i along the direction of view, so the deepest item comes
+	first; items at the same depth keep their relative order.  On return,
+	order[k] is the index of the item to draw k'th.  Large arrays are radix
+	sorted on their depths, in time linear in their size.
+*/
+void depth_order( const std::vector<double>& depth, std::vector<size_t>& order);
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_DEPTH_SORT_HPP
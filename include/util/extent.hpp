@@ -15,18 +15,30 @@ class extent_data {
 private:
 	friend class extent;
 
-	double cot_hfov, invsin_hfov, sin_hfov, cos_hfov;
+	double tan_hfov, cot_hfov, invsin_hfov;
 
 	vector mins, maxs;
-	double camera_z;
+	/** The camera distance needed to see everything is the largest of
+	 *  max(|x|,|y|)*cot_hfov + |z| over the contents, which is the largest
+	 *  of eight linear functions of position.  Keeping the maximum of each
+	 *  separately lets extents be translated and merged exactly; see
+	 *  extent::add_extent().
+	 */
+	double support[8];
 
 	size_t buffer_depth; ///< The required depth of the selection buffer.
 
-	bool is_empty() const;
-
 public:
 	extent_data( double tan_hfov );
 
+	/** True if nothing has been added. */
+	bool is_empty() const;
+	/** True if other holds the same measurements as this. */
+	bool same( const extent_data& other) const;
+	/** The corners of the axis-aligned bounding box, if !is_empty(). */
+	vector get_mins() const { return mins; }
+	vector get_maxs() const { return maxs; }
+
 	// The following functions represent the interface for render_surface objects.
 	/** Returns the center position of the scene in world space. */
 	vector get_center() const;
@@ -39,7 +51,9 @@ public:
 	 */
 	vector get_range( vector center) const;
 
-	double get_camera_z() const { return camera_z; }
+	double get_camera_z() const;
+
+	double get_tan_hfov() const { return tan_hfov; }
 
 	/** Returns the size for the select buffer when rendering in select mode,
 	 * after having traversed the world. */
@@ -55,11 +69,42 @@ class extent
 	extent_data& data;
 	tmatrix l_cw;
 	int frame_depth;
+
+	// While the children of a frame are measured, they are also measured
+	// into the frame's own extent_data, in its coordinates (see
+	// frame::culled()).  frame_data is that extent, l_frame takes local
+	// coordinates to its, and outer is the extent that the frame itself is
+	// measured in, placed by frame_to_outer.  frame_data is null outside of
+	// any frame.
+	extent_data* frame_data;
+	tmatrix l_frame;
+	extent* outer;
+	tmatrix frame_to_outer;
+
+	// Extend data.support to include a body centered at c (in centered
+	// world space) that reaches reach farther than c in every direction.
+	static void add_support( extent_data& data, const vector& c, double reach );
+	// Extend data to include a point, sphere or circle in its coordinates.
+	static void grow_point( extent_data& data, const vector& point );
+	static void grow_sphere( extent_data& data, const vector& center, double radius );
+	static void grow_circle( extent_data& data, const vector& center,
+		const vector& normal, double radius );
+	// Extend the frame_data of this and every enclosing frame.
+	void frame_point( vector point );
+	void frame_sphere( vector center, double radius );
+	void frame_circle( vector center, vector normal, double radius );
  public:
 	extent( extent_data& data, const tmatrix& local_to_centered_world );
 	extent( extent& parent, const tmatrix& local_to_parent );
+	/** Measure the children of a frame that is placed in parent by
+	 *  local_to_parent.  Besides growing parent, everything is measured into
+	 *  local in the frame's coordinates.
+	 */
+	extent( extent& parent, const tmatrix& local_to_parent, extent_data& local );
 	~extent(); //< Might be necessary to "flush" local cached results into parent
 
+	double get_tan_hfov() const { return data.tan_hfov; }
+
 	// The following functions represent the interface for renderable objects.
 	/** Extend the range to include this point.
  		@param point a point in world space coordinates.
@@ -75,6 +120,12 @@ class extent
 	void add_box( const tmatrix& local_to_world, const vector& min, const vector& max );
 	/** Extend the range to include this circle */
 	void add_circle( const vector& center, const vector& normal, double radius );
+	/** Extend the range to include everything in other, which must have
+	 *  been measured in world space with the same field of view.  Only valid
+	 *  for a top-level extent, whose local_to_centered_world is a
+	 *  translation.
+	 */
+	void add_extent( const extent_data& other );
 
 	/** Report the number of bodies that this object represents.  This is used
 	 *  for the calculation of the hit buffer size.
@@ -0,0 +1,76 @@
+#ifndef VPYTHON_UTIL_FRAME_READBACK_HPP
+#define VPYTHON_UTIL_FRAME_READBACK_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/gl_extensions.hpp"
+
+#include <boost/function.hpp>
+#include <vector>
+#include <cstddef>
+
+namespace cvisual {
+
+/** Copies rendered frames out of the framebuffer without stalling the
+	pipeline.  With ARB_pixel_buffer_object, each frame is read into one of a
+	ring of pixel buffers, and only mapped once the ring comes back around to
+	it, by which time the transfer has long finished; so a frame is handed over
+	depth-1 frames after it was drawn.  Without the extension, each frame is
+	read and handed over at once.
+
+	Frames are handed over as tightly packed RGBA rows, top row first.  All
+	of the calls must be made with the same OpenGL context current.
+*/
+class frame_readback
+{
+ public:
+	/** Called with each frame read back.  The pixels are only valid during
+		the call. */
+	typedef boost::function<void (const unsigned char* rgba, int width, int height)> consumer;
+
+	explicit frame_readback( size_t depth = 3);
+	~frame_readback();
+
+	/** Start reading back the frame just drawn, width by height pixels from
+		the lower left of the current read buffer, and pass the oldest frame
+		still pending, if its turn has come, to out.
+	*/
+	void read( const gl_extensions& glext, int width, int height, const consumer& out);
+
+	/** Pass every frame still pending to out, oldest first. */
+	void flush( const gl_extensions& glext, const consumer& out);
+
+	/** The number of frames read but not yet handed over. */
+	size_t pending() const;
+
+ private:
+	struct slot
+	{
+		GLuint buffer;
+		size_t capacity; ///< In bytes.
+		int width;
+		int height;
+		bool pending;
+		slot();
+	};
+	std::vector<slot> ring;
+	size_t next; ///< The slot the next frame goes into.
+	std::vector<unsigned char> flipped;
+	PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB;
+
+	frame_readback( const frame_readback&);
+	frame_readback& operator=( const frame_readback&);
+
+	// Maps s, passes it to out, and marks it free.
+	void deliver( const gl_extensions& glext, slot& s, const consumer& out);
+	// Turns the rows of a width by height frame the right way up, and passes
+	// them to out.
+	void flip( const unsigned char* rgba, int width, int height, const consumer& out);
+	static void gl_free( PFNGLDELETEBUFFERSARBPROC, GLuint);
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_FRAME_READBACK_HPP
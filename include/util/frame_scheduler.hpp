@@ -0,0 +1,89 @@
+#ifndef VPYTHON_UTIL_FRAME_SCHEDULER_HPP
+#define VPYTHON_UTIL_FRAME_SCHEDULER_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/thread.hpp"
+#include "util/timer.hpp"
+
+namespace cvisual {
+
+/** How the rendering cycles have been keeping up.  Times are in seconds. */
+struct frame_pacing
+{
+	double frame_rate; ///< The target, as given to set_frame_rate().
+	double paint; ///< The smoothed time spent painting each cycle.
+	double swap; ///< The smoothed time spent swapping buffers.
+	double cycle; ///< The smoothed time from the start of one cycle to the next.
+	double interval; ///< The wait before the next cycle, as last scheduled.
+	unsigned long frames; ///< Cycles completed.
+	unsigned long dropped; ///< Cycles that were due but never started, being late.
+
+	frame_pacing();
+};
+
+/** Decides when the platform driver should next paint the displays, and keeps
+	count of the cycles, for render_manager.  Cycles are due on a fixed grid of
+	deadlines rather than a fixed delay after the last one, so that timer slop
+	in the platform's event loop does not add up.  When a cycle starts a whole
+	period or more after it was due, the cycles skipped are counted as dropped
+	and the grid starts again from the late one.
+
+	It also lets rate() wait for a cycle, so that each step of the Python
+	program's loop is drawn once instead of racing the renderer.
+*/
+class frame_scheduler
+{
+ private:
+	mutable mutex barrier;
+	condition frame_done;
+	timer clock;
+
+	double target; ///< Frames per second; 0 to adapt to the cost of painting.
+	bool sync; ///< Whether rate() waits for a cycle.
+	frame_pacing stats;
+	double start; ///< When the cycle in progress started.
+	double due; ///< When the cycle in progress should have started.
+	double period; ///< How far apart cycles were due, when due was set.
+	unsigned long begun; ///< Cycles started, including the one in progress.
+
+ public:
+	frame_scheduler();
+
+	/** Pace the cycles to fps per second.  0 restores the default, which keeps
+		the Python program running about half of the time; infinity paints as
+		fast as possible.
+	*/
+	void set_frame_rate( double fps);
+	double get_frame_rate() const;
+
+	/** Whether rate() should also wait for the rendering cycle, see
+		sync_step(). */
+	void set_rate_sync( bool);
+	bool get_rate_sync() const;
+
+	frame_pacing get_pacing() const;
+
+	/** Called by render_manager when a cycle starts. */
+	void begin_frame();
+	/** Called by render_manager when a cycle has swapped, with how long it
+		spent painting and swapping.  Returns the number of seconds to wait
+		before the next cycle. */
+	double end_frame( double paint, double swap);
+
+	/** Called by rate() in the Python thread, without the GIL.  When the
+		rate sync is on, blocks until a cycle that starts after the call has
+		completed, so that the state of each step gets drawn.  Gives up after
+		a tenth of a second, in case nothing is being rendered.
+	*/
+	void sync_step();
+};
+
+/** The one frame_scheduler, which paces every display. */
+extern frame_scheduler render_schedule;
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_FRAME_SCHEDULER_HPP
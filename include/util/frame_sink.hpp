@@ -0,0 +1,92 @@
+#ifndef VPYTHON_UTIL_FRAME_SINK_HPP
+#define VPYTHON_UTIL_FRAME_SINK_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/thread.hpp"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace boost { class thread; }
+
+namespace cvisual {
+
+/** A frame read back from OpenGL, as tightly packed RGBA rows, top row first. */
+struct frame_image
+{
+	std::vector<unsigned char> pixels;
+	int width;
+	int height;
+};
+
+/** Somewhere to put rendered frames, given as tightly packed RGBA rows, top
+	row first.  Errors are reported by throwing std::runtime_error.
+*/
+class frame_sink
+{
+ public:
+	virtual ~frame_sink();
+	virtual void write( const unsigned char* rgba, int width, int height) = 0;
+	/** Write a frame that the sink may keep a reference to, rather than
+		copying it.  The default just calls write(). */
+	virtual void write_image( const boost::shared_ptr<frame_image>& frame);
+
+	/** Make a sink of one of these kinds:
+		"raw": appends the bytes of each frame to the file named by target.
+		"png": writes each frame to a PNG file of its own, named by target with
+			a printf-style %d (optionally zero padded, as in %05d) replaced by
+			the frame number, counting from 0.
+		"pipe": writes the bytes of each frame to the standard input of the
+			shell command target, started with the first frame, after replacing
+			{width}, {height} and {size} (as WIDTHxHEIGHT) in it, so that
+			"ffmpeg -f rawvideo -pix_fmt rgba -s {size} -i - out.mp4" encodes a
+			movie.
+		Throws std::invalid_argument for any other kind.
+	*/
+	static boost::shared_ptr<frame_sink> create( const std::string& kind,
+		const std::string& target);
+};
+
+/** Writes frames to a frame_sink in a thread of its own, so that encoding and
+	I/O overlap the rendering.  write() copies the frame and returns at once,
+	unless several frames are already waiting, in which case it waits for room
+	rather than using memory without bound.  Once the sink fails, the error
+	is thrown by every later call to write(), and by close().
+*/
+class frame_writer
+{
+ public:
+	explicit frame_writer( boost::shared_ptr<frame_sink> sink, size_t backlog = 4);
+	/** Calls close(), but discards any error. */
+	~frame_writer();
+
+	void write( const unsigned char* rgba, int width, int height);
+	/** Waits for every frame to be written, and then closes the sink. */
+	void close();
+
+ private:
+	boost::shared_ptr<frame_sink> sink;
+	size_t backlog;
+	mutex barrier;
+	condition changed;
+	std::deque<boost::shared_ptr<frame_image> > queue;
+	bool closing;
+	std::string error;
+	boost::scoped_ptr<boost::thread> worker;
+
+	frame_writer( const frame_writer&);
+	frame_writer& operator=( const frame_writer&);
+
+	void run();
+	void check_error();
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_FRAME_SINK_HPP
@@ -0,0 +1,64 @@
+#ifndef VPYTHON_UTIL_FRAME_STATS_HPP
+#define VPYTHON_UTIL_FRAME_STATS_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/thread.hpp"
+#include <vector>
+
+namespace cvisual {
+
+/** The time taken by each phase of one rendering cycle of a display, and how
+	much was drawn.  All times are in seconds.  When stereo draws the scene
+	twice, the drawing phases include both eyes.
+*/
+struct frame_stats
+{
+	double start; ///< When the cycle began, on the display's render timer.
+	double cycle; ///< The time since the previous cycle began.
+	double gil_wait; ///< Waiting for the Python interpreter lock.
+	double extent; ///< Computing the extent of the scene for autoscaling.
+	double snapshot; ///< Copying the state of the objects for drawing.
+	double sort; ///< Depth sorting the transparent objects.
+	double opaque; ///< Drawing the opaque objects.
+	double transparent; ///< Drawing the transparent objects.
+	double screen; ///< Drawing the objects in screen space, such as labels.
+	double pick; ///< Preparing mouse picking for the next cycle.
+	double swap; ///< Swapping buffers, shared by all displays painted together.
+	double total; ///< From the start of the cycle to the end of the swap.
+	int objects; ///< Opaque objects drawn.
+	int transparent_objects; ///< Transparent objects drawn.
+	int screen_objects; ///< Screen space objects drawn.
+	int culled; ///< Objects, or whole frames, skipped as out of sight.
+
+	frame_stats();
+};
+
+/** The most recent frame_stats of a display.  The rendering thread adds a
+	record at the end of each cycle, while the Python program may read them at
+	any time.  The records are kept in a fixed ring, so this does not allocate
+	once it is full.
+*/
+class frame_stats_log
+{
+ private:
+	mutable mutex barrier;
+	std::vector<frame_stats> ring;
+	size_t next; ///< Where the next record will go.
+	size_t count; ///< How many records the ring holds.
+
+ public:
+	explicit frame_stats_log( size_t capacity = 256);
+
+	/** Add a record, replacing the oldest one if the ring is full. */
+	void push( const frame_stats&);
+	/** The records held, oldest first. */
+	std::vector<frame_stats> recent() const;
+	void clear();
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_FRAME_STATS_HPP
@@ -0,0 +1,45 @@
+#ifndef VPYTHON_UTIL_FRUSTUM_HPP
+#define VPYTHON_UTIL_FRUSTUM_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vector.hpp"
+#include "util/tmatrix.hpp"
+
+namespace cvisual {
+
+/** The volume that can be seen through a projection, as six planes, for
+	skipping objects that are certainly out of sight.  The tests are
+	conservative: an object near a corner of the volume may be kept although
+	it cannot be seen.  A default constructed frustum contains everything.
+*/
+class frustum
+{
+ public:
+	frustum();
+	/** The volume seen through world_clip (a projection times a modelview),
+		in coordinates that are multiplied by scale (the gcf) before
+		world_clip is applied.
+	*/
+	frustum( const tmatrix& world_clip, double scale);
+
+	/** False if this contains everything. */
+	bool bounded() const { return is_bounded; }
+
+	/** True if no part of the sphere can be inside. */
+	bool excludes_sphere( const vector& center, double radius) const;
+
+ private:
+	// Each plane as a unit normal pointing inward and an offset, so that the
+	// points p inside have normal[i].dot(p*scale) + offset[i] >= 0.
+	vector normal[6];
+	double offset[6];
+	double scale;
+	bool is_bounded;
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_FRUSTUM_HPP
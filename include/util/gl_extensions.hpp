@@ -4,6 +4,14 @@
 
 #include "wrap_gl.hpp"
 
+// The glext.h shipped with the Mac build predates instancing.
+#ifndef GL_ARB_draw_instanced
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINSTANCEDARBPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei primcount);
+#endif
+#ifndef GL_ARB_instanced_arrays
+typedef void (APIENTRYP PFNGLVERTEXATTRIBDIVISORARBPROC) (GLuint index, GLuint divisor);
+#endif
+
 namespace cvisual {
 
 // GL extension functions wrapper - just the functions we currently need
@@ -35,6 +43,31 @@ class gl_extensions {
 	PFNGLGETOBJECTPARAMETERIVARBPROC glGetObjectParameterivARB;
 	PFNGLGETINFOLOGARBPROC			glGetInfoLogARB;
 
+	// Extension: ARB_vertex_shader
+	bool ARB_vertex_shader;
+	PFNGLGETATTRIBLOCATIONARBPROC	glGetAttribLocationARB;
+	PFNGLVERTEXATTRIBPOINTERARBPROC	glVertexAttribPointerARB;
+	PFNGLENABLEVERTEXATTRIBARRAYARBPROC		glEnableVertexAttribArrayARB;
+	PFNGLDISABLEVERTEXATTRIBARRAYARBPROC	glDisableVertexAttribArrayARB;
+
+	// Extension: ARB_draw_instanced
+	bool ARB_draw_instanced;
+	PFNGLDRAWELEMENTSINSTANCEDARBPROC	glDrawElementsInstancedARB;
+
+	// Extension: ARB_instanced_arrays
+	bool ARB_instanced_arrays;
+	PFNGLVERTEXATTRIBDIVISORARBPROC	glVertexAttribDivisorARB;
+
+	// Extension: ARB_vertex_buffer_object
+	bool ARB_vertex_buffer_object;
+	PFNGLGENBUFFERSARBPROC			glGenBuffersARB;
+	PFNGLBINDBUFFERARBPROC			glBindBufferARB;
+	PFNGLBUFFERDATAARBPROC			glBufferDataARB;
+	PFNGLBUFFERSUBDATAARBPROC		glBufferSubDataARB;
+	PFNGLDELETEBUFFERSARBPROC		glDeleteBuffersARB;
+	PFNGLMAPBUFFERARBPROC			glMapBufferARB;
+	PFNGLUNMAPBUFFERARBPROC			glUnmapBufferARB;
+
 	// Extension: EXT_texture3D
 	bool EXT_texture3D;
 	PFNGLTEXIMAGE3DEXTPROC			glTexImage3D;
@@ -47,6 +80,24 @@ class gl_extensions {
 	// Extension: ARB_point_parameters
 	bool ARB_point_parameters;
 	PFNGLPOINTPARAMETERFVARBPROC	glPointParameterfvARB;
+
+	// Extension: EXT_framebuffer_object
+	bool EXT_framebuffer_object;
+	PFNGLGENFRAMEBUFFERSEXTPROC		glGenFramebuffersEXT;
+	PFNGLBINDFRAMEBUFFEREXTPROC		glBindFramebufferEXT;
+	PFNGLFRAMEBUFFERTEXTURE2DEXTPROC	glFramebufferTexture2DEXT;
+	PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC	glCheckFramebufferStatusEXT;
+	PFNGLDELETEFRAMEBUFFERSEXTPROC	glDeleteFramebuffersEXT;
+
+	// Extension: EXT_blend_func_separate
+	bool EXT_blend_func_separate;
+	PFNGLBLENDFUNCSEPARATEEXTPROC	glBlendFuncSeparateEXT;
+
+	// Extensions that add no functions
+	bool ARB_texture_float;
+	bool ARB_depth_texture;
+	bool ARB_texture_non_power_of_two;
+	bool ARB_pixel_buffer_object; //< Uses the ARB_vertex_buffer_object functions.
 };
 
 }
@@ -10,12 +10,16 @@ class gl_free_manager {
  public:
 	// The callback will be called if the OpenGL context(s) are destroyed
 	template <class T>
-	void connect( T callback ) { on_shutdown().connect( callback ); }
+	void connect( T callback ) { lock L(barrier()); on_shutdown().connect( callback ); }
 	
 	// The callback will be called the next time OpenGL objects may be freed, and
 	//   will no longer be called on shutdown().
 	template <class T>
-	void free( T callback ) { on_next_frame().connect( callback ); on_shutdown().disconnect( callback ); }
+	void free( T callback ) {
+		lock L(barrier());
+		on_next_frame().connect( callback );
+		on_shutdown().disconnect( callback );
+	}
 	
 	// Call with OpenGL context active
 	void frame();
@@ -26,6 +30,9 @@ class gl_free_manager {
  private:
 	boost::signal< void() > &on_shutdown();
 	boost::signal< void() > &on_next_frame();
+	// Displays that render in threads of their own (display_kernel::render_threads)
+	// create and free objects at the same time.
+	mutex &barrier();
 };
 
 // At present, there is just one of these, because all OpenGL contexts share server
@@ -34,6 +41,12 @@ class gl_free_manager {
 // future, there will need to be an instance for each context.
 extern gl_free_manager on_gl_free;
 
+// Held while creating the OpenGL objects and models that are shared by every
+// display, such as the static displaylists of the primitives, so that displays
+// rendering in threads of their own don't create them twice, or use them
+// half-built.
+extern mutex gl_share_lock;
+
 } // !namespace cvisual
 
 #endif // !defined VPYTHON_UTIL_GL_FREE_HPP
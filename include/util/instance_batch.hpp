@@ -0,0 +1,85 @@
+#ifndef VPYTHON_UTIL_INSTANCE_BATCH_HPP
+#define VPYTHON_UTIL_INSTANCE_BATCH_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/rgba.hpp"
+#include "util/tmatrix.hpp"
+
+#include <map>
+#include <vector>
+
+namespace cvisual {
+
+class mesh;
+class shader_program;
+struct view;
+
+/** Collects the opaque primitives of one frame that are copies of a shared
+	mesh, and draws all of the copies of each mesh together.  Where the driver
+	supports ARB_draw_instanced and ARB_instanced_arrays, each mesh is drawn
+	with a single glDrawElementsInstancedARB() call, with the transform and
+	color of each copy passed as per-instance vertex attributes and the fixed
+	function lighting model reproduced by a small shader.  Otherwise the
+	vertex arrays are bound once per mesh and each copy costs only a matrix,
+	a color, and a glDrawElements().
+
+	Spheres may be queued as impostors instead: a square facing the eye for
+	each one, on which a fragment shader finds the sphere by intersecting the
+	ray through each pixel, and writes its depth.  All of them are drawn from
+	one packed vertex array with a single call.  Where the shader cannot be
+	used they are drawn as copies of a fallback mesh.
+
+	The shaders are shared by every batch, so that each frame may keep a
+	batch of its own children.
+*/
+class instance_batch
+{
+ public:
+	instance_batch();
+	~instance_batch();
+
+	/** Queue one copy of model, which must live at least until the next call
+		to gl_render().  model_world includes the gcf.
+	*/
+	void add( const view& v, const mesh* model, const tmatrix& model_world,
+		rgb color, float opacity);
+
+	/** Queue an opaque sphere to be drawn as an impostor.  center and radius
+		include the gcf.  fallback is a unit sphere of the detail the sphere
+		would otherwise be drawn with, which is drawn in its place if
+		impostors are unavailable, and must live as model does.
+	*/
+	void add_sphere( const view& v, const mesh* fallback, const vector& center,
+		double radius, rgb color);
+
+	/** Draw everything queued since the last call, and empty the queue.
+		Lighting must already be set up for the scene.
+	*/
+	void gl_render( const view& v);
+
+ private:
+	// For each copy: the three rows of the model to world transform followed
+	// by the color, 16 floats in all.  Vectors are reused between frames.
+	typedef std::map<const mesh*, std::vector<float> > groups_t;
+	groups_t groups;
+
+	// For each corner of each impostor: the center and radius of the sphere,
+	// its color, and the corner's position in the square, 10 floats in all.
+	std::vector<float> impostors;
+	std::vector<const mesh*> impostor_fallbacks; ///< One for each impostor.
+
+	/** Returns false if the impostor shader is unavailable. */
+	bool gl_render_impostors( const view& v);
+	/** Queue the impostors as copies of their fallback meshes instead. */
+	void impostors_to_meshes();
+	/** Returns false if the instancing path is unavailable. */
+	bool gl_render_instanced( const view& v);
+	void gl_render_arrays( const view& v);
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_INSTANCE_BATCH_HPP
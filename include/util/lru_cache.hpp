@@ -0,0 +1,92 @@
+#ifndef VPYTHON_UTIL_LRU_CACHE_HPP
+#define VPYTHON_UTIL_LRU_CACHE_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include <list>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+
+namespace cvisual {
+
+/** A map that holds at most a fixed number of entries.  When a new entry would
+	exceed that, the least recently used one is dropped.  Lookups count hits
+	and misses, so that the effectiveness of the cache can be reported.
+	Not thread safe.
+*/
+template <typename Key, typename Value>
+class lru_cache
+{
+ private:
+	typedef std::list< std::pair<Key, Value> > entries_t;
+	typedef std::map<Key, typename entries_t::iterator> index_t;
+
+	entries_t entries; ///< Most recently used first.
+	index_t index;
+	size_t capacity;
+	unsigned long hit_count;
+	unsigned long miss_count;
+
+ public:
+	explicit lru_cache( size_t capacity)
+		: capacity(capacity), hit_count(0), miss_count(0)
+	{}
+
+	/** Returns the value for key, marking it as the most recently used, or
+		0 if there is none.
+	*/
+	Value*
+	find( const Key& key)
+	{
+		typename index_t::iterator i = index.find( key);
+		if (i == index.end()) {
+			++miss_count;
+			return 0;
+		}
+		++hit_count;
+		entries.splice( entries.begin(), entries, i->second);
+		return &i->second->second;
+	}
+
+	/** Add or replace the value for key, dropping the least recently used
+		entry if the cache is full.  If dropped is not null, the value of the
+		dropped entry is swapped into it.
+	*/
+	Value&
+	insert( const Key& key, const Value& value, Value* dropped = 0)
+	{
+		typename index_t::iterator i = index.find( key);
+		if (i != index.end()) {
+			entries.splice( entries.begin(), entries, i->second);
+			return i->second->second = value;
+		}
+		if (capacity && entries.size() >= capacity) {
+			if (dropped)
+				std::swap( *dropped, entries.back().second);
+			index.erase( entries.back().first);
+			entries.pop_back();
+		}
+		entries.push_front( std::make_pair( key, value));
+		index.insert( std::make_pair( key, entries.begin()));
+		return entries.front().second;
+	}
+
+	void
+	clear()
+	{
+		entries.clear();
+		index.clear();
+	}
+
+	size_t size() const { return entries.size(); }
+	unsigned long hits() const { return hit_count; }
+	unsigned long misses() const { return miss_count; }
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_LRU_CACHE_HPP
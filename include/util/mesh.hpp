@@ -0,0 +1,58 @@
+#ifndef VPYTHON_UTIL_MESH_HPP
+#define VPYTHON_UTIL_MESH_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include <vector>
+
+namespace cvisual {
+
+/** An indexed triangle mesh in model coordinates, drawn with vertex arrays.
+	Unlike a displaylist, the geometry remains accessible to the client, so
+	that many copies of the same model can be drawn with a single call (see
+	instance_batch).  The primitives keep one mesh per level of detail for the
+	life of the program.
+*/
+class mesh
+{
+ public:
+	std::vector<float> pos;    ///< x, y, z for each vertex
+	std::vector<float> normal; ///< x, y, z for each vertex
+	std::vector<unsigned int> indices; ///< Three per triangle, counterclockwise.
+	/** True if the model contains separate inside faces (box and pyramid),
+		and so must be drawn with GL_CULL_FACE enabled.
+	*/
+	bool cull_face;
+
+	mesh();
+
+	/** @return true iff no geometry has been generated yet. */
+	bool empty() const { return indices.empty(); }
+	/** @return The number of vertices. */
+	unsigned int size() const { return pos.size() / 3; }
+
+	/** Add a vertex and return its index. */
+	unsigned int add_vertex( float x, float y, float z, float nx, float ny, float nz);
+	void add_triangle( unsigned int a, unsigned int b, unsigned int c);
+
+	/** Append the same sphere as quadric::render_sphere(). */
+	void add_sphere( float radius, int slices, int stacks);
+	/** Append the same tube as quadric::render_cylinder(), running from the
+		origin to <height,0,0>, without end caps.
+	*/
+	void add_cylinder( float base_radius, float top_radius, float height,
+		int slices, int stacks);
+	/** Append a disk in the plane x == offset, facing +x if facing > 0 and
+		-x otherwise (see quadric::render_disk()).
+	*/
+	void add_disk( float radius, int slices, int rings, float offset, float facing);
+
+	/** Discard all geometry. */
+	void clear();
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_MESH_HPP
@@ -0,0 +1,29 @@
+#ifndef VPYTHON_UTIL_PARALLEL_HPP
+#define VPYTHON_UTIL_PARALLEL_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include <boost/function.hpp>
+#include <cstddef>
+
+namespace cvisual {
+
+/** Call job( begin, end) for consecutive chunks of [0, n), each of at least
+	grain items, and return when all of them have finished.  The chunks run on
+	a pool of worker threads, one for each processor, shared by everything
+	that uses this; the calling thread takes the first chunk itself.  When n
+	is too small to divide, or there is only one processor, this is just
+	job( 0, n).
+
+	The chunks may run at the same time, so job must only write to what its
+	own chunk owns, and must not call into Python.  If any chunk throws, the
+	first exception caught is thrown again here once all of them are done.
+*/
+void parallel_for( size_t n, size_t grain,
+	const boost::function<void (size_t, size_t)>& job);
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_PARALLEL_HPP
@@ -0,0 +1,69 @@
+#ifndef VPYTHON_UTIL_QUICKHULL_HPP
+#define VPYTHON_UTIL_QUICKHULL_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vector.hpp"
+
+#include <vector>
+#include <cstddef>
+
+namespace cvisual {
+
+/** The convex hull of a set of points, as a closed mesh of triangles.  It is
+	built by quickhull, and can be extended as points are added without being
+	built again.  The points should not be coplanar; convex jitters them so
+	that they never are.
+*/
+class quickhull
+{
+ public:
+	/// A face of the hull, counterclockwise as seen from outside.
+	struct face
+	{
+		size_t corner[3]; ///< Indices into the points.
+		/// The face across the edge from corner[i] to corner[(i+1)%3].
+		size_t neighbor[3];
+		vector normal;
+		double d;
+		/// True once the face has been replaced; it is dropped by compact().
+		bool removed;
+		/// Points in front of this face, while the hull is being built.
+		std::vector<size_t> outside;
+
+		inline bool visible_from( const vector& p, double epsilon) const
+		{ return normal.dot(p) - d > epsilon; }
+	};
+
+	quickhull();
+
+	/** Forget the points and the hull. */
+	void clear();
+	/** Add a point.  It joins the hull at the next build() or extend(). */
+	void push_back( const vector& p) { points.push_back( p); }
+	/** Build the hull of all of the points, of which there must be at least
+		three.
+	*/
+	void build();
+	/** Extend a built hull to the points added since. */
+	void extend();
+
+	const std::vector<vector>& get_points() const { return points; }
+	const std::vector<face>& get_faces() const { return faces; }
+
+ private:
+	face make_face( size_t a, size_t b, size_t c) const;
+	void add_point( size_t p, size_t visible_face);
+	void compact();
+
+	std::vector<vector> points;
+	std::vector<face> faces;
+	size_t hull_points; ///< How many of the points the hull has seen.
+	double epsilon; ///< How far in front of a face a point must be to see it.
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_QUICKHULL_HPP
@@ -10,8 +10,17 @@ namespace cvisual {
 		// returning the number of seconds to wait before calling this function again.
 		// Takes care of a lot of platform-independent policy and implementation, including
 		// the tradeoff between frame rate and Python program performance, vertical retrace
-		// synchronization, etc.
+		// synchronization, etc.  The wait is decided by render_schedule, which may be
+		// pacing to a fixed frame rate.
 		static double paint_displays( const std::vector< class display* >&, bool swap_single_threaded = false );
+
+		// Like paint_displays(), but each display is painted and swapped by a thread of
+		// its own, which is started on its first frame and stopped on the first frame
+		// without it.  All of the threads begin each frame together and this returns
+		// when the last of them has swapped, so every window is paced to the same
+		// interval.  Used when display_kernel::render_threads is set; the display must
+		// be able to make its OpenGL context current in any thread.
+		static double paint_displays_threaded( const std::vector< class display* >& );
 	};
 };
 
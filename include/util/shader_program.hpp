@@ -20,20 +20,28 @@ class shader_program {
 	
 	const std::string& get_source() const { return source; }
 	int get_uniform_location( const view& v, const char* name );
+	// Requires ARB_vertex_shader; returns -1 if the attribute is not active.
+	int get_attribute_location( const view& v, const char* name );
 	void set_uniform_matrix( const view& v, int loc, const tmatrix& in );
 
  private:
 	friend class use_shader_program;
 	void realize( const view& );
 	
-	void compile( const view&, int type, const std::string& source );
+	void compile( const view&, int handle, int type, const std::string& source );
 	std::string getSection( const std::string& name );
 	
 	static void gl_free( PFNGLDELETEOBJECTARBPROC, int );
 	
 	std::string source;
 	std::map<std::string, int> uniforms;
-	int program;
+	std::map<std::string, int> attributes;
+	// Materials share their program among displays, which may render in
+	// threads of their own.  Guards uniforms and attributes.
+	mutex barrier;
+	// Only set when the program is complete, so that realize() can skip the
+	// lock once it is.
+	volatile int program;
 	PFNGLDELETEOBJECTARBPROC glDeleteObjectARB;
 };
 
@@ -0,0 +1,64 @@
+#ifndef VPYTHON_UTIL_VERTEX_BUFFER_HPP
+#define VPYTHON_UTIL_VERTEX_BUFFER_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/gl_extensions.hpp"
+
+#include <cstddef>
+
+namespace cvisual {
+
+struct view;
+
+/** An array of floats (or of vertex indices) kept in GPU memory with
+	ARB_vertex_buffer_object, for vertex data that changes little from frame
+	to frame.  The caller is responsible for checking that the extension is
+	available.
+
+	Copies of a vertex_buffer start out empty; the GL object is never shared.
+*/
+class vertex_buffer
+{
+ public:
+	/** target is GL_ARRAY_BUFFER_ARB for vertex data, or
+		GL_ELEMENT_ARRAY_BUFFER_ARB for indices.
+	*/
+	explicit vertex_buffer( GLenum target = GL_ARRAY_BUFFER_ARB);
+	vertex_buffer( const vertex_buffer&);
+	vertex_buffer& operator=( const vertex_buffer&) { return *this; }
+	~vertex_buffer();
+
+	/** Make room for at least size floats or indices.  Returns true if the buffer had
+		to be reallocated, in which case its contents are undefined.
+	*/
+	bool reserve( const view& v, size_t size);
+
+	/** Replace size floats starting at offset, which must be within the
+		reserved size.
+	*/
+	void upload( const view& v, size_t offset, size_t size, const float* data);
+	void upload( const view& v, size_t offset, size_t size, const GLuint* data);
+
+	/** Bind the buffer to its target, so that the pointer arguments of
+		glVertexPointer() and friends (or the indices of glDrawElements()) are
+		offsets into it.
+	*/
+	void gl_bind( const view& v);
+	/** Return to client-side arrays. */
+	static void gl_unbind( const view& v, GLenum target = GL_ARRAY_BUFFER_ARB);
+
+ private:
+	GLenum target;
+	GLuint handle;
+	size_t capacity; ///< In floats or indices.
+	PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB;
+
+	static void gl_free( PFNGLDELETEBUFFERSARBPROC, GLuint);
+};
+
+} // !namespace cvisual
+
+#endif // !defined VPYTHON_UTIL_VERTEX_BUFFER_HPP
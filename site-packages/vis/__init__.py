@@ -1,16 +1,22 @@
 version = ('5.72', 'release')
 
 from .cvisual import (vector, dot, mag, mag2, norm, cross, rotate,
-                       comp, proj, diff_angle, rate, waitclose)
+                       comp, proj, diff_angle, rate, waitclose,
+                       sphere_intercollisions, set_frame_rate, get_frame_rate,
+                       set_rate_sync, frame_pacing)
 from .primitives import (arrow, cylinder, cone, sphere, box, ring, label,
                                frame, pyramid, ellipsoid, curve, faces, convex, helix,
-                               points, text, distant_light, local_light, extrusion)
+                               points, particles, text, distant_light, local_light, extrusion)
 try:
     from Polygon import Polygon
 except:
     pass
 
 from .ui import display
+try:
+    from .ui import offscreen
+except ImportError:
+    pass # Built without EGL.
 scene = display() # a display needs to exist in order for an object reference to work
 from . import crayola
 color = crayola
@@ -200,10 +200,6 @@ class py_renderable(object):
                     self.pos = keywords['pos']
                     del keywords['pos']
                     self.trail_object.pos = self.pos
-            self.primitive_object = self
-            self.retain = -1
-            self.interval = 0
-            self.interval_count = 0
         else:
             make_trail = None
 
@@ -214,13 +210,6 @@ class py_renderable(object):
         if not (make_trail is None):
             self.make_trail = make_trail
 
-def trail_update(obj):
-    if obj.interval_count == 0:
-        obj.trail_object.append(pos=obj.pos, retain=obj.retain)
-    obj.interval_count += 1
-    if obj.interval_count >= obj.interval:
-        obj.interval_count = 0
-
 class py_renderable_uniform (py_renderable):
     def check_init_invariants(self):
         if not self.display.uniform:
@@ -536,6 +525,22 @@ class points ( py_renderable_arrayobject, cvisual.points ):
     green = property( py_renderable_arrayobject.get_green, cvisual.points.set_green, None)
     blue = property( py_renderable_arrayobject.get_blue, cvisual.points.set_blue, None)
 
+class particles ( py_renderable_arrayobject, cvisual.particles ):
+    # Many spheres or boxes in one object.  Assign to a slice of an array,
+    # e.g. p.pos[:] = new_pos, to move all of them at once.
+
+    pos = property( cvisual.particles.get_pos, cvisual.particles.set_pos, None)
+    color = property( cvisual.particles.get_color, cvisual.particles.set_color, None)
+    radius = property( cvisual.particles.get_radius, cvisual.particles.set_radius, None)
+    axis = property( cvisual.particles.get_axis, cvisual.particles.set_axis, None)
+    opacity = property( cvisual.particles.get_opacity, cvisual.particles.set_opacity, None)
+    x = property( py_renderable_arrayobject.get_x, cvisual.particles.set_x, None)
+    y = property( py_renderable_arrayobject.get_y, cvisual.particles.set_y, None)
+    z = property( py_renderable_arrayobject.get_z, cvisual.particles.set_z, None)
+    red = property( py_renderable_arrayobject.get_red, cvisual.particles.set_red, None)
+    green = property( py_renderable_arrayobject.get_green, cvisual.particles.set_green, None)
+    blue = property( py_renderable_arrayobject.get_blue, cvisual.particles.set_blue, None)
+
 class convex( py_renderable_arrayobject, py_renderable_uniform, cvisual.convex ):
     pos = property( cvisual.convex.get_pos, cvisual.convex.set_pos, None)
 
@@ -16,3 +16,10 @@
 
 ##from . import materials
 ##materials.rough = materials.diffuse\
+
+## On Linux, several windows can be drawn by threads of their own, all in
+## step, rather than one after another; this keeps the frame rate up with
+## many windows.  It must be set before the first window is opened:
+
+##from .ui import display
+##display.render_threads = True
@@ -3,10 +3,9 @@ from . primitives import distant_light, local_light
 from . import materials
 
 # Code to provide special initialization for a display object, and overloaded
-# properties.
-class display( cvisual.display):
-    def __init__( self, **keywords):
-        cvisual.display.__init__(self)
+# properties, shared by the windowed displays and the offscreen ones.
+class _display_base(object):
+    def _setup( self, keywords):
         self.material = materials.diffuse
         # If visible is set before width (say), can get error "can't change window".
         # So deal with visible attribute separately.
@@ -26,9 +25,9 @@ class display( cvisual.display):
             distant_light( direction=(-0.88, -0.22, -.44), color=(0.3,0.3,0.3), display=self )
         self.select()
     def select(self):
-        cvisual.display.set_selected(self)
-    ambient = property( cvisual.display._get_ambient, cvisual.display._set_ambient)
-    range = property( cvisual.display._get_range, cvisual.display._set_range)
+        cvisual._display_kernel.set_selected(self)
+    ambient = property( cvisual._display_kernel._get_ambient, cvisual._display_kernel._set_ambient)
+    range = property( cvisual._display_kernel._get_range, cvisual._display_kernel._set_range)
 
     def _return_objects(self):
         return tuple([ o for o in self._get_objects() if not isinstance(o, cvisual.light) ])
@@ -56,3 +55,68 @@ class display( cvisual.display):
                                display=self )
 
     lights = property( _get_lights, _set_lights, None)
+
+    _stats_phases = ('gil_wait', 'extent', 'snapshot', 'sort', 'opaque',
+                     'transparent', 'screen', 'pick', 'swap')
+    _stats_columns = ('start', 'cycle') + _stats_phases + ('total', 'objects',
+                     'transparent_objects', 'screen_objects', 'culled')
+
+    def save_stats(self, filename):
+        """Write scene.stats to filename: as a Chrome trace (chrome://tracing)
+        if it ends in .json, and otherwise as comma separated values, one line
+        per frame.  Times are in seconds in the CSV file."""
+        stats = self.stats
+        f = open(filename, 'w')
+        try:
+            if filename.endswith('.json'):
+                import json
+                events = []
+                for frame in stats:
+                    # The phases are laid end to end from the start of the
+                    # cycle; the gaps between them are not shown.
+                    t = frame['start'] - frame['gil_wait']
+                    for phase in self._stats_phases:
+                        events.append({'name': phase, 'ph': 'X', 'pid': 0, 'tid': 0,
+                                       'ts': 1e6*t, 'dur': 1e6*frame[phase]})
+                        t += frame[phase]
+                json.dump({'traceEvents': events}, f)
+            else:
+                f.write(','.join(self._stats_columns) + '\n')
+                for frame in stats:
+                    f.write(','.join([repr(frame[c]) for c in self._stats_columns]) + '\n')
+        finally:
+            f.close()
+
+    def record(self, target, kind=None):
+        """Send every frame drawn from now on to target, until stop_recording()
+        is called.  target may be a function, which is called with each frame
+        as an array like those capture() returns; or the name of a file.  The
+        kind of file is 'png' for numbered PNG files, named by a pattern such
+        as 'frame%05d.png'; 'raw' for one file of RGBA bytes; or 'pipe', for
+        the standard input of a shell command, in which {size}, {width} and
+        {height} are replaced with those of the frames.  By default, it is
+        'png' for names ending in .png and 'raw' for others.  The frames are
+        written, or passed to the function, in a thread of their own."""
+        if callable(target):
+            self._record(target)
+        else:
+            if kind is None:
+                kind = 'png' if target.lower().endswith('.png') else 'raw'
+            self._record(kind, target)
+
+class display( _display_base, cvisual.display):
+    def __init__( self, **keywords):
+        cvisual.display.__init__(self)
+        self._setup(keywords)
+
+if hasattr(cvisual, 'offscreen_display'):
+    class offscreen( _display_base, cvisual.offscreen_display):
+        """A display with no window, for rendering frames in batches on a
+        machine without a screen.  Nothing is drawn until render() is called,
+        once for each frame; set_output() sends the frames drawn to a raw
+        file, to numbered PNG files, or to a command such as ffmpeg, and
+        close_output() finishes writing them.  It cannot be used in the same
+        program as a windowed display."""
+        def __init__( self, **keywords):
+            cvisual.offscreen_display.__init__(self)
+            self._setup(keywords)
@@ -63,7 +63,8 @@ for ufunc in ('hypot',):
 
 import vis.crayola as color
 from vis.cvisual import (vector, mag, mag2, norm, cross, rotate,
-                             comp, proj, diff_angle, rate)
+                             comp, proj, diff_angle, rate,
+                             sphere_intercollisions, text_cache_stats)
 
 # Fix the problem that numpy dot(vector,vector) returns numpy.float64 rather
 # than an ordinary float, causing trouble with later vector calculations:
@@ -4,6 +4,7 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "arrow.hpp"
+#include "pick_engine.hpp"
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
 #include "box.hpp"
@@ -105,14 +106,26 @@ arrow::get_center() const
 	return (pos + axis)/2.0;
 }
 
-void
-arrow::gl_pick_render( const view& scene)
+bool
+arrow::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	// TODO: material related stuff in this file really needs cleaning up!
-	boost::shared_ptr<material> m;
-	m.swap(mat);
-	gl_render(scene);
-	m.swap(mat);
+	if (degenerate())
+		return false;
+	double hl,hw,len,sw;
+	effective_geometry( hw, sw, len, hl, 1.0 );
+
+	vector origin, dir;
+	model_ray( ray, vector(1,1,1), origin, dir);
+	bool ret = ray_box( origin, dir,
+		vector(0, -sw*0.5, -sw*0.5), vector(len - hl, sw*0.5, sw*0.5), hit.t);
+	if (hl && hw) {
+		// The head is pyramid's model, scaled as in gl_render().
+		vector head_origin( (origin.x - (len - hl)) / hl, origin.y / hw, origin.z / hw);
+		vector head_dir( dir.x / hl, dir.y / hw, dir.z / hw);
+		if (pyramid::ray_intersect_model( head_origin, head_dir, hit.t))
+			ret = true;
+	}
+	return ret;
 }
 
 void
@@ -4,32 +4,41 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "box.hpp"
+#include "pick_engine.hpp"
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/instance_batch.hpp"
+#include "util/gl_free.hpp"
 
 namespace cvisual {
 
 displaylist box::model;
+mesh box::batch_model;
+
+namespace {
+const float s = 0.5;
+const float vertices[6][4][3] = {
+	{{ +s, +s, +s }, { +s, -s, +s }, { +s, -s, -s }, { +s, +s, -s }}, // Right face
+	{{ -s, +s, -s }, { -s, -s, -s }, { -s, -s, +s }, { -s, +s, +s }}, // Left face
+	{{ -s, -s, +s }, { -s, -s, -s }, { +s, -s, -s }, { +s, -s, +s }}, // Bottom face
+	{{ -s, +s, -s }, { -s, +s, +s }, { +s, +s, +s }, { +s, +s, -s }}, // Top face
+	{{ +s, +s, +s }, { -s, +s, +s }, { -s, -s, +s }, { +s, -s, +s }}, // Front face
+	{{ -s, -s, -s }, { -s, +s, -s }, { +s, +s, -s }, { +s, -s, -s }}  // Back face
+};
+const float normals[6][3] = {
+	{ +1, 0, 0 }, { -1, 0, 0 }, { 0, -1, 0 }, { 0, +1, 0 }, { 0, 0, +1 }, { 0, 0, -1 }
+};
+} // !namespace (anonymous)
 
 void
 box::init_model( displaylist& model, bool skip_right_face ) {
 	// Note that this model is also used by arrow!
+	lock L(gl_share_lock);
+	if (model) return;
 	model.gl_compile_begin();
 	glEnable(GL_CULL_FACE);
 	glBegin( GL_QUADS );
 
-	const float s = 0.5;
-	float vertices[6][4][3] = {
-		{{ +s, +s, +s }, { +s, -s, +s }, { +s, -s, -s }, { +s, +s, -s }}, // Right face
-		{{ -s, +s, -s }, { -s, -s, -s }, { -s, -s, +s }, { -s, +s, +s }}, // Left face
-		{{ -s, -s, +s }, { -s, -s, -s }, { +s, -s, -s }, { +s, -s, +s }}, // Bottom face
-		{{ -s, +s, -s }, { -s, +s, +s }, { +s, +s, +s }, { +s, +s, -s }}, // Top face
-		{{ +s, +s, +s }, { -s, +s, +s }, { -s, -s, +s }, { +s, -s, +s }}, // Front face
-		{{ -s, -s, -s }, { -s, +s, -s }, { +s, +s, -s }, { +s, -s, -s }}  // Back face
-	};
-	float normals[6][3] = {
-		{ +1, 0, 0 }, { -1, 0, 0 }, { 0, -1, 0 }, { 0, +1, 0 }, { 0, 0, +1 }, { 0, 0, -1 }
-	};
 	// Draw inside (reverse winding and normals)
 	for(int f=skip_right_face; f<6; f++) {
 		glNormal3f( -normals[f][0], -normals[f][1], -normals[f][2] );
@@ -48,10 +57,36 @@ box::init_model( displaylist& model, bool skip_right_face ) {
 	check_gl_error();
 }
 
-void 
-box::gl_pick_render( const view& scene)
+void
+box::init_mesh()
+{
+	lock L(gl_share_lock);
+	if (!batch_model.empty())
+		return;
+
+	// The same faces as init_model(), split into triangles.
+	batch_model.cull_face = true;
+	for (int side = -1; side <= 1; side += 2) {
+		for (int f = 0; f < 6; ++f) {
+			unsigned int first = batch_model.size();
+			for (int v = 0; v < 4; ++v) {
+				const float* p = vertices[f][side > 0 ? v : 3-v];
+				batch_model.add_vertex( p[0], p[1], p[2],
+					side*normals[f][0], side*normals[f][1], side*normals[f][2]);
+			}
+			batch_model.add_triangle( first, first+1, first+2);
+			batch_model.add_triangle( first, first+2, first+3);
+		}
+	}
+}
+
+bool
+box::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	gl_render(scene);
+	vector origin, dir;
+	if (!model_ray( ray, get_render_size(), origin, dir))
+		return false;
+	return ray_box( origin, dir, vector(-.5,-.5,-.5), vector(.5,.5,.5), hit.t);
 }
 
 void 
@@ -68,6 +103,24 @@ box::gl_render( const view& scene)
 	check_gl_error();
 }
 
+bool
+box::add_to_batch( const view& scene, instance_batch& batch)
+{
+	if (mat)
+		return false;
+
+	init_mesh();
+	batch.add( scene, &batch_model, get_transform( scene ), color, opacity);
+	return true;
+}
+
+bool
+box::culled( const view& scene)
+{
+	// The sphere through the corners of the box.
+	return scene.visible.excludes_sphere( pos, 0.5 * vector( axis.mag(), height, width).mag());
+}
+
 void 
 box::grow_extent( extent& e)
 {
@@ -84,5 +137,6 @@ box::get_material_matrix(const view&, tmatrix& out) {
 }
 
 PRIMITIVE_TYPEINFO_IMPL(box)
+PRIMITIVE_SNAPSHOT_IMPL(box)
 
 } // !namespace cvisual
\ No newline at end of file
@@ -4,10 +4,14 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "cone.hpp"
+#include "pick_engine.hpp"
 #include "util/errors.hpp"
 #include "util/displaylist.hpp"
 #include "util/quadric.hpp"
 #include "util/gl_enable.hpp"
+#include "util/instance_batch.hpp"
+#include "util/mesh.hpp"
+#include "util/gl_free.hpp"
 
 #include <vector>
 
@@ -79,6 +83,11 @@ render_cone_model( size_t n_sides, size_t n_stacks = 1)
 }
 
 static displaylist cone_simple_model[6];
+static mesh cone_mesh[6];
+
+// The number of faces and stacks corrisponding to each level of detail.
+static const size_t n_faces[] = { 8, 16, 32, 46, 68, 90 };
+static const size_t n_stacks[] = { 1, 2, 4, 7, 10, 14 };
 
 cone::cone()
 {
@@ -99,11 +108,9 @@ cone::get_length()
 void
 cone::init_model()
 {
+	lock L(gl_share_lock);
 	if (!cone_simple_model[0]) {
 		clear_gl_error();
-		// The number of faces corrisponding to each level of detail.
-		size_t n_faces[] = { 8, 16, 32, 46, 68, 90 };
-		size_t n_stacks[] = { 1, 2, 4, 7, 10, 14 };
 		for (size_t i = 0; i < 6; ++i) {
 			cone_simple_model[i].gl_compile_begin();
 			render_cone_model( n_faces[i], n_stacks[i]);
@@ -113,35 +120,31 @@ cone::init_model()
 	}
 }
 
-void
-cone::gl_pick_render( const view& scene)
+bool
+cone::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	if (degenerate())
-		return;
-	init_model();
-
-	size_t lod = 2;
-	clear_gl_error();
-
-	gl_matrix_stackguard guard;
-	const double length = axis.mag();
-	model_world_transform( scene.gcf, vector( length, radius, radius ) ).gl_mult();
-
-	cone_simple_model[lod].gl_render();
-	check_gl_error();
+	vector origin, dir;
+	if (degenerate() || !model_ray( ray, vector( axis.mag(), radius, radius), origin, dir))
+		return false;
+	return ray_unit_cone( origin, dir, hit.t);
 }
 
 void
-cone::gl_render( const view& scene)
+cone::init_mesh()
 {
-	if (degenerate())
+	lock L(gl_share_lock);
+	if (!cone_mesh[0].empty())
 		return;
+	for (size_t i = 0; i < 6; ++i) {
+		cone_mesh[i].add_cylinder( 1.0, 0.0, 1.0, n_faces[i], n_stacks[i]);
+		cone_mesh[i].add_disk( 1.0, n_faces[i], n_stacks[i] * 2, 0.0, -1);
+	}
+}
 
-	init_model();
-
-	clear_gl_error();
-
-	// See sphere::gl_render() for a description of the level of detail calc.
+int
+cone::get_lod( const view& scene)
+{
+	// See sphere::get_lod() for a description of the level of detail calc.
 	double coverage = scene.pixel_coverage( pos, radius);
 	int lod = 0;
 	if (coverage < 0)
@@ -163,6 +166,20 @@ cone::gl_render( const view& scene)
 		lod = 0;
 	else if (lod > 5)
 		lod = 5;
+	return lod;
+}
+
+void
+cone::gl_render( const view& scene)
+{
+	if (degenerate())
+		return;
+
+	init_model();
+
+	clear_gl_error();
+
+	int lod = get_lod( scene);
 
 	gl_matrix_stackguard guard;
 	const double length = axis.mag();
@@ -188,6 +205,22 @@ cone::gl_render( const view& scene)
 	check_gl_error();
 }
 
+bool
+cone::add_to_batch( const view& scene, instance_batch& batch)
+{
+	if (mat)
+		return false;
+	if (degenerate())
+		return true;
+
+	init_mesh();
+	const double length = axis.mag();
+	batch.add( scene, &cone_mesh[get_lod( scene)],
+		model_world_transform( scene.gcf, vector( length, radius, radius ) ),
+		color, opacity);
+	return true;
+}
+
 void
 cone::grow_extent( extent& e)
 {
@@ -205,5 +238,6 @@ cone::get_center() const
 }
 
 PRIMITIVE_TYPEINFO_IMPL(cone)
+PRIMITIVE_SNAPSHOT_IMPL(cone)
 
 } // !namespace cvisual
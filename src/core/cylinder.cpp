@@ -4,10 +4,14 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "cylinder.hpp"
+#include "pick_engine.hpp"
 #include "util/errors.hpp"
 #include "util/displaylist.hpp"
 #include "util/quadric.hpp"
 #include "util/gl_enable.hpp"
+#include "util/instance_batch.hpp"
+#include "util/mesh.hpp"
+#include "util/gl_free.hpp"
 
 namespace cvisual {
 
@@ -31,6 +35,11 @@ render_cylinder_model( size_t n_sides, size_t n_stacks = 1)
 }
 
 static displaylist cylinder_simple_model[6];
+static mesh cylinder_mesh[6];
+
+// The number of faces and stacks corrisponding to each level of detail.
+static const size_t n_faces[] = { 8, 16, 32, 64, 96, 188 };
+static const size_t n_stacks[] = {1, 1, 3, 6, 10, 20 };
 
 cylinder::cylinder()
 {
@@ -48,11 +57,9 @@ cylinder::~cylinder()
 void
 cylinder::init_model()
 {
+	lock L(gl_share_lock);
 	if (!cylinder_simple_model[0]) {
 		clear_gl_error();
-		// The number of faces corrisponding to each level of detail.
-		size_t n_faces[] = { 8, 16, 32, 64, 96, 188 };
-		size_t n_stacks[] = {1, 1, 3, 6, 10, 20 };
 		for (size_t i = 0; i < 6; ++i) {
 			cylinder_simple_model[i].gl_compile_begin();
 			render_cylinder_model( n_faces[i], n_stacks[i]);
@@ -74,34 +81,32 @@ cylinder::get_length()
 	return axis.mag();
 }
 
-void
-cylinder::gl_pick_render( const view& scene)
+bool
+cylinder::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	if (degenerate())
-		return;
-	init_model();
-
-	size_t lod = 2;
-	clear_gl_error();
-
-	gl_matrix_stackguard guard;
-	const double length = axis.mag();
-	model_world_transform( scene.gcf, vector( length, radius, radius ) ).gl_mult();
-
-	cylinder_simple_model[lod].gl_render();
-	check_gl_error();
+	vector origin, dir;
+	if (degenerate() || !model_ray( ray, vector( axis.mag(), radius, radius), origin, dir))
+		return false;
+	return ray_unit_cylinder( origin, dir, hit.t);
 }
 
 void
-cylinder::gl_render( const view& scene)
+cylinder::init_mesh()
 {
-	if (degenerate())
+	lock L(gl_share_lock);
+	if (!cylinder_mesh[0].empty())
 		return;
-	init_model();
-
-	clear_gl_error();
+	for (size_t i = 0; i < 6; ++i) {
+		cylinder_mesh[i].add_cylinder( 1.0, 1.0, 1.0, n_faces[i], n_stacks[i]);
+		cylinder_mesh[i].add_disk( 1.0, n_faces[i], 1, 0.0, -1); // left end of cylinder
+		cylinder_mesh[i].add_disk( 1.0, n_faces[i], 1, 1.0, 1); // right end of cylinder
+	}
+}
 
-	// See sphere::gl_render() for a description of the level of detail calc.
+int
+cylinder::get_lod( const view& scene)
+{
+	// See sphere::get_lod() for a description of the level of detail calc.
 	double coverage = scene.pixel_coverage( pos, radius);
 	int lod = 0;
 	if (coverage < 0)
@@ -123,6 +128,19 @@ cylinder::gl_render( const view& scene)
 		lod = 0;
 	else if (lod > 5)
 		lod = 5;
+	return lod;
+}
+
+void
+cylinder::gl_render( const view& scene)
+{
+	if (degenerate())
+		return;
+	init_model();
+
+	clear_gl_error();
+
+	int lod = get_lod( scene);
 
 	gl_matrix_stackguard guard;
 	const double length = axis.mag();
@@ -149,6 +167,22 @@ cylinder::gl_render( const view& scene)
 	check_gl_error();
 }
 
+bool
+cylinder::add_to_batch( const view& scene, instance_batch& batch)
+{
+	if (mat)
+		return false;
+	if (degenerate())
+		return true;
+
+	init_mesh();
+	const double length = axis.mag();
+	batch.add( scene, &cylinder_mesh[get_lod( scene)],
+		model_world_transform( scene.gcf, vector( length, radius, radius ) ),
+		color, opacity);
+	return true;
+}
+
 void
 cylinder::grow_extent( extent& e)
 {
@@ -167,5 +201,6 @@ cylinder::get_center() const
 }
 
 PRIMITIVE_TYPEINFO_IMPL(cylinder)
+PRIMITIVE_SNAPSHOT_IMPL(cylinder)
 
 } // !namespace cvisual
@@ -7,8 +7,10 @@
 #include "util/errors.hpp"
 #include "util/tmatrix.hpp"
 #include "util/gl_enable.hpp"
+#include "util/depth_sort.hpp"
 #include "material.hpp"
 #include "frame.hpp"
+#include "label.hpp"
 #include "text.hpp"
 #include "wrap_gl.hpp"
 
@@ -17,15 +19,17 @@
 #include <iterator>
 #include <sstream>
 #include <iostream>
-#include <boost/scoped_array.hpp>
 
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/thread_time.hpp>
 
 namespace cvisual {
 
 shared_ptr<display_kernel> display_kernel::selected;
 
 bool display_kernel::enable_shaders = true;
+bool display_kernel::render_threads = false;
 
 ////////////////////////////////////////////////////////////////
 // Implementation of display_kernel::waitWhileAnyDisplayVisible()
@@ -58,14 +62,22 @@ display_kernel::enable_lights(view& scene)
 	scene.light_count[0] = 0;
 	scene.light_pos.clear();
 	scene.light_color.clear();
-	std::list<shared_ptr<renderable> >::iterator i = layer_world.begin();
-	std::list<shared_ptr<renderable> >::iterator i_end = layer_world.end();
+	// Only lights and frames (which may contain lights) do anything here, and
+	// neither of them provides a snapshot.
+	std::vector<frame_object>::iterator i = frame_world.begin();
+	std::vector<frame_object>::iterator i_end = frame_world.end();
 	for(; i != i_end; ++i)
-		(*i)->render_lights( scene );
-	std::vector<shared_ptr<renderable> >::iterator j = layer_world_transparent.begin();
-	std::vector<shared_ptr<renderable> >::iterator j_end = layer_world_transparent.end();
+		if (!i->state) {
+			python::gil_lock gil;
+			i->owner->render_lights( scene );
+		}
+	std::vector<frame_object>::iterator j = frame_world_transparent.begin();
+	std::vector<frame_object>::iterator j_end = frame_world_transparent.end();
 	for(; j != j_end; ++j)
-		(*j)->render_lights( scene );
+		if (!j->state) {
+			python::gil_lock gil;
+			j->owner->render_lights( scene );
+		}
 
 	tmatrix world_camera; world_camera.gl_modelview_get();
 	vertex p;
@@ -145,6 +157,7 @@ display_kernel::display_kernel()
 	visible(false),
 	explicitly_invisible(false),
 	fullscreen(false),
+	windowless(false),
 	title( "VPython" ),
 	window_x(0), window_y(0), window_width(430), window_height(450),
 	view_width(-1), view_height(-1),
@@ -166,30 +179,39 @@ display_kernel::display_kernel()
 	show_toolbar( false),
 	show_rendertime( false),
 	last_time(0),
+	frame_pending(false),
 	background(0, 0, 0), //< Transparent black.
 	spin_allowed(true),
 	zoom_allowed(true),
 	mouse_mode( ZOOM_ROTATE),
 	stereo_mode( NO_STEREO),
 	stereodepth( 0.0f),
+	transparency_mode( SORTED_TRANSPARENCY),
 	lod_adjust(0),
 	realized(false),
+	frames_read(0),
+	frames_delivered(0),
+	capturing(false),
+	capture_from(0),
+	record_from(0),
+	record_until(0),
 	mouse( *this ),
 	range_auto(0.0),
 	range(0,0,0),
-	world_extent(0.0)
+	world_extent(0.0),
+	impostors(false)
 {
 }
 
 display_kernel::~display_kernel()
 {
-	if (visible)
+	if (visible && !windowless)
 		set_display_visible( this, false );
 }
 
 void
 display_kernel::report_closed() {
-	if (visible)
+	if (visible && !windowless)
 		set_display_visible( this, false );
 
 	VPYTHON_NOTE("report_closed: try to lock realize_lock.");
@@ -576,6 +598,11 @@ display_kernel::world_to_view_transform(
 		nearclip * tan_hfov_y,
 		nearclip,
 		farclip );
+	geometry.world_clip = tmatrix().gl_projection_get() * world_camera;
+	// Objects are drawn at gcf times their coordinates.  Without uniform
+	// axes some are drawn at gcfvec times theirs instead, so none are culled.
+	geometry.visible = (gcfvec.x == gcfvec.y && gcfvec.y == gcfvec.z)
+		? frustum( geometry.world_clip, geometry.gcf) : frustum();
 
 	glMatrixMode( GL_MODELVIEW);
 	check_gl_error();
@@ -602,34 +629,38 @@ display_kernel::recalc_extent(void)
 	tan_hfov( &tan_hfov_x, &tan_hfov_y );
 	double tan_hfov = std::max(tan_hfov_x, tan_hfov_y);
 
-	while (1) {  //< Might have to do this twice for autocenter
-		world_extent = extent_data( tan_hfov );
-
-		tmatrix l_cw;
-		l_cw.translate( -center );
-		extent ext( world_extent, l_cw );
+	// Measure the world in world space, where each object can reuse its
+	// extent from the last frame if it has not changed.
+	extent_data world( tan_hfov );
+	{
+		extent ext( world, tmatrix() );
 
 		world_iterator i( layer_world.begin());
 		world_iterator end( layer_world.end());
 		while (i != end) {
-			i->grow_extent( ext);
+			i->grow_extent_cached( ext);
 			++i;
 		}
 		world_trans_iterator j( layer_world_transparent.begin());
 		world_trans_iterator j_end( layer_world_transparent.end());
 		while (j != j_end) {
-			j->grow_extent( ext);
+			j->grow_extent_cached( ext);
 			++j;
 		}
-		if (autocenter) {
-			vector c = world_extent.get_center() + center;
-			if ( (center-c).mag2() > (center.mag2() + c.mag2()) * 1e-6 ) {
-				// Change center and recalculate extent (since camera_z depends on center)
-				center = c;
-				continue;
-			}
-		}
-		break;
+	}
+	if (autocenter) {
+		vector c = world.get_center();
+		if ( (center-c).mag2() > (center.mag2() + c.mag2()) * 1e-6 )
+			center = c;
+	}
+
+	// camera_z depends on center, so the world extent is kept relative to it.
+	world_extent = extent_data( tan_hfov );
+	{
+		tmatrix l_cw;
+		l_cw.translate( -center );
+		extent ext( world_extent, l_cw );
+		ext.add_extent( world);
 	}
 	if (autoscale && uniform) {
 		double r = world_extent.get_camera_z();
@@ -681,13 +712,101 @@ void
 display_kernel::remove_renderable( shared_ptr<renderable> obj)
 {
 	// Driven from visual/primitives.py set_visible
-	if (!obj->translucent()) {
-		std::remove( layer_world.begin(), layer_world.end(), obj);
-		layer_world.pop_back();
+	// The object may have changed opacity since take_snapshot() last put it
+	// in a layer, so look in both.
+	std::list<shared_ptr<renderable> >::iterator i
+		= std::find( layer_world.begin(), layer_world.end(), obj);
+	if (i != layer_world.end()) {
+		layer_world.erase( i);
+		return;
+	}
+	std::vector<shared_ptr<renderable> >::iterator j = std::find(
+		layer_world_transparent.begin(), layer_world_transparent.end(), obj);
+	if (j != layer_world_transparent.end())
+		layer_world_transparent.erase( j);
+}
+
+void
+display_kernel::take_snapshot()
+{
+	// Release last frame's references here, where the GIL is held, since
+	// dropping the last reference to an object may call into Python.
+	double snapshot_start = render_timer.elapsed();
+	frame_world.clear();
+	frame_world_transparent.clear();
+	frame_world_mixed.clear();
+	const bool blending = use_blend();
+
+	std::list<shared_ptr<renderable> >::iterator i = layer_world.begin();
+	std::list<shared_ptr<renderable> >::iterator i_end = layer_world.end();
+	while (i != i_end) {
+		if ((*i)->translucent()) {
+			// The color of the object has become transparent when it was not
+			// initially.  Move it to the transparent layer.
+			layer_world_transparent.push_back( *i);
+			i = layer_world.erase(i);
+			continue;
+		}
+		frame_world.push_back( frame_object( *i, (*i)->snapshot()));
+		++i;
+	}
+
+	// The depth of each transparent object is computed here rather than in
+	// the sort, since get_center() may read Python-owned data.  Objects that
+	// have become opaque again go back to the opaque layer, where they are
+	// neither sorted nor at risk of being drawn in the wrong order.
+	vector forward = internal_forward.norm();
+	std::vector<shared_ptr<renderable> >::iterator j = layer_world_transparent.begin();
+	while (j != layer_world_transparent.end()) {
+		if (!(*j)->translucent()) {
+			layer_world.push_back( *j);
+			frame_world.push_back( frame_object( *j, (*j)->snapshot()));
+			j = layer_world_transparent.erase( j);
+			continue;
+		}
+		frame_world_transparent.push_back( frame_object( *j, (*j)->snapshot()));
+		frame_world_transparent.back().depth = forward.dot( (*j)->get_center());
+		if (blending && (*j)->mixed_opacity())
+			frame_world_mixed.push_back( frame_world_transparent.back());
+		++j;
+	}
+	double sort_start = render_timer.elapsed();
+	// Put the transparent world in order from back to front, unless it is to
+	// be blended in any order.
+	const size_t n_transparent = frame_world_transparent.size();
+	if (n_transparent > 1 && !blending) {
+		transparent_depth.resize( n_transparent);
+		for (size_t k = 0; k < n_transparent; ++k)
+			transparent_depth[k] = frame_world_transparent[k].depth;
+		depth_order( transparent_depth, transparent_order);
+		std::vector<frame_object> sorted;
+		sorted.reserve( n_transparent);
+		for (size_t k = 0; k < n_transparent; ++k)
+			sorted.push_back( frame_world_transparent[transparent_order[k]]);
+		frame_world_transparent.swap( sorted);
+	}
+
+	current_frame.snapshot = sort_start - snapshot_start;
+	current_frame.sort = render_timer.elapsed() - sort_start;
+	current_frame.objects = frame_world.size();
+	current_frame.transparent_objects = frame_world_transparent.size();
+}
+
+void
+display_kernel::render_frame_object( const frame_object& obj, const view& scene_geometry)
+{
+	if (obj.state) {
+		if (obj.state->culled( scene_geometry))
+			++scene_geometry.culled_objects;
+		else
+			obj.state->outer_render( scene_geometry);
 	}
 	else {
-		std::remove( layer_world_transparent.begin(), layer_world_transparent.end(), obj);
-		layer_world_transparent.pop_back();
+		python::gil_lock gil;
+		if (obj.owner->culled( scene_geometry))
+			++scene_geometry.culled_objects;
+		else
+			obj.owner->outer_render( scene_geometry);
 	}
 }
 
@@ -695,57 +814,69 @@ bool
 display_kernel::draw(
 	view& scene_geometry, int whicheye)
 {
+	double opaque_start = render_timer.elapsed();
 	// Set up the base modelview and projection matrices
 	world_to_view_transform( scene_geometry, whicheye);
 
-	// Render all opaque objects in the world space layer
+	// Render all opaque objects in the world space layer.  Simple primitives
+	// are queued by type and level of detail, and drawn a whole group at a
+	// time.  Objects out of sight are skipped.
 	enable_lights(scene_geometry);
-	world_iterator i( layer_world.begin());
-	world_iterator i_end( layer_world.end());
-	while (i != i_end) {
-		if (i->translucent()) {
-			// The color of the object has become transparent when it was not
-			// initially.  Move it to the transparent layer.  The penalty for
-			// being rendered in the transparent layer when it is opaque is only
-			// a small speed hit when it has to be sorted.  Therefore, that case
-			// is not tested at all.  (TODO Untrue-- rendering opaque objects in transparent
-			// layer makes it possible to have opacity artifacts with a single convex
-			// opaque objects, provided other objects in the scene were ONCE transparent)
-			layer_world_transparent.push_back( *i.base());
-			i = layer_world.erase(i.base());
+	std::vector<frame_object>::const_iterator i = frame_world.begin();
+	std::vector<frame_object>::const_iterator i_end = frame_world.end();
+	for (; i != i_end; ++i) {
+		if (i->state && i->state->culled( scene_geometry)) {
+			++scene_geometry.culled_objects;
 			continue;
 		}
-
-		i->outer_render( scene_geometry);
-		++i;
+		if (!i->state || !i->state->add_to_batch( scene_geometry, batch))
+			render_frame_object( *i, scene_geometry);
 	}
-
-	// Perform a depth sort of the transparent world from back to front.
-	if (layer_world_transparent.size() > 1)
-		std::stable_sort(
-			layer_world_transparent.begin(), layer_world_transparent.end(),
-			z_comparator( internal_forward.norm()));
-
-	// Render translucent objects in world space.
-	world_trans_iterator j( layer_world_transparent.begin());
-	world_trans_iterator j_end( layer_world_transparent.end());
-	while (j != j_end) {
-		j->outer_render( scene_geometry );
-		++j;
+	// The opaque parts of translucent bodies whose translucent parts are to
+	// be blended.
+	scene_geometry.parts = view::OPAQUE_PARTS;
+	for (i = frame_world_mixed.begin(); i != frame_world_mixed.end(); ++i)
+		render_frame_object( *i, scene_geometry);
+	batch.gl_render( scene_geometry);
+	double transparent_start = render_timer.elapsed();
+	current_frame.opaque += transparent_start - opaque_start;
+
+	// Render translucent objects in world space, already sorted by take_snapshot().
+	std::vector<frame_object>::const_iterator j_begin = frame_world_transparent.begin();
+	std::vector<frame_object>::const_iterator j_end = frame_world_transparent.end();
+	// Once the opaque parts of a body have been drawn, only its translucent
+	// parts are left, even if blending fails below.
+	scene_geometry.parts = frame_world_mixed.empty()
+		? view::ALL_PARTS : view::TRANSLUCENT_PARTS;
+	if (j_begin != j_end && use_blend() && blend.begin_accumulation( scene_geometry)) {
+		scene_geometry.parts = view::TRANSLUCENT_PARTS;
+		for (std::vector<frame_object>::const_iterator j = j_begin; j != j_end; ++j)
+			render_frame_object( *j, scene_geometry);
+		// The second pass culls the same objects again; count them once.
+		const int culled = scene_geometry.culled_objects;
+		blend.begin_revealage( scene_geometry);
+		for (std::vector<frame_object>::const_iterator j = j_begin; j != j_end; ++j)
+			render_frame_object( *j, scene_geometry);
+		blend.composite( scene_geometry);
+		scene_geometry.culled_objects = culled;
+	}
+	else {
+		for (std::vector<frame_object>::const_iterator j = j_begin; j != j_end; ++j)
+			render_frame_object( *j, scene_geometry);
 	}
+	scene_geometry.parts = view::ALL_PARTS;
+	double screen_start = render_timer.elapsed();
+	current_frame.transparent += screen_start - transparent_start;
 
 	// Render all objects in screen space.
+	current_frame.screen_objects = scene_geometry.screen_objects.size();
+	// With stereo, this includes both eyes.
+	current_frame.culled = scene_geometry.culled_objects;
 	disable_lights();
 	gl_disable depth_test( GL_DEPTH_TEST);
-	typedef std::multimap<vector, displaylist, z_comparator>::iterator
-		screen_iterator;
-	screen_iterator k( scene_geometry.screen_objects.begin());
-	screen_iterator k_end( scene_geometry.screen_objects.end());
-	while ( k != k_end) {
-		k->second.gl_render();
-		++k;
-	}
+	screen_label::gl_render_all( scene_geometry, scene_geometry.screen_objects);
 	scene_geometry.screen_objects.clear();
+	current_frame.screen += render_timer.elapsed() - screen_start;
 
 	return true;
 }
@@ -755,6 +886,12 @@ display_kernel::draw(
 bool
 display_kernel::render_scene(void)
 {
+	// The GIL is held only while the snapshot is taken and while the mouse
+	// is updated; see below.
+	double wait_start = render_timer.elapsed();
+	python::gil_lock gil;
+	double start_time = render_timer.elapsed();
+
 	// TODO: Exception handling?
 	if (!realized) {
 		realize();
@@ -763,18 +900,26 @@ display_kernel::render_scene(void)
 		realized = true;
 		realize_condition.notify_all();
 	}
-	double start_time, cycle;
-	if (show_rendertime) {
-		start_time = render_timer.elapsed();
-		cycle = start_time - last_time;
-		last_time = start_time;
-	}
+	double cycle = last_time ? start_time - last_time : 0;
+	last_time = start_time;
+	current_frame = frame_stats();
+	current_frame.start = start_time;
+	current_frame.cycle = cycle;
+	current_frame.gil_wait = start_time - wait_start;
 	try {
+		double extent_start = render_timer.elapsed();
 		recalc_extent();
+		current_frame.extent = render_timer.elapsed() - extent_start;
+		take_snapshot();
 		view scene_geometry( internal_forward.norm(), center, view_width,
 			view_height, forward_changed, gcf, gcfvec, gcf_changed, glext);
 		scene_geometry.lod_adjust = lod_adjust;
 		scene_geometry.enable_shaders = enable_shaders;
+		scene_geometry.impostors = impostors;
+
+		// Drawing works from the snapshot, so the Python program may run until
+		// the end of this block.
+		python::gil_release nogil;
 		clear_gl_error();
 
 		on_gl_free.frame();
@@ -943,6 +1088,17 @@ display_kernel::render_scene(void)
 		check_gl_error();
 		gcf_changed = false;
 		forward_changed = false;
+
+		// Keep the transforms that map the cursor into the scene.  Picking
+		// itself waits until the Python program asks for mouse.pick or
+		// mouse.pickpos.
+		view pick_geometry( internal_forward.norm(), center, view_width, view_height,
+			forward_changed, gcf, gcfvec, gcf_changed, glext);
+		world_to_view_transform( pick_geometry, 0, false);
+		pick_modelview.gl_modelview_get();
+		pick_projection.gl_projection_get();
+
+		read_frame();
 	}
 	catch (gl_error e) {
 		std::ostringstream msg;
@@ -954,170 +1110,102 @@ display_kernel::render_scene(void)
 		render_time = render_timer.elapsed()-start_time;
 	}
 
-	// TODO: Can we delay picking until the Python program actually wants one of these attributes?
+	// Replacing mouse.pick may release the last reference to an object, so
+	// this is done with the GIL held.
+	double pick_start = render_timer.elapsed();
+	vector mousepos;
+	pick_ray ray = get_pick_ray( mouse.get_x(), mouse.get_y(), 2.0, mousepos);
 	mouse.get_mouse().cam = camera;
-	boost::tie( mouse.get_mouse().pick, mouse.get_mouse().pickpos, mouse.get_mouse().position) =
-		pick( mouse.get_x(), mouse.get_y() );
+	mouse.get_mouse().position = mousepos;
+	mouse.get_mouse().picked.reset( new lazy_pick( make_pick_engine(), ray));
+	current_frame.pick = render_timer.elapsed() - pick_start;
+	frame_pending = true;
 
 	on_gl_free.frame();
 
 	return true;
 }
 
+void
+display_kernel::end_frame( double swap_time)
+{
+	if (!frame_pending)
+		return;
+	frame_pending = false;
+	current_frame.swap = swap_time;
+	current_frame.total = render_timer.elapsed() - current_frame.start;
+	stats.push( current_frame);
+}
+
+pick_ray
+display_kernel::get_pick_ray( int x, int y, float d_pixels, vector& mousepos)
+{
+	GLint viewport_bounds[4] = {
+		0, 0, view_width, view_height
+	};
+	const double* modelview = pick_modelview.matrix_addr();
+	const double* projection = pick_projection.matrix_addr();
+	const double wy = view_height - y;
+
+	// The points under the cursor, and one pixel to the right of it, on the
+	// near and far clipping planes.
+	vector near_point, far_point, near_side, far_side;
+	gluUnProject( x, wy, 0.0, modelview, projection, viewport_bounds,
+		&near_point.x, &near_point.y, &near_point.z);
+	gluUnProject( x, wy, 1.0, modelview, projection, viewport_bounds,
+		&far_point.x, &far_point.y, &far_point.z);
+	gluUnProject( x+1, wy, 0.0, modelview, projection, viewport_bounds,
+		&near_side.x, &near_side.y, &near_side.z);
+	gluUnProject( x+1, wy, 1.0, modelview, projection, viewport_bounds,
+		&far_side.x, &far_side.y, &far_side.z);
+
+	vector tcenter;
+	gluProject( center.x*gcf, center.y*gcf, center.z*gcf,
+		modelview, projection, viewport_bounds,
+		&tcenter.x, &tcenter.y, &tcenter.z);
+	gluUnProject( x, wy, tcenter.z, modelview, projection, viewport_bounds,
+		&mousepos.x, &mousepos.y, &mousepos.z);
+	mousepos = mousepos.scale_inv( gcfvec);
+
+	near_point = near_point.scale_inv( gcfvec);
+	far_point = far_point.scale_inv( gcfvec);
+	near_side = near_side.scale_inv( gcfvec);
+	far_side = far_side.scale_inv( gcfvec);
+
+	// The width of a pixel grows linearly with distance from the camera.
+	double depth = (far_point - near_point).mag();
+	double pixel = depth ? ((far_side - far_point).mag()
+		- (near_side - near_point).mag()) / depth : 0.0;
+	return pick_ray( near_point, (far_point - near_point).norm(),
+		pixel * d_pixels * 0.5, pixel);
+}
+
+shared_ptr<pick_engine>
+display_kernel::make_pick_engine()
+{
+	if (!picker)
+		picker.reset( new pick_engine());
+	// Queued mouse events share the last frame's pick.  They must see that
+	// frame's bodies, so answer it now, before the engine is refilled.
+	const shared_ptr<lazy_pick>& last_pick = mouse.get_mouse().picked;
+	if (last_pick && !last_pick.unique())
+		last_pick->evaluate();
+	picker->clear();
+	for (std::vector<frame_object>::const_iterator i = frame_world.begin();
+			i != frame_world.end(); ++i)
+		picker->add( i->owner);
+	for (std::vector<frame_object>::const_iterator j = frame_world_transparent.begin();
+			j != frame_world_transparent.end(); ++j)
+		picker->add( j->owner);
+	return picker;
+}
+
 boost::tuple< shared_ptr<renderable>, vector, vector>
 display_kernel::pick( int x, int y, float d_pixels)
 {
-	using boost::scoped_array;
-
-	shared_ptr<renderable> best_pick;
-    vector pickpos;
-    vector mousepos;
-	try {
-		clear_gl_error();
-		// Notes:
-		// culled polygons don't count.  glRasterPos() does count.
-
-		// Allocate a selection buffer of uints.  Format for returned hits is:
-		// {uint32: n_names}{uint32: minimunm depth}{uint32: maximum depth}
-		// {unit32[n_names]: name_stack}
-		// n_names is the depth of the name stack at the time of the hit.
-		// minimum and maximum depth are the minimum and maximum values in the
-		// depth buffer scaled between 0 and 2^32-1. (source is [0,1])
-		// name_stack is the full contents of the name stack at the time of the
-		// hit.
-
-		size_t hit_buffer_size = std::max(
-				(layer_world.size()+layer_world_transparent.size())*4,
-				world_extent.get_select_buffer_depth());
-		// Allocate an exception-safe buffer for the GL to talk back to us.
-		scoped_array<unsigned int> hit_buffer(
-			new unsigned int[hit_buffer_size]);
-		// unsigned int hit_buffer[hit_buffer_size];
-
-		// Allocate a std::vector<shared_ptr<renderable> > to lookup names
-		// as they are rendered.
-		std::vector<shared_ptr<renderable> > name_table;
-		// Pass the name stack to OpenGL with glSelectBuffer.
-		glSelectBuffer( hit_buffer_size, (GLuint*)hit_buffer.get());
-		// Enter selection mode with glRenderMode
-		glRenderMode( GL_SELECT);
-		glClear( GL_DEPTH_BUFFER_BIT);
-		// Clear the name stack with glInitNames(), raise the height of the name
-		// stack with glPushName() exactly once.
-		glInitNames();
-		glPushName(0);
-
-		// Initialize the picking matrix.
-		GLint viewport_bounds[4] = {
-			0, 0, view_width, view_height
-		};
-		glMatrixMode( GL_PROJECTION);
-		glLoadIdentity();
-		gluPickMatrix( (float)x, (float)(view_height - y), d_pixels, d_pixels, viewport_bounds);
-		view scene_geometry( internal_forward.norm(), center, view_width, view_height,
-			forward_changed, gcf, gcfvec, gcf_changed, glext);
-		scene_geometry.lod_adjust = lod_adjust;
-		world_to_view_transform( scene_geometry, 0, true);
-
-		// Iterate across the world, rendering each body for picking.
-		std::list<shared_ptr<renderable> >::iterator i = layer_world.begin();
-		std::list<shared_ptr<renderable> >::iterator i_end = layer_world.end();
-		while (i != i_end) {
-			glLoadName( name_table.size());
-			name_table.push_back( *i);
-			{
-				(*i)->gl_pick_render( scene_geometry);
-			}
-			++i;
-		}
-		std::vector<shared_ptr<renderable> >::iterator j
-			= layer_world_transparent.begin();
-		std::vector<shared_ptr<renderable> >::iterator j_end
-			= layer_world_transparent.end();
-		while (j != j_end) {
-			glLoadName( name_table.size());
-			name_table.push_back( *j);
-			{
-				(*j)->gl_pick_render( scene_geometry);
-			}
-			++j;
-		}
-		// Return the name stack to the bottom with glPopName() exactly once.
-		glPopName();
-
-		// Exit selection mode, return to normal rendering rendering. (collects
-		// the number of hits at this time).
-		size_t n_hits = glRenderMode( GL_RENDER);
-		check_gl_error();
-
-		// Lookup the name to get the shared_ptr<renderable> associated with it.
-		// The farthest point away in the depth buffer.
-		double best_pick_depth = 1.0;
-		unsigned int* hit_record = hit_buffer.get();
-		unsigned int* const hit_buffer_end = hit_buffer.get() + hit_buffer_size;
-		while (n_hits > 0 && hit_record < hit_buffer_end) {
-			unsigned int n_names = hit_record[0];
-			if (hit_record + 3 + n_names > hit_buffer_end)
-				break;
-			double min_hit_depth = static_cast<double>(hit_record[1])
-				/ 0xffffffffu;
-			if (min_hit_depth < best_pick_depth) {
-				best_pick_depth = min_hit_depth;
-				best_pick = name_table[*(hit_record+3)];
-				if (n_names > 1) {
-					// Then the picked object is the child of a frame.
-					frame* ref_frame = dynamic_cast<frame*>(best_pick.get());
-					assert(ref_frame != NULL);
-					best_pick = ref_frame->lookup_name(
-						hit_record + 4, hit_record + 3 + n_names);
-				}
-			}
-			hit_record += 3 + n_names;
-			n_hits--;
-		}
-		if (hit_record > hit_buffer_end)
-			VPYTHON_CRITICAL_ERROR(
-				"More objects were picked than could be reported by the GL."
-				"  The hit buffer size was too small.");
-
-        tmatrix modelview;
-        modelview.gl_modelview_get();
-        tmatrix projection;
-        projection.gl_projection_get();
-        gluUnProject(
-            x, view_height - y, best_pick_depth,
-            modelview.matrix_addr(),
-            projection.matrix_addr(),
-            viewport_bounds,
-            &pickpos.x, &pickpos.y, &pickpos.z);
-        // TODO: Replace the calls to gluUnProject() with own tmatrix inverse
-        // and such for optimization
-        vector tcenter;
-        gluProject( center.x*gcf, center.y*gcf, center.z*gcf,
-           	modelview.matrix_addr(),
-            projection.matrix_addr(),
-            viewport_bounds,
-            &tcenter.x, &tcenter.y, &tcenter.z);
-
-        gluUnProject(
-        	x, view_height - y, tcenter.z,
-        	modelview.matrix_addr(),
-        	projection.matrix_addr(),
-        	viewport_bounds,
-        	&mousepos.x, &mousepos.y, &mousepos.z);
-	}
-	catch (gl_error e) {
-		std::ostringstream msg;
-		msg << "OpenGL error: " << e.what() << ", aborting.\n";
-		VPYTHON_CRITICAL_ERROR( msg.str());
-		std::exit(1);
-	}
-	pickpos.x /= gcfvec.x;
-	pickpos.y /= gcfvec.y;
-	pickpos.z /= gcfvec.z;
-	mousepos.x /= gcfvec.x;
-	mousepos.y /= gcfvec.y;
-	mousepos.z /= gcfvec.z;
+	vector pickpos, mousepos;
+	pick_ray ray = get_pick_ray( x, y, d_pixels, mousepos);
+	shared_ptr<renderable> best_pick = make_pick_engine()->pick( ray, pickpos);
 	return boost::make_tuple( best_pick, pickpos, mousepos);
 }
 
@@ -1351,6 +1439,156 @@ display_kernel::is_showing_rendertime()
 	return show_rendertime;
 }
 
+void
+display_kernel::set_impostors( bool n_impostors)
+{
+	impostors = n_impostors;
+}
+
+bool
+display_kernel::get_impostors()
+{
+	return impostors;
+}
+
+std::vector<frame_stats>
+display_kernel::get_stats() const
+{
+	return stats.recent();
+}
+
+void
+display_kernel::clear_stats()
+{
+	stats.clear();
+}
+
+void
+display_kernel::read_frame()
+{
+	lock L(capture_barrier);
+	const bool wanted = capturing || (recorder && record_until > frames_read);
+	if (wanted && view_width > 0 && view_height > 0) {
+		++frames_read;
+		readback.read( glext, view_width, view_height,
+			boost::bind( &display_kernel::deliver_frame, this, _1, _2, _3));
+	}
+	else if (readback.pending())
+		// Nothing more is wanted, so the frames still in the pixel buffers are
+		// all there is to come.
+		readback.flush( glext,
+			boost::bind( &display_kernel::deliver_frame, this, _1, _2, _3));
+}
+
+void
+display_kernel::flush_frames()
+{
+	lock L(capture_barrier);
+	readback.flush( glext,
+		boost::bind( &display_kernel::deliver_frame, this, _1, _2, _3));
+}
+
+void
+display_kernel::deliver_frame( const unsigned char* rgba, int width, int height)
+{
+	// Called from read_frame() or flush_frames(), with capture_barrier held.
+	const unsigned long serial = frames_delivered++;
+	if (capturing && serial >= capture_from) {
+		captured.reset( new frame_image);
+		captured->pixels.assign( rgba, rgba + (size_t)width * height * 4);
+		captured->width = width;
+		captured->height = height;
+		capturing = false;
+	}
+	if (recorder && serial >= record_from && serial < record_until) {
+		try {
+			recorder->write( rgba, width, height);
+		}
+		catch (std::runtime_error&) {
+			// The error is thrown again by stop_recording(), and the writer
+			// drops the frames after it, so there is nothing more to do here.
+		}
+	}
+	capture_changed.notify_all();
+}
+
+void
+display_kernel::request_capture()
+{
+	lock L(capture_barrier);
+	// Frames already being read were drawn before the request.
+	capture_from = frames_read;
+	capturing = true;
+	captured.reset();
+}
+
+shared_ptr<frame_image>
+display_kernel::take_capture()
+{
+	lock L(capture_barrier);
+	capturing = false;
+	shared_ptr<frame_image> ret;
+	ret.swap( captured);
+	return ret;
+}
+
+shared_ptr<frame_image>
+display_kernel::capture()
+{
+	if (!visible)
+		throw std::runtime_error( "Only a visible display can be captured.");
+	// The renderer may hold capture_barrier while it waits for a writer that
+	// needs the GIL.
+	python::gil_release nogil;
+	request_capture();
+	lock L(capture_barrier);
+	const boost::system_time limit = boost::get_system_time()
+		+ boost::posix_time::seconds(1);
+	while (!captured && visible)
+		if (!capture_changed.timed_wait( L, limit))
+			break;
+	capturing = false;
+	if (!captured)
+		throw std::runtime_error( "The display did not draw a frame to capture.");
+	shared_ptr<frame_image> ret;
+	ret.swap( captured);
+	return ret;
+}
+
+void
+display_kernel::record( shared_ptr<frame_sink> sink)
+{
+	stop_recording();
+	shared_ptr<frame_writer> writer( new frame_writer( sink));
+	python::gil_release nogil;
+	lock L(capture_barrier);
+	recorder = writer;
+	record_from = frames_read;
+	record_until = (unsigned long)-1;
+}
+
+void
+display_kernel::stop_recording()
+{
+	python::gil_release nogil;
+	shared_ptr<frame_writer> writer;
+	{
+		lock L(capture_barrier);
+		if (!recorder)
+			return;
+		record_until = frames_read;
+		// Give the renderer a moment to hand over the frames already read;
+		// without it, they are lost.
+		const boost::system_time limit = boost::get_system_time()
+			+ boost::posix_time::seconds(1);
+		while (visible && frames_delivered < record_until)
+			if (!capture_changed.timed_wait( L, limit))
+				break;
+		writer.swap( recorder);
+	}
+	writer->close();
+}
+
 void
 display_kernel::set_ambient_f( float a)
 {
@@ -1432,6 +1670,32 @@ display_kernel::set_stereomode( std::string mode)
 		throw std::invalid_argument( "Unimplemented or invalid stereo mode");
 }
 
+void
+display_kernel::set_transparency( std::string mode)
+{
+	if (mode == "sorted")
+		transparency_mode = SORTED_TRANSPARENCY;
+	else if (mode == "blended")
+		transparency_mode = BLENDED_TRANSPARENCY;
+	else
+		throw std::invalid_argument( "Invalid transparency mode");
+}
+
+std::string
+display_kernel::get_transparency()
+{
+	if (transparency_mode == BLENDED_TRANSPARENCY)
+		return "blended";
+	return "sorted";
+}
+
+bool
+display_kernel::use_blend() const
+{
+	return transparency_mode == BLENDED_TRANSPARENCY
+		&& blend.available( glext, enable_shaders);
+}
+
 std::string
 display_kernel::get_stereomode()
 {
@@ -1558,7 +1822,8 @@ display_kernel::set_visible( bool vis)
 	if (!vis) explicitly_invisible = true;
 	if (vis != visible) {
 		visible = vis;
-		set_display_visible( this, visible );
+		if (!windowless)
+			set_display_visible( this, visible );
 		activate( vis );
 
 		// Wait for (in)activation to complete
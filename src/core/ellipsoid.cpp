@@ -106,5 +106,6 @@ ellipsoid::grow_extent( extent& world)
 }
 
 PRIMITIVE_TYPEINFO_IMPL(ellipsoid)
+PRIMITIVE_SNAPSHOT_IMPL(ellipsoid)
 
 } // !namespace cvisual
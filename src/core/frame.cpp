@@ -4,6 +4,8 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "frame.hpp"
+#include "pick_engine.hpp"
+#include "util/depth_sort.hpp"
 
 #include <algorithm>
 
@@ -12,9 +14,10 @@ namespace cvisual {
 frame::frame()
 	: pos( 0, 0, 0),
 	axis( 1, 0, 0),
-	up( 0, 1, 0)
+	up( 0, 1, 0),
 	// Disable frame.scale in Visual 4.0
 	//scale( 1.0, 1.0, 1.0)
+	extent_children(0), children_cullable(false)
 {
 }
 
@@ -22,8 +25,9 @@ frame::frame( const frame& other)
 	: renderable( other),
 	pos(other.pos.x, other.pos.y, other.pos.z),
 	axis(other.axis.x, other.axis.y, other.axis.z),
-	up(other.up.x, other.up.y, other.up.z)
+	up(other.up.x, other.up.y, other.up.z),
 	// scale(other.scale.x, other.scale.y, other.scale.z)
+	extent_children(0), children_cullable(false)
 {
 }
 
@@ -235,20 +239,26 @@ frame::add_renderable( shared_ptr<renderable> obj)
 		children.push_back( obj);
 	else
 		trans_children.push_back( obj);
+	extent_changed();
 }
 
 void
 frame::remove_renderable( shared_ptr<renderable> obj)
 {
 	// Driven from visual/primitives.py set_visible
-	if (!obj->translucent()) {
-		std::remove( children.begin(), children.end(), obj);
-		children.pop_back();
-	}
+	// The child may have changed opacity since gl_render() last put it in a
+	// list, so look in both, as display_kernel::remove_renderable() does.
+	std::list<shared_ptr<renderable> >::iterator i
+		= std::find( children.begin(), children.end(), obj);
+	if (i != children.end())
+		children.erase( i);
 	else {
-		std::remove( trans_children.begin(), trans_children.end(), obj);
-		trans_children.pop_back();
+		std::vector<shared_ptr<renderable> >::iterator j
+			= std::find( trans_children.begin(), trans_children.end(), obj);
+		if (j != trans_children.end())
+			trans_children.erase( j);
 	}
+	extent_changed();
 }
 
 std::vector<shared_ptr<renderable> >
@@ -259,39 +269,6 @@ frame::get_objects()
 	return ret;
 }
 
-shared_ptr<renderable>
-frame::lookup_name(
-	const unsigned int* name_top,
-	const unsigned int* name_end)
-{
-	assert( name_top < name_end);
-	assert( *name_top < children.size() + trans_children.size());
-	using boost::dynamic_pointer_cast;
-
-	shared_ptr<renderable> ret;
-	unsigned int size = 0;
-	const_child_iterator i( children.begin());
-	const_child_iterator i_end( children.end());
-	while (i != i_end) {
-		if (*name_top == size) {
-			ret = *i.base();
-			break;
-		}
-		size++;
-		++i;
-	}
-	if (!ret)
-		ret = trans_children[*(name_top) - size];
-
-	if (name_end - name_top > 1) {
-		frame* ref_frame = dynamic_cast<frame*>(ret.get());
-		assert( ref_frame != NULL);
-		return ref_frame->lookup_name(name_top + 1, name_end);
-	}
-	else
-		return ret;
-}
-
 vector
 frame::get_center() const
 {
@@ -303,9 +280,25 @@ frame::gl_render( const view& v)
 {
 	view local(v); local.apply_frame_transform(world_frame_transform());
     tmatrix fwt = frame_world_transform(v.gcf);
+	local.world_clip = v.world_clip * fwt;
+	if (v.visible.bounded())
+		local.visible = frustum( local.world_clip, v.gcf);
+	local.culled_objects = 0;
 	{
 		gl_matrix_stackguard guard( fwt);
 
+		// Children that have become opaque again go back to the opaque list,
+		// as in display_kernel::take_snapshot().
+		std::vector<shared_ptr<renderable> >::iterator j = trans_children.begin();
+		while (j != trans_children.end()) {
+			if (!(*j)->translucent()) {
+				children.push_back( *j);
+				j = trans_children.erase( j);
+			}
+			else
+				++j;
+		}
+
 		child_iterator i(children.begin());
 		child_iterator i_end(children.end());
 		while (i != i_end) {
@@ -315,26 +308,61 @@ frame::gl_render( const view& v)
 				i = children.erase(i.base());
 				continue;
 			}
-			i->outer_render(local);
+			// The opaque children were drawn in the opaque pass; see
+			// view::parts.
+			if (v.parts == view::TRANSLUCENT_PARTS) {
+				i++;
+				continue;
+			}
+			if (i->culled( local))
+				++local.culled_objects;
+			else if (!i->add_to_batch( local, batch))
+				i->outer_render(local);
 			i++;
 		}
-
-		// Perform a depth sort of the transparent children from forward to backward.
-		if (!trans_children.empty()) {
-			opacity = 0.5;  //< TODO: BAD HACK
+		// As display_kernel::draw() does, in the frame's coordinates.
+		batch.gl_render( local);
+
+		// The frame is drawn with the transparent layer while it has
+		// translucent children, and with the opaque layer once it has none.
+		opacity = trans_children.empty() ? 1.0f : 0.5f;
+
+		if (v.parts == view::ALL_PARTS) {
+			// Perform a depth sort of the transparent children from back to
+			// front.  Each child's depth is found once, rather than in every
+			// comparison.
+			vector forward = (pos*v.gcf - v.camera).norm();
+			std::vector<double> depth( trans_children.size());
+			for (size_t k = 0; k < trans_children.size(); ++k)
+				depth[k] = forward.dot( trans_children[k]->get_center());
+			std::vector<size_t> order;
+			depth_order( depth, order);
+
+			for (size_t k = 0; k < order.size(); ++k) {
+				if (trans_children[order[k]]->culled( local))
+					++local.culled_objects;
+				else
+					trans_children[order[k]]->outer_render(local);
+			}
 		}
-		if (trans_children.size() > 1)
-			std::stable_sort( trans_children.begin(), trans_children.end(),
-				z_comparator( (pos*v.gcf - v.camera).norm()));
-
-		for (trans_child_iterator i = trans_children.begin();
-			i != trans_child_iterator(trans_children.end());
-			++i)
-		{
-			i->outer_render(local);
+		else {
+			// The transparent layer is blended, in any order.  In the opaque
+			// pass, only the translucent children with opaque parts of their
+			// own have anything to draw.
+			trans_child_iterator k( trans_children.begin());
+			trans_child_iterator k_end( trans_children.end());
+			for (; k != k_end; ++k) {
+				if (v.parts == view::OPAQUE_PARTS && !k->mixed_opacity())
+					continue;
+				if (k->culled( local))
+					++local.culled_objects;
+				else
+					k->outer_render(local);
+			}
 		}
 	}
-	typedef std::multimap<vector, displaylist, z_comparator>::iterator screen_iterator;
+	v.culled_objects += local.culled_objects;
+	typedef view::screen_objects_t::iterator screen_iterator;
 	screen_iterator i( local.screen_objects.begin());
 	screen_iterator i_end( local.screen_objects.end());
   //  v.screen_objects.clear();
@@ -344,55 +372,116 @@ frame::gl_render( const view& v)
 	}
 }
 
-void
-frame::gl_pick_render( const view& scene)
+bool
+frame::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	// TODO: This needs to construct a valid local view!
-	// Push name
-	glPushName(0);
-	{
-		gl_matrix_stackguard guard( frame_world_transform(scene.gcf));
-		//gl_matrix_stackguard guard( frame_world_transform(1.0));
-		child_iterator i( children.begin());
-		child_iterator i_end( children.end());
-		// The unique integer to pass to OpenGL.
-		unsigned int name = 0;
-		while (i != i_end) {
-			glLoadName(name);
-			i->gl_pick_render( scene);
-			++i;
-			++name;
-		}
+	// The transform is rigid, so distances along the ray are unchanged.
+	tmatrix wft = world_frame_transform();
+	pick_ray local( wft * ray.origin, wft.times_v( ray.dir), ray.tolerance, ray.pixel);
 
-		trans_child_iterator j( trans_children.begin());
-		trans_child_iterator j_end( trans_children.end());
-		while (j != j_end) {
-			glLoadName(name);
-			j->gl_pick_render(scene);
-			++j;
-			++name;
+	bool ret = false;
+	for (std::list<shared_ptr<renderable> >::iterator i = children.begin();
+			i != children.end(); ++i) {
+		pick_hit child_hit;
+		child_hit.t = hit.t;
+		if ((*i)->ray_intersect( local, child_hit)) {
+			hit.t = child_hit.t;
+			hit.object = child_hit.object ? child_hit.object : *i;
+			ret = true;
 		}
 	}
-	// Pop name
-	glPopName();
+	for (std::vector<shared_ptr<renderable> >::iterator j = trans_children.begin();
+			j != trans_children.end(); ++j) {
+		pick_hit child_hit;
+		child_hit.t = hit.t;
+		if ((*j)->ray_intersect( local, child_hit)) {
+			hit.t = child_hit.t;
+			hit.object = child_hit.object ? child_hit.object : *j;
+			ret = true;
+		}
+	}
+	return ret;
 }
 
 void
 frame::grow_extent( extent& world)
 {
-	extent local( world, frame_world_transform(1.0) );
+	// The children are also measured in the frame's coordinates, where the
+	// result stays good for culling for as long as they do not change, however
+	// the frame moves.
+	child_extent.reset( new extent_data( world.get_tan_hfov()));
+	children_cullable = true;
+	extent local( world, frame_world_transform(1.0), *child_extent );
 	child_iterator i( children.begin());
 	child_iterator i_end( children.end());
 	for (; i != i_end; ++i) {
 		i->grow_extent( local);
 		local.add_body();
+		children_cullable = children_cullable && i->cullable();
 	}
 	trans_child_iterator j( trans_children.begin());
 	trans_child_iterator j_end( trans_children.end());
 	for ( ; j != j_end; ++j) {
 		j->grow_extent( local);
 		local.add_body();
+		children_cullable = children_cullable && j->cullable();
+	}
+}
+
+bool
+frame::cullable()
+{
+	return children_cullable;
+}
+
+bool
+frame::mixed_opacity()
+{
+	if (!children.empty())
+		return true;
+	trans_child_iterator i( trans_children.begin());
+	trans_child_iterator i_end( trans_children.end());
+	for (; i != i_end; ++i)
+		if (i->mixed_opacity())
+			return true;
+	return false;
+}
+
+bool
+frame::culled( const view& v)
+{
+	if (!children_cullable || !child_extent || child_extent->is_empty())
+		return false;
+	vector mins = child_extent->get_mins();
+	vector maxs = child_extent->get_maxs();
+	return v.visible.excludes_sphere( frame_world_transform(1.0) * ((mins + maxs) * 0.5),
+		(maxs - mins).mag() * 0.5);
+}
+
+unsigned long
+frame::extent_version()
+{
+	// Every child must be asked, so that each sees its own changes.
+	unsigned long children_version = 0;
+	child_iterator i( children.begin());
+	child_iterator i_end( children.end());
+	for (; i != i_end; ++i)
+		children_version += i->extent_version();
+	trans_child_iterator j( trans_children.begin());
+	trans_child_iterator j_end( trans_children.end());
+	for ( ; j != j_end; ++j)
+		children_version += j->extent_version();
+
+	// pos, axis and up may be changed in place from Python.
+	if (children_version != extent_children || pos != extent_pos
+		|| axis != extent_axis || up != extent_up) {
+		extent_children = children_version;
+		extent_pos = pos;
+		extent_axis = axis;
+		extent_up = up;
+		extent_changed();
 	}
+	return extent_serial;
 }
 
 void frame::render_lights( view& world ) {
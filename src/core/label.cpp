@@ -27,7 +27,10 @@ label::label()
 	line_enabled(true),
 	linecolor( color),
 	opacity(0.66f),
-	text_changed(true)
+	text_changed(true),
+	box_changed(true),
+	halfwidth(0),
+	halfheight(0)
 {
 	background = rgb(0., 0., 0.);
 }
@@ -46,7 +49,10 @@ label::label( const label& other)
 	linecolor( other.linecolor),
 	opacity( other.opacity),
 	text( other.text),
-	text_changed( true)
+	text_changed( true),
+	box_changed( true),
+	halfwidth(0),
+	halfheight(0)
 {
 	background = rgb(0., 0., 0.);
 }
@@ -217,6 +223,7 @@ void
 label::set_border( double n_border)
 {
 	border = n_border;
+	box_changed = true;
 }
 
 double
@@ -315,27 +322,22 @@ label::gl_render( const view& scene)
 		else
 			text_layout = texmap_font->lay_out( text);
 		text_changed = false;
+		box_changed = true;
 	}
-	// Compute the width of the text box.
-	vector extents = text_layout->extent( scene );
-	double box_width = extents.x + 2.0*border;
-
-	// Compute the positions of the text in the text box, and the height of the
-	// text box.  The text positions are relative to the lower left corner of
-	// the text box.
-	double box_height = extents.y + 2.0*border;
-
-	vector text_pos( border, box_height - border);
-
-	clear_gl_error();
-	vector label_pos = pos.scale(scene.gcfvec);
-	tmatrix lst = tmatrix().gl_projection_get() * tmatrix().gl_modelview_get();
-	{
-		tmatrix translate;
-		translate.w_column( label_pos);
-		lst = lst * translate;
+	if (box_changed) {
+		// Compute the size of the text box, and the position of the text in
+		// it relative to its lower left corner.  These only change with the
+		// text and the border.
+		vector extents = text_layout->extent( scene );
+		double box_width = extents.x + 2.0*border;
+		double box_height = extents.y + 2.0*border;
+		halfwidth = (int)(0.5*box_width+0.5);
+		halfheight = (int)(0.5*box_height+0.5);
+		text_pos = vector( border, box_height - border);
+		box_changed = false;
 	}
-	vector origin = (lst * vertex(vector(), 1.0)).project();
+
+	vector origin = (scene.world_clip * vertex( pos.scale(scene.gcfvec), 1.0)).project();
 
 	// It is very important to make sure that the texture is positioned
 	// accurately at a screen pixel location, to avoid artifacts around the texture.
@@ -351,90 +353,46 @@ label::gl_render( const view& scene)
 	} else {
 		origin.y = -((int)(-ky*origin.y+0.5))/ky;
 	}
-	double halfwidth = (int)(0.5*box_width+0.5);
-	double halfheight = (int)(0.5*box_height+0.5);
 
-	rgb stereo_linecolor = linecolor;
+	// The record is only shared while it is queued, so once the last frame
+	// has been drawn it can be filled in again.
+	if (!queued || !queued.unique())
+		queued.reset( new screen_label());
+	screen_label& q = *queued;
+	q.origin = origin;
+	q.space_offset = vector();
+	q.line_end = vector( xoffset, yoffset);
+	q.corner = vector( -halfwidth, -halfheight);
+	if (xoffset || yoffset) {
+		// Move the origin away from the body, and the box to the end of the
+		// line.
+		if (space)
+			q.space_offset = vector(xoffset, yoffset).norm() * std::fabs(space);
+		if (std::fabs(xoffset) > std::fabs(yoffset))
+			q.corner = vector(
+				xoffset + ((xoffset > 0) ? 0 : -2.0*halfwidth),
+				yoffset - halfheight);
+		else
+			q.corner = vector(
+				xoffset - halfwidth,
+				yoffset + ((yoffset > 0) ? 0 : -2.0*halfheight));
+	}
+	q.width = 2.0*halfwidth;
+	q.height = 2.0*halfheight;
+	q.text_pos = text_pos;
+	q.line_enabled = line_enabled && (xoffset || yoffset);
+	q.box_enabled = box_enabled;
+	q.opacity = opacity;
+	q.background = background;
+	q.linecolor = linecolor;
 	if (scene.anaglyph)
 		if (scene.coloranaglyph)
-			stereo_linecolor = linecolor.desaturate();
+			q.linecolor = linecolor.desaturate();
 		else
-			stereo_linecolor = linecolor.grayscale();
-
-	displaylist list;
-	list.gl_compile_begin();
-	{
-		stereo_linecolor.gl_set(1.0f);
-		// Zero out the existing matrices, rendering will be in screen coords.
-		gl_matrix_stackguard guard;
-		tmatrix identity;
-		identity.gl_load();
-		glMatrixMode( GL_PROJECTION); { //< Zero out the projection matrix, too
-		gl_matrix_stackguard guard2;
-		identity.gl_load();
-
-		glTranslated( origin.x, origin.y, origin.z);
-		glScaled( 1.0/kx, 1.0/ky, 1.0);
-		// At this point, all further translations are in direction of label space.
-		if (space && (xoffset || yoffset)) {
-			// Move the origin away from the body.
-			vector space_offset = vector(xoffset, yoffset).norm() * std::fabs(space);
-			glTranslated( space_offset.x, space_offset.y, space_offset.z);
-		}
-		// Optionally draw the line, and move the origin to the bottom left
-		// corner of the text box.
-		if (xoffset || yoffset) {
-			if (line_enabled) {
-				glBegin( GL_LINES);
-					vector().gl_render();
-					vector(xoffset, yoffset).gl_render();
-				glEnd();
-			}
-			if (std::fabs(xoffset) > std::fabs(yoffset)) {
-				glTranslated(
-					xoffset + ((xoffset > 0) ? 0 : -2.0*halfwidth),
-					yoffset - halfheight,
-					0);
-			}
-			else {
-				glTranslated(
-					xoffset - halfwidth,
-					yoffset + ((yoffset > 0) ? 0 : -2.0*halfheight),
-					0);
-			}
-		}
-		else {
-			glTranslated( -halfwidth, -halfheight, 0.0);
-		}
-
-		if (opacity) {
-			// Occlude objects behind the label.
-			rgba( background[0], background[1], background[2], opacity).gl_set();
-			glBegin( GL_QUADS);
-				vector().gl_render();
-				vector( 2.0*halfwidth, 0).gl_render();
-				vector( 2.0*halfwidth, 2.0*halfheight).gl_render();
-				vector( 0, 2.0*halfheight).gl_render();
-			glEnd();
-		}
-		if (box_enabled) {
-			// Draw a box around the text.
-			stereo_linecolor.gl_set(1.0f);
-			glBegin( GL_LINE_LOOP);
-				vector().gl_render();
-				vector( 2.0*halfwidth, 0).gl_render();
-				vector( 2.0*halfwidth, 2.0*halfheight).gl_render();
-				vector( 0, 2.0*halfheight).gl_render();
-			glEnd();
-		}
-
-		// Render the text itself.
-		color.gl_set(1.0f);
-		text_layout->gl_render(scene, text_pos);
-	} glMatrixMode( GL_MODELVIEW); } // Pops the matrices back off the stack
-	list.gl_compile_end();
-	check_gl_error();
-	scene.screen_objects.insert( std::make_pair(pos, list));
+			q.linecolor = linecolor.grayscale();
+	q.color = color;
+	q.text_layout = text_layout;
+	scene.screen_objects.insert( std::make_pair(pos, queued));
 }
 
 vector
@@ -443,4 +401,72 @@ label::get_center() const
 	return pos;
 }
 
+void
+screen_label::gl_render( const view& v) const
+{
+	gl_matrix_stackguard guard;
+	glTranslated( origin.x, origin.y, origin.z);
+	glScaled( 2.0/v.view_width, 2.0/v.view_height, 1.0);
+	// At this point, all further translations are in pixels.
+	glTranslated( space_offset.x, space_offset.y, 0.0);
+	if (line_enabled) {
+		linecolor.gl_set(1.0f);
+		glBegin( GL_LINES);
+			vector().gl_render();
+			line_end.gl_render();
+		glEnd();
+	}
+	glTranslated( corner.x, corner.y, 0.0);
+
+	if (opacity) {
+		// Occlude objects behind the label.
+		rgba( background[0], background[1], background[2], opacity).gl_set();
+		glBegin( GL_QUADS);
+			vector().gl_render();
+			vector( width, 0).gl_render();
+			vector( width, height).gl_render();
+			vector( 0, height).gl_render();
+		glEnd();
+	}
+	if (box_enabled) {
+		// Draw a box around the text.
+		linecolor.gl_set(1.0f);
+		glBegin( GL_LINE_LOOP);
+			vector().gl_render();
+			vector( width, 0).gl_render();
+			vector( width, height).gl_render();
+			vector( 0, height).gl_render();
+		glEnd();
+	}
+
+	// Render the text itself.
+	color.gl_set(1.0f);
+	text_layout->gl_render( v, text_pos);
+}
+
+void
+screen_label::gl_render_all( const view& v, const view::screen_objects_t& labels)
+{
+	if (labels.empty())
+		return;
+	clear_gl_error();
+	// Zero out the existing matrices once for all of the labels; rendering
+	// will be in clip coordinates.
+	glMatrixMode( GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode( GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	view::screen_objects_t::const_iterator i = labels.begin();
+	view::screen_objects_t::const_iterator i_end = labels.end();
+	for (; i != i_end; ++i)
+		i->second->gl_render( v);
+	glPopMatrix();
+	glMatrixMode( GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW);
+	check_gl_error();
+}
+
 } // !namespace cvisual
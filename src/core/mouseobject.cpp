@@ -12,8 +12,7 @@ namespace cvisual {
 static void init_event( int which, shared_ptr<event> ret, const mouse_t& mouse)
 {
 	ret->position = mouse.position;
-	ret->pick = mouse.pick;
-	ret->pickpos = mouse.pickpos;
+	ret->picked = mouse.picked;
 	ret->cam = mouse.cam;
 	ret->set_shift( mouse.is_shift());
 	ret->set_ctrl( mouse.is_ctrl());
@@ -131,7 +130,17 @@ mousebase::project2( vector normal, vector point)
 shared_ptr<renderable>
 mousebase::get_pick()
 {
-	return pick;
+	if (!picked)
+		return shared_ptr<renderable>();
+	return picked->get_pick();
+}
+
+vector
+mousebase::get_pickpos()
+{
+	if (!picked)
+		return vector();
+	return picked->get_pickpos();
 }
 
 /************** event implementation **************/
@@ -0,0 +1,469 @@
+// Copyright (c) 2000, 2001, 2002, 2003 by David Scherer and others.
+// Copyright (c) 2003, 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "pick_engine.hpp"
+#include "renderable.hpp"
+#include "util/extent.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cvisual {
+
+namespace {
+
+const double no_hit = 1e300;
+
+// Bodies per leaf of the hierarchy.
+const size_t leaf_size = 4;
+
+// Accept candidate if it is in [0, t).
+inline bool
+closer( double candidate, double& t)
+{
+	if (candidate >= 0 && candidate < t) {
+		t = candidate;
+		return true;
+	}
+	return false;
+}
+
+// Solve a*t^2 + b*t + c == 0 for real roots, in increasing order.
+inline bool
+solve_quadratic( double a, double b, double c, double& t0, double& t1)
+{
+	if (std::fabs(a) < 1e-30) {
+		if (b == 0)
+			return false;
+		t0 = t1 = -c / b;
+		return true;
+	}
+	double disc = b*b - 4*a*c;
+	if (disc < 0)
+		return false;
+	// The numerically stable form, avoiding cancellation in -b + sqrt(disc).
+	double q = -0.5 * (b + (b < 0 ? -std::sqrt(disc) : std::sqrt(disc)));
+	t0 = q / a;
+	t1 = q != 0 ? c / q : t0;
+	if (t0 > t1)
+		std::swap( t0, t1);
+	return true;
+}
+
+// The ends of the unit cylinder and cone, x == plane_x with y^2+z^2 <= 1.
+inline bool
+ray_unit_disk( const vector& origin, const vector& dir, double plane_x, double& t)
+{
+	if (dir.x == 0)
+		return false;
+	double s = (plane_x - origin.x) / dir.x;
+	if (s < 0 || s >= t)
+		return false;
+	double y = origin.y + s*dir.y, z = origin.z + s*dir.z;
+	if (y*y + z*z > 1.0)
+		return false;
+	t = s;
+	return true;
+}
+
+// The range [t_enter, t_exit] of the line through origin along dir that is
+// inside the box, or false if it misses.  Either end may be negative.
+inline bool
+ray_slab( const vector& origin, const vector& dir,
+	const vector& mins, const vector& maxs, double& t_enter, double& t_exit)
+{
+	t_enter = -no_hit;
+	t_exit = no_hit;
+	for (int i = 0; i < 3; ++i) {
+		if (dir[i] == 0) {
+			if (origin[i] < mins[i] || origin[i] > maxs[i])
+				return false;
+			continue;
+		}
+		double inv = 1.0 / dir[i];
+		double t0 = (mins[i] - origin[i]) * inv;
+		double t1 = (maxs[i] - origin[i]) * inv;
+		if (t0 > t1)
+			std::swap( t0, t1);
+		t_enter = std::max( t_enter, t0);
+		t_exit = std::min( t_exit, t1);
+		if (t_enter > t_exit)
+			return false;
+	}
+	return true;
+}
+
+template <typename Body>
+struct centroid_less
+{
+	const std::vector<Body>& bodies;
+	int axis;
+	centroid_less( const std::vector<Body>& b, int a) : bodies(b), axis(a) {}
+	bool operator()( size_t lhs, size_t rhs) const
+	{
+		return (bodies[lhs].mins + bodies[lhs].maxs)[axis]
+			< (bodies[rhs].mins + bodies[rhs].maxs)[axis];
+	}
+};
+
+} // !namespace (anonymous)
+
+pick_hit::pick_hit()
+	: t( no_hit)
+{
+}
+
+bool
+ray_unit_sphere( const vector& origin, const vector& dir, double& t)
+{
+	double t0, t1;
+	if (!solve_quadratic( dir.dot(dir), 2*origin.dot(dir), origin.dot(origin) - 1.0, t0, t1))
+		return false;
+	// The inside of a sphere is visible from within it.
+	return closer( t0, t) || closer( t1, t);
+}
+
+bool
+ray_sphere( const vector& origin, const vector& dir,
+	const vector& center, double r, double& t)
+{
+	vector o = origin - center;
+	double b = o.dot(dir);
+	double disc = b*b - o.dot(o) + r*r;
+	if (disc < 0)
+		return false;
+	double s = std::sqrt(disc);
+	return closer( -b - s, t) || closer( -b + s, t);
+}
+
+bool
+ray_box( const vector& origin, const vector& dir,
+	const vector& mins, const vector& maxs, double& t)
+{
+	double t_enter, t_exit;
+	if (!ray_slab( origin, dir, mins, maxs, t_enter, t_exit))
+		return false;
+	// Boxes have inside faces, so from within the box the exit is the hit.
+	return closer( t_enter, t) || closer( t_exit, t);
+}
+
+bool
+ray_unit_cylinder( const vector& origin, const vector& dir, double& t)
+{
+	bool ret = false;
+	double t0, t1;
+	if (solve_quadratic( dir.y*dir.y + dir.z*dir.z,
+			2*(origin.y*dir.y + origin.z*dir.z),
+			origin.y*origin.y + origin.z*origin.z - 1.0, t0, t1)) {
+		double roots[2] = { t0, t1 };
+		for (int i = 0; i < 2; ++i) {
+			double x = origin.x + roots[i]*dir.x;
+			if (x >= 0 && x <= 1 && closer( roots[i], t))
+				ret = true;
+		}
+	}
+	ret = ray_unit_disk( origin, dir, 0.0, t) || ret;
+	ret = ray_unit_disk( origin, dir, 1.0, t) || ret;
+	return ret;
+}
+
+bool
+ray_unit_cone( const vector& origin, const vector& dir, double& t)
+{
+	bool ret = false;
+	double t0, t1;
+	double h = 1.0 - origin.x;
+	if (solve_quadratic( dir.y*dir.y + dir.z*dir.z - dir.x*dir.x,
+			2*(origin.y*dir.y + origin.z*dir.z + h*dir.x),
+			origin.y*origin.y + origin.z*origin.z - h*h, t0, t1)) {
+		double roots[2] = { t0, t1 };
+		for (int i = 0; i < 2; ++i) {
+			// Reject the mirror image of the cone beyond its tip.
+			double x = origin.x + roots[i]*dir.x;
+			if (x >= 0 && x <= 1 && closer( roots[i], t))
+				ret = true;
+		}
+	}
+	ret = ray_unit_disk( origin, dir, 0.0, t) || ret;
+	return ret;
+}
+
+bool
+ray_triangle( const vector& origin, const vector& dir,
+	const vector& a, const vector& b, const vector& c, double& t)
+{
+	// Moller and Trumbore, "Fast, Minimum Storage Ray/Triangle Intersection"
+	vector e1 = b - a;
+	vector e2 = c - a;
+	vector p = dir.cross(e2);
+	double det = e1.dot(p);
+	if (std::fabs(det) < 1e-300)
+		return false;
+	double inv_det = 1.0 / det;
+	vector s = origin - a;
+	double u = s.dot(p) * inv_det;
+	if (u < 0 || u > 1)
+		return false;
+	vector q = s.cross(e1);
+	double v = dir.dot(q) * inv_det;
+	if (v < 0 || u + v > 1)
+		return false;
+	return closer( e2.dot(q) * inv_det, t);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+pick_engine::pick_engine()
+{
+}
+
+pick_engine::~pick_engine()
+{
+}
+
+void
+pick_engine::clear()
+{
+	objects.clear();
+}
+
+void
+pick_engine::add( const shared_ptr<renderable>& obj)
+{
+	objects.push_back( obj);
+}
+
+bool
+pick_engine::measure( body& b, bool force)
+{
+	unsigned long version = b.obj->extent_version();
+	if (!force && version == b.version)
+		return false;
+	b.version = version;
+	// The default extent_version() has just measured the object itself.
+	const extent_data* measured = b.obj->measured_extent();
+	// The tangent only matters for camera_z, which isn't used here.
+	extent_data bounds( 1.0);
+	if (!measured) {
+		extent e( bounds, tmatrix());
+		b.obj->grow_extent( e);
+		measured = &bounds;
+	}
+	b.empty = measured->is_empty();
+	b.mins = measured->get_mins();
+	b.maxs = measured->get_maxs();
+	return true;
+}
+
+void
+pick_engine::update()
+{
+	bool same = objects.size() == bodies.size();
+	for (size_t i = 0; same && i < objects.size(); ++i)
+		same = objects[i] == bodies[i].obj;
+
+	if (!same) {
+		bodies.resize( objects.size());
+		for (size_t i = 0; i < objects.size(); ++i) {
+			bodies[i].obj = objects[i];
+			measure( bodies[i], true);
+		}
+		build();
+		return;
+	}
+
+	bool moved = false, emptied = false;
+	for (size_t i = 0; i < bodies.size(); ++i) {
+		const bool was_empty = bodies[i].empty;
+		if (measure( bodies[i], false)) {
+			moved = true;
+			emptied = emptied || bodies[i].empty != was_empty;
+		}
+	}
+	// A body that appears or disappears changes the leaves.
+	if (emptied)
+		build();
+	else if (moved)
+		refit();
+}
+
+void
+pick_engine::build()
+{
+	leaves.clear();
+	nodes.clear();
+	for (size_t i = 0; i < bodies.size(); ++i)
+		if (!bodies[i].empty)
+			leaves.push_back( i);
+	if (!leaves.empty()) {
+		nodes.reserve( 2 * leaves.size() / leaf_size + 1);
+		build_node( 0, leaves.size());
+	}
+}
+
+void
+pick_engine::build_node( size_t begin, size_t end)
+{
+	size_t index = nodes.size();
+	nodes.push_back( node());
+	node n;
+	n.mins = bodies[leaves[begin]].mins;
+	n.maxs = bodies[leaves[begin]].maxs;
+	vector cmin = (n.mins + n.maxs) * 0.5;
+	vector cmax = cmin;
+	for (size_t i = begin+1; i < end; ++i) {
+		const body& b = bodies[leaves[i]];
+		vector c = (b.mins + b.maxs) * 0.5;
+		for (int k = 0; k < 3; ++k) {
+			n.mins[k] = std::min( n.mins[k], b.mins[k]);
+			n.maxs[k] = std::max( n.maxs[k], b.maxs[k]);
+			cmin[k] = std::min( cmin[k], c[k]);
+			cmax[k] = std::max( cmax[k], c[k]);
+		}
+	}
+
+	if (end - begin <= leaf_size) {
+		n.first = begin;
+		n.count = end - begin;
+		nodes[index] = n;
+		return;
+	}
+
+	// Split at the median centroid along the axis where the centroids are
+	// most spread out.
+	vector spread = cmax - cmin;
+	int axis = 0;
+	if (spread.y > spread[axis])
+		axis = 1;
+	if (spread.z > spread[axis])
+		axis = 2;
+	size_t mid = begin + (end - begin) / 2;
+	std::nth_element( leaves.begin() + begin, leaves.begin() + mid,
+		leaves.begin() + end, centroid_less<body>( bodies, axis));
+
+	n.count = 0;
+	build_node( begin, mid);
+	n.first = nodes.size();
+	build_node( mid, end);
+	nodes[index] = n;
+}
+
+void
+pick_engine::refit()
+{
+	// Children always follow their parent, so working backward reaches every
+	// node after its children.
+	for (size_t i = nodes.size(); i-- > 0; ) {
+		node& n = nodes[i];
+		if (n.count) {
+			n.mins = bodies[leaves[n.first]].mins;
+			n.maxs = bodies[leaves[n.first]].maxs;
+			for (size_t j = n.first + 1; j < n.first + n.count; ++j) {
+				const body& b = bodies[leaves[j]];
+				for (int k = 0; k < 3; ++k) {
+					n.mins[k] = std::min( n.mins[k], b.mins[k]);
+					n.maxs[k] = std::max( n.maxs[k], b.maxs[k]);
+				}
+			}
+		}
+		else {
+			const node& lhs = nodes[i+1];
+			const node& rhs = nodes[n.first];
+			for (int k = 0; k < 3; ++k) {
+				n.mins[k] = std::min( lhs.mins[k], rhs.mins[k]);
+				n.maxs[k] = std::max( lhs.maxs[k], rhs.maxs[k]);
+			}
+		}
+	}
+}
+
+bool
+pick_engine::hit_node( const node& n, const pick_ray& ray, double t)
+{
+	// Thin objects may be picked from a little outside of their bounds.
+	vector margin;
+	if (ray.tolerance) {
+		vector center = (n.mins + n.maxs) * 0.5;
+		double reach = (center - ray.origin).mag() + (n.maxs - center).mag();
+		double m = ray.tolerance * reach;
+		margin = vector( m, m, m);
+	}
+	// Unlike ray_box(), a node that contains the origin must be searched
+	// even if it is left beyond t, since a body inside it may be nearer.
+	double t_enter, t_exit;
+	return ray_slab( ray.origin, ray.dir, n.mins - margin, n.maxs + margin, t_enter, t_exit)
+		&& t_exit >= 0 && std::max( t_enter, 0.0) < t;
+}
+
+shared_ptr<renderable>
+pick_engine::pick( const pick_ray& ray, vector& pickpos)
+{
+	update();
+
+	shared_ptr<renderable> ret;
+	if (nodes.empty())
+		return ret;
+
+	double best = no_hit;
+	std::vector<size_t> stack;
+	stack.push_back( 0);
+	while (!stack.empty()) {
+		const node& n = nodes[stack.back()];
+		size_t index = stack.back();
+		stack.pop_back();
+		if (!hit_node( n, ray, best))
+			continue;
+		if (n.count) {
+			for (size_t i = n.first; i < n.first + n.count; ++i) {
+				const body& b = bodies[leaves[i]];
+				pick_hit hit;
+				hit.t = best;
+				if (b.obj->ray_intersect( ray, hit)) {
+					best = hit.t;
+					ret = hit.object ? hit.object : b.obj;
+				}
+			}
+		}
+		else {
+			stack.push_back( n.first);
+			stack.push_back( index + 1);
+		}
+	}
+	if (ret)
+		pickpos = ray.at( best);
+	return ret;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+lazy_pick::lazy_pick( const shared_ptr<pick_engine>& e, const pick_ray& r)
+	: engine(e), ray(r)
+{
+}
+
+void
+lazy_pick::evaluate()
+{
+	if (!engine)
+		return;
+	pick = engine->pick( ray, pickpos);
+	engine.reset();
+}
+
+shared_ptr<renderable>
+lazy_pick::get_pick()
+{
+	evaluate();
+	return pick;
+}
+
+vector
+lazy_pick::get_pickpos()
+{
+	evaluate();
+	return pickpos;
+}
+
+} // !namespace cvisual
@@ -4,9 +4,9 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "primitive.hpp"
+#include "pick_engine.hpp"
 #include "util/errors.hpp"
-
-#include <boost/python/import.hpp>
+#include "python/arrayprim.hpp"
 
 #include <typeinfo>
 #include <cmath>
@@ -56,6 +56,19 @@ primitive::model_world_transform(double world_scale, const vector& object_scale)
 	return ret;
 }
 
+bool
+primitive::model_ray( const pick_ray& ray, const vector& object_scale,
+	vector& origin, vector& dir) const
+{
+	if (!object_scale.x || !object_scale.y || !object_scale.z)
+		return false;
+	// The rotation is orthonormal, so its inverse is its transpose.
+	tmatrix mwt = model_world_transform( 1.0);
+	origin = mwt.times_inv( ray.origin).scale_inv( object_scale);
+	dir = mwt.times_inv( ray.dir, 0.0).scale_inv( object_scale);
+	return true;
+}
+
 // Oblong objects (e.g. cylinder) whose center is not at "pos" override primitive::get_center
 vector
 primitive::get_center() const
@@ -63,21 +76,30 @@ primitive::get_center() const
 	return pos;
 }
 
-using boost::python::import;
 using boost::python::object;
 
-bool startup = true;
-boost::python::object trail_update;
-
 primitive::primitive()
-	: axis(1,0,0), up(0,1,0), pos(0,0,0), trail_initialized(false), obj_initialized(false)
+	: axis(1,0,0), up(0,1,0), pos(0,0,0), make_trail(false), trail(0),
+	trail_retain(-1), trail_interval(0), trail_count(0)
 {
 }
 
 primitive::primitive( const primitive& other)
 	: renderable( other), axis(other.axis), up(other.up), 
-		pos(other.pos)
+		pos(other.pos), make_trail(false), trail(0),
+		trail_retain(other.trail_retain), trail_interval(other.trail_interval),
+		trail_count(0)
+{
+}
+
+primitive&
+primitive::operator=( const primitive& other)
 {
+	renderable::operator=( other);
+	axis = other.axis;
+	up = other.up;
+	pos = other.pos;
+	return *this;
 }
 
 primitive::~primitive()
@@ -105,12 +127,7 @@ void
 primitive::set_pos( const vector& n_pos)
 {
 	pos = n_pos;
-	if (trail_initialized && make_trail) {
-		if (obj_initialized) {
-			python::gil_lock gil;
-			trail_update(primitive_object);
-		}
-	}
+	update_trail();
 }
 
 shared_vector&
@@ -123,12 +140,7 @@ void
 primitive::set_x( double x)
 {
 	pos.set_x( x);
-	if (trail_initialized && make_trail) {
-		if (obj_initialized) {
-			python::gil_lock gil;
-			trail_update(primitive_object);
-		}
-	}
+	update_trail();
 }
 
 double
@@ -141,12 +153,7 @@ void
 primitive::set_y( double y)
 {
 	pos.set_y( y);
-	if (trail_initialized && make_trail) {
-		if (obj_initialized) {
-			python::gil_lock gil;
-			trail_update(primitive_object);
-		}
-	}
+	update_trail();
 }
 
 double
@@ -159,12 +166,7 @@ void
 primitive::set_z( double z)
 {
 	pos.set_z( z);
-	if (trail_initialized && make_trail) {
-		if (obj_initialized) {
-			python::gil_lock gil;
-			trail_update(primitive_object);
-		}
-	}
+	update_trail();
 }
 
 double
@@ -260,14 +262,9 @@ primitive::get_opacity()
 void
 primitive::set_make_trail( bool t)
 {
-	if (t && !obj_initialized)
+	if (t && !trail)
 		throw std::runtime_error( "Can't set make_trail=True unless object was created with make_trail specified");
-	if (startup) {
-		trail_update = import("vis.primitives").attr("trail_update");
-		startup = false;
-	}
 	make_trail = t;
-	trail_initialized = true;
 }
 
 bool
@@ -277,16 +274,56 @@ primitive::get_make_trail()
 }
 
 void
-primitive::set_primitive_object( boost::python::object obj)
+primitive::set_trail_object( python::arrayprim* t, boost::python::object owner)
 {
-	primitive_object = obj;
-	obj_initialized = true;
+	trail = t;
+	trail_object = owner;
+	trail_count = 0;
+	if (!trail)
+		make_trail = false;
 }
 
 boost::python::object
-primitive::get_primitive_object()
+primitive::get_trail_object()
 {
-	return primitive_object;
+	return trail_object;
+}
+
+void
+primitive::set_retain( int n)
+{
+	trail_retain = n;
+}
+
+int
+primitive::get_retain()
+{
+	return trail_retain;
+}
+
+void
+primitive::set_interval( int n)
+{
+	trail_interval = n;
+}
+
+int
+primitive::get_interval()
+{
+	return trail_interval;
+}
+
+void
+primitive::update_trail()
+{
+	if (!make_trail || !trail)
+		return;
+	if (trail_count == 0) {
+		python::gil_lock gil;
+		trail->append( pos, trail_retain);
+	}
+	if (++trail_count >= trail_interval)
+		trail_count = 0;
 }
 
 PRIMITIVE_TYPEINFO_IMPL(primitive)
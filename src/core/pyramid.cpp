@@ -4,38 +4,47 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "pyramid.hpp"
+#include "pick_engine.hpp"
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/instance_batch.hpp"
+#include "util/gl_free.hpp"
 
 namespace cvisual {
 
 displaylist pyramid::model;
+mesh pyramid::batch_model;
+
+namespace {
+const float vertices[][3] = {
+	{0, .5, .5},
+	{0,-.5, .5},
+	{0,-.5,-.5},
+	{0, .5,-.5},
+	{1,  0,  0}
+};
+const int triangle_indices[][3] = { 
+	{3, 0, 4},  // top
+	{1, 2, 4},  // bottom
+	{0, 1, 4},  // front
+	{3, 4, 2},  // back
+	{0, 3, 2},  // left (base) 1
+	{0, 2, 1},  // left (base) 2
+};
+const float normals[][3] = { {1,2,0}, {1,-2,0}, {1,0,2}, {1,0,-2}, {-1,0,0}, {-1,0,0} };
+} // !namespace (anonymous)
 
 PRIMITIVE_TYPEINFO_IMPL(pyramid)
+PRIMITIVE_SNAPSHOT_IMPL(pyramid)
 
 void
 pyramid::init_model()
 {
 	// Note that this model is also used by arrow!
+	lock L(gl_share_lock);
+	if (model) return;
 	model.gl_compile_begin();
 	
-	float vertices[][3] = {
-		{0, .5, .5},
-		{0,-.5, .5},
-		{0,-.5,-.5},
-		{0, .5,-.5},
-		{1,  0,  0}
-	};
-	int triangle_indices[][3] = { 
-		{3, 0, 4},  // top
-		{1, 2, 4},  // bottom
-		{0, 1, 4},  // front
-		{3, 4, 2},  // back
-		{0, 3, 2},  // left (base) 1
-		{0, 2, 1},  // left (base) 2
-	};
-	float normals[][3] = { {1,2,0}, {1,-2,0}, {1,0,2}, {1,0,-2}, {-1,0,0}, {-1,0,0} };
-
 	glEnable(GL_CULL_FACE);
 	glBegin( GL_TRIANGLES);
 
@@ -60,10 +69,50 @@ pyramid::init_model()
 	check_gl_error();
 }
 
-void 
-pyramid::gl_pick_render( const view& scene)
+void
+pyramid::init_mesh()
+{
+	lock L(gl_share_lock);
+	if (!batch_model.empty())
+		return;
+
+	// The same faces as init_model().
+	batch_model.cull_face = true;
+	for (int side = -1; side <= 1; side += 2) {
+		for (int f = 0; f < 6; ++f) {
+			unsigned int first = batch_model.size();
+			for (int v = 0; v < 3; ++v) {
+				const float* p = vertices[ triangle_indices[f][side > 0 ? v : 2-v] ];
+				batch_model.add_vertex( p[0], p[1], p[2],
+					side*normals[f][0], side*normals[f][1], side*normals[f][2]);
+			}
+			batch_model.add_triangle( first, first+1, first+2);
+		}
+	}
+}
+
+bool
+pyramid::ray_intersect_model( const vector& origin, const vector& dir, double& t)
 {
-	gl_render(scene);
+	bool ret = false;
+	for (int f = 0; f < 6; ++f) {
+		const float* a = vertices[ triangle_indices[f][0] ];
+		const float* b = vertices[ triangle_indices[f][1] ];
+		const float* c = vertices[ triangle_indices[f][2] ];
+		if (ray_triangle( origin, dir, vector(a[0], a[1], a[2]),
+				vector(b[0], b[1], b[2]), vector(c[0], c[1], c[2]), t))
+			ret = true;
+	}
+	return ret;
+}
+
+bool
+pyramid::ray_intersect( const pick_ray& ray, pick_hit& hit)
+{
+	vector origin, dir;
+	if (!model_ray( ray, get_render_size(), origin, dir))
+		return false;
+	return ray_intersect_model( origin, dir, hit.t);
 }
 
 void 
@@ -80,6 +129,17 @@ pyramid::gl_render( const view& scene)
 	check_gl_error();
 }
 
+bool
+pyramid::add_to_batch( const view& scene, instance_batch& batch)
+{
+	if (mat)
+		return false;
+
+	init_mesh();
+	batch.add( scene, &batch_model, get_transform( scene ), color, opacity);
+	return true;
+}
+
 void 
 pyramid::grow_extent( extent& world_extent)
 {
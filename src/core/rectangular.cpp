@@ -80,15 +80,25 @@ rectangular::set_size( const vector& s)
 
 void
 rectangular::apply_transform( const view& scene )
+{
+	get_transform( scene ).gl_mult();
+}
+
+tmatrix
+rectangular::get_transform( const view& scene )
+{
+	return model_world_transform( scene.gcf, get_render_size() );
+}
+
+vector
+rectangular::get_render_size() const
 {
 	// OpenGL needs to invert the modelview matrix to generate the normal matrix,
 	//   so try not to make it singular:
 	double min_scale = std::max( axis.mag(), std::max(height,width) ) * 1e-6;
-	vector size( std::max(min_scale,axis.mag()),
-				 std::max(min_scale,height),
-			     std::max(min_scale,width) );
-
-	model_world_transform( scene.gcf, size ).gl_mult();
+	return vector( std::max(min_scale,axis.mag()),
+				   std::max(min_scale,height),
+				   std::max(min_scale,width) );
 }
 
 } // !namespace cvisual
@@ -21,7 +21,8 @@ view::view( const vector n_forward, vector n_center, int n_width,
 	gcf( n_gcf), gcfvec( n_gcfvec), gcf_changed( n_gcf_changed), lod_adjust(0),
 	anaglyph(false), coloranaglyph(false), tan_hfov_x(0), tan_hfov_y(0),
 	screen_objects( z_comparator( forward)), glext(glext),
-	enable_shaders(true)
+	culled_objects(0), enable_shaders(true), impostors(false),
+	parts(ALL_PARTS)
 {
 	for(int i=0; i<N_LIGHT_TYPES; i++)
 		light_count[i] = 0;
@@ -54,7 +55,8 @@ view::pixel_coverage( const vector& pos, double radius) const
 }
 
 renderable::renderable()
-	: visible(true), opacity( 1.0 )
+	: visible(true), opacity( 1.0 ), extent_serial(0), extent_cache_version(0),
+	extent_measured( 1.0), extent_measured_valid(false)
 {
 }
 
@@ -88,9 +90,10 @@ renderable::gl_render( const view&)
 	return;
 }
 
-void
-renderable::gl_pick_render( const view&)
+bool
+renderable::ray_intersect( const pick_ray&, pick_hit&)
 {
+	return false;
 }
 
 void
@@ -99,6 +102,42 @@ renderable::grow_extent( extent&)
 	return;
 }
 
+void
+renderable::grow_extent_cached( extent& world)
+{
+	unsigned long version = extent_version();
+	if (!extent_cache || version != extent_cache_version
+		|| extent_cache->get_tan_hfov() != world.get_tan_hfov()) {
+		extent_cache.reset( new extent_data( world.get_tan_hfov()));
+		extent local( *extent_cache, tmatrix());
+		grow_extent( local);
+		extent_cache_version = version;
+	}
+	world.add_extent( *extent_cache);
+}
+
+unsigned long
+renderable::extent_version()
+{
+	extent_data now( extent_measured.get_tan_hfov());
+	{
+		extent e( now, tmatrix());
+		grow_extent( e);
+	}
+	if (!now.same( extent_measured)) {
+		extent_measured = now;
+		extent_changed();
+	}
+	extent_measured_valid = true;
+	return extent_serial;
+}
+
+const extent_data*
+renderable::measured_extent() const
+{
+	return extent_measured_valid ? &extent_measured : 0;
+}
+
 void
 renderable::set_material( shared_ptr<class material> m )
 {
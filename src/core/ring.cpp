@@ -4,10 +4,13 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "ring.hpp"
+#include "pick_engine.hpp"
 #include "util/displaylist.hpp"
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <utility>
 #include <boost/scoped_array.hpp>
 using boost::scoped_array;
@@ -41,10 +44,42 @@ ring::get_thickness()
 	return thickness;
 }
 
-void
-ring::gl_pick_render( const view& scene)
+bool
+ring::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	gl_render(scene);
+	if (degenerate())
+		return false;
+	// The same dimensions as create_model().
+	const double R = std::fabs(radius);
+	const double r = thickness ? std::fabs(thickness) : R * 0.1;
+
+	// The ray is not scaled, so dir is a unit vector in the model.
+	vector origin, dir;
+	model_ray( ray, vector(1,1,1), origin, dir);
+
+	// Only march through the bounding sphere of the torus.
+	const double bound = R + r;
+	double b = origin.dot(dir);
+	double disc = b*b - origin.dot(origin) + bound*bound;
+	if (disc < 0)
+		return false;
+	double t = std::max( -b - std::sqrt(disc), 0.0);
+	double t_end = std::min( -b + std::sqrt(disc), hit.t);
+
+	// Sphere tracing: step by the exact distance to the torus, which lies in
+	// the yz plane around the x axis, until the surface is reached.
+	const double epsilon = bound * 1e-6;
+	for (int step = 0; step < 256 && t < t_end; ++step) {
+		vector p = origin + dir*t;
+		double q = std::sqrt(p.y*p.y + p.z*p.z) - R;
+		double d = std::sqrt(q*q + p.x*p.x) - r;
+		if (d < epsilon) {
+			hit.t = t;
+			return true;
+		}
+		t += d;
+	}
+	return false;
 }
 
 void
@@ -4,16 +4,29 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "sphere.hpp"
+#include "pick_engine.hpp"
 #include "util/quadric.hpp"
 #include "util/errors.hpp"
 #include "util/icososphere.hpp"
 #include "util/gl_enable.hpp"
+#include "util/instance_batch.hpp"
+#include "util/gl_free.hpp"
 
+#include <cmath>
 #include <vector>
 
 namespace cvisual {
 
 displaylist sphere::lod_cache[6];
+mesh sphere::lod_mesh[6];
+
+namespace {
+// The slices and stacks used for each level of detail.
+const int lod_slices[6] = { 13, 19, 35, 55, 70, 140 };
+const int lod_stacks[6] = { 7, 11, 19, 29, 34, 69 };
+// Spheres smaller than this many pixels in radius are drawn as impostors.
+const double impostor_coverage = 30;
+} // !namespace (anonymous)
 
 sphere::sphere()
 {
@@ -28,20 +41,13 @@ sphere::~sphere()
 {
 }
 
-void
-sphere::gl_pick_render( const view& geometry)
+bool
+sphere::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	if (degenerate())
-		return;
-	init_model();
-
-	clear_gl_error();
-
-	gl_matrix_stackguard guard;
-	model_world_transform( geometry.gcf, get_scale() ).gl_mult();
-
-	lod_cache[0].gl_render();
-	check_gl_error();
+	vector origin, dir;
+	if (degenerate() || !model_ray( ray, get_scale(), origin, dir))
+		return false;
+	return ray_unit_sphere( origin, dir, hit.t);
 }
 
 double
@@ -50,19 +56,16 @@ sphere::get_max_dimension()
 	return radius;
 }
 
-void
-sphere::gl_render( const view& geometry)
+int
+sphere::get_lod( const view& geometry)
 {
-	if (degenerate())
-		return;
-
-	init_model();
-
-	clear_gl_error();
-	
-
 	// coverage is the radius of this sphere in pixels:
-	double coverage = geometry.pixel_coverage( pos, get_max_dimension());
+	return get_lod( geometry, geometry.pixel_coverage( pos, get_max_dimension()));
+}
+
+int
+sphere::get_lod( const view& geometry, double coverage)
+{
 	int lod = 0;
 	
 	if (coverage < 0) // Behind the camera, but still visible.
@@ -83,6 +86,30 @@ sphere::gl_render( const view& geometry)
 		lod = 5;
 	else if (lod < 0)
 		lod = 0;
+	return lod;
+}
+
+bool
+sphere::impostor( const view& geometry, double coverage)
+{
+	// Behind the camera, the square may not cover the sphere.
+	if (coverage < 0)
+		return false;
+	return geometry.impostors || coverage < impostor_coverage;
+}
+
+void
+sphere::gl_render( const view& geometry)
+{
+	if (degenerate())
+		return;
+
+	init_model();
+
+	clear_gl_error();
+	
+
+	int lod = get_lod( geometry);
 
 	gl_matrix_stackguard guard;
 	model_world_transform( geometry.gcf, get_scale() ).gl_mult();
@@ -108,6 +135,35 @@ sphere::gl_render( const view& geometry)
 	check_gl_error();
 }
 
+bool
+sphere::add_to_batch( const view& geometry, instance_batch& batch)
+{
+	if (mat)
+		return false;
+	if (degenerate())
+		return true;
+
+	init_mesh();
+	const double coverage = geometry.pixel_coverage( pos, get_max_dimension());
+	const vector scale = get_scale();
+	const mesh* model = &lod_mesh[get_lod( geometry, coverage)];
+	// Ellipsoids share this, but only true spheres can be impostors.
+	if (scale.x == scale.y && scale.y == scale.z && impostor( geometry, coverage)) {
+		batch.add_sphere( geometry, model, pos * geometry.gcf,
+			std::fabs( radius) * geometry.gcf, color);
+		return true;
+	}
+	batch.add( geometry, model, model_world_transform( geometry.gcf, scale ),
+		color, opacity);
+	return true;
+}
+
+bool
+sphere::culled( const view& geometry)
+{
+	return geometry.visible.excludes_sphere( pos, get_max_dimension());
+}
+
 void
 sphere::grow_extent( extent& e)
 {
@@ -118,40 +174,32 @@ sphere::grow_extent( extent& e)
 void
 sphere::init_model()
 {
+	lock L(gl_share_lock);
 	if (lod_cache[0]) return;
 
 	clear_gl_error();
 
 	quadric sph;
-	
-	lod_cache[0].gl_compile_begin();
-	sph.render_sphere( 1.0, 13, 7);
-	lod_cache[0].gl_compile_end();
-
-	lod_cache[1].gl_compile_begin();
-	sph.render_sphere( 1.0, 19, 11);
-	lod_cache[1].gl_compile_end();
-
-	lod_cache[2].gl_compile_begin();
-	sph.render_sphere( 1.0, 35, 19);
-	lod_cache[2].gl_compile_end();
-
-	lod_cache[3].gl_compile_begin();
-	sph.render_sphere( 1.0, 55, 29);
-	lod_cache[3].gl_compile_end();
-
-	lod_cache[4].gl_compile_begin();
-	sph.render_sphere( 1.0, 70, 34);
-	lod_cache[4].gl_compile_end();
-
-	// Only for the very largest bodies.
-	lod_cache[5].gl_compile_begin();
-	sph.render_sphere( 1.0, 140, 69);
-	lod_cache[5].gl_compile_end();
-	
+	// The last level is only for the very largest bodies.
+	for (size_t i = 0; i < 6; ++i) {
+		lod_cache[i].gl_compile_begin();
+		sph.render_sphere( 1.0, lod_slices[i], lod_stacks[i]);
+		lod_cache[i].gl_compile_end();
+	}
+
 	check_gl_error();
 }
 
+void
+sphere::init_mesh()
+{
+	lock L(gl_share_lock);
+	if (!lod_mesh[0].empty()) return;
+
+	for (size_t i = 0; i < 6; ++i)
+		lod_mesh[i].add_sphere( 1.0, lod_slices[i], lod_stacks[i]);
+}
+
 vector
 sphere::get_scale()
 {
@@ -172,5 +220,6 @@ sphere::get_material_matrix(const view&, tmatrix& out) {
 }
 
 PRIMITIVE_TYPEINFO_IMPL(sphere)
+PRIMITIVE_SNAPSHOT_IMPL(sphere)
 
 } // !namespace cvisual
@@ -5,15 +5,252 @@
 #include "boost/algorithm/string.hpp"
 #include "text_adjust.hpp"
 
+#include <map>
+#include <algorithm>
+
 namespace cvisual {
 
 using std::wstring;
 
-typedef std::map< std::pair<wstring, int>, boost::shared_ptr<font> >
+namespace {
+
+// The size in pixels of each texture of a glyph_atlas.
+const int atlas_size = 512;
+const size_t font_cache_size = 32;
+// The number of layouts kept by each font.
+const size_t layout_cache_size = 256;
+
+// Protects the caches and counters below, and the fonts' atlases and layouts.
+mutex text_barrier;
+
+typedef lru_cache< std::pair<wstring, int>, boost::shared_ptr<font> >
 	fontcache_t;
-fontcache_t font_cache;
+fontcache_t font_cache( font_cache_size);
+
+unsigned long layout_hits = 0, layout_misses = 0;
+unsigned long glyph_hits = 0, glyph_misses = 0;
+size_t glyph_count = 0, page_count = 0;
+
+// True if c can be drawn on its own, independent of its neighbors.  This is
+// conservative, excluding for instance scripts that join their characters and
+// the combining marks.
+bool
+composable( wchar_t c)
+{
+	return (c >= 0x20 && c < 0x7f) || (c >= 0xa0 && c < 0x300)
+		|| (c >= 0x370 && c < 0x483) || (c >= 0x48a && c < 0x530);
+}
+
+int
+bytes_per_pixel( int gl_format)
+{
+	switch (gl_format) {
+		case GL_ALPHA:
+		case GL_LUMINANCE:
+			return 1;
+		case GL_RGB:
+		case GL_BGR_EXT:
+			return 3;
+		case GL_RGBA:
+		case GL_BGRA_EXT:
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+// Keeps the image of a single character until it is copied into an atlas.
+class glyph_image : public text_image
+{
+ public:
+	int width, height;
+	bool bottom_up;
+	int internal_format, format, type, alignment;
+	std::vector<unsigned char> data;
+
+	glyph_image()
+		: width(0), height(0), bottom_up(false), internal_format(0), format(0),
+		type(0), alignment(1)
+	{}
+
+	void
+	set_image( int w, int h, int gl_internal_format, int gl_format,
+		int gl_type, int a, void* pixels)
+	{
+		bottom_up = h < 0;
+		width = w;
+		height = bottom_up ? -h : h;
+		internal_format = gl_internal_format;
+		format = gl_format;
+		type = gl_type;
+		alignment = a;
+		int row = width * bytes_per_pixel( format);
+		int pitch = (row + alignment - 1) / alignment * alignment;
+		const unsigned char* begin = static_cast<const unsigned char*>(pixels);
+		data.assign( begin, begin + pitch * height);
+	}
+};
+
+// One texture of a glyph_atlas.
+class atlas_page : public texture
+{
+ public:
+	atlas_page( int internal_format, int format, int type)
+		: internal_format( internal_format), format( format), type( type)
+	{
+		damage();
+	}
+
+ private:
+	int internal_format, format, type;
+
+	virtual void
+	gl_init( const view& v)
+	{
+		GLuint handle;
+		glGenTextures(1, &handle);
+		set_handle( v, handle );
+		glBindTexture( GL_TEXTURE_2D, handle);
+
+		// No filtering - we want the exact pixels from the texture
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		std::vector<unsigned char> blank( atlas_size * atlas_size * 4);
+		glTexImage2D( GL_TEXTURE_2D, 0, internal_format, atlas_size, atlas_size,
+			0, format, type, &blank[0]);
+	}
+};
+
+} // !namespace (anonymous)
+
+/** The characters of one font that have been used, each rendered once into
+	one of a set of textures.  Must be used with text_barrier held, except to
+	destroy it.
+*/
+class glyph_atlas
+{
+ public:
+	struct glyph {
+		size_t page;
+		int width, height; ///< The size of the character's image, in pixels.
+		float s0, t0; ///< The texture coordinates of the top left corner.
+		float s1, t1; ///< The texture coordinates of the bottom right corner.
+	};
+
+	glyph_atlas()
+		: internal_format(0), format(0), type(0), x(0), y(0), row_height(0)
+	{}
+
+	~glyph_atlas()
+	{
+		lock L(text_barrier);
+		glyph_count -= glyphs.size();
+		page_count -= pages.size();
+	}
+
+	/** The glyph of c, which is rendered on its first use.  Returns null if it
+		cannot be put in the atlas.
+	*/
+	const glyph* find( const view&, font_renderer&, wchar_t c);
+
+	void gl_activate( const view& v, size_t page) { pages[page]->gl_activate( v); }
+	int get_internal_format() const { return internal_format; }
+
+ private:
+	/// Characters that could not be put in the atlas are kept with a
+	/// negative width.
+	std::map<wchar_t, glyph> glyphs;
+	std::vector< boost::shared_ptr<atlas_page> > pages;
+	int internal_format, format, type; ///< Of every page.
+	int x, y; ///< Where the next glyph goes in the last page.
+	int row_height; ///< The height of the current row of glyphs.
+};
+
+const glyph_atlas::glyph*
+glyph_atlas::find( const view& v, font_renderer& renderer, wchar_t c)
+{
+	std::map<wchar_t, glyph>::iterator i = glyphs.find( c);
+	if (i != glyphs.end()) {
+		++glyph_hits;
+		return (i->second.width < 0) ? 0 : &i->second;
+	}
+	++glyph_misses;
+	++glyph_count;
+	glyph& g = glyphs[c];
+	g.width = -1;
+
+	glyph_image image;
+	renderer.gl_render_to_texture( v, wstring( 1, c), image);
+	if (!image.width || image.type != GL_UNSIGNED_BYTE
+		|| !bytes_per_pixel( image.format))
+		return 0;
+	if (pages.empty()) {
+		internal_format = image.internal_format;
+		format = image.format;
+		type = image.type;
+	}
+	else if (image.internal_format != internal_format || image.format != format)
+		return 0;
+	// Leave a pixel between the glyphs, so that none bleeds into another.
+	if (image.width + 1 > atlas_size || image.height + 1 > atlas_size)
+		return 0;
+
+	if (!pages.empty() && x + image.width + 1 > atlas_size) {
+		x = 0;
+		y += row_height;
+		row_height = 0;
+	}
+	if (pages.empty() || y + image.height + 1 > atlas_size) {
+		pages.push_back( boost::shared_ptr<atlas_page>(
+			new atlas_page( internal_format, format, type)));
+		++page_count;
+		x = y = row_height = 0;
+	}
+
+	pages.back()->gl_activate( v);
+	glPixelStorei( GL_UNPACK_ALIGNMENT, image.alignment);
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, image.width);
+	glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, image.width, image.height,
+		format, type, &image.data[0]);
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0);
+	check_gl_error();
+
+	g.page = pages.size() - 1;
+	g.width = image.width;
+	g.height = image.height;
+	double top = y, bottom = y + image.height;
+	if (image.bottom_up)
+		std::swap( top, bottom);
+	g.s0 = float(x) / atlas_size;
+	g.s1 = float(x + image.width) / atlas_size;
+	g.t0 = top / atlas_size;
+	g.t1 = bottom / atlas_size;
+
+	x += image.width + 1;
+	row_height = std::max( row_height, image.height + 1);
+	return &g;
+}
+
+namespace {
 
-font::font( font_renderer* fr ) : renderer(fr) {}
+// A character of a layout, relative to the top left corner of the text.
+struct placed_glyph {
+	const glyph_atlas::glyph* g;
+	int x, y;
+};
+
+} // !namespace (anonymous)
+
+font::font( font_renderer* fr )
+	: renderer(fr), layouts( layout_cache_size)
+{
+	if (renderer->ok() && renderer->composable())
+		atlas.reset( new glyph_atlas());
+}
+
+font::~font() {}
 
 boost::shared_ptr<font>
 font::find_font( const wstring& desc, int height ) {
@@ -44,11 +281,24 @@ font::find_font( const wstring& desc, int height ) {
 		fonts.swap( real_fonts );
 	}
 		
+	// Fonts dropped from the cache are freed, if nothing else uses them, after
+	// text_barrier is released.
+	std::vector< boost::shared_ptr<font> > dropped;
+	lock L(text_barrier);
 	for(size_t i=0; i<fonts.size(); i++) {
-		boost::shared_ptr<font>& f = font_cache[ std::make_pair( fonts[i], int(height*text_adjust+0.5)) ];
-		if (!f) {
-			f.reset( new font( new font_renderer( fonts[i], int(height*text_adjust+0.5) ) ) );
+		std::pair<wstring, int> key( fonts[i], int(height*text_adjust+0.5) );
+		boost::shared_ptr<font> f;
+		if (boost::shared_ptr<font>* cached = font_cache.find( key ))
+			f = *cached;
+		else {
+			f.reset( new font( new font_renderer( key.first, key.second ) ) );
 			f->self = f;
+			dropped.push_back( boost::shared_ptr<font>() );
+			font_cache.insert( key, f, &dropped.back() );
+			// The layouts of a font refer to it, so it can only be freed once
+			// they are let go.
+			if (dropped.back())
+				dropped.back()->layouts.clear();
 		}
 				
 		if ( f->renderer->ok() )
@@ -60,32 +310,130 @@ font::find_font( const wstring& desc, int height ) {
 
 boost::shared_ptr<layout> 
 font::lay_out( const wstring& text ) {
+	lock L(text_barrier);
+	if (boost::shared_ptr<layout>* cached = layouts.find( text )) {
+		++layout_hits;
+		return *cached;
+	}
+	++layout_misses;
 	shared_ptr<font> me( self );
-	return boost::shared_ptr<layout>(
-		new layout( me, text ) );
+	return layouts.insert( text, boost::shared_ptr<layout>( new layout( me, text ) ) );
+}
+
+text_cache_stats
+font::get_cache_stats() {
+	lock L(text_barrier);
+	text_cache_stats ret;
+	ret.font_hits = font_cache.hits();
+	ret.font_misses = font_cache.misses();
+	ret.layout_hits = layout_hits;
+	ret.layout_misses = layout_misses;
+	ret.glyph_hits = glyph_hits;
+	ret.glyph_misses = glyph_misses;
+	ret.fonts = font_cache.size();
+	ret.glyphs = glyph_count;
+	ret.atlas_pages = page_count;
+	return ret;
 }
 
 layout::layout( const boost::shared_ptr<font>& font, const wstring& text )
- : tx( font, text )
+ : composed(false), from_atlas(false), tx( font, text )
 {
 }
 
+void layout::compose( const view& v ) {
+	if (composed)
+		return;
+	composed = true;
+	font& f = *tx.text_font;
+	const wstring& text = tx.text;
+	if (!f.atlas)
+		return;
+	for (size_t i = 0; i < text.size(); ++i)
+		if (text[i] != L'\n' && !composable( text[i] ))
+			return;
+
+	lock L(text_barrier);
+	const glyph_atlas::glyph* space = f.atlas->find( v, *f.renderer, L' ' );
+	if (!space)
+		return;
+	int line_height = space->height;
+
+	// Place the characters left to right and top to bottom, from the top left
+	// corner of the text.
+	std::vector<placed_glyph> quads;
+	quads.reserve( text.size() );
+	int pen_x = 0, pen_y = 0, width = 0;
+	size_t pages = 0;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == L'\n') {
+			pen_x = 0;
+			pen_y += line_height;
+			continue;
+		}
+		const glyph_atlas::glyph* g = f.atlas->find( v, *f.renderer, text[i] );
+		if (!g)
+			return;
+		if (text[i] != L' ') {
+			placed_glyph p = { g, pen_x, pen_y };
+			quads.push_back( p );
+			pages = std::max( pages, g->page + 1 );
+		}
+		pen_x += g->width;
+		width = std::max( width, pen_x );
+	}
+	size = vector( width, pen_y + line_height );
+
+	// Group the quads by the page of the atlas they use, so that each page
+	// is bound once.
+	vertices.reserve( quads.size() * 8 );
+	tcoords.reserve( quads.size() * 8 );
+	for (size_t page = 0; page < pages; ++page) {
+		run r = { page, int(vertices.size() / 2), 0 };
+		for (size_t i = 0; i < quads.size(); ++i) {
+			const glyph_atlas::glyph& g = *quads[i].g;
+			if (g.page != page)
+				continue;
+			float left = quads[i].x, right = quads[i].x + g.width;
+			float top = -quads[i].y, bottom = -quads[i].y - g.height;
+			float quad[8] = { left, top, left, bottom, right, bottom, right, top };
+			float tquad[8] = { g.s0, g.t0, g.s0, g.t1, g.s1, g.t1, g.s1, g.t0 };
+			vertices.insert( vertices.end(), quad, quad + 8 );
+			tcoords.insert( tcoords.end(), tquad, tquad + 8 );
+			r.count += 4;
+		}
+		if (r.count)
+			runs.push_back( r );
+	}
+	from_atlas = true;
+}
+
 vector layout::extent( const view& v ) {
+	compose( v );
+	if (from_atlas)
+		return size;
 	tx.gl_activate(v);  //< a little tacky
 	return vector( tx.width, tx.height );
 }
 
 void layout::gl_render( const view& v, const vector& pos_ll ) {
+	compose( v );
 	gl_enable enTex( tx.enable_type() );
-	tx.gl_activate(v);
+	int internal_format;
+	if (from_atlas)
+		internal_format = tx.text_font->atlas->get_internal_format();
+	else {
+		tx.gl_activate(v);
+		internal_format = tx.internal_format;
+	}
 
 	glTranslated( pos_ll.x, pos_ll.y, pos_ll.z );
 
-	if (tx.internal_format == GL_ALPHA) {
+	if (internal_format == GL_ALPHA) {
 		// Simple antialiasing
 		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		draw_quad();
+		draw( v );
 	} else {
 		// For color antialiasing, we want to render "spectral alpha", i.e.
 		//   framebuffer = framebuffer * (1-texture) + color * texture
@@ -95,17 +443,35 @@ void layout::gl_render( const view& v, const vector& pos_ll ) {
 
 		glBlendFunc( GL_ZERO, GL_ONE_MINUS_SRC_COLOR );
 		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE );
-		draw_quad();
+		draw( v );
 
 		glBlendFunc( GL_ONE, GL_ONE );
 		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		draw_quad();
+		draw( v );
 	}
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	
 	check_gl_error();
 }
 
+void layout::draw( const view& v ) {
+	if (!from_atlas) {
+		draw_quad();
+		return;
+	}
+	if (runs.empty())
+		return;
+	lock L(text_barrier);
+	gl_enable_client vertex_array( GL_VERTEX_ARRAY );
+	gl_enable_client tcoord_array( GL_TEXTURE_COORD_ARRAY );
+	glVertexPointer( 2, GL_FLOAT, 0, &vertices[0] );
+	glTexCoordPointer( 2, GL_FLOAT, 0, &tcoords[0] );
+	for (size_t i = 0; i < runs.size(); ++i) {
+		tx.text_font->atlas->gl_activate( v, runs[i].page );
+		glDrawArrays( GL_QUADS, runs[i].first, runs[i].count );
+	}
+}
+
 void layout::draw_quad() {
 	glBegin(GL_QUADS);
 	for(int i=0; i<4; i++) {
@@ -0,0 +1,225 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/blended_transparency.hpp"
+#include "util/shader_program.hpp"
+#include "util/gl_enable.hpp"
+#include "util/gl_free.hpp"
+#include "util/errors.hpp"
+
+#include <boost/bind.hpp>
+
+namespace cvisual {
+
+namespace {
+
+// Draws a quad covering the viewport with the weighted average color of the
+// transparent layer, as opaque as the background is hidden.
+const char* composite_shader =
+	"[varying]\n"
+	"varying vec2 position;\n"
+	"[vertex]\n"
+	"void main() {\n"
+	"	position = gl_Vertex.xy * 0.5 + 0.5;\n"
+	"	gl_Position = gl_Vertex;\n"
+	"}\n"
+	"[fragment]\n"
+	"uniform sampler2D accum;\n"
+	"uniform sampler2D reveal;\n"
+	"void main() {\n"
+	"	vec4 sum = texture2D( accum, position);\n"
+	"	float revealed = texture2D( reveal, position).a;\n"
+	"	gl_FragColor = vec4( sum.rgb / max( sum.a, 0.00001), 1.0 - revealed);\n"
+	"}\n";
+
+void
+texture_storage( GLuint texture, GLint internal_format, GLenum format,
+	GLenum type, int width, int height)
+{
+	glBindTexture( GL_TEXTURE_2D, texture);
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D( GL_TEXTURE_2D, 0, internal_format, width, height, 0,
+		format, type, 0);
+}
+
+} // !namespace (anonymous)
+
+blended_transparency::blended_transparency()
+	: width(0), height(0), framebuffer(0), depth_texture(0), accum_texture(0),
+	reveal_texture(0), failed(false), glDeleteFramebuffersEXT(0)
+{
+}
+
+blended_transparency::~blended_transparency()
+{
+	if (framebuffer)
+		on_gl_free.free( boost::bind( &blended_transparency::gl_free,
+			glDeleteFramebuffersEXT, framebuffer, depth_texture, accum_texture,
+			reveal_texture));
+}
+
+void
+blended_transparency::gl_free( PFNGLDELETEFRAMEBUFFERSEXTPROC glDeleteFramebuffersEXT,
+	GLuint framebuffer, GLuint depth, GLuint accum, GLuint reveal)
+{
+	glDeleteFramebuffersEXT( 1, &framebuffer);
+	GLuint textures[3] = { depth, accum, reveal };
+	glDeleteTextures( 3, textures);
+}
+
+bool
+blended_transparency::available( const gl_extensions& glext, bool enable_shaders) const
+{
+	return !failed && enable_shaders && glext.ARB_shader_objects
+		&& glext.ARB_multitexture && glext.EXT_framebuffer_object
+		&& glext.EXT_blend_func_separate && glext.ARB_texture_float
+		&& glext.ARB_depth_texture && glext.ARB_texture_non_power_of_two;
+}
+
+bool
+blended_transparency::realize( const view& v, int w, int h)
+{
+	if (!framebuffer) {
+		GLuint textures[3];
+		glGenTextures( 3, textures);
+		depth_texture = textures[0];
+		accum_texture = textures[1];
+		reveal_texture = textures[2];
+		v.glext.glGenFramebuffersEXT( 1, &framebuffer);
+		// See the TODO in shader_program::realize() about calling extension
+		// functions from on_gl_free callbacks.
+		glDeleteFramebuffersEXT = v.glext.glDeleteFramebuffersEXT;
+		on_gl_free.connect( boost::bind( &blended_transparency::gl_free,
+			glDeleteFramebuffersEXT, framebuffer, depth_texture, accum_texture,
+			reveal_texture));
+	}
+	width = w;
+	height = h;
+	texture_storage( depth_texture, GL_DEPTH_COMPONENT24_ARB, GL_DEPTH_COMPONENT,
+		GL_UNSIGNED_INT, w, h);
+	texture_storage( accum_texture, GL_RGBA16F_ARB, GL_RGBA, GL_FLOAT, w, h);
+	texture_storage( reveal_texture, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, w, h);
+	glBindTexture( GL_TEXTURE_2D, 0);
+
+	// Both color buffers must work with the depth buffer.
+	v.glext.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, framebuffer);
+	v.glext.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+		GL_TEXTURE_2D, depth_texture, 0);
+	v.glext.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+		GL_TEXTURE_2D, reveal_texture, 0);
+	bool complete = v.glext.glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT)
+		== GL_FRAMEBUFFER_COMPLETE_EXT;
+	v.glext.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+		GL_TEXTURE_2D, accum_texture, 0);
+	complete = complete && v.glext.glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT)
+		== GL_FRAMEBUFFER_COMPLETE_EXT;
+	v.glext.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, 0);
+	return complete;
+}
+
+bool
+blended_transparency::begin_accumulation( const view& v)
+{
+	if (!available( v.glext, v.enable_shaders))
+		return false;
+
+	if (!program)
+		program.reset( new shader_program( composite_shader));
+	{
+		use_shader_program use( v, *program);
+		if (!use.ok()) {
+			failed = true;
+			return false;
+		}
+	}
+
+	// A multisampled depth buffer cannot be copied to a texture.
+	GLint sample_buffers = 0;
+	glGetIntegerv( GL_SAMPLE_BUFFERS_ARB, &sample_buffers);
+	if (sample_buffers) {
+		failed = true;
+		return false;
+	}
+
+	glGetIntegerv( GL_VIEWPORT, viewport);
+	int w = viewport[2], h = viewport[3];
+	if (w <= 0 || h <= 0)
+		return false;
+	clear_gl_error();
+	if ((w != width || h != height) && !realize( v, w, h)) {
+		failed = true;
+		return false;
+	}
+
+	// Transparent surfaces behind opaque ones are hidden by a copy of the
+	// opaque layer's depth buffer.
+	glBindTexture( GL_TEXTURE_2D, depth_texture);
+	glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], w, h);
+	glBindTexture( GL_TEXTURE_2D, 0);
+	if (glGetError() != GL_NO_ERROR) {
+		failed = true;
+		return false;
+	}
+
+	glGetFloatv( GL_COLOR_CLEAR_VALUE, clear_color);
+	v.glext.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, framebuffer);
+	v.glext.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+		GL_TEXTURE_2D, accum_texture, 0);
+	glViewport( 0, 0, w, h);
+	glClearColor( 0, 0, 0, 0);
+	glClear( GL_COLOR_BUFFER_BIT);
+	glDepthMask( GL_FALSE);
+	// Color accumulates the sum of color*alpha, and alpha the sum of alpha.
+	v.glext.glBlendFuncSeparateEXT( GL_SRC_ALPHA, GL_ONE, GL_ONE, GL_ONE);
+	return true;
+}
+
+void
+blended_transparency::begin_revealage( const view& v)
+{
+	v.glext.glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+		GL_TEXTURE_2D, reveal_texture, 0);
+	glClearColor( 1, 1, 1, 1);
+	glClear( GL_COLOR_BUFFER_BIT);
+	// Alpha accumulates the product of (1 - alpha).
+	v.glext.glBlendFuncSeparateEXT( GL_ZERO, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void
+blended_transparency::composite( const view& v)
+{
+	v.glext.glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, 0);
+	glViewport( viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor( clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+	glDepthMask( GL_TRUE);
+	// The usual blending, as set by display_kernel::realize(), is also what
+	// lays the average color over the background.
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	gl_disable depth_test( GL_DEPTH_TEST);
+	v.glext.glActiveTexture( GL_TEXTURE1_ARB);
+	glBindTexture( GL_TEXTURE_2D, reveal_texture);
+	v.glext.glActiveTexture( GL_TEXTURE0_ARB);
+	glBindTexture( GL_TEXTURE_2D, accum_texture);
+	{
+		use_shader_program use( v, *program);
+		v.glext.glUniform1iARB( program->get_uniform_location( v, "accum"), 0);
+		v.glext.glUniform1iARB( program->get_uniform_location( v, "reveal"), 1);
+		glBegin( GL_QUADS);
+		glVertex2f( -1, -1);
+		glVertex2f( 1, -1);
+		glVertex2f( 1, 1);
+		glVertex2f( -1, 1);
+		glEnd();
+	}
+	v.glext.glActiveTexture( GL_TEXTURE1_ARB);
+	glBindTexture( GL_TEXTURE_2D, 0);
+	v.glext.glActiveTexture( GL_TEXTURE0_ARB);
+	glBindTexture( GL_TEXTURE_2D, 0);
+}
+
+} // !namespace cvisual
@@ -0,0 +1,90 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/depth_sort.hpp"
+
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace cvisual {
+
+namespace {
+
+struct deeper
+{
+	const std::vector<double>& depth;
+	deeper( const std::vector<double>& d) : depth(d) {}
+	bool operator()( size_t lhs, size_t rhs) const
+	{ return depth[lhs] > depth[rhs]; }
+};
+
+struct keyed_index
+{
+	boost::uint64_t key;
+	size_t index;
+};
+
+// An unsigned key that increases as d decreases.
+inline boost::uint64_t
+descending_key( double d)
+{
+	if (d == 0)
+		d = 0; // Sort -0.0 with 0.0.
+	boost::uint64_t bits;
+	std::memcpy( &bits, &d, sizeof bits);
+	// Flip the sign bit of positive numbers and every bit of negative ones,
+	// so that the keys compare as unsigned integers in the same order as the
+	// doubles do, then reverse that order.
+	const boost::uint64_t sign = (boost::uint64_t)1 << 63;
+	bits = (bits & sign) ? ~bits : (bits | sign);
+	return ~bits;
+}
+
+// Below this, the radix sort's passes over its 256 buckets cost more than
+// they save.
+const size_t radix_threshold = 256;
+
+} // !namespace (unnamed)
+
+void
+depth_order( const std::vector<double>& depth, std::vector<size_t>& order)
+{
+	const size_t n = depth.size();
+	order.resize( n);
+	for (size_t i = 0; i < n; ++i)
+		order[i] = i;
+	if (n < radix_threshold) {
+		std::stable_sort( order.begin(), order.end(), deeper(depth));
+		return;
+	}
+
+	std::vector<keyed_index> keys( n);
+	std::vector<keyed_index> scratch( n);
+	for (size_t i = 0; i < n; ++i) {
+		keys[i].key = descending_key( depth[i]);
+		keys[i].index = i;
+	}
+
+	// Least significant byte first; each pass is stable, so the result is.
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t start[257] = { 0 };
+		for (size_t i = 0; i < n; ++i)
+			++start[((keys[i].key >> shift) & 0xff) + 1];
+		// Skip the bytes that every key shares, such as the exponent bits of
+		// depths of similar size.
+		if (*std::max_element( start + 1, start + 257) == n)
+			continue;
+		for (int b = 0; b < 256; ++b)
+			start[b+1] += start[b];
+		for (size_t i = 0; i < n; ++i)
+			scratch[start[(keys[i].key >> shift) & 0xff]++] = keys[i];
+		keys.swap( scratch);
+	}
+
+	for (size_t i = 0; i < n; ++i)
+		order[i] = keys[i].index;
+}
+
+} // !namespace cvisual
@@ -12,20 +12,52 @@
 
 namespace cvisual {
 
+namespace {
+// The directions of extent_data::support: (+-cot_hfov, 0, +-1) and
+// (0, +-cot_hfov, +-1).
+inline vector
+support_direction( int k, double cot_hfov)
+{
+	double s = (k & 1) ? -cot_hfov : cot_hfov;
+	double z = (k & 2) ? -1.0 : 1.0;
+	return (k & 4) ? vector( 0, s, z) : vector( s, 0, z);
+}
+} // !namespace (anonymous)
+
 extent_data::extent_data(double tan_hfov)
-: mins(QNAN,QNAN,QNAN),
+: tan_hfov(tan_hfov),
+  mins(QNAN,QNAN,QNAN),
   maxs(QNAN,QNAN,QNAN),
-  camera_z(0),
   buffer_depth(0)
 {
+	for (int k = 0; k < 8; ++k)
+		support[k] = -DBL_MAX;
 	cot_hfov = 1.0 / tan_hfov;
-	sin_hfov = sin( atan(tan_hfov) );
-	cos_hfov = sqrt( 1 - sin_hfov*sin_hfov );
-	invsin_hfov = 1.0 / sin_hfov;
+	invsin_hfov = 1.0 / sin( atan(tan_hfov) );
 }
 
 bool extent_data::is_empty() const { return !(mins.x == mins.x); } //< return isnan(mins.x)
 
+bool
+extent_data::same( const extent_data& other) const
+{
+	if (is_empty() || other.is_empty())
+		return is_empty() == other.is_empty() && buffer_depth == other.buffer_depth;
+	if (mins != other.mins || maxs != other.maxs || buffer_depth != other.buffer_depth)
+		return false;
+	for (int k = 0; k < 8; ++k)
+		if (support[k] != other.support[k])
+			return false;
+	return true;
+}
+
+double extent_data::get_camera_z() const {
+	double ret = 0;
+	for (int k = 0; k < 8; ++k)
+		ret = std::max( ret, support[k]);
+	return ret;
+}
+
 vector extent_data::get_center() const {
 	if (is_empty()) return vector();
 	return (mins + maxs) * 0.5;
@@ -71,12 +103,23 @@ vector extent_data::get_range( vector center) const {
 //////////////////////////////////
 
 extent::extent( extent_data& data, const tmatrix& local_to_centered_world )
-	: data(data), l_cw( local_to_centered_world ), frame_depth(0)
+	: data(data), l_cw( local_to_centered_world ), frame_depth(0),
+	frame_data(0), outer(0)
 {
 }
 
 extent::extent( extent& parent, const tmatrix& local_to_parent )
-	: data( parent.data ), frame_depth(parent.frame_depth+1)
+	: data( parent.data ), frame_depth(parent.frame_depth+1),
+	frame_data( parent.frame_data ), outer( parent.outer ),
+	frame_to_outer( parent.frame_to_outer )
+{
+	l_cw = parent.l_cw * local_to_parent;
+	l_frame = parent.l_frame * local_to_parent;
+}
+
+extent::extent( extent& parent, const tmatrix& local_to_parent, extent_data& local )
+	: data( parent.data ), frame_depth(parent.frame_depth+1),
+	frame_data( &local ), outer( &parent ), frame_to_outer( local_to_parent )
 {
 	l_cw = parent.l_cw * local_to_parent;
 }
@@ -85,10 +128,8 @@ extent::~extent() {
 }
 
 void
-extent::add_point( vector point)
+extent::grow_point( extent_data& data, const vector& point)
 {
-	point = l_cw * point;
-
 	// std::min(a,NAN) is defined as (NAN<a)?NAN:a, which is a.  So these will select point on the
 	//   first call!
 	data.mins.x = std::min( point.x, data.mins.x);
@@ -98,20 +139,27 @@ extent::add_point( vector point)
 	data.mins.z = std::min( point.z, data.mins.z);
 	data.maxs.z = std::max( point.z, data.maxs.z);
 
-	// TODO: it might be more elegant (and even faster) to compute extents along
-	//   specified axes (normal to the sides of the view frustum) and then display_kernel
-	//   could compute camera_z from that.  The downside is that taking the fabs(point.z) out
-	//   means 4 axes are needed instead of 2.
-	data.camera_z  = std::max( data.camera_z,
-		std::max(fabs(point.x),fabs(point.y))*data.cot_hfov + fabs(point.z) );
+	add_support( data, point, 0.0 );
 }
 
 void
-extent::add_sphere( vector center, double radius)
+extent::add_support( extent_data& data, const vector& c, double reach )
 {
-	radius = fabs(radius); //<TODO: why?
-	center = l_cw * center;
+	// The eight values of (+-x*cot_hfov or +-y*cot_hfov) +- z, in the order
+	// of support_direction().
+	const double x = c.x * data.cot_hfov;
+	const double y = c.y * data.cot_hfov;
+	const double value[8] = {
+		x + c.z, -x + c.z, x - c.z, -x - c.z,
+		y + c.z, -y + c.z, y - c.z, -y - c.z
+	};
+	for (int k = 0; k < 8; ++k)
+		data.support[k] = std::max( data.support[k], value[k] + reach );
+}
 
+void
+extent::grow_sphere( extent_data& data, const vector& center, double radius)
+{
 	data.mins.x = std::min( center.x - radius, data.mins.x );
 	data.maxs.x = std::max( center.x + radius, data.maxs.x );
 	data.mins.y = std::min( center.y - radius, data.mins.y );
@@ -119,10 +167,76 @@ extent::add_sphere( vector center, double radius)
 	data.mins.z = std::min( center.z - radius, data.mins.z );
 	data.maxs.z = std::max( center.z + radius, data.maxs.z );
 
-	data.camera_z  = std::max( data.camera_z,
-		std::max(fabs(center.x),fabs(center.y))*data.cot_hfov
-			+ fabs(center.z)
-			+ radius * data.invsin_hfov );
+	// Every support direction has length 1/sin_hfov.
+	add_support( data, center, radius * data.invsin_hfov );
+}
+
+void
+extent::grow_circle( extent_data& data, const vector& c, const vector& n, double r )
+{
+	vector n2( n.x*n.x, n.y*n.y, n.z*n.z );
+	vector r_proj( r*sqrt(1.0 - n2.x), r*sqrt(1.0 - n2.y), r*sqrt(1.0 - n2.z) );
+
+	data.mins.x = std::min( c.x - r_proj.x, data.mins.x );
+	data.maxs.x = std::max( c.x + r_proj.x, data.maxs.x );
+	data.mins.y = std::min( c.y - r_proj.y, data.mins.y );
+	data.maxs.y = std::max( c.y + r_proj.y, data.maxs.y );
+	data.mins.z = std::min( c.z - r_proj.z, data.mins.z );
+	data.maxs.z = std::max( c.z + r_proj.z, data.maxs.z );
+
+	// A circle reaches r*sqrt(|d|^2 - (d.n)^2) beyond its center along d.
+	for (int k = 0; k < 8; ++k) {
+		vector d = support_direction( k, data.cot_hfov);
+		double dn = d.dot(n);
+		double reach = r * sqrt( std::max( 0.0, d.mag2() - dn*dn));
+		data.support[k] = std::max( data.support[k], d.dot(c) + reach );
+	}
+}
+
+void
+extent::frame_point( vector point)
+{
+	if (!frame_data)
+		return;
+	point = l_frame * point;
+	grow_point( *frame_data, point);
+	outer->frame_point( frame_to_outer * point);
+}
+
+void
+extent::frame_sphere( vector center, double radius)
+{
+	if (!frame_data)
+		return;
+	center = l_frame * center;
+	grow_sphere( *frame_data, center, radius);
+	outer->frame_sphere( frame_to_outer * center, radius);
+}
+
+void
+extent::frame_circle( vector center, vector normal, double radius)
+{
+	if (!frame_data)
+		return;
+	center = l_frame * center;
+	normal = l_frame.times_v( normal);
+	grow_circle( *frame_data, center, normal, radius);
+	outer->frame_circle( frame_to_outer * center, frame_to_outer.times_v( normal), radius);
+}
+
+void
+extent::add_point( vector point)
+{
+	frame_point( point);
+	grow_point( data, l_cw * point);
+}
+
+void
+extent::add_sphere( vector center, double radius)
+{
+	radius = fabs(radius); //<TODO: why?
+	frame_sphere( center, radius);
+	grow_sphere( data, l_cw * center, radius);
 }
 
 void
@@ -138,29 +252,28 @@ extent::add_box( const tmatrix& fwt, const vector& a, const vector& b ) {
 }
 
 void extent::add_circle( const vector& center, const vector& normal, double r ) {
-	vector c = l_cw * center;
-	vector n = l_cw.times_v(normal);
+	frame_circle( center, normal, r);
+	grow_circle( data, l_cw * center, l_cw.times_v(normal), r);
+}
 
-	vector n2( n.x*n.x, n.y*n.y, n.z*n.z );
-	vector r_proj( r*sqrt(1.0 - n2.x), r*sqrt(1.0 - n2.y), r*sqrt(1.0 - n2.z) );
+void
+extent::add_extent( const extent_data& other )
+{
+	data.buffer_depth += other.buffer_depth;
+	if (other.is_empty())
+		return;
 
-	data.mins.x = std::min( c.x - r_proj.x, data.mins.x );
-	data.maxs.x = std::max( c.x + r_proj.x, data.maxs.x );
-	data.mins.y = std::min( c.y - r_proj.y, data.mins.y );
-	data.maxs.y = std::max( c.y + r_proj.y, data.maxs.y );
-	data.mins.z = std::min( c.z - r_proj.z, data.mins.z );
-	data.maxs.z = std::max( c.z + r_proj.z, data.maxs.z );
+	const vector t = l_cw * vector();
+	data.mins.x = std::min( other.mins.x + t.x, data.mins.x );
+	data.maxs.x = std::max( other.maxs.x + t.x, data.maxs.x );
+	data.mins.y = std::min( other.mins.y + t.y, data.mins.y );
+	data.maxs.y = std::max( other.maxs.y + t.y, data.maxs.y );
+	data.mins.z = std::min( other.mins.z + t.z, data.mins.z );
+	data.maxs.z = std::max( other.maxs.z + t.z, data.maxs.z );
 
-	double nxd = n.z*data.sin_hfov - n.x*data.cos_hfov;
-	double nyd = n.z*data.sin_hfov - n.y*data.cos_hfov;
-	data.camera_z  = std::max( data.camera_z,
-		fabs(c.x)*data.cot_hfov
-			+ fabs(c.z)
-			+ r * sqrt(1.0 - nxd*nxd) * data.invsin_hfov );
-	data.camera_z  = std::max( data.camera_z,
-		fabs(c.y)*data.cot_hfov
-			+ fabs(c.z)
-			+ r * sqrt(1.0 - nyd*nyd) * data.invsin_hfov );
+	for (int k = 0; k < 8; ++k)
+		data.support[k] = std::max( data.support[k],
+			other.support[k] + support_direction( k, data.cot_hfov).dot(t) );
 }
 
 void
@@ -0,0 +1,136 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/frame_readback.hpp"
+#include "util/gl_free.hpp"
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace cvisual {
+
+frame_readback::slot::slot()
+	: buffer(0), capacity(0), width(0), height(0), pending(false)
+{
+}
+
+frame_readback::frame_readback( size_t depth)
+	: ring( std::max( depth, (size_t)1)), next(0), glDeleteBuffersARB(0)
+{
+}
+
+frame_readback::~frame_readback()
+{
+	for (size_t i = 0; i < ring.size(); ++i)
+		if (ring[i].buffer)
+			on_gl_free.free( boost::bind( &frame_readback::gl_free,
+				glDeleteBuffersARB, ring[i].buffer));
+}
+
+void
+frame_readback::gl_free( PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB, GLuint handle)
+{
+	glDeleteBuffersARB( 1, &handle);
+}
+
+size_t
+frame_readback::pending() const
+{
+	size_t ret = 0;
+	for (size_t i = 0; i < ring.size(); ++i)
+		if (ring[i].pending)
+			++ret;
+	return ret;
+}
+
+void
+frame_readback::read( const gl_extensions& glext, int width, int height,
+	const consumer& out)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	const size_t size = (size_t)width * height * 4;
+
+	// Read what was drawn, whichever buffer that was.
+	GLint draw_buffer = GL_BACK;
+	glGetIntegerv( GL_DRAW_BUFFER, &draw_buffer);
+	glReadBuffer( draw_buffer);
+	glPixelStorei( GL_PACK_ALIGNMENT, 1);
+
+	if (!glext.ARB_pixel_buffer_object) {
+		std::vector<unsigned char> pixels( size);
+		glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		flip( &pixels[0], width, height, out);
+		return;
+	}
+
+	slot& s = ring[next];
+	next = (next + 1) % ring.size();
+	// The ring has come around, so this slot's frame must be done with
+	// before it is reused.
+	if (s.pending)
+		deliver( glext, s, out);
+
+	if (!s.buffer) {
+		glext.glGenBuffersARB( 1, &s.buffer);
+		// See the TODO in shader_program::realize() about calling extension
+		// functions from on_gl_free callbacks.
+		glDeleteBuffersARB = glext.glDeleteBuffersARB;
+		on_gl_free.connect( boost::bind( &frame_readback::gl_free,
+			glDeleteBuffersARB, s.buffer));
+	}
+	glext.glBindBufferARB( GL_PIXEL_PACK_BUFFER_ARB, s.buffer);
+	if (s.capacity < size) {
+		glext.glBufferDataARB( GL_PIXEL_PACK_BUFFER_ARB, size, 0, GL_STREAM_READ_ARB);
+		s.capacity = size;
+	}
+	// With a pack buffer bound, the pointer is an offset into it, and the
+	// call returns without waiting for the transfer.
+	glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glext.glBindBufferARB( GL_PIXEL_PACK_BUFFER_ARB, 0);
+	s.width = width;
+	s.height = height;
+	s.pending = true;
+}
+
+void
+frame_readback::flush( const gl_extensions& glext, const consumer& out)
+{
+	// Oldest first: the slot after the most recent one.
+	for (size_t i = 0; i < ring.size(); ++i) {
+		slot& s = ring[(next + i) % ring.size()];
+		if (s.pending)
+			deliver( glext, s, out);
+	}
+}
+
+void
+frame_readback::deliver( const gl_extensions& glext, slot& s, const consumer& out)
+{
+	s.pending = false;
+	glext.glBindBufferARB( GL_PIXEL_PACK_BUFFER_ARB, s.buffer);
+	const unsigned char* pixels = static_cast<const unsigned char*>(
+		glext.glMapBufferARB( GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB));
+	if (pixels) {
+		flip( pixels, s.width, s.height, out);
+		glext.glUnmapBufferARB( GL_PIXEL_PACK_BUFFER_ARB);
+	}
+	glext.glBindBufferARB( GL_PIXEL_PACK_BUFFER_ARB, 0);
+}
+
+void
+frame_readback::flip( const unsigned char* rgba, int width, int height,
+	const consumer& out)
+{
+	// OpenGL's rows go bottom up; images go top down.
+	const size_t row = (size_t)width * 4;
+	flipped.resize( row * height);
+	for (int y = 0; y < height; ++y)
+		std::memcpy( &flipped[row * (height - 1 - y)], rgba + row * y, row);
+	if (out)
+		out( &flipped[0], width, height);
+}
+
+} // !namespace cvisual
@@ -0,0 +1,146 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/frame_scheduler.hpp"
+
+#include <boost/thread/thread_time.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cvisual {
+
+namespace {
+// The weight of the latest cycle in the smoothed times.
+const double smoothing = 0.125;
+} // !namespace (anonymous)
+
+frame_scheduler render_schedule;
+
+frame_pacing::frame_pacing()
+	: frame_rate(0), paint(0), swap(0), cycle(0), interval(0), frames(0),
+	dropped(0)
+{
+}
+
+frame_scheduler::frame_scheduler()
+	: target(0), sync(false), start(0), due(0), period(0), begun(0)
+{
+}
+
+void
+frame_scheduler::set_frame_rate( double fps)
+{
+	if (!(fps >= 0.0))
+		throw std::invalid_argument( "The frame rate must not be negative.");
+	lock L(barrier);
+	target = fps;
+	stats.frame_rate = fps;
+}
+
+double
+frame_scheduler::get_frame_rate() const
+{
+	lock L(barrier);
+	return target;
+}
+
+void
+frame_scheduler::set_rate_sync( bool s)
+{
+	lock L(barrier);
+	sync = s;
+	// Let anything waiting for a cycle that may now never come go on.
+	frame_done.notify_all();
+}
+
+bool
+frame_scheduler::get_rate_sync() const
+{
+	lock L(barrier);
+	return sync;
+}
+
+frame_pacing
+frame_scheduler::get_pacing() const
+{
+	lock L(barrier);
+	return stats;
+}
+
+void
+frame_scheduler::begin_frame()
+{
+	lock L(barrier);
+	double now = clock.elapsed();
+	if (stats.frames) {
+		stats.cycle += smoothing * ((now - start) - stats.cycle);
+		// Cycles which should have started by now, but didn't, are dropped,
+		// and the grid of deadlines starts over from this one.
+		if (period > 0 && now - due >= period) {
+			stats.dropped += (unsigned long)((now - due) / period);
+			due = now;
+		}
+	}
+	else
+		due = now;
+	start = now;
+	++begun;
+}
+
+double
+frame_scheduler::end_frame( double paint, double swap)
+{
+	lock L(barrier);
+	if (stats.frames) {
+		stats.paint += smoothing * (paint - stats.paint);
+		stats.swap += smoothing * (swap - stats.swap);
+	}
+	else {
+		stats.paint = paint;
+		stats.swap = swap;
+	}
+
+	double now = clock.elapsed();
+	double interval;
+	if (target > 0) {
+		// Infinity makes the period 0, so every cycle starts right away.
+		period = 1.0 / target;
+		due += period;
+		interval = std::max( 0.0, due - now);
+	}
+	else {
+		// We want to be holding the lock about half the time, so the next rendering cycle
+		// should begin /paint/ seconds after painting finished /swap/ seconds ago.  The minimum
+		// of 5ms is to prevent absurd behavior if vertical retrace synchronization is disabled in
+		// the driver, and to ensure that we have some time for event handling if painting is instant.
+		// The times are smoothed, so that one slow cycle doesn't make the next one late.
+		interval = std::max(.005, stats.paint - stats.swap);
+		if (stats.paint+stats.swap+interval < 0.03) interval = 0.03-stats.paint-stats.swap;
+		period = stats.paint + stats.swap + interval;
+		due = now + interval;
+	}
+
+	stats.interval = interval;
+	++stats.frames;
+	frame_done.notify_all();
+	return interval;
+}
+
+void
+frame_scheduler::sync_step()
+{
+	lock L(barrier);
+	if (!sync)
+		return;
+	// The cycle must start after this step finished, for the step to be
+	// drawn, so one that is already under way does not count.
+	unsigned long wanted = begun + 1;
+	boost::system_time limit = boost::get_system_time()
+		+ boost::posix_time::milliseconds(100);
+	while (sync && stats.frames < wanted)
+		if (!frame_done.timed_wait( L, limit))
+			break;
+}
+
+} // !namespace cvisual
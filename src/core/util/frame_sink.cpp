@@ -0,0 +1,358 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/frame_sink.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef _WIN32
+# define popen _popen
+# define pclose _pclose
+# define PIPE_MODE "wb"
+#else
+# define PIPE_MODE "w"
+#endif
+
+namespace cvisual {
+
+namespace {
+
+void
+write_or_throw( std::FILE* f, const void* data, size_t size, const std::string& name)
+{
+	if (size && std::fwrite( data, 1, size, f) != size)
+		throw std::runtime_error( "Could not write frames to " + name + ".");
+}
+
+// Appends each frame to one file.
+class raw_sink : public frame_sink
+{
+	std::string name;
+	std::FILE* file;
+ public:
+	raw_sink( const std::string& n)
+		: name(n), file( std::fopen( n.c_str(), "wb"))
+	{
+		if (!file)
+			throw std::runtime_error( "Could not open " + name + " for writing.");
+	}
+	~raw_sink() { std::fclose( file); }
+
+	void write( const unsigned char* rgba, int width, int height)
+	{
+		write_or_throw( file, rgba, (size_t)width * height * 4, name);
+	}
+};
+
+// Feeds each frame to a command, which is started with the first one so
+// that its size can be given on the command line.
+class pipe_sink : public frame_sink
+{
+	std::string command;
+	std::FILE* pipe;
+	int width;
+	int height;
+
+	static void
+	replace( std::string& s, const std::string& key, const std::string& value)
+	{
+		for (size_t at = s.find( key); at != std::string::npos;
+				at = s.find( key, at + value.size()))
+			s.replace( at, key.size(), value);
+	}
+
+ public:
+	pipe_sink( const std::string& c)
+		: command(c), pipe(0), width(0), height(0)
+	{
+	}
+	~pipe_sink()
+	{
+		if (pipe)
+			pclose( pipe);
+	}
+
+	void write( const unsigned char* rgba, int w, int h)
+	{
+		if (!pipe) {
+			std::string c = command;
+			const std::string ws = boost::lexical_cast<std::string>(w);
+			const std::string hs = boost::lexical_cast<std::string>(h);
+			replace( c, "{width}", ws);
+			replace( c, "{height}", hs);
+			replace( c, "{size}", ws + "x" + hs);
+			pipe = popen( c.c_str(), PIPE_MODE);
+			if (!pipe)
+				throw std::runtime_error( "Could not run " + c + ".");
+			width = w;
+			height = h;
+		}
+		else if (w != width || h != height)
+			throw std::runtime_error( "The frames piped to " + command
+				+ " changed size.");
+		write_or_throw( pipe, rgba, (size_t)w * h * 4, command);
+	}
+};
+
+// The CRC-32 of each byte value, for the checksums of PNG chunks.  It is
+// filled in when the library is loaded, before any writer thread can use it.
+struct crc32_table
+{
+	unsigned long entry[256];
+	crc32_table()
+	{
+		for (unsigned long n = 0; n < 256; ++n) {
+			unsigned long k = n;
+			for (int b = 0; b < 8; ++b)
+				k = (k & 1) ? 0xedb88320UL ^ (k >> 1) : k >> 1;
+			entry[n] = k;
+		}
+	}
+} crc_table;
+
+// Writes each frame to a PNG file of its own.  So as not to depend on zlib,
+// the image data is stored rather than compressed; a movie encoder or an
+// image tool can always compress it afterwards.
+class png_sink : public frame_sink
+{
+	std::string prefix;
+	std::string suffix;
+	int digits; ///< Zero padding of the frame number; 0 for none.
+	unsigned long count;
+
+	static unsigned long
+	crc( unsigned long c, const unsigned char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+			c = crc_table.entry[(c ^ data[i]) & 0xff] ^ (c >> 8);
+		return c;
+	}
+
+	static void
+	put32( std::vector<unsigned char>& out, unsigned long v)
+	{
+		out.push_back( (v >> 24) & 0xff);
+		out.push_back( (v >> 16) & 0xff);
+		out.push_back( (v >> 8) & 0xff);
+		out.push_back( v & 0xff);
+	}
+
+	static void
+	chunk( std::vector<unsigned char>& out, const char* type,
+		const std::vector<unsigned char>& data)
+	{
+		put32( out, data.size());
+		const size_t start = out.size();
+		out.insert( out.end(), type, type + 4);
+		out.insert( out.end(), data.begin(), data.end());
+		put32( out, crc( 0xffffffffUL, &out[start], out.size() - start) ^ 0xffffffffUL);
+	}
+
+ public:
+	png_sink( const std::string& pattern)
+		: digits(0), count(0)
+	{
+		size_t at = pattern.find( '%');
+		size_t end = at;
+		if (at != std::string::npos) {
+			end = at + 1;
+			while (end < pattern.size() && pattern[end] >= '0' && pattern[end] <= '9')
+				++end;
+			if (end == pattern.size() || pattern[end] != 'd')
+				throw std::invalid_argument(
+					"A PNG file name may only contain %d, or %0Nd, for the frame number.");
+			if (end > at + 1)
+				digits = std::atoi( pattern.substr( at + 1, end - at - 1).c_str());
+			++end;
+		}
+		else {
+			// Without a number in the name, put one before the extension.
+			at = pattern.rfind( '.');
+			if (at == std::string::npos || at < pattern.find_last_of( "/\\") + 1)
+				at = pattern.size();
+			end = at;
+		}
+		prefix = pattern.substr( 0, at);
+		suffix = pattern.substr( end);
+	}
+
+	void write( const unsigned char* rgba, int width, int height)
+	{
+		std::string number = boost::lexical_cast<std::string>(count++);
+		if ((int)number.size() < digits)
+			number.insert( 0, digits - number.size(), '0');
+		const std::string name = prefix + number + suffix;
+
+		std::vector<unsigned char> header;
+		put32( header, width);
+		put32( header, height);
+		header.push_back( 8); // bits per channel
+		header.push_back( 6); // RGBA
+		header.push_back( 0); // deflate
+		header.push_back( 0); // adaptive filtering
+		header.push_back( 0); // no interlace
+
+		// Each row is preceded by its filter type, none.  The result is
+		// wrapped in a zlib stream of stored blocks, of at most 65535 bytes.
+		const size_t row = (size_t)width * 4;
+		std::vector<unsigned char> raw;
+		raw.reserve( (row + 1) * height);
+		for (int y = 0; y < height; ++y) {
+			raw.push_back( 0);
+			raw.insert( raw.end(), rgba + row*y, rgba + row*(y+1));
+		}
+		std::vector<unsigned char> data;
+		data.reserve( raw.size() + raw.size() / 65535 * 5 + 11);
+		data.push_back( 0x78);
+		data.push_back( 0x01);
+		size_t done = 0;
+		do {
+			const size_t n = std::min( raw.size() - done, (size_t)65535);
+			data.push_back( done + n == raw.size() ? 1 : 0);
+			data.push_back( n & 0xff);
+			data.push_back( n >> 8);
+			data.push_back( ~n & 0xff);
+			data.push_back( (~n >> 8) & 0xff);
+			data.insert( data.end(), raw.begin() + done, raw.begin() + done + n);
+			done += n;
+		} while (done < raw.size());
+		unsigned long a = 1, b = 0;
+		for (size_t i = 0; i < raw.size(); ++i) {
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		put32( data, (b << 16) | a);
+
+		static const unsigned char signature[8] = {
+			0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		std::vector<unsigned char> png( signature, signature + 8);
+		chunk( png, "IHDR", header);
+		chunk( png, "IDAT", data);
+		chunk( png, "IEND", std::vector<unsigned char>());
+
+		std::FILE* file = std::fopen( name.c_str(), "wb");
+		if (!file)
+			throw std::runtime_error( "Could not open " + name + " for writing.");
+		const bool ok = std::fwrite( &png[0], 1, png.size(), file) == png.size();
+		if (std::fclose( file) != 0 || !ok)
+			throw std::runtime_error( "Could not write " + name + ".");
+	}
+};
+
+} // !namespace (anonymous)
+
+frame_sink::~frame_sink()
+{
+}
+
+void
+frame_sink::write_image( const boost::shared_ptr<frame_image>& frame)
+{
+	write( &frame->pixels[0], frame->width, frame->height);
+}
+
+boost::shared_ptr<frame_sink>
+frame_sink::create( const std::string& kind, const std::string& target)
+{
+	if (kind == "raw")
+		return boost::shared_ptr<frame_sink>( new raw_sink( target));
+	if (kind == "png")
+		return boost::shared_ptr<frame_sink>( new png_sink( target));
+	if (kind == "pipe")
+		return boost::shared_ptr<frame_sink>( new pipe_sink( target));
+	throw std::invalid_argument( "The kind of output must be 'raw', 'png' or 'pipe'.");
+}
+
+frame_writer::frame_writer( boost::shared_ptr<frame_sink> s, size_t b)
+	: sink(s), backlog( std::max( b, (size_t)1)), closing(false),
+	worker( new boost::thread( boost::bind( &frame_writer::run, this)))
+{
+}
+
+frame_writer::~frame_writer()
+{
+	try {
+		close();
+	}
+	catch (...) {
+	}
+}
+
+void
+frame_writer::check_error()
+{
+	if (!error.empty())
+		throw std::runtime_error( error);
+}
+
+void
+frame_writer::write( const unsigned char* rgba, int width, int height)
+{
+	boost::shared_ptr<frame_image> f( new frame_image);
+	f->pixels.assign( rgba, rgba + (size_t)width * height * 4);
+	f->width = width;
+	f->height = height;
+
+	lock L(barrier);
+	while (queue.size() >= backlog && error.empty())
+		changed.wait( L);
+	check_error();
+	queue.push_back( f);
+	changed.notify_all();
+}
+
+void
+frame_writer::close()
+{
+	{
+		lock L(barrier);
+		if (!worker)
+			return;
+		closing = true;
+		changed.notify_all();
+	}
+	worker->join();
+	worker.reset();
+	sink.reset();
+	lock L(barrier);
+	check_error();
+}
+
+void
+frame_writer::run()
+{
+	lock L(barrier);
+	while (true) {
+		while (queue.empty() && !closing)
+			changed.wait( L);
+		if (queue.empty())
+			return;
+		boost::shared_ptr<frame_image> f = queue.front();
+		if (error.empty()) {
+			// Write without the lock, so that the next frame can be queued.
+			L.unlock();
+			std::string failed;
+			try {
+				sink->write_image( f);
+			}
+			catch (std::exception& e) {
+				failed = e.what();
+			}
+			L.lock();
+			if (!failed.empty())
+				error = failed;
+		}
+		// After an error, the frames left are dropped.
+		queue.pop_front();
+		changed.notify_all();
+	}
+}
+
+} // !namespace cvisual
@@ -0,0 +1,50 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/frame_stats.hpp"
+
+namespace cvisual {
+
+frame_stats::frame_stats()
+	: start(0), cycle(0), gil_wait(0), extent(0), snapshot(0), sort(0),
+	opaque(0), transparent(0), screen(0), pick(0), swap(0), total(0),
+	objects(0), transparent_objects(0), screen_objects(0), culled(0)
+{
+}
+
+frame_stats_log::frame_stats_log( size_t capacity)
+	: ring( capacity), next(0), count(0)
+{
+}
+
+void
+frame_stats_log::push( const frame_stats& s)
+{
+	lock L(barrier);
+	ring[next] = s;
+	next = (next + 1) % ring.size();
+	if (count < ring.size())
+		++count;
+}
+
+std::vector<frame_stats>
+frame_stats_log::recent() const
+{
+	lock L(barrier);
+	std::vector<frame_stats> ret;
+	ret.reserve( count);
+	size_t oldest = (next + ring.size() - count) % ring.size();
+	for (size_t i = 0; i < count; ++i)
+		ret.push_back( ring[(oldest + i) % ring.size()]);
+	return ret;
+}
+
+void
+frame_stats_log::clear()
+{
+	lock L(barrier);
+	next = count = 0;
+}
+
+} // !namespace cvisual
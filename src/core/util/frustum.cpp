@@ -0,0 +1,55 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/frustum.hpp"
+
+#include <cmath>
+
+namespace cvisual {
+
+frustum::frustum()
+	: scale(1.0), is_bounded(false)
+{
+	for (int i = 0; i < 6; ++i)
+		offset[i] = 0;
+}
+
+frustum::frustum( const tmatrix& m, double s)
+	: scale(s), is_bounded(true)
+{
+	// A point is inside when -w <= x, y, z <= w in clip coordinates, so each
+	// plane is the bottom row of the matrix plus or minus one of the others.
+	for (int i = 0; i < 6; ++i) {
+		const size_t row = i / 2;
+		const double sign = (i % 2) ? -1.0 : 1.0;
+		vector n( m(3,0) + sign*m(row,0), m(3,1) + sign*m(row,1),
+			m(3,2) + sign*m(row,2));
+		double d = m(3,3) + sign*m(row,3);
+		// Normalize, so that distances from the planes are true distances.
+		const double len = n.mag();
+		if (len == 0.0) {
+			// Never happens for a valid projection; keep everything.
+			normal[i] = vector();
+			offset[i] = 1.0;
+			continue;
+		}
+		normal[i] = n / len;
+		offset[i] = d / len;
+	}
+}
+
+bool
+frustum::excludes_sphere( const vector& center, double radius) const
+{
+	if (!is_bounded)
+		return false;
+	const vector c = center * scale;
+	const double r = std::fabs( radius) * scale;
+	for (int i = 0; i < 6; ++i)
+		if (normal[i].dot( c) + offset[i] < -r)
+			return true;
+	return false;
+}
+
+} // !namespace cvisual
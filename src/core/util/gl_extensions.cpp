@@ -40,6 +40,31 @@ void gl_extensions::init( display_kernel& d ) {
 		F( glGetInfoLogARB );
 	}
 
+	if ( ARB_vertex_shader = d.hasExtension( "GL_ARB_vertex_shader" ) ) {
+		F( glGetAttribLocationARB );
+		F( glVertexAttribPointerARB );
+		F( glEnableVertexAttribArrayARB );
+		F( glDisableVertexAttribArrayARB );
+	}
+
+	if ( ARB_draw_instanced = d.hasExtension( "GL_ARB_draw_instanced" ) ) {
+		F( glDrawElementsInstancedARB );
+	}
+
+	if ( ARB_instanced_arrays = d.hasExtension( "GL_ARB_instanced_arrays" ) ) {
+		F( glVertexAttribDivisorARB );
+	}
+
+	if ( ARB_vertex_buffer_object = d.hasExtension( "GL_ARB_vertex_buffer_object" ) ) {
+		F( glGenBuffersARB );
+		F( glBindBufferARB );
+		F( glBufferDataARB );
+		F( glBufferSubDataARB );
+		F( glDeleteBuffersARB );
+		F( glMapBufferARB );
+		F( glUnmapBufferARB );
+	}
+
 	if ( EXT_texture3D = d.hasExtension( "GL_EXT_texture3D" ) ) {
 		F( glTexImage3D );
 		F( glTexSubImage3D );
@@ -59,6 +84,24 @@ void gl_extensions::init( display_kernel& d ) {
 	if ( ARB_point_parameters = d.hasExtension( "GL_ARB_point_parameters" ) ) {
 		F( glPointParameterfvARB );
 	}
+
+	if ( EXT_framebuffer_object = d.hasExtension( "GL_EXT_framebuffer_object" ) ) {
+		F( glGenFramebuffersEXT );
+		F( glBindFramebufferEXT );
+		F( glFramebufferTexture2DEXT );
+		F( glCheckFramebufferStatusEXT );
+		F( glDeleteFramebuffersEXT );
+	}
+
+	if ( EXT_blend_func_separate = d.hasExtension( "GL_EXT_blend_func_separate" ) ) {
+		F( glBlendFuncSeparateEXT );
+	}
+
+	ARB_texture_float = d.hasExtension( "GL_ARB_texture_float" );
+	ARB_depth_texture = d.hasExtension( "GL_ARB_depth_texture" );
+	ARB_texture_non_power_of_two = d.hasExtension( "GL_ARB_texture_non_power_of_two" );
+	ARB_pixel_buffer_object = ARB_vertex_buffer_object
+		&& d.hasExtension( "GL_ARB_pixel_buffer_object" );
 }
 
 } // namespace cvisual
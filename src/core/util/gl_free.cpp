@@ -3,6 +3,7 @@
 namespace cvisual {
 
 gl_free_manager on_gl_free;
+mutex gl_share_lock;
 
 boost::signal< void() >& gl_free_manager::on_shutdown() {
 	static boost::signal< void() >* i = new boost::signal< void() >;
@@ -14,14 +15,21 @@ boost::signal< void() >& gl_free_manager::on_next_frame() {
 	return *i;
 }
 
+mutex& gl_free_manager::barrier() {
+	static mutex* i = new mutex;
+	return *i;
+}
+
 void 
 gl_free_manager::frame() {
+	lock L(barrier());
 	on_next_frame()();
 	on_next_frame().disconnect_all_slots();
 }
 
 void
 gl_free_manager::shutdown() {
+	lock L(barrier());
 	on_next_frame()();
 	on_next_frame().disconnect_all_slots();
 	on_shutdown()();
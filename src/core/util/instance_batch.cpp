@@ -0,0 +1,350 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/instance_batch.hpp"
+#include "util/mesh.hpp"
+#include "util/shader_program.hpp"
+#include "util/gl_enable.hpp"
+#include "util/errors.hpp"
+#include "util/gl_free.hpp"
+
+namespace cvisual {
+
+namespace {
+
+const size_t instance_size = 16;
+
+// Reproduces the fixed function pipeline as display_kernel sets it up:
+// per-vertex lighting with GL_COLOR_MATERIAL for ambient and diffuse, no
+// specular, and GL_NORMALIZE.
+const char* instance_shader =
+	"[vertex]\n"
+	"uniform int light_count;\n"
+	"uniform vec4 light_pos[8];\n"
+	"uniform vec4 light_color[8];\n"
+	"attribute vec4 instance_x;\n"
+	"attribute vec4 instance_y;\n"
+	"attribute vec4 instance_z;\n"
+	"attribute vec4 instance_color;\n"
+	"void main() {\n"
+	"	vec4 p = vec4( dot(instance_x, gl_Vertex), dot(instance_y, gl_Vertex),\n"
+	"		dot(instance_z, gl_Vertex), 1.0);\n"
+	"	// Normals transform by the cofactor matrix, which is the inverse\n"
+	"	// transpose up to the scale removed by normalize().\n"
+	"	vec3 c0 = vec3( instance_x.x, instance_y.x, instance_z.x);\n"
+	"	vec3 c1 = vec3( instance_x.y, instance_y.y, instance_z.y);\n"
+	"	vec3 c2 = vec3( instance_x.z, instance_y.z, instance_z.z);\n"
+	"	vec3 n = cross(c1, c2)*gl_Normal.x + cross(c2, c0)*gl_Normal.y\n"
+	"		+ cross(c0, c1)*gl_Normal.z;\n"
+	"	if (dot(c0, cross(c1, c2)) < 0.0) n = -n;\n"
+	"	vec3 N = normalize( gl_NormalMatrix * n);\n"
+	"	vec4 P = gl_ModelViewMatrix * p;\n"
+	"	vec3 c = gl_LightModel.ambient.rgb * instance_color.rgb;\n"
+	"	for (int i = 0; i < 8; i++) {\n"
+	"		if (i >= light_count) break;\n"
+	"		vec3 L = normalize( light_pos[i].xyz - P.xyz*light_pos[i].w);\n"
+	"		c += light_color[i].rgb * instance_color.rgb * max( dot(N, L), 0.0);\n"
+	"	}\n"
+	"	gl_FrontColor = vec4( c, instance_color.a);\n"
+	"	gl_Position = gl_ProjectionMatrix * P;\n"
+	"}\n"
+	"[fragment]\n"
+	"void main() {\n"
+	"	gl_FragColor = gl_Color;\n"
+	"}\n";
+
+const char* instance_attributes[] = {
+	"instance_x", "instance_y", "instance_z", "instance_color"
+};
+
+const size_t impostor_size = 10;
+
+// gl_Vertex is the center and radius of the sphere, gl_MultiTexCoord0 the
+// corner of the square, from -1 to 1.  The square passes through the center,
+// facing the eye, and is just large enough to cover the outline of the sphere
+// in perspective.  The fragment shader lights the sphere as the instance
+// shader does, though per pixel, and writes the depth of the sphere rather
+// than that of the square.
+const char* impostor_shader =
+	"[varying]\n"
+	"varying vec3 eye_pos;\n"
+	"varying vec3 eye_center;\n"
+	"varying float eye_radius;\n"
+	"[vertex]\n"
+	"void main() {\n"
+	"	vec4 c = gl_ModelViewMatrix * vec4( gl_Vertex.xyz, 1.0);\n"
+	"	eye_center = c.xyz / c.w;\n"
+	"	eye_radius = gl_Vertex.w * length( gl_ModelViewMatrix[0].xyz);\n"
+	"	float d2 = dot( eye_center, eye_center);\n"
+	"	float r2 = eye_radius * eye_radius;\n"
+	"	float size = eye_radius * sqrt( d2 / max( d2 - r2, 1e-6 * d2));\n"
+	"	vec3 toward = normalize( -eye_center);\n"
+	"	vec3 up = abs( toward.y) > 0.9 ? vec3( 1.0, 0.0, 0.0) : vec3( 0.0, 1.0, 0.0);\n"
+	"	vec3 right = normalize( cross( up, toward));\n"
+	"	up = cross( toward, right);\n"
+	"	eye_pos = eye_center\n"
+	"		+ (right*gl_MultiTexCoord0.x + up*gl_MultiTexCoord0.y) * size;\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"	gl_Position = gl_ProjectionMatrix * vec4( eye_pos, 1.0);\n"
+	"}\n"
+	"[fragment]\n"
+	"uniform int light_count;\n"
+	"uniform vec4 light_pos[8];\n"
+	"uniform vec4 light_color[8];\n"
+	"void main() {\n"
+	"	// The nearer intersection of the ray from the eye with the sphere.\n"
+	"	vec3 D = normalize( eye_pos);\n"
+	"	float b = dot( D, eye_center);\n"
+	"	float disc = b*b - dot( eye_center, eye_center) + eye_radius*eye_radius;\n"
+	"	if (disc < 0.0) discard;\n"
+	"	vec3 P = D * (b - sqrt( disc));\n"
+	"	vec3 N = (P - eye_center) / eye_radius;\n"
+	"	vec3 c = gl_LightModel.ambient.rgb * gl_Color.rgb;\n"
+	"	for (int i = 0; i < 8; i++) {\n"
+	"		if (i >= light_count) break;\n"
+	"		vec3 L = normalize( light_pos[i].xyz - P*light_pos[i].w);\n"
+	"		c += light_color[i].rgb * gl_Color.rgb * max( dot(N, L), 0.0);\n"
+	"	}\n"
+	"	gl_FragColor = vec4( c, gl_Color.a);\n"
+	"	vec4 clip = gl_ProjectionMatrix * vec4( P, 1.0);\n"
+	"	gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w\n"
+	"		+ gl_DepthRange.near + gl_DepthRange.far);\n"
+	"}\n";
+
+// The programs for instance_shader and impostor_shader, shared by every batch
+// and display like the models they draw.  They are never freed.
+shader_program* instance_program = 0;
+shader_program* impostor_program = 0;
+
+shader_program&
+shared_program( shader_program*& program, const char* source)
+{
+	lock L(gl_share_lock);
+	if (!program)
+		program = new shader_program( source);
+	return *program;
+}
+
+// The corners of the square, in the order of a GL_QUADS.
+const float impostor_corners[4][2] = {
+	{ -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 }
+};
+
+} // !namespace (anonymous)
+
+instance_batch::instance_batch()
+{
+}
+
+instance_batch::~instance_batch()
+{
+}
+
+void
+instance_batch::add( const view& v, const mesh* model, const tmatrix& model_world,
+	rgb color, float opacity)
+{
+	// Same as renderable::outer_render()
+	if (v.anaglyph) {
+		if (v.coloranaglyph)
+			color = color.desaturate();
+		else
+			color = color.grayscale();
+	}
+
+	std::vector<float>& data = groups[model];
+	for (size_t row = 0; row < 3; ++row)
+		for (size_t col = 0; col < 4; ++col)
+			data.push_back( model_world(row, col));
+	data.push_back( color.red);
+	data.push_back( color.green);
+	data.push_back( color.blue);
+	data.push_back( opacity);
+}
+
+void
+instance_batch::add_sphere( const view& v, const mesh* fallback, const vector& center,
+	double radius, rgb color)
+{
+	if (v.anaglyph) {
+		if (v.coloranaglyph)
+			color = color.desaturate();
+		else
+			color = color.grayscale();
+	}
+
+	impostor_fallbacks.push_back( fallback);
+	for (size_t k = 0; k < 4; ++k) {
+		impostors.push_back( center.x);
+		impostors.push_back( center.y);
+		impostors.push_back( center.z);
+		impostors.push_back( radius);
+		impostors.push_back( color.red);
+		impostors.push_back( color.green);
+		impostors.push_back( color.blue);
+		impostors.push_back( 1.0f);
+		impostors.push_back( impostor_corners[k][0]);
+		impostors.push_back( impostor_corners[k][1]);
+	}
+}
+
+void
+instance_batch::gl_render( const view& v)
+{
+	clear_gl_error();
+	if (!impostors.empty() && !gl_render_impostors( v))
+		impostors_to_meshes();
+	impostors.clear();
+	impostor_fallbacks.clear();
+	if (!gl_render_instanced( v))
+		gl_render_arrays( v);
+	check_gl_error();
+
+	for (groups_t::iterator i = groups.begin(); i != groups.end(); ++i)
+		i->second.clear();
+}
+
+bool
+instance_batch::gl_render_impostors( const view& v)
+{
+	if (!v.enable_shaders || !v.glext.ARB_shader_objects || !v.glext.ARB_vertex_shader)
+		return false;
+
+	shader_program& program = shared_program( impostor_program, impostor_shader);
+	use_shader_program use( v, program);
+	if (!use.ok())
+		return false;
+
+	int u;
+	if ((u = program.get_uniform_location( v, "light_count")) >= 0)
+		v.glext.glUniform1iARB( u, v.light_count[0]);
+	if ((u = program.get_uniform_location( v, "light_pos")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( u, v.light_count[0], &v.light_pos[0]);
+	if ((u = program.get_uniform_location( v, "light_color")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( u, v.light_count[0], &v.light_color[0]);
+
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client colors( GL_COLOR_ARRAY);
+	gl_enable_client corners( GL_TEXTURE_COORD_ARRAY);
+	const GLsizei stride = impostor_size * sizeof(float);
+	glVertexPointer( 4, GL_FLOAT, stride, &impostors[0]);
+	glColorPointer( 4, GL_FLOAT, stride, &impostors[4]);
+	glTexCoordPointer( 2, GL_FLOAT, stride, &impostors[8]);
+	glDrawArrays( GL_QUADS, 0, impostors.size() / impostor_size);
+	return true;
+}
+
+void
+instance_batch::impostors_to_meshes()
+{
+	for (size_t k = 0; k < impostor_fallbacks.size(); ++k) {
+		std::vector<float>& data = groups[impostor_fallbacks[k]];
+		// The first corner of each square has everything.
+		const float* d = &impostors[4*impostor_size*k];
+		tmatrix mwt;
+		mwt.w_column( vector( d[0], d[1], d[2]));
+		mwt.w_row();
+		mwt.scale( vector( d[3], d[3], d[3]));
+		for (size_t row = 0; row < 3; ++row)
+			for (size_t col = 0; col < 4; ++col)
+				data.push_back( mwt(row, col));
+		data.insert( data.end(), d + 4, d + 8);
+	}
+}
+
+bool
+instance_batch::gl_render_instanced( const view& v)
+{
+	if (!v.enable_shaders || !v.glext.ARB_shader_objects || !v.glext.ARB_vertex_shader
+		|| !v.glext.ARB_draw_instanced || !v.glext.ARB_instanced_arrays)
+		return false;
+
+	shader_program& program = shared_program( instance_program, instance_shader);
+	use_shader_program use( v, program);
+	if (!use.ok())
+		return false;
+
+	int loc[4];
+	for (size_t k = 0; k < 4; ++k)
+		if ((loc[k] = program.get_attribute_location( v, instance_attributes[k])) < 0)
+			return false;
+
+	int u;
+	if ((u = program.get_uniform_location( v, "light_count")) >= 0)
+		v.glext.glUniform1iARB( u, v.light_count[0]);
+	if ((u = program.get_uniform_location( v, "light_pos")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( u, v.light_count[0], &v.light_pos[0]);
+	if ((u = program.get_uniform_location( v, "light_color")) >= 0 && v.light_count[0])
+		v.glext.glUniform4fvARB( u, v.light_count[0], &v.light_color[0]);
+
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client normals( GL_NORMAL_ARRAY);
+	for (size_t k = 0; k < 4; ++k) {
+		v.glext.glEnableVertexAttribArrayARB( loc[k]);
+		v.glext.glVertexAttribDivisorARB( loc[k], 1);
+	}
+
+	for (groups_t::iterator i = groups.begin(); i != groups.end(); ++i) {
+		const mesh& m = *i->first;
+		const std::vector<float>& data = i->second;
+		if (data.empty())
+			continue;
+
+		glVertexPointer( 3, GL_FLOAT, 0, &m.pos[0]);
+		glNormalPointer( GL_FLOAT, 0, &m.normal[0]);
+		for (size_t k = 0; k < 4; ++k)
+			v.glext.glVertexAttribPointerARB( loc[k], 4, GL_FLOAT, GL_FALSE,
+				instance_size * sizeof(float), &data[4*k]);
+
+		if (m.cull_face)
+			glEnable( GL_CULL_FACE);
+		v.glext.glDrawElementsInstancedARB( GL_TRIANGLES, m.indices.size(),
+			GL_UNSIGNED_INT, &m.indices[0], data.size() / instance_size);
+		if (m.cull_face)
+			glDisable( GL_CULL_FACE);
+	}
+
+	for (size_t k = 0; k < 4; ++k) {
+		v.glext.glVertexAttribDivisorARB( loc[k], 0);
+		v.glext.glDisableVertexAttribArrayARB( loc[k]);
+	}
+	return true;
+}
+
+void
+instance_batch::gl_render_arrays( const view& v)
+{
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+	gl_enable_client normals( GL_NORMAL_ARRAY);
+
+	float matrix[16] = { 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,1 };
+	for (groups_t::iterator i = groups.begin(); i != groups.end(); ++i) {
+		const mesh& m = *i->first;
+		const std::vector<float>& data = i->second;
+		if (data.empty())
+			continue;
+
+		glVertexPointer( 3, GL_FLOAT, 0, &m.pos[0]);
+		glNormalPointer( GL_FLOAT, 0, &m.normal[0]);
+		if (m.cull_face)
+			glEnable( GL_CULL_FACE);
+
+		for (size_t j = 0; j < data.size(); j += instance_size) {
+			const float* d = &data[j];
+			// Transpose the rows into OpenGL's column-major order.
+			for (size_t row = 0; row < 3; ++row)
+				for (size_t col = 0; col < 4; ++col)
+					matrix[col*4 + row] = d[row*4 + col];
+			gl_matrix_stackguard guard;
+			glMultMatrixf( matrix);
+			glColor4fv( d + 12);
+			glDrawElements( GL_TRIANGLES, m.indices.size(), GL_UNSIGNED_INT, &m.indices[0]);
+		}
+
+		if (m.cull_face)
+			glDisable( GL_CULL_FACE);
+	}
+}
+
+} // !namespace cvisual
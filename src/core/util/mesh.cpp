@@ -0,0 +1,141 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/mesh.hpp"
+
+#include <cmath>
+
+namespace cvisual {
+
+namespace {
+const double pi = 3.14159265358979323846;
+} // !namespace (anonymous)
+
+mesh::mesh()
+	: cull_face(false)
+{
+}
+
+unsigned int
+mesh::add_vertex( float x, float y, float z, float nx, float ny, float nz)
+{
+	unsigned int ret = size();
+	pos.push_back(x);
+	pos.push_back(y);
+	pos.push_back(z);
+	normal.push_back(nx);
+	normal.push_back(ny);
+	normal.push_back(nz);
+	return ret;
+}
+
+void
+mesh::add_triangle( unsigned int a, unsigned int b, unsigned int c)
+{
+	indices.push_back(a);
+	indices.push_back(b);
+	indices.push_back(c);
+}
+
+void
+mesh::add_sphere( float radius, int slices, int stacks)
+{
+	// Rows of vertices run from the +z pole to the -z pole, like gluSphere().
+	const unsigned int base = size();
+	for (int i = 0; i <= stacks; ++i) {
+		double phi = pi * i / stacks;
+		double z = std::cos(phi), r = std::sin(phi);
+		for (int j = 0; j <= slices; ++j) {
+			double theta = 2*pi * j / slices;
+			double x = r*std::cos(theta), y = r*std::sin(theta);
+			add_vertex( radius*x, radius*y, radius*z, x, y, z);
+		}
+	}
+	const unsigned int row = slices + 1;
+	for (int i = 0; i < stacks; ++i) {
+		for (int j = 0; j < slices; ++j) {
+			unsigned int a = base + i*row + j;
+			unsigned int b = a + row;
+			// The triangles touching the poles are degenerate.
+			if (i != stacks-1)
+				add_triangle( a, b, b+1);
+			if (i != 0)
+				add_triangle( a, b+1, a+1);
+		}
+	}
+}
+
+void
+mesh::add_cylinder( float base_radius, float top_radius, float height,
+	int slices, int stacks)
+{
+	// The normal of a (possibly conical) tube has a constant component along
+	// the axis.
+	double nx = (base_radius - top_radius) / height;
+	double nr = 1.0 / std::sqrt( 1.0 + nx*nx);
+	nx *= nr;
+
+	const unsigned int base = size();
+	for (int s = 0; s <= stacks; ++s) {
+		double x = height * s / stacks;
+		double r = base_radius + (top_radius - base_radius) * s / stacks;
+		for (int j = 0; j <= slices; ++j) {
+			double theta = 2*pi * j / slices;
+			double c = std::cos(theta), d = std::sin(theta);
+			add_vertex( x, r*c, r*d, nx, nr*c, nr*d);
+		}
+	}
+	const unsigned int row = slices + 1;
+	for (int s = 0; s < stacks; ++s) {
+		bool apex = (s == stacks-1) && top_radius == 0;
+		for (int j = 0; j < slices; ++j) {
+			unsigned int a = base + s*row + j;
+			unsigned int b = a + row;
+			if (!apex)
+				add_triangle( a, b+1, b);
+			add_triangle( a, a+1, b+1);
+		}
+	}
+}
+
+void
+mesh::add_disk( float radius, int slices, int rings, float offset, float facing)
+{
+	const float n = facing > 0 ? 1.0f : -1.0f;
+	const unsigned int base = size();
+	for (int k = 0; k <= rings; ++k) {
+		double r = radius * k / rings;
+		for (int j = 0; j <= slices; ++j) {
+			double theta = 2*pi * j / slices;
+			add_vertex( offset, r*std::cos(theta), r*std::sin(theta), n, 0, 0);
+		}
+	}
+	const unsigned int row = slices + 1;
+	for (int k = 0; k < rings; ++k) {
+		for (int j = 0; j < slices; ++j) {
+			unsigned int a = base + k*row + j;
+			unsigned int b = a + row;
+			if (n > 0) {
+				add_triangle( a, b, b+1);
+				if (k != 0)
+					add_triangle( a, b+1, a+1);
+			}
+			else {
+				add_triangle( a, b+1, b);
+				if (k != 0)
+					add_triangle( a, a+1, b+1);
+			}
+		}
+	}
+}
+
+void
+mesh::clear()
+{
+	pos.clear();
+	normal.clear();
+	indices.clear();
+}
+
+} // !namespace cvisual
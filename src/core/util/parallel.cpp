@@ -0,0 +1,99 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/parallel.hpp"
+#include "util/thread.hpp"
+#include <threadpool.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+
+namespace cvisual {
+
+namespace {
+
+// Counts down the chunks still running for one call of parallel_for().  Each
+// call has its own, so that callers in different threads don't wait for each
+// other's work, as they would with pool::wait().
+struct latch
+{
+	mutex barrier;
+	boost::condition done;
+	size_t remaining;
+	boost::exception_ptr error; ///< The first exception thrown by a chunk.
+};
+
+// Call job( begin, end), and return what it throws, if anything.
+boost::exception_ptr
+call_chunk( const boost::function<void (size_t, size_t)>& job,
+	size_t begin, size_t end)
+{
+	try {
+		job( begin, end);
+	}
+	catch (...) {
+		return boost::current_exception();
+	}
+	return boost::exception_ptr();
+}
+
+void
+run_chunk( const boost::function<void (size_t, size_t)>& job,
+	size_t begin, size_t end, latch* chunks)
+{
+	boost::exception_ptr error = call_chunk( job, begin, end);
+	lock L(chunks->barrier);
+	if (error && !chunks->error)
+		chunks->error = error;
+	if (!--chunks->remaining)
+		chunks->done.notify_all();
+}
+
+mutex pool_barrier;
+boost::threadpool::pool* workers = NULL;
+
+} // !namespace (anonymous)
+
+void
+parallel_for( size_t n, size_t grain,
+	const boost::function<void (size_t, size_t)>& job)
+{
+	static const size_t processors = std::max( boost::thread::hardware_concurrency(), 1u);
+	const size_t chunks = std::min( processors, n / std::max( grain, (size_t)1));
+	if (chunks < 2) {
+		job( 0, n);
+		return;
+	}
+
+	{
+		lock L(pool_barrier);
+		// Like the pool for swapping buffers in render_manager, this lives
+		// until the program exits.
+		if (!workers)
+			workers = new boost::threadpool::pool( processors - 1);
+	}
+
+	latch pending;
+	pending.remaining = chunks - 1;
+	for (size_t k = 1; k < chunks; ++k)
+		workers->schedule( boost::bind( &run_chunk, boost::cref( job),
+			n*k/chunks, n*(k+1)/chunks, &pending));
+	// Every chunk must finish before pending and job go away, even if this
+	// one throws.
+	boost::exception_ptr error = call_chunk( job, 0, n/chunks);
+	{
+		lock L(pending.barrier);
+		while (pending.remaining)
+			pending.done.wait( L);
+		if (!error)
+			error = pending.error;
+	}
+	if (error)
+		boost::rethrow_exception( error);
+}
+
+} // !namespace cvisual
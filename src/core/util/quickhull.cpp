@@ -0,0 +1,222 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/quickhull.hpp"
+
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+namespace cvisual {
+
+quickhull::quickhull()
+	: hull_points(0), epsilon(0)
+{
+}
+
+void
+quickhull::clear()
+{
+	points.clear();
+	faces.clear();
+	hull_points = 0;
+}
+
+quickhull::face
+quickhull::make_face( size_t a, size_t b, size_t c) const
+{
+	face ret;
+	ret.corner[0] = a;
+	ret.corner[1] = b;
+	ret.corner[2] = c;
+	ret.normal = (points[b] - points[a]).cross( points[c] - points[a]).norm();
+	ret.d = ret.normal.dot( points[a]);
+	ret.removed = false;
+	return ret;
+}
+
+void
+quickhull::build()
+{
+	faces.clear();
+	const size_t count = points.size();
+	hull_points = count;
+	if (count < 3)
+		return;
+
+	double scale = 0;
+	for (size_t i = 0; i < count; ++i)
+		scale = std::max( scale, std::max( std::fabs(points[i].x),
+			std::max( std::fabs(points[i].y), std::fabs(points[i].z))));
+	epsilon = scale * 1e-12;
+
+	// Start from the largest triangle that is quick to find: the points
+	// farthest apart in x, and the point farthest from the line through them.
+	size_t a = 0, b = 0;
+	for (size_t i = 1; i < count; ++i) {
+		if (points[i].x < points[a].x) a = i;
+		if (points[i].x > points[b].x) b = i;
+	}
+	if (a == b)
+		b = (a + 1) % count;
+	size_t c = a;
+	double farthest = -1;
+	vector axis = (points[b] - points[a]).norm();
+	for (size_t i = 0; i < count; ++i) {
+		if (i == a || i == b)
+			continue;
+		vector offset = points[i] - points[a];
+		double dist = (offset - axis * offset.dot( axis)).mag2();
+		if (dist > farthest) {
+			farthest = dist;
+			c = i;
+		}
+	}
+
+	// The triangle and its reverse, each the neighbor of the other on every
+	// edge.
+	faces.push_back( make_face( a, b, c));
+	faces.push_back( make_face( a, c, b));
+	faces[0].neighbor[0] = faces[0].neighbor[1] = faces[0].neighbor[2] = 1;
+	faces[1].neighbor[0] = faces[1].neighbor[1] = faces[1].neighbor[2] = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (i == a || i == b || i == c)
+			continue;
+		for (size_t f = 0; f < 2; ++f)
+			if (faces[f].visible_from( points[i], epsilon)) {
+				faces[f].outside.push_back( i);
+				break;
+			}
+	}
+
+	// Quickhull: add the farthest point in front of each face until no face
+	// has any.  New faces are appended, so they are reached in turn.
+	for (size_t f = 0; f < faces.size(); ++f) {
+		if (faces[f].removed || faces[f].outside.empty())
+			continue;
+		size_t far = faces[f].outside[0];
+		double far_dist = -1;
+		for (size_t i = 0; i < faces[f].outside.size(); ++i) {
+			size_t p = faces[f].outside[i];
+			double dist = faces[f].normal.dot( points[p]) - faces[f].d;
+			if (dist > far_dist) {
+				far_dist = dist;
+				far = p;
+			}
+		}
+		add_point( far, f);
+	}
+	compact();
+}
+
+void
+quickhull::extend()
+{
+	if (faces.empty()) {
+		build();
+		return;
+	}
+	for (size_t p = hull_points; p < points.size(); ++p) {
+		for (size_t f = 0; f < faces.size(); ++f) {
+			if (!faces[f].removed && faces[f].visible_from( points[p], epsilon)) {
+				add_point( p, f);
+				break;
+			}
+		}
+		// Otherwise the point is inside the hull.
+	}
+	hull_points = points.size();
+	compact();
+}
+
+void
+quickhull::add_point( size_t p, size_t visible_face)
+{
+	const vector pv = points[p];
+
+	// The faces visible from p are connected; find them, and the horizon
+	// around them, by a search from one of them.  The edges of the horizon
+	// are kept with the hidden face across each.
+	std::vector<size_t> visible;
+	std::vector<size_t> stack( 1, visible_face);
+	std::vector<size_t> horizon; // a, b, hidden for each edge
+	faces[visible_face].removed = true;
+	while (!stack.empty()) {
+		size_t f = stack.back();
+		stack.pop_back();
+		visible.push_back( f);
+		for (int e = 0; e < 3; ++e) {
+			size_t n = faces[f].neighbor[e];
+			if (faces[n].removed)
+				continue;
+			if (faces[n].visible_from( pv, epsilon)) {
+				faces[n].removed = true;
+				stack.push_back( n);
+			}
+			else {
+				horizon.push_back( faces[f].corner[e]);
+				horizon.push_back( faces[f].corner[(e+1)%3]);
+				horizon.push_back( n);
+			}
+		}
+	}
+
+	// Cover the hole with a fan of faces from the horizon to p.  The face on
+	// the horizon edge from a to b is the neighbor across edge 1 of the one
+	// from the edge ending at a.
+	const size_t first_new = faces.size();
+	std::map<size_t, size_t> starting_at;
+	for (size_t h = 0; h < horizon.size(); h += 3) {
+		size_t a = horizon[h], b = horizon[h+1], hidden = horizon[h+2];
+		size_t k = faces.size();
+		faces.push_back( make_face( a, b, p));
+		faces[k].neighbor[0] = hidden;
+		for (int e = 0; e < 3; ++e)
+			if (faces[hidden].corner[e] == b && faces[hidden].corner[(e+1)%3] == a)
+				faces[hidden].neighbor[e] = k;
+		starting_at[a] = k;
+	}
+	for (size_t k = first_new; k < faces.size(); ++k) {
+		size_t next = starting_at[faces[k].corner[1]];
+		faces[k].neighbor[1] = next;
+		faces[next].neighbor[2] = k;
+	}
+
+	// Points in front of the removed faces are either in front of a new one,
+	// or inside the hull for good.
+	for (size_t v = 0; v < visible.size(); ++v) {
+		std::vector<size_t> outside;
+		outside.swap( faces[visible[v]].outside);
+		for (size_t i = 0; i < outside.size(); ++i) {
+			if (outside[i] == p)
+				continue;
+			for (size_t k = first_new; k < faces.size(); ++k)
+				if (faces[k].visible_from( points[outside[i]], epsilon)) {
+					faces[k].outside.push_back( outside[i]);
+					break;
+				}
+		}
+	}
+}
+
+void
+quickhull::compact()
+{
+	std::vector<size_t> moved( faces.size());
+	size_t kept = 0;
+	for (size_t f = 0; f < faces.size(); ++f) {
+		moved[f] = kept;
+		if (!faces[f].removed) {
+			if (kept != f)
+				std::swap( faces[kept], faces[f]);
+			++kept;
+		}
+	}
+	faces.resize( kept);
+	for (size_t f = 0; f < faces.size(); ++f)
+		for (int e = 0; e < 3; ++e)
+			faces[f].neighbor[e] = moved[faces[f].neighbor[e]];
+}
+
+} // !namespace cvisual
@@ -1,9 +1,18 @@
 #include "util/render_manager.hpp"
 #include "util/errors.hpp"
+#include "util/thread.hpp"
+#include "util/timer.hpp"
+#include "util/frame_scheduler.hpp"
 #include <threadpool.hpp>
 #include "display.hpp"
 
 #include <boost/python/detail/wrap_python.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <map>
 
 /* No longer used:
 #include <boost/python/import.hpp>
@@ -16,6 +25,94 @@ using boost::python::object;
 using boost::python::import;
 */
 
+namespace {
+
+// Paints and swaps one display, once for each frame that begin() releases it for.
+class render_thread : boost::noncopyable
+{
+ public:
+	render_thread( display* target )
+		: target( target), frame(0), finished(0), stopping(false), paint(0),
+		worker( boost::bind( &render_thread::run, this ))
+	{
+	}
+
+	~render_thread() {
+		{
+			lock L(barrier);
+			stopping = true;
+			wake.notify_all();
+		}
+		worker.join();
+	}
+
+	void begin() {
+		lock L(barrier);
+		++frame;
+		wake.notify_all();
+	}
+
+	// Waits until the frame released by begin() has been swapped, and returns
+	// how long it took to paint.  If painting or swapping it threw, that is
+	// thrown again here instead.
+	double end() {
+		lock L(barrier);
+		while (finished != frame)
+			done.wait( L);
+		if (error) {
+			boost::exception_ptr e = error;
+			error = boost::exception_ptr();
+			boost::rethrow_exception( e);
+		}
+		return paint;
+	}
+
+ private:
+	void run() {
+		timer time;
+		lock L(barrier);
+		while (true) {
+			while (!stopping && finished == frame)
+				wake.wait( L);
+			if (stopping)
+				return;
+
+			L.unlock();
+			double start = time.elapsed();
+			double painted = start;
+			boost::exception_ptr e;
+			// The frame must be finished even if it fails, or end() would wait
+			// for it forever.
+			try {
+				target->paint();
+				painted = time.elapsed();
+				target->swap();
+				target->end_frame( time.elapsed() - painted);
+			}
+			catch (...) {
+				e = boost::current_exception();
+			}
+			L.lock();
+
+			paint = painted - start;
+			error = e;
+			++finished;
+			done.notify_all();
+		}
+	}
+
+	display* target;
+	mutex barrier;
+	condition wake, done;
+	int frame, finished; //< The frames released, and the frames swapped.
+	bool stopping;
+	double paint;
+	boost::exception_ptr error; //< Thrown by the last frame, until end() rethrows it.
+	boost::thread worker; //< Last, so that it starts after the rest is initialized.
+};
+
+} // !namespace (anonymous)
+
 double render_manager::paint_displays( const std::vector< display* >& displays, bool swap_single_threaded ) {
 	// If there are no active displays, poll at a reasonable rate.  The platform driver
 	// may turn off polling in this situation, which is fine.
@@ -27,6 +124,7 @@ double render_manager::paint_displays( const std::vector< display* >& displays,
 	// Most of the time spent in paint() will be holding the lock, and most of the time
 	// holding the lock is spent in paint().  So we measure this time as an estimate of
 	// how long per cycle we are holding the lock.
+	render_schedule.begin_frame();
 	double start = time.elapsed();
 	for(size_t d=0; d<displays.size(); d++)
 		displays[d]->paint();
@@ -53,13 +151,10 @@ double render_manager::paint_displays( const std::vector< display* >& displays,
 	}
 	
 	double swap = time.elapsed() - (start+paint);
+	for(size_t d=0; d<displays.size(); d++)
+		displays[d]->end_frame( swap);
 	
-	// We want to be holding the lock about half the time, so the next rendering cycle
-	// should begin /paint/ seconds after painting finished /swap/ seconds ago.  The minimum
-	// of 5ms is to prevent absurd behavior if vertical retrace synchronization is disabled in
-	// the driver, and to ensure that we have some time for event handling if painting is instant.
-	double interval = std::max(.005, paint - swap);
-	if (paint+swap+interval < 0.03) interval = 0.03-paint-swap;
+	double interval = render_schedule.end_frame( paint, swap);
 	
 	#if 0  // for debugging
 	static double lasts = 0.0;
@@ -76,4 +171,55 @@ double render_manager::paint_displays( const std::vector< display* >& displays,
 	return interval;
 }
 
+double render_manager::paint_displays_threaded( const std::vector< display* >& displays ) {
+	typedef std::map< display*, render_thread* > threads_t;
+	static threads_t threads;
+	static timer time;
+
+	// Stop the threads of the displays that have closed since the last cycle.  None
+	// of them is between begin() and end(), so they are all waiting for a frame.
+	for (threads_t::iterator i = threads.begin(); i != threads.end(); ) {
+		if (std::find( displays.begin(), displays.end(), i->first ) == displays.end()) {
+			delete i->second;
+			threads.erase( i++ );
+		}
+		else
+			++i;
+	}
+
+	if (!displays.size()) return .030;
+
+	// Release every display at once, so that their swaps land on the same retrace,
+	// and wait for the slowest before starting the next cycle.  Painting happens at
+	// the same time in each thread, so the longest of them stands for the time spent
+	// holding the lock.
+	render_schedule.begin_frame();
+	double start = time.elapsed();
+	for(size_t d=0; d<displays.size(); d++) {
+		render_thread*& t = threads[ displays[d] ];
+		if (!t)
+			t = new render_thread( displays[d] );
+		t->begin();
+	}
+	// Every display must finish its frame before the next cycle releases it
+	// again, so the first failure is only rethrown once all have ended, as
+	// the painting in paint_displays() would have thrown it.
+	double paint = 0;
+	boost::exception_ptr error;
+	for(size_t d=0; d<displays.size(); d++) {
+		try {
+			paint = std::max( paint, threads[ displays[d] ]->end() );
+		}
+		catch (...) {
+			if (!error)
+				error = boost::current_exception();
+		}
+	}
+	if (error)
+		boost::rethrow_exception( error);
+	double swap = time.elapsed() - (start+paint);
+
+	return render_schedule.end_frame( paint, swap);
+}
+
 } // namespace cvisual
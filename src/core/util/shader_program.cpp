@@ -17,12 +17,22 @@ shader_program::~shader_program() {
 int shader_program::get_uniform_location( const view& v, const char* name ) {
 	// TODO: change interface to cache the uniforms we actually want and avoid string comparisons
 	if (program <= 0 || !v.glext.ARB_shader_objects) return -1;
+	lock L(barrier);
 	int& cache = uniforms[ name ];
 	if (cache == 0)
 		cache = 2 + v.glext.glGetUniformLocationARB( program, name );
 	return cache - 2;
 }
 
+int shader_program::get_attribute_location( const view& v, const char* name ) {
+	if (program <= 0 || !v.glext.ARB_vertex_shader) return -1;
+	lock L(barrier);
+	int& cache = attributes[ name ];
+	if (cache == 0)
+		cache = 2 + v.glext.glGetAttribLocationARB( program, name );
+	return cache - 2;
+}
+
 void shader_program::set_uniform_matrix( const view& v, int loc, const tmatrix& in ) {
 	float matrix[16];
 	const double* in_p = in.matrix_addr();
@@ -39,17 +49,20 @@ void shader_program::realize( const view& v ) {
 	if ( !v.glext.ARB_shader_objects )
 		return;
 
-	program = v.glext.glCreateProgramObjectARB();
+	lock L(gl_share_lock);
+	if (program != -1) return;
+
+	int handle = v.glext.glCreateProgramObjectARB();
 	check_gl_error();
 
-	compile( v, GL_VERTEX_SHADER_ARB, getSection("varying")+getSection("vertex") );
-	compile( v, GL_FRAGMENT_SHADER_ARB, getSection("varying")+getSection("fragment") );
+	compile( v, handle, GL_VERTEX_SHADER_ARB, getSection("varying")+getSection("vertex") );
+	compile( v, handle, GL_FRAGMENT_SHADER_ARB, getSection("varying")+getSection("fragment") );
 
-	v.glext.glLinkProgramARB( program );
+	v.glext.glLinkProgramARB( handle );
 
 	// Check if linking succeeded
 	GLint link_ok = 0;
-	v.glext.glGetObjectParameterivARB( program, GL_OBJECT_LINK_STATUS_ARB, &link_ok );
+	v.glext.glGetObjectParameterivARB( handle, GL_OBJECT_LINK_STATUS_ARB, &link_ok );
 
 	if ( !link_ok ) {
 		// Some drivers (incorrectly?) set the GL error in glLinkProgramARB() in this situation
@@ -59,9 +72,9 @@ void shader_program::realize( const view& v ) {
 		std::string infoLog;
 
 		GLint length = 0;
-		v.glext.glGetObjectParameterivARB( program, GL_OBJECT_INFO_LOG_LENGTH_ARB, &length );
+		v.glext.glGetObjectParameterivARB( handle, GL_OBJECT_INFO_LOG_LENGTH_ARB, &length );
 		boost::scoped_array<char> temp( new char[length+2] );
-		v.glext.glGetInfoLogARB( program, length+1, &length, &temp[0] );
+		v.glext.glGetInfoLogARB( handle, length+1, &length, &temp[0] );
 		infoLog.append( &temp[0], length );
 
 		// TODO: A way to report infoLog to the program?
@@ -70,21 +83,21 @@ void shader_program::realize( const view& v ) {
 		// Get rid of the program, since it can't be used without generating GL errors.  We set
 		//   program to 0 instead of -1 so that binding it will revert to the fixed function pipeline,
 		//   and realize() won't be called again.
-		v.glext.glDeleteObjectARB( program );
+		v.glext.glDeleteObjectARB( handle );
 		program = 0;
 		return;
 	}
 	check_gl_error();
 
 #ifdef __APPLE__
-	v.glext.glUseProgramObjectARB( program );
+	v.glext.glUseProgramObjectARB( handle );
 	GLint gpuVertexProcessing=0; // OS X 10.4 wants a long
 	CGLGetParameter(CGLGetCurrentContext(), kCGLCPGPUVertexProcessing, &gpuVertexProcessing);
 	v.glext.glUseProgramObjectARB( 0 );
 	// gpuVertexProcessing=1 on MacBook Pro (GeForce); gpuVertexProcessing=0 on MacBook (no graphics)
 	if (!gpuVertexProcessing) {
 		write_stderr("Shader would be emulated in software; disabling.\n");
-		v.glext.glDeleteObjectARB( program );
+		v.glext.glDeleteObjectARB( handle );
 		program = 0;
 		return;
 	}
@@ -94,16 +107,17 @@ void shader_program::realize( const view& v ) {
 	// since they might run in a different context, even though the program _handle_ is shared.  Plus
 	// this is kind of ugly.
 	glDeleteObjectARB = v.glext.glDeleteObjectARB;
-	on_gl_free.connect( boost::bind( &shader_program::gl_free, v.glext.glDeleteObjectARB, program ) );
+	on_gl_free.connect( boost::bind( &shader_program::gl_free, v.glext.glDeleteObjectARB, handle ) );
+	program = handle;
 }
 
-void shader_program::compile( const view& v, int type, const std::string& source ) {
+void shader_program::compile( const view& v, int handle, int type, const std::string& source ) {
 	int shader = v.glext.glCreateShaderObjectARB( type );
 	const char* str = source.c_str();
 	GLint len = source.size();
 	v.glext.glShaderSourceARB( shader, 1, &str, &len );
 	v.glext.glCompileShaderARB( shader );
-	v.glext.glAttachObjectARB( program, shader );
+	v.glext.glAttachObjectARB( handle, shader );
 	v.glext.glDeleteObjectARB( shader );
 }
 
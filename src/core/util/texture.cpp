@@ -36,11 +36,15 @@ texture::enable_type() const {
 void
 texture::gl_activate(const view& v)
 {
-	damage_check();
-	if (damaged) {
-		gl_init(v);
-		damaged = false;
-		check_gl_error();
+	{
+		// The same texture may be used by displays rendering in different threads.
+		lock L(gl_share_lock);
+		damage_check();
+		if (damaged) {
+			gl_init(v);
+			damaged = false;
+			check_gl_error();
+		}
 	}
 	if (!handle) return;
 	
@@ -0,0 +1,85 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "util/vertex_buffer.hpp"
+#include "util/gl_free.hpp"
+#include "renderable.hpp"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+namespace cvisual {
+
+vertex_buffer::vertex_buffer( GLenum t)
+	: target(t), handle(0), capacity(0), glDeleteBuffersARB(0)
+{
+}
+
+vertex_buffer::vertex_buffer( const vertex_buffer& other)
+	: target(other.target), handle(0), capacity(0), glDeleteBuffersARB(0)
+{
+}
+
+vertex_buffer::~vertex_buffer()
+{
+	if (handle)
+		on_gl_free.free( boost::bind( &vertex_buffer::gl_free, glDeleteBuffersARB, handle));
+}
+
+void
+vertex_buffer::gl_free( PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB, GLuint handle)
+{
+	glDeleteBuffersARB( 1, &handle);
+}
+
+bool
+vertex_buffer::reserve( const view& v, size_t size)
+{
+	if (handle && size <= capacity)
+		return false;
+	if (!handle) {
+		v.glext.glGenBuffersARB( 1, &handle);
+		// See the TODO in shader_program::realize() about calling extension
+		// functions from on_gl_free callbacks.
+		glDeleteBuffersARB = v.glext.glDeleteBuffersARB;
+		on_gl_free.connect( boost::bind( &vertex_buffer::gl_free, glDeleteBuffersARB, handle));
+	}
+	// Grow geometrically, so that appending a point at a time is amortized.
+	capacity = std::max( size, 2*capacity);
+	v.glext.glBindBufferARB( target, handle);
+	// Floats and GLuints are the same size.
+	v.glext.glBufferDataARB( target, capacity * sizeof(float), 0,
+		GL_STATIC_DRAW_ARB);
+	v.glext.glBindBufferARB( target, 0);
+	return true;
+}
+
+void
+vertex_buffer::upload( const view& v, size_t offset, size_t size, const float* data)
+{
+	v.glext.glBindBufferARB( target, handle);
+	v.glext.glBufferSubDataARB( target, offset * sizeof(float),
+		size * sizeof(float), data);
+	v.glext.glBindBufferARB( target, 0);
+}
+
+void
+vertex_buffer::upload( const view& v, size_t offset, size_t size, const GLuint* data)
+{
+	upload( v, offset, size, reinterpret_cast<const float*>(data));
+}
+
+void
+vertex_buffer::gl_bind( const view& v)
+{
+	v.glext.glBindBufferARB( target, handle);
+}
+
+void
+vertex_buffer::gl_unbind( const view& v, GLenum target)
+{
+	v.glext.glBindBufferARB( target, 0);
+}
+
+} // !namespace cvisual
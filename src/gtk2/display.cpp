@@ -400,6 +400,7 @@ int NumberOfExtensions;
 
 ////////////////////////////////// gui_main implementation ////////////////////
 gui_main* gui_main::self = 0;
+bool gui_main::render_threads_started = false;
 mutex* gui_main::init_lock = 0;
 condition* gui_main::init_signal = 0;
 
@@ -432,7 +433,10 @@ gui_main::poll()
 	if (shutting_down) return false;
 
 
-	int interval = (int)(1000 * render_manager::paint_displays( displays, true ));
+	double seconds = render_threads_started
+		? render_manager::paint_displays_threaded( displays )
+		: render_manager::paint_displays( displays, true );
+	int interval = (int)(1000 * seconds);
 
 	Glib::signal_timeout().connect( sigc::mem_fun( *this, &gui_main::poll), interval, Glib::PRIORITY_HIGH_IDLE);
 	return false; // We connect a new timeout every time, so we don't want this timeout to repeat
@@ -446,6 +450,12 @@ gui_main::thread_proc(void)
 	assert( !self);
 	{
 		lock L(*init_lock);
+		// Xlib must be told before anything else uses it that it will be called
+		// from several threads, so this can't be changed once the first display
+		// has been opened.
+		render_threads_started = display::render_threads;
+		if (render_threads_started)
+			XInitThreads();
 		self = new gui_main();
 		init_signal->notify_all();
 	}
@@ -73,7 +73,11 @@ bool font_renderer::ok() {
 	return (bool)ft2_context;
 }
 
-void font_renderer::gl_render_to_texture( const view&, const wstring& text, layout_texture& tx ) {
+bool font_renderer::composable() {
+	return true;
+}
+
+void font_renderer::gl_render_to_texture( const view&, const wstring& text, text_image& tx ) {
 	// Lay out text
 	Glib::RefPtr<Pango::Layout> pango_layout = Pango::Layout::create( ft2_context);
 
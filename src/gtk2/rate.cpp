@@ -9,6 +9,7 @@
 
 #include <math.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <stdexcept>
 
@@ -81,24 +82,19 @@ rate_timer::delay( double _delay)
 	// OSX's nanosleep() is very accurate :)
 	timespec sleep_wait( wait);
 	nanosleep( &sleep_wait, &remaining);
+	gettimeofday( &this->origin, 0);
 #else
 	// Computation of the requested delay is the same, but the execution differs
-	// from OSX.  This is to provide somewhat more accurate timing on Linux, 
-	// whose timing is abominable.
-	if (wait > 2000) {
-		timespec sleep_wait(wait);
-		nanosleep( &sleep_wait, &remaining);
-	}
-	else {
-		// Busy wait out the remainder of the time.
-		while (wait > 0) {
-			sched_yield();
-			gettimeofday( &now, 0);
-			wait = delay - ((long long)now - origin);
-		}
-	}
+	// from OSX.  Sleeping until the deadline itself, rather than for the time
+	// remaining, is accurate with the high resolution timers of current kernels,
+	// without busy waiting.  The next deadline follows on from this one rather
+	// than from when we woke up, so that lateness in waking doesn't add up.
+	timespec deadline( origin + delay);
+	while (clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, &deadline, &remaining) == EINTR)
+		;
+	this->origin.tv_sec = deadline.tv_sec;
+	this->origin.tv_usec = deadline.tv_nsec / 1000;
 #endif // !defined __APPLE__
-	gettimeofday( &this->origin, 0);
 }
 
 } // !namespace (unnamed)
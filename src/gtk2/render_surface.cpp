@@ -18,6 +18,7 @@
 #include <gtkmm/gl/init.h>
 #include <gdkmm/gl/pixmap.h>
 #include <gdkmm/gl/pixmapext.h>
+#include <GL/glx.h>
 
 #include <gdkmm/pixmap.h>
 #include <gdkmm/pixbuf.h>
@@ -44,6 +45,12 @@ namespace cvisual {
 
 namespace {
 	Glib::RefPtr<Gdk::GL::Context> share_list;
+
+	// GDK is not thread safe, but with display_kernel::render_threads each
+	// render_surface makes its context current and swaps in a thread of its
+	// own.  The gui thread is waiting for them meanwhile, so only they need to
+	// be kept apart.
+	mutex gdk_barrier;
 }
 
 render_surface::render_surface( display_kernel& _core, mouse_manager& _mouse, bool activestereo)
@@ -181,7 +188,6 @@ render_surface::paint(Gtk::Window* window, bool change, bool vis) // if change,
 {
 	gl_begin();
 	{
-		python::gil_lock L;
 		if (change and !vis) {
 			std::cerr << "cursor.visible = 0 is not yet supported on Linux." << std::endl;
 		}
@@ -199,7 +205,7 @@ render_surface::paint(Gtk::Window* window, bool change, bool vis) // if change,
 			}
 		}
 		*/
-		core.render_scene(); // render the scene
+		core.render_scene(); // render the scene; acquires the GIL only as needed
 	}
 	gl_end();
 }
@@ -232,6 +238,7 @@ render_surface::on_button_release_event( GdkEventButton* event)
 void
 render_surface::gl_begin()
 {
+	lock L(gdk_barrier);
 	bool ok = get_gl_window()->gl_begin(get_gl_context());
 	assert(ok);
 }
@@ -239,6 +246,7 @@ render_surface::gl_begin()
 void
 render_surface::gl_end()
 {
+	lock L(gdk_barrier);
 	get_gl_window()->gl_end();
 }
 
@@ -246,9 +254,18 @@ void
 render_surface::gl_swap_buffers()
 {
 	gl_begin();
-	get_gl_window()->swap_buffers();
+	{
+		lock L(gdk_barrier);
+		get_gl_window()->swap_buffers();
+	}
 	glFinish(); 	// Ensure rendering completes here (without the GIL) rather than at the next paint (with the GIL)
 	gl_end();
+	if (core.render_threads) {
+		// Let go of the context, so that it can be destroyed along with the
+		// window from the gui thread.
+		lock L(gdk_barrier);
+		glXMakeCurrent( glXGetCurrentDisplay(), None, NULL);
+	}
 }
 
 } // !namespace cvisual
@@ -0,0 +1,216 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "headless/offscreen_display.hpp"
+#include "util/errors.hpp"
+#include "util/thread.hpp"
+#include "python/gil.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace cvisual {
+
+namespace {
+
+// The EGL display and the context shared by every offscreen_display.  They
+// are made by the first one to be activated, and are never destroyed, since
+// the models of the primitives live in the context until the program exits.
+mutex egl_barrier;
+EGLDisplay egl_display = EGL_NO_DISPLAY;
+EGLConfig egl_config = 0;
+EGLContext egl_context = EGL_NO_CONTEXT;
+
+bool
+has_client_extension( const char* name)
+{
+	const char* all = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (!all)
+		return false;
+	const size_t len = std::strlen( name);
+	for (const char* at = std::strstr( all, name); at; at = std::strstr( at + len, name))
+		if ((at == all || at[-1] == ' ') && (at[len] == ' ' || at[len] == '\0'))
+			return true;
+	return false;
+}
+
+void
+init_egl()
+{
+	lock L(egl_barrier);
+	if (egl_context != EGL_NO_CONTEXT)
+		return;
+
+	// The default display needs a window system on some drivers, Mesa's in
+	// particular; its surfaceless platform does not.
+	EGLint major, minor;
+	egl_display = eglGetDisplay( EGL_DEFAULT_DISPLAY);
+	if ((egl_display == EGL_NO_DISPLAY || !eglInitialize( egl_display, &major, &minor))
+			&& has_client_extension( "EGL_MESA_platform_surfaceless")
+			&& has_client_extension( "EGL_EXT_platform_base")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT");
+		egl_display = eglGetPlatformDisplayEXT
+			? eglGetPlatformDisplayEXT( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0)
+			: EGL_NO_DISPLAY;
+		if (egl_display != EGL_NO_DISPLAY && !eglInitialize( egl_display, &major, &minor))
+			egl_display = EGL_NO_DISPLAY;
+	}
+	if (egl_display == EGL_NO_DISPLAY)
+		throw std::runtime_error( "Could not initialize EGL for offscreen rendering.");
+	VPYTHON_NOTE( "Initialized EGL for offscreen rendering.");
+
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLint n_configs = 0;
+	if (!eglChooseConfig( egl_display, config_attribs, &egl_config, 1, &n_configs)
+			|| n_configs < 1)
+		throw std::runtime_error( "EGL has no configuration for offscreen OpenGL rendering.");
+	if (!eglBindAPI( EGL_OPENGL_API))
+		throw std::runtime_error( "EGL does not support desktop OpenGL.");
+	egl_context = eglCreateContext( egl_display, egl_config, EGL_NO_CONTEXT, 0);
+	if (egl_context == EGL_NO_CONTEXT)
+		throw std::runtime_error( "Could not create an EGL context for offscreen rendering.");
+}
+
+} // !namespace (anonymous)
+
+offscreen_display::offscreen_display()
+	: surface(EGL_NO_SURFACE)
+{
+	windowless = true;
+}
+
+offscreen_display::~offscreen_display()
+{
+	if (surface != EGL_NO_SURFACE) {
+		eglMakeCurrent( egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroySurface( egl_display, surface);
+	}
+}
+
+void
+offscreen_display::make_current()
+{
+	if (!eglMakeCurrent( egl_display, surface, surface, egl_context))
+		throw std::runtime_error( "Could not make the offscreen display current.");
+}
+
+void
+offscreen_display::draw()
+{
+	// Frames being recorded may have to wait for the writer, which may need
+	// the GIL to pass them to Python.
+	python::gil_release nogil;
+	make_current();
+	if (!render_scene())
+		throw std::runtime_error( "Could not render the offscreen display.");
+	// There is no buffer to swap; flushing stands in for it.
+	glFlush();
+	end_frame( 0);
+}
+
+void
+offscreen_display::activate( bool active)
+{
+	if (active) {
+		VPYTHON_NOTE( "Opening an offscreen display.");
+		init_egl();
+		const EGLint surface_attribs[] = {
+			EGL_WIDTH, window_width,
+			EGL_HEIGHT, window_height,
+			EGL_NONE
+		};
+		surface = eglCreatePbufferSurface( egl_display, egl_config, surface_attribs);
+		if (surface == EGL_NO_SURFACE)
+			throw std::runtime_error( "Could not create an offscreen surface.");
+		report_window_resize( 0, 0, window_width, window_height);
+		report_view_resize( window_width, window_height);
+		// set_visible() waits for the display to be realized, which happens
+		// in the first frame; with no window system to draw it, draw it now.
+		draw();
+	}
+	else {
+		VPYTHON_NOTE( "Closing an offscreen display.");
+		if (surface != EGL_NO_SURFACE) {
+			python::gil_release nogil;
+			make_current();
+			flush_frames();
+			eglMakeCurrent( egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroySurface( egl_display, surface);
+			surface = EGL_NO_SURFACE;
+		}
+		report_closed();
+	}
+}
+
+display_kernel::EXTENSION_FUNCTION
+offscreen_display::getProcAddress( const char* name)
+{
+	return (EXTENSION_FUNCTION)eglGetProcAddress( name);
+}
+
+void
+offscreen_display::render()
+{
+	if (!visible)
+		set_visible( true);
+	draw();
+}
+
+shared_ptr<frame_image>
+offscreen_display::capture()
+{
+	if (!visible)
+		set_visible( true);
+	request_capture();
+	draw();
+	{
+		python::gil_release nogil;
+		make_current();
+		flush_frames();
+	}
+	shared_ptr<frame_image> ret = take_capture();
+	if (!ret)
+		throw std::runtime_error( "Could not read back the offscreen display.");
+	return ret;
+}
+
+void
+offscreen_display::stop_recording()
+{
+	// The frames still in the pixel buffers can be read here and now, rather
+	// than waiting for another frame to be drawn.
+	if (surface != EGL_NO_SURFACE) {
+		python::gil_release nogil;
+		make_current();
+		flush_frames();
+	}
+	display_kernel::stop_recording();
+}
+
+void
+offscreen_display::set_output( const std::string& kind, const std::string& target)
+{
+	record( frame_sink::create( kind, target));
+}
+
+void
+offscreen_display::close_output()
+{
+	stop_recording();
+}
+
+} // !namespace cvisual
@@ -82,8 +82,8 @@ void display::paint() {
 				HideCursor();
 			}
 		}
-		render_scene();
 	}
+	render_scene(); // acquires the GIL only as needed
 
 	gl_end();
 }
@@ -55,7 +55,12 @@ bool font_renderer::ok() {
 font_renderer::~font_renderer() {
 }
 
-void font_renderer::gl_render_to_texture( const view&, const std::wstring& text, layout_texture& tx ) {
+bool font_renderer::composable() {
+	// The images are cropped to the ink of the text, so a space has none.
+	return false;
+}
+
+void font_renderer::gl_render_to_texture( const view&, const std::wstring& text, text_image& tx ) {
 	std::vector< unsigned short > text_16;
 	static int pfactor = 65536;
 	if (!ucs4_to_utf16( text, text_16 ))
@@ -8,13 +8,30 @@ using boost::python::make_tuple;
 using boost::python::tuple;
 
 template <class CTYPE>
-arrayprim_array<CTYPE>::arrayprim_array()
- : array(NULL), length(0), allocated(256)
+arrayprim_array<CTYPE>::arrayprim_array( size_t c )
+ : array(NULL), storage(NULL), columns(c), start(0), length(0), allocated(256), dirty(0, 1)
 {
 	std::vector<npy_intp> dims(2);
 	dims[0] = allocated;
-	dims[1] = 3;
-	array::operator=( makeNum( dims, (NPY_TYPES)type_npy_traits<CTYPE>::npy_type ) );
+	dims[1] = columns;
+	storage = makeNum( dims, (NPY_TYPES)type_npy_traits<CTYPE>::npy_type );
+	set_start(0);
+}
+
+template <class CTYPE>
+arrayprim_array<CTYPE>::arrayprim_array( const arrayprim_array& r )
+ : array(NULL), storage(object(r)), columns(r.columns), start(0), length(r.length),
+	allocated(r.allocated - r.start), dirty(0, r.length)
+{
+	set_start(0);
+}
+
+template <class CTYPE>
+void arrayprim_array<CTYPE>::set_start( size_t new_start ) {
+	using cvisual::python::slice;
+
+	start = new_start;
+	array::operator=( boost::python::extract<array>( storage[ slice( start, allocated ) ] )() );
 }
 
 template <class CTYPE>
@@ -23,42 +40,86 @@ void arrayprim_array<CTYPE>::set_length( size_t new_len ) {
 
 	size_t old_len = length;
 
-	if (new_len < old_len ) {
-		// Shrink, keeping the last points (for retain)
-		//(*this)[ slice(0,new_len) ] = (*this)[ slice(old_len-new_len,old_len) ];
-		// Avoid array operations because they release the lock.
-		memmove( data(0), data(old_len-new_len), sizeof(CTYPE) * new_len * 3 );
+	if (new_len < old_len && new_len) {
+		// Shrink, keeping the last points (for retain).  Rather than moving
+		// them down, move the start of the array up to them.
+		set_start( start + old_len - new_len );
 	}
 	if (!old_len && allocated) old_len = 1;  // The very first point is meaningful even when length is 0; that's how an empty curve can have a color
 
-	if (new_len > allocated) {
-		// Expand allocated size, keeping old_len points
-		std::vector<npy_intp> dims(2);
-		dims[0] = 2*(new_len-1);
-		dims[1] = 3;
-
-		array n_arr = makeNum( dims, (NPY_TYPES)type_npy_traits<CTYPE>::npy_type );
-		std::memcpy( cvisual::python::data(n_arr), data(0), sizeof(CTYPE) * old_len * dims[1] );
-		array::operator=( n_arr ); // doesn't actually copy
-
-		allocated = dims[0];
+	if (start + new_len > allocated) {
+		if (2*new_len > allocated) {
+			// Expand allocated size, keeping old_len points
+			std::vector<npy_intp> dims(2);
+			dims[0] = 2*new_len;
+			dims[1] = columns;
+
+			array n_arr = makeNum( dims, (NPY_TYPES)type_npy_traits<CTYPE>::npy_type );
+			std::memcpy( cvisual::python::data(n_arr), data(0), sizeof(CTYPE) * old_len * dims[1] );
+			storage = n_arr; // doesn't actually copy
+
+			allocated = dims[0];
+		}
+		else {
+			// Move the points back to the beginning of the storage.  At least
+			// half of it is free afterwards, so this is amortized over at
+			// least as many points added as are moved.
+			// Avoid array operations because they release the lock.
+			memmove( cvisual::python::data(storage), data(0), sizeof(CTYPE) * old_len * columns );
+		}
+		set_start(0);
+		mark_dirty( 0, old_len );
 	}
 
 	if (new_len > old_len) {
-		// Broadcast the last meaningful point over the new points
-		(*this)[ slice( old_len, new_len ) ] = (*this)[ slice( old_len-1, old_len ) ];
+		// Broadcast the last meaningful point over the new points.  The rows
+		// are contiguous, so copy them directly: a numpy slice assignment
+		// costs more than all the rest of append(), which trails call every
+		// time an object moves.
+		const CTYPE* last = data( old_len-1 );
+		for (size_t i = old_len; i < new_len; ++i)
+			std::memcpy( data(i), last, sizeof(CTYPE) * columns );
+		mark_dirty( old_len, new_len );
 	}
 
 	length = new_len;
 }
 
+template <class CTYPE>
+bool arrayprim_array<CTYPE>::take_dirty( size_t& begin, size_t& end ) {
+	if (exposed())
+		mark_dirty( 0, length );
+	if (!dirty.take( begin, end, start + length ))
+		return false;
+	begin = std::max( begin, start );
+	return begin < end;
+}
+
 template class arrayprim_array<double>;
 template class arrayprim_array<float>;
 
+void upload_points( const view& v, const arrayprim_array<double>& array,
+	size_t begin, size_t end, vertex_buffer& buffer )
+{
+	const size_t first = array.offset();
+	const size_t last = first + array.size();
+	if (buffer.reserve( v, 3*last )) {
+		begin = first;
+		end = last;
+	}
+	begin = std::max( begin, first );
+	end = std::min( end, last );
+	if (begin >= end)
+		return;
+
+	std::vector<float> tmp( array.data(begin - first), array.data(end - first) );
+	buffer.upload( v, 3*begin, tmp.size(), &tmp[0] );
+}
+
 ////////////////////////////////
 
 arrayprim::arrayprim()
-: count(0)
+: count(0), pos_exposed(false)
 {
 	double* pos_i = pos.data(0);
 	for(int i=0; i<3; i++) pos_i[i] = 0;
@@ -67,12 +128,25 @@ arrayprim::arrayprim()
 void arrayprim::set_length( size_t new_len ) {
 	pos.set_length(new_len);
 	count = new_len;
+	extent_changed();
 }
 
 object arrayprim::get_pos() {
+	pos_exposed = true;
+	pos.mark_dirty();
 	return pos[all()];
 }
 
+unsigned long arrayprim::extent_version() {
+	// Python can change pos in place through the array returned by
+	// get_pos(), for as long as it holds that array or any view of it, and
+	// every such view holds a reference to pos.
+	if (pos_exposed || pos.exposed())
+		extent_changed();
+	pos_exposed = false;
+	return extent_serial;
+}
+
 void arrayprim::set_pos( const double_array& n_pos )
 {
 	std::vector<npy_intp> dims = shape( n_pos );
@@ -88,11 +162,13 @@ void arrayprim::set_pos( const double_array& n_pos )
 		set_length( dims[0] );
 		pos[make_tuple(all(), slice(0,2))] = n_pos;
 		pos[make_tuple(all(), 2)] = 0.0;
+		pos.mark_dirty();
 		return;
 	}
 	else if (dims[1] == 3) {
 		set_length( dims[0] );
 		pos[all()] = n_pos;
+		pos.mark_dirty();
 		return;
 	}
 	else {
@@ -103,6 +179,7 @@ void arrayprim::set_pos( const double_array& n_pos )
 void arrayprim::set_pos_v( const vector& npos ) {
 	set_length(1);
 	pos[all()] = npos;
+	pos.mark_dirty();
 }
 
 void arrayprim::set_x( const double_array& arg )
@@ -110,6 +187,7 @@ void arrayprim::set_x( const double_array& arg )
 	if (shape(arg).size() != 1) throw std::invalid_argument("x must be a 1D array.");
 	set_length( shape(arg)[0] );
 	pos[make_tuple( all(), 0)] = arg;
+	pos.mark_dirty();
 }
 
 void arrayprim::set_y( const double_array& arg )
@@ -117,6 +195,7 @@ void arrayprim::set_y( const double_array& arg )
 	if (shape(arg).size() != 1) throw std::invalid_argument("y must be a 1D array.");
 	set_length( shape(arg)[0] );
 	pos[make_tuple( all(), 1)] = arg;
+	pos.mark_dirty();
 }
 
 void arrayprim::set_z( const double_array& arg )
@@ -124,24 +203,31 @@ void arrayprim::set_z( const double_array& arg )
 	if (shape(arg).size() != 1) throw std::invalid_argument("z must be a 1D array.");
 	set_length( shape(arg)[0] );
 	pos[make_tuple( all(), 2)] = arg;
+	pos.mark_dirty();
 }
 
 void arrayprim::set_x_d( const double x)
 {
 	if (!count)	set_length(1);
 	pos[make_tuple( all(), 0)] = x;
+	pos.mark_dirty();
+	extent_changed();
 }
 
 void arrayprim::set_y_d( const double y)
 {
 	if (!count)	set_length(1);
 	pos[make_tuple( all(), 1)] = y;
+	pos.mark_dirty();
+	extent_changed();
 }
 
 void arrayprim::set_z_d( const double z)
 {
 	if (!count)	set_length(1);
 	pos[make_tuple( all(), 2)] = z;
+	pos.mark_dirty();
+	extent_changed();
 }
 
 void arrayprim::append( const vector& npos, int retain )
@@ -155,6 +241,7 @@ void arrayprim::append( const vector& npos, int retain )
 	last_pos[0] = npos.x;
 	last_pos[1] = npos.y;
 	last_pos[2] = npos.z;
+	pos.mark_dirty( count-1, count );
 }
 
 ////////////////////////////////
@@ -170,6 +257,7 @@ void arrayprim_color::set_length( size_t new_len ) {
 }
 
 object arrayprim_color::get_color() {
+	color.mark_dirty();
 	return color[all()];
 }
 
@@ -180,12 +268,14 @@ void arrayprim_color::set_color( const double_array& n_color)
 		// A single color, broadcast across the entire (used) array.
 		int npoints = (count) ? count : 1;
 		color[slice( 0, npoints)] = n_color;
+		color.mark_dirty( 0, npoints );
 		return;
 	}
 	if (dims.size() == 2 && dims[1] == 3) {
 		// An RGB chunk of color
 		set_length(dims[0]);
 		color[all()] = n_color;
+		color.mark_dirty();
 		return;
 	}
 	throw std::invalid_argument( "color must be an Nx3 array");
@@ -196,6 +286,7 @@ void arrayprim_color::set_red( const double_array& arg )
 	if (shape(arg).size() != 1) throw std::invalid_argument("red must be a 1D array.");
 	set_length( shape(arg)[0] );
 	color[make_tuple( all(), 0)] = arg;
+	color.mark_dirty();
 }
 
 void arrayprim_color::set_green( const double_array& arg )
@@ -203,6 +294,7 @@ void arrayprim_color::set_green( const double_array& arg )
 	if (shape(arg).size() != 1) throw std::invalid_argument("green must be a 1D array.");
 	set_length( shape(arg)[0] );
 	color[make_tuple( all(), 1)] = arg;
+	color.mark_dirty();
 }
 
 void arrayprim_color::set_blue( const double_array& arg )
@@ -210,24 +302,28 @@ void arrayprim_color::set_blue( const double_array& arg )
 	if (shape(arg).size() != 1) throw std::invalid_argument("blue must be a 1D array.");
 	set_length( shape(arg)[0] );
 	color[make_tuple( all(), 2)] = arg;
+	color.mark_dirty();
 }
 
 void arrayprim_color::set_red_d( const double arg )
 {
 	int npoints = count ? count : 1;
 	color[make_tuple(slice(0,npoints), 0)] = arg;
+	color.mark_dirty( 0, npoints );
 }
 
 void arrayprim_color::set_green_d( const double arg )
 {
 	int npoints = count ? count : 1;
 	color[make_tuple(slice(0,npoints), 1)] = arg;
+	color.mark_dirty( 0, npoints );
 }
 
 void arrayprim_color::set_blue_d( const double arg )
 {
 	int npoints = count ? count : 1;
 	color[make_tuple(slice(0,npoints), 2)] = arg;
+	color.mark_dirty( 0, npoints );
 }
 
 void arrayprim_color::append( const vector& npos, const rgb& ncolor, int retain )
@@ -237,6 +333,7 @@ void arrayprim_color::append( const vector& npos, const rgb& ncolor, int retain
 	last_color[0] = ncolor.red;
 	last_color[1] = ncolor.green;
 	last_color[2] = ncolor.blue;
+	color.mark_dirty( count-1, count );
 }
 
 void arrayprim_color::append_rgb( const vector& npos, double red, double green, double blue, int retain)
@@ -246,6 +343,7 @@ void arrayprim_color::append_rgb( const vector& npos, double red, double green,
 	if (red != -1) last_color[0] = red;
 	if (green != -1) last_color[1] = green;
 	if (blue != -1)	last_color[2] = blue;
+	color.mark_dirty( count-1, count );
 }
 
 } } // namespace cvisual::python
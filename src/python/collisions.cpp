@@ -0,0 +1,252 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "python/collisions.hpp"
+#include "python/gil.hpp"
+#include "util/parallel.hpp"
+
+#include <boost/python/def.hpp>
+#include <boost/python/args.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace cvisual {
+namespace python {
+
+namespace {
+
+// The coordinates of a cell of the grid.
+struct cell
+{
+	boost::int64_t x, y, z;
+
+	cell() : x(0), y(0), z(0) {}
+	cell( boost::int64_t x_, boost::int64_t y_, boost::int64_t z_)
+		: x(x_), y(y_), z(z_) {}
+
+	bool operator<( const cell& rhs) const
+	{
+		if (x != rhs.x)
+			return x < rhs.x;
+		if (y != rhs.y)
+			return y < rhs.y;
+		return z < rhs.z;
+	}
+	bool operator==( const cell& rhs) const
+	{
+		return x == rhs.x && y == rhs.y && z == rhs.z;
+	}
+};
+
+struct entry
+{
+	cell where;
+	size_t index;
+
+	bool operator<( const entry& rhs) const
+	{
+		if (where == rhs.where)
+			return index < rhs.index;
+		return where < rhs.where;
+	}
+};
+
+// The spheres sorted into cells of a uniform grid.  The cells are as wide as
+// the largest sphere, so that overlapping spheres are always in the same or
+// neighboring cells.
+class sphere_grid
+{
+ public:
+	sphere_grid( const double* pos, const double* radius, size_t radius_stride,
+		size_t n);
+
+	// Append the collisions (i, j) with begin <= i < end and i < j to out.
+	void collide( size_t begin, size_t end, std::vector<npy_intp>* out) const;
+
+ private:
+	const double* pos;
+	const double* radius;
+	size_t radius_stride;
+	size_t n;
+	double width;
+
+	std::vector<entry> entries; ///< Sorted by cell.
+	std::vector<cell> cells; ///< The distinct cells, sorted.
+	std::vector<size_t> cell_begin; ///< The first entry of each cell, and one more.
+
+	cell cell_of( size_t i) const
+	{
+		const double* p = pos + 3*i;
+		return cell( (boost::int64_t)std::floor( p[0] / width),
+			(boost::int64_t)std::floor( p[1] / width),
+			(boost::int64_t)std::floor( p[2] / width));
+	}
+	double radius_of( size_t i) const { return radius[i*radius_stride]; }
+};
+
+sphere_grid::sphere_grid( const double* p, const double* r, size_t r_stride,
+	size_t count)
+	: pos(p), radius(r), radius_stride(r_stride), n(count), width(0)
+{
+	for (size_t i = 0; i < n; ++i)
+		width = std::max( width, 2*radius_of(i));
+	// Spheres of no size never collide.
+	if (!(width > 0))
+		return;
+
+	// Cells too far from the origin to be counted in 64 bits mean that the
+	// spheres are too small for their spread to be worth testing this way.
+	const double limit = 4e18;
+	entries.resize( n);
+	for (size_t i = 0; i < n; ++i) {
+		for (int k = 0; k < 3; ++k)
+			if (!(std::fabs( pos[3*i+k] / width) < limit))
+				throw std::invalid_argument( "sphere_intercollisions: pos must be finite"
+					" and not too large compared to radius.");
+		entries[i].where = cell_of( i);
+		entries[i].index = i;
+	}
+	std::sort( entries.begin(), entries.end());
+
+	for (size_t i = 0; i < n; ++i) {
+		if (i == 0 || !(entries[i].where == entries[i-1].where)) {
+			cells.push_back( entries[i].where);
+			cell_begin.push_back( i);
+		}
+	}
+	cell_begin.push_back( n);
+}
+
+void
+sphere_grid::collide( size_t begin, size_t end, std::vector<npy_intp>* out) const
+{
+	if (cells.empty())
+		return;
+
+	std::vector<size_t> hits;
+	for (size_t i = begin; i < end; ++i) {
+		const cell home = cell_of( i);
+		const double* p_i = pos + 3*i;
+		const double r_i = radius_of( i);
+		hits.clear();
+
+		for (int dx = -1; dx <= 1; ++dx) for (int dy = -1; dy <= 1; ++dy) for (int dz = -1; dz <= 1; ++dz) {
+			cell c( home.x + dx, home.y + dy, home.z + dz);
+			std::vector<cell>::const_iterator found =
+				std::lower_bound( cells.begin(), cells.end(), c);
+			if (found == cells.end() || !(*found == c))
+				continue;
+			size_t k = found - cells.begin();
+			// Entries within a cell are in increasing order of index.
+			for (size_t e = cell_begin[k+1]; e > cell_begin[k]; --e) {
+				size_t j = entries[e-1].index;
+				if (j <= i)
+					break;
+				const double* p_j = pos + 3*j;
+				double d[3] = { p_i[0] - p_j[0], p_i[1] - p_j[1], p_i[2] - p_j[2] };
+				double reach = r_i + radius_of( j);
+				// Spheres that just touch collide.
+				if (d[0]*d[0] + d[1]*d[1] + d[2]*d[2] <= reach*reach)
+					hits.push_back( j);
+			}
+		}
+
+		std::sort( hits.begin(), hits.end());
+		for (std::vector<size_t>::iterator j = hits.begin(); j != hits.end(); ++j) {
+			out->push_back( i);
+			out->push_back( *j);
+		}
+	}
+}
+
+// Collide the spheres of parts [begin, end) of the n spheres divided into
+// parts, each into its own list of pairs.
+void
+collide_parts( const sphere_grid* grid, size_t n, size_t parts,
+	std::vector< std::vector<npy_intp> >* pairs, size_t begin, size_t end)
+{
+	for (size_t k = begin; k < end; ++k)
+		grid->collide( n*k/parts, n*(k+1)/parts, &(*pairs)[k]);
+}
+
+} // !namespace (anonymous)
+
+array
+sphere_intercollisions( const double_array& pos, const double_array& radius,
+	int threads)
+{
+	std::vector<npy_intp> pos_dims = shape( pos);
+	if (pos_dims.size() != 2 || pos_dims[1] != 3)
+		throw std::invalid_argument( "sphere_intercollisions: pos must be an Nx3 array.");
+	const size_t n = pos_dims[0];
+
+	std::vector<npy_intp> r_dims = shape( radius);
+	size_t r_size = 1;
+	for (size_t k = 0; k < r_dims.size(); ++k)
+		r_size *= r_dims[k];
+	if (r_size != 1 && (r_dims.empty() || (size_t)r_dims[0] != n || r_size != n))
+		throw std::out_of_range( "sphere_intercollisions: radius must have one element"
+			" for each element of pos, or only one.");
+	if (threads < 1)
+		throw std::invalid_argument( "sphere_intercollisions: threads must be at least 1.");
+
+	// Other Python threads may change the arrays while the lock is released,
+	// so work on copies of them.
+	const double* pos_i = (const double*)data( pos);
+	const double* radius_i = (const double*)data( radius);
+	const std::vector<double> pos_copy( pos_i, pos_i + 3*n);
+	const std::vector<double> radius_copy( radius_i, radius_i + r_size);
+
+	// One list of pairs per part of the spheres, kept in order.
+	std::vector< std::vector<npy_intp> > pairs;
+	{
+		gil_release release;
+		sphere_grid grid( n ? &pos_copy[0] : 0, r_size ? &radius_copy[0] : 0,
+			r_size == 1 ? 0 : 1, n);
+
+		const size_t parts = n < 1024 ? 1 : threads;
+		pairs.resize( parts);
+		// The parts run on the worker threads shared through parallel_for(),
+		// which rethrows here anything that one of them throws.
+		parallel_for( parts, 1, boost::bind( &collide_parts, &grid, n, parts,
+			&pairs, _1, _2));
+	}
+
+	size_t total = 0;
+	for (size_t k = 0; k < pairs.size(); ++k)
+		total += pairs[k].size();
+	std::vector<npy_intp> dims(2);
+	dims[0] = total / 2;
+	dims[1] = 2;
+	array ret = makeNum( dims, NPY_INTP);
+	npy_intp* r_i = (npy_intp*)data( ret);
+	for (size_t k = 0; k < pairs.size(); ++k)
+		r_i = std::copy( pairs[k].begin(), pairs[k].end(), r_i);
+	return ret;
+}
+
+} // !namespace python
+
+void
+wrap_collisions()
+{
+	using namespace boost::python;
+
+	def( "sphere_intercollisions", &python::sphere_intercollisions,
+		( arg("pos"), arg("radius"), arg("threads")=1 ),
+		"sphere_intercollisions(pos, radius, threads=1) -> Find the pairs of\n"
+		"overlapping spheres with centers pos (an Nx3 array) and radii radius\n"
+		"(N values, or one for all of them).  Returns an Mx2 array of indexes\n"
+		"(i, j), i < j, into pos, in increasing order.  The spheres are sorted\n"
+		"into a grid, so the time taken grows with N rather than with N**2;\n"
+		"threads > 1 divides the work into that many parts, run at once on\n"
+		"visual's worker threads, one for each processor.");
+}
+
+} // !namespace cvisual
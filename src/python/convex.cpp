@@ -4,6 +4,7 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "python/convex.hpp"
+#include "pick_engine.hpp"
 #include "python/slice.hpp"
 #include "util/gl_enable.hpp"
 #include "util/errors.hpp"
@@ -11,6 +12,8 @@
 #include <boost/python/extract.hpp>
 #include <boost/crc.hpp>
 
+#include <algorithm>
+
 namespace cvisual { namespace python {
 
 convex::jitter_table convex::jitter;
@@ -30,83 +33,100 @@ convex::degenerate() const
 }
 
 void
-convex::recalc()
+convex::update()
 {
-	hull.clear();
+	if (degenerate())
+		return;
 
-	const double* pos_i = pos.data();
-	// A face from the first, second, and third vectors.
-	hull.push_back( face( vector(pos_i), vector(pos_i+3), vector(pos_i+3*2)));
-	// The reverse face from the first, third, and second vectors.
-	hull.push_back( face( vector(pos_i), vector(pos_i+3*2), vector(pos_i+3)));
-	// The remainder of the possible faces.
-	for (size_t i = 3; i < count; ++i) {
-		add_point( i, vector(pos_i + i*3));
+	const size_t hull_size = hull.get_points().size();
+	size_t begin, end;
+	if (pos.exposed()) {
+		pos.take_dirty( begin, end);
+		long check = checksum();
+		if (check == last_checksum && hull_size == count
+			&& !hull.get_faces().empty())
+			return;
+		recalc();
+		last_checksum = check;
+		return;
 	}
-	
-	// Calculate extents
-	min_extent = max_extent = vector( pos_i );
-	for(size_t i=1; i<count; i++)
-		for(size_t j=0; j<3; j++) {
-			if (*pos_i < min_extent[j]) min_extent[j] = *pos_i;
-			else if (*pos_i > max_extent[j]) max_extent[j] = *pos_i;
-			pos_i++;
-		}
+	bool dirty = pos.take_dirty( begin, end);
+	if (!dirty && hull_size == count && hull_start == pos.offset()
+		&& !hull.get_faces().empty())
+		return;
 
-	last_checksum = checksum();
+	// Points added after the last update, with nothing before them moved or
+	// changed, only extend the hull.
+	if (!hull.get_faces().empty() && hull_start == pos.offset()
+		&& count > hull_size && (!dirty || begin - pos.offset() >= hull_size))
+		append_points();
+	else
+		recalc();
+	// Not known until Python holds a view of pos.
+	last_checksum = -1;
 }
 
-void
-convex::add_point( size_t n, vector pv)
+vector
+convex::jittered( size_t n) const
 {
+	vector pv( pos.data(n));
 	double m = pv.mag();
 	pv.x += m * jitter.v[(n  ) & jitter.mask];
 	pv.y += m * jitter.v[(n+1) & jitter.mask];
 	pv.z += m * jitter.v[(n+2) & jitter.mask];
+	return pv;
+}
 
-	std::vector<edge> hole;
-	for (size_t f=0; f<hull.size(); ) {
-		if ( hull[f].visible_from(pv) ) {
-			// hull[f] is visible from pv.  We will never get here if pv is
-			//   inside the hull.
-
-			// add the edges to the hole.  If an edge is already in the hole,
-			//   it is not on the boundary of the hole and is removed.
-			for(int e=0; e<3; ++e) {
-				edge E( hull[f].corner[e], hull[f].corner[(e+1)%3] );
-
-				bool boundary = true;
-				for(std::vector<edge>::iterator h = hole.begin(); h != hole.end(); ++h) {
-					if (*h == E) {
-						*h = hole.back();
-						hole.pop_back();
-						boundary = false;
-						break;
-					}
-				}
-
-				if (boundary) {
-					hole.push_back(E);
-				}
-			}
+void
+convex::recalc()
+{
+	hull.clear();
+	for (size_t i = 0; i < count; ++i)
+		hull.push_back( jittered( i));
+	hull_start = pos.offset();
+	hull.build();
+	build_mesh();
+}
 
-			// remove hull[f]
-			hull[f] = hull.back();
-			hull.pop_back();
-		}
-		else
-			f++;
-	}
+void
+convex::append_points()
+{
+	for (size_t n = hull.get_points().size(); n < count; ++n)
+		hull.push_back( jittered( n));
+	hull.extend();
+	build_mesh();
+}
 
-	// Now add the boundary of the hole to the hull.  If pv was inside
-	//   the hull, the hole will be empty and nothing happens here.
-	for (std::vector<edge>::const_iterator h = hole.begin(); h != hole.end(); ++h) {
-		hull.push_back(face(h->v[0], h->v[1], pv));
+void
+convex::build_mesh()
+{
+	const std::vector<vector>& points = hull.get_points();
+	const std::vector<quickhull::face>& faces = hull.get_faces();
+	mesh.resize( faces.size() * 18);
+	float* m = mesh.empty() ? 0 : &mesh[0];
+	center = vector();
+	min_extent = max_extent = points[faces[0].corner[0]];
+	for (size_t f = 0; f < faces.size(); ++f) {
+		for (int c = 0; c < 3; ++c) {
+			const vector& corner = points[faces[f].corner[c]];
+			*m++ = faces[f].normal.x;
+			*m++ = faces[f].normal.y;
+			*m++ = faces[f].normal.z;
+			*m++ = corner.x;
+			*m++ = corner.y;
+			*m++ = corner.z;
+			center += corner / 3.0;
+			for (size_t j = 0; j < 3; ++j) {
+				min_extent[j] = std::min( min_extent[j], corner[j]);
+				max_extent[j] = std::max( max_extent[j], corner[j]);
+			}
+		}
 	}
+	center /= faces.size();
 }
 
 convex::convex()
-	: last_checksum(0)
+	: last_checksum(0), hull_start(0)
 {
 }
 
@@ -125,24 +145,20 @@ convex::gl_render( const view& scene)
 {
 	if (degenerate())
 		return;
-	long check = checksum();
-	if (check != last_checksum) {
-		recalc();
-		last_checksum = check;
-	}
+	update();
 
+	// The hull is kept in world coordinates; see faces::gl_render().
+	gl_matrix_stackguard guard;
+	glScaled( scene.gcf, scene.gcf, scene.gcf);
 	glShadeModel(GL_FLAT);
 	gl_enable cull_face( GL_CULL_FACE);
+	gl_enable_client normals( GL_NORMAL_ARRAY);
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
 	color.gl_set(1.0);
 
-	glBegin(GL_TRIANGLES);
-	for (std::vector<face>::const_iterator f = hull.begin(); f != hull.end(); ++f) {
-		f->normal.gl_normal();
-		(f->corner[0] * scene.gcf).gl_render();
-		(f->corner[1] * scene.gcf).gl_render();
-		(f->corner[2] * scene.gcf).gl_render();
-	}
-	glEnd();
+	glNormalPointer( GL_FLOAT, 6*sizeof(float), &mesh[0]);
+	glVertexPointer( 3, GL_FLOAT, 6*sizeof(float), &mesh[3]);
+	glDrawArrays( GL_TRIANGLES, 0, hull.get_faces().size() * 3);
 	glShadeModel( GL_SMOOTH);
 }
 
@@ -151,20 +167,26 @@ convex::get_center() const
 {
 	if (degenerate())
 		return vector();
-
-	vector ret;
-	for (std::vector<face>::const_iterator f = hull.begin(); f != hull.end(); ++f) {
-		ret += f->center;
-	}
-	ret /= hull.empty() ? 1 : hull.size();
-
-	return ret;
+	return center;
 }
 
-void
-convex::gl_pick_render( const view& scene)
+bool
+convex::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	gl_render( scene);
+	if (degenerate())
+		return false;
+	update();
+
+	const std::vector<vector>& points = hull.get_points();
+	const std::vector<quickhull::face>& faces = hull.get_faces();
+	bool ret = false;
+	for (std::vector<quickhull::face>::const_iterator f = faces.begin();
+			f != faces.end(); ++f) {
+		if (ray_triangle( ray.origin, ray.dir, points[f->corner[0]],
+				points[f->corner[1]], points[f->corner[2]], hit.t))
+			ret = true;
+	}
+	return ret;
 }
 
 void
@@ -172,17 +194,16 @@ convex::grow_extent( extent& world)
 {
 	if (degenerate())
 		return;
-
-	long check = checksum();
-	if (check != last_checksum) {
-		recalc();
-	}
-	assert( hull.size() != 0);
-
-	for (std::vector<face>::const_iterator f = hull.begin(); f != hull.end(); ++f) {
-		world.add_point( f->corner[0]);
-		world.add_point( f->corner[1]);
-		world.add_point( f->corner[2]);
+	update();
+	const std::vector<vector>& points = hull.get_points();
+	const std::vector<quickhull::face>& faces = hull.get_faces();
+	assert( faces.size() != 0);
+
+	for (std::vector<quickhull::face>::const_iterator f = faces.begin();
+			f != faces.end(); ++f) {
+		world.add_point( points[f->corner[0]]);
+		world.add_point( points[f->corner[1]]);
+		world.add_point( points[f->corner[2]]);
 	}
 	world.add_body();
 }
@@ -7,6 +7,7 @@
 
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/parallel.hpp"
 
 #include "python/slice.hpp"
 #include "python/curve.hpp"
@@ -15,35 +16,42 @@
 #include <cassert>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <boost/bind.hpp>
 
 // Recall that the default constructor for object() is a reference to None.
 
 namespace cvisual { namespace python {
 
 curve::curve()
-	: antialias( true), radius(0.0), sides(4)
+	: antialias( true), radius(0.0), simplify(0.0), sides(4), mono(true),
+	importance_valid(false), selected_level(0), tube_corners(0), tube_dropped(0), tube_closed(false),
+	tube_skip(0), tube_index_buffer( GL_ELEMENT_ARRAY_BUFFER_ARB)
 {
 	for (size_t i=0; i<sides; i++) {
 		curve_sc[i]  = (float) std::cos(i * 2 * M_PI / sides);
 		curve_sc[i+sides] = (float) std::sin(i * 2 * M_PI / sides);
 	}
-
-	// curve_slice is a list of indices for picking out the correct vertices from
-	// a list of vertices representing one side of a thick-line curve. The lower
-	// indices (0-255) are used for all but one of the sides. The upper indices
-	// (256-511) are used for the final side.
-	for (int i=0; i<128; i++) {
-		curve_slice[i*2]       = i*sides;
-		curve_slice[i*2+1]     = i*sides + 1;
-		curve_slice[i*2 + 256] = i*sides + (sides - 1);
-		curve_slice[i*2 + 257] = i*sides;
-	}
 }
 
 void
 curve::set_radius( const double& radius)
 {
 	this->radius = radius;
+	tube_corners = 0;
+	extent_changed();
+}
+
+void
+curve::set_length( size_t new_len)
+{
+	// Shrinking keeps the last points; see arrayprim_array::set_length().
+	if (new_len < count && new_len)
+		tube_dropped += count - new_len;
+	arrayprim_color::set_length( new_len);
 }
 
 void
@@ -52,28 +60,18 @@ curve::set_antialias( bool aa)
 	this->antialias = aa;
 }
 
-bool
-curve::degenerate() const
+void
+curve::set_simplify( const double& pixels)
 {
-	return count < 2;
+	if (pixels < 0)
+		throw std::invalid_argument( "simplify must be nonnegative.");
+	simplify = pixels;
 }
 
 bool
-curve::monochrome(float* tcolor, size_t pcount)
+curve::degenerate() const
 {
-	rgb first_color( tcolor[0], tcolor[1], tcolor[2]);
-	size_t nn;
-
-	for(nn=0; nn<pcount; nn++)  {
-		if (tcolor[nn*3] != first_color.red)
-			return false;
-		if (tcolor[nn*3+1] != first_color.green)
-			return false;
-		if (tcolor[nn*3+2] != first_color.blue)
-			return false;
-	}
-
-	return true;
+	return count < 2;
 }
 
 namespace {
@@ -112,15 +110,6 @@ curve::get_center() const
 	return ret;
 }
 
-void
-curve::gl_pick_render( const view& scene)
-{
-	// Aack, I can't think of any obvious optimizations here.
-	// But since Visual 3 didn't permit picking of curves, omit for now.
-	// We can't afford it; serious impact on performance.
-	//gl_render( scene);
-}
-
 void
 curve::grow_extent( extent& world)
 {
@@ -137,91 +126,453 @@ curve::grow_extent( extent& world)
 	world.add_body();
 }
 
-bool
-curve::adjust_colors( const view& scene, float* tcolor, size_t pcount)
+namespace {
+
+// The distance from p to the segment from a to b.
+double
+segment_distance( const vector& p, const vector& a, const vector& b)
 {
-	rgb rendered_color;
-	bool mono = monochrome(tcolor, pcount);
-	if (mono) {
-		// We can get away without using a color array.
-		rendered_color = rgb( tcolor[0], tcolor[1], tcolor[2]);
-		if (scene.anaglyph) {
-			if (scene.coloranaglyph)
-				rendered_color.desaturate().gl_set(opacity);
-			else
-				rendered_color.grayscale().gl_set(opacity);
-		}
+	vector ab = b - a;
+	double len2 = ab.mag2();
+	double t = len2 ? (p - a).dot(ab) / len2 : 0.0;
+	t = std::max( 0.0, std::min( 1.0, t));
+	return (p - (a + ab*t)).mag();
+}
+
+// A span of the curve still to be simplified.
+struct dp_segment
+{
+	size_t first, last;
+	float limit;
+	dp_segment( size_t f, size_t l, float lim) : first(f), last(l), limit(lim) {}
+};
+
+inline void
+put( std::vector<float>& v, size_t i, const vector& x)
+{
+	v[3*i] = x.x;
+	v[3*i+1] = x.y;
+	v[3*i+2] = x.z;
+}
+
+inline void
+put( std::vector<float>& v, size_t i, const double* c)
+{
+	v[3*i] = c[0];
+	v[3*i+1] = c[1];
+	v[3*i+2] = c[2];
+}
+
+inline vector
+get( const std::vector<float>& v, size_t i)
+{
+	return vector( v[3*i], v[3*i+1], v[3*i+2]);
+}
+
+// Copy elements [begin, end) of data into buffer, or all of it if the buffer
+// has to grow.
+template <typename T>
+void
+upload_range( const view& scene, const std::vector<T>& data, size_t begin,
+	size_t end, vertex_buffer& buffer)
+{
+	if (buffer.reserve( scene, data.size())) {
+		begin = 0;
+		end = data.size();
+	}
+	end = std::min( end, data.size());
+	if (begin < end)
+		buffer.upload( scene, begin, end - begin, &data[begin]);
+}
+
+// Copy data from element begin onward into buffer, or all of it if the
+// buffer has to grow.
+template <typename T>
+void
+upload_tail( const view& scene, const std::vector<T>& data, size_t begin,
+	vertex_buffer& buffer)
+{
+	upload_range( scene, data, begin, data.size(), buffer);
+}
+
+// The colors of n points as they appear in anaglyph stereo.
+template <typename T>
+void
+anaglyph_colors( const view& scene, const T* c_i, size_t n, std::vector<rgb>& out)
+{
+	out.resize( n);
+	for (size_t i = 0; i < n; ++i, c_i += 3) {
+		if (scene.coloranaglyph)
+			out[i] = rgb( c_i).desaturate();
 		else
-			rendered_color.gl_set(opacity);
+			out[i] = rgb( c_i).grayscale();
 	}
-	else {
-		glEnableClientState( GL_COLOR_ARRAY);
-		if (scene.anaglyph) {
-			// Must desaturate or grayscale the color.
-
-			for (size_t i = 0; i < pcount; ++i) {
-				rendered_color = rgb( tcolor[3*i], tcolor[3*i+1], tcolor[3*i+2]);
-				if (scene.coloranaglyph)
-					rendered_color = rendered_color.desaturate();
-				else
-					rendered_color = rendered_color.grayscale();
-				tcolor[3*i] = rendered_color.red;
-				tcolor[3*i+1] = rendered_color.green;
-				tcolor[3*i+2] = rendered_color.blue;
+}
+
+} // !namespace (anonymous)
+
+void
+curve::update_mono( size_t begin, size_t end)
+{
+	// A change to the first point, or to a curve that already has more than
+	// one color, needs a look at every point.
+	const double* first = color.data();
+	if (begin == 0 || !mono) {
+		begin = 1;
+		end = count;
+		mono = true;
+	}
+	const double* c_end = color.data( end);
+	for (const double* c_i = color.data( begin); mono && c_i < c_end; c_i += 3) {
+		if (c_i[0] != first[0] || c_i[1] != first[1] || c_i[2] != first[2])
+			mono = false;
+	}
+}
+
+void
+curve::gl_set_color( const view& scene)
+{
+	rgb rendered_color( color.data());
+	if (scene.anaglyph) {
+		if (scene.coloranaglyph)
+			rendered_color = rendered_color.desaturate();
+		else
+			rendered_color = rendered_color.grayscale();
+	}
+	rendered_color.gl_set( opacity);
+}
+
+size_t
+curve::corner( size_t k) const
+{
+	return selected.empty() ? k : selected[k];
+}
+
+void
+curve::update_importance()
+{
+	importance.assign( count, 0.0f);
+	importance[0] = importance[count-1] = std::numeric_limits<float>::max();
+
+	bounds_min = bounds_max = vector( pos.data());
+	for (const double* pos_i = pos.data(1); pos_i < pos.end(); pos_i += 3) {
+		for (int j = 0; j < 3; ++j) {
+			bounds_min[j] = std::min( bounds_min[j], pos_i[j]);
+			bounds_max[j] = std::max( bounds_max[j], pos_i[j]);
+		}
+	}
+
+	// Douglas-Peucker, recording for each point the tolerance at which it
+	// would be split off instead of stopping at any one tolerance.  No point
+	// is allowed more than the one that split its segment, so that the points
+	// kept at one tolerance include those kept at every larger one.
+	std::vector<dp_segment> stack;
+	stack.push_back( dp_segment( 0, count-1, std::numeric_limits<float>::max()));
+	while (!stack.empty()) {
+		dp_segment seg = stack.back();
+		stack.pop_back();
+		if (seg.last - seg.first < 2)
+			continue;
+		vector a( pos.data( seg.first));
+		vector b( pos.data( seg.last));
+		size_t worst = seg.first + 1;
+		double worst_dist = -1.0;
+		for (size_t i = seg.first + 1; i < seg.last; ++i) {
+			double dist = segment_distance( vector( pos.data(i)), a, b);
+			if (dist > worst_dist) {
+				worst = i;
+				worst_dist = dist;
 			}
 		}
+		float limit = std::min( (float)worst_dist, seg.limit);
+		importance[worst] = limit;
+		stack.push_back( dp_segment( seg.first, worst, limit));
+		stack.push_back( dp_segment( worst, seg.last, limit));
 	}
-	return mono;
+	importance_valid = true;
 }
 
-namespace {
-template <typename T>
-struct converter
+bool
+curve::update_selection( const view& scene)
 {
-	T data[3];
-};
-} // !namespace (anonymous)
+	if (!simplify || !scene.view_width) {
+		if (selected.empty())
+			return false;
+		std::vector<GLuint>().swap( selected);
+		return true;
+	}
+
+	bool changed = false;
+	if (!importance_valid) {
+		update_importance();
+		changed = true;
+	}
+
+	// Size the tolerance for the nearest part of the curve.
+	double near = std::numeric_limits<double>::max();
+	for (int i = 0; i < 8; ++i) {
+		vector c( (i & 1) ? bounds_max.x : bounds_min.x,
+			(i & 2) ? bounds_max.y : bounds_min.y,
+			(i & 4) ? bounds_max.z : bounds_min.z);
+		near = std::min( near, (c - scene.camera).dot( scene.forward));
+	}
+	if (near <= 0.0) {
+		// Part of the curve is beside or behind the camera.
+		if (selected.empty())
+			return changed;
+		std::vector<GLuint>().swap( selected);
+		return true;
+	}
+	double pixel = 2.0 * scene.tan_hfov_x * near / scene.view_width;
+
+	// Tolerances are rounded down to a power of two, so that the selection
+	// only changes when the view zooms by a factor of two.
+	int level;
+	std::frexp( simplify * pixel, &level);
+	if (!changed && !selected.empty() && level == selected_level)
+		return false;
+	selected_level = level;
+
+	const float tolerance = std::ldexp( 1.0, level-1);
+	selected.clear();
+	for (size_t i = 0; i < count; ++i)
+		if (importance[i] > tolerance)
+			selected.push_back( i);
+	return true;
+}
 
 void
-curve::thickline( const view& scene, double* spos, float* tcolor, size_t pcount, double scaled_radius)
+curve::render_line( const view& scene)
 {
-	float *cost = curve_sc;
-	float *sint = cost + sides;
+	glDisable( GL_LIGHTING);
+	if (antialias)
+		glEnable( GL_LINE_SMOOTH);
+	gl_enable_client vertexes( GL_VERTEX_ARRAY);
+
+	std::vector<rgb> tcolor;
+	if (mono)
+		gl_set_color( scene);
+	else {
+		glEnableClientState( GL_COLOR_ARRAY);
+		if (scene.anaglyph)
+			anaglyph_colors( scene, color.data(), count, tcolor);
+	}
 
-	vector lastA; // unit vector of previous segment
+	if (scene.glext.ARB_vertex_buffer_object) {
+		size_t begin, end;
+		line_pos_dirty.take( begin, end, pos.offset() + count);
+		upload_points( scene, pos, begin, end, line_pos_buffer);
+		line_color_dirty.take( begin, end, color.offset() + count);
+		upload_points( scene, color, begin, end, line_color_buffer);
+
+		line_pos_buffer.gl_bind( scene);
+		glVertexPointer( 3, GL_FLOAT, 0, buffer_offset( pos));
+		if (!mono && !scene.anaglyph) {
+			line_color_buffer.gl_bind( scene);
+			glColorPointer( 3, GL_FLOAT, 0, buffer_offset( color));
+		}
+		vertex_buffer::gl_unbind( scene);
+	}
+	else {
+		glVertexPointer( 3, GL_DOUBLE, 0, pos.data());
+		if (!mono && !scene.anaglyph)
+			glColorPointer( 3, GL_DOUBLE, 0, color.data());
+	}
+	if (!mono && scene.anaglyph)
+		glColorPointer( 3, GL_FLOAT, sizeof(rgb), &tcolor[0].red);
+
+	if (selected.empty())
+		glDrawArrays( GL_LINE_STRIP, 0, count);
+	else
+		glDrawElements( GL_LINE_STRIP, selected.size(), GL_UNSIGNED_INT, &selected[0]);
+
+	if (!mono)
+		glDisableClientState( GL_COLOR_ARRAY);
+	glEnable( GL_LIGHTING);
+	if (antialias)
+		glDisable( GL_LINE_SMOOTH);
+}
+
+void
+curve::render_tube( const view& scene, bool reselected)
+{
+	const size_t n = selected.empty() ? count : selected.size();
+	const bool closed = vector( pos.data( corner(0))) == vector( pos.data( corner(n-1)));
+
+	// A change to a point moves the rings of the corners on either side of
+	// it, and everything after them along the tube.
+	size_t first = n;
+	size_t begin, end;
+	if (tube_dirty.take( begin, end, count))
+		first = (selected.empty() && begin) ? begin - 1 : 0;
+	// When the first segment has no length, the first corner is oriented by
+	// some later point.
+	if (first != n && vector( pos.data( corner(0))) == vector( pos.data( corner(1))))
+		first = 0;
+	if (reselected || closed != tube_closed)
+		first = 0;
+	first = std::min( first, tube_corners);
+
+	size_t first_ring = 2*n;
+	const size_t old_indices = tube_indices.size();
+	if (first < n) {
+		tube_closed = closed;
+		if (!tessellate( first, n, first_ring))
+			return;
+	}
+	const size_t vertices = tube_pos.size() / 3 - tube_skip;
+	const size_t skipped = 3*tube_skip;
+
+	gl_enable_client vertex_arrays( GL_VERTEX_ARRAY);
+	gl_enable_client normal_arrays( GL_NORMAL_ARRAY);
+	std::vector<rgb> tcolor;
+	if (mono)
+		gl_set_color( scene);
+	else {
+		glEnableClientState( GL_COLOR_ARRAY);
+		if (scene.anaglyph)
+			anaglyph_colors( scene, &tube_color[skipped], vertices, tcolor);
+	}
+
+	size_t moved_begin, moved_end;
+	const bool moved = tube_moved.take( moved_begin, moved_end, tube_pos.size() / 3);
+	if (scene.glext.ARB_vertex_buffer_object) {
+		if (moved) {
+			upload_range( scene, tube_pos, 3*moved_begin, 3*moved_end, tube_pos_buffer);
+			upload_range( scene, tube_normal, 3*moved_begin, 3*moved_end, tube_normal_buffer);
+			upload_range( scene, tube_color, 3*moved_begin, 3*moved_end, tube_color_buffer);
+		}
+		const size_t offset = skipped + 3*first_ring*sides;
+		upload_tail( scene, tube_pos, offset, tube_pos_buffer);
+		upload_tail( scene, tube_normal, offset, tube_normal_buffer);
+		upload_tail( scene, tube_color, offset, tube_color_buffer);
+		upload_tail( scene, tube_indices, std::min( old_indices, tube_indices.size()),
+			tube_index_buffer);
+
+		const GLvoid* start = (const GLvoid*)(skipped * sizeof(float));
+		tube_pos_buffer.gl_bind( scene);
+		glVertexPointer( 3, GL_FLOAT, 0, start);
+		tube_normal_buffer.gl_bind( scene);
+		glNormalPointer( GL_FLOAT, 0, start);
+		if (!mono && !scene.anaglyph) {
+			tube_color_buffer.gl_bind( scene);
+			glColorPointer( 3, GL_FLOAT, 0, start);
+		}
+		vertex_buffer::gl_unbind( scene);
+		if (!mono && scene.anaglyph)
+			glColorPointer( 3, GL_FLOAT, sizeof(rgb), &tcolor[0].red);
+
+		tube_index_buffer.gl_bind( scene);
+		glDrawElements( GL_TRIANGLES, tube_indices.size(), GL_UNSIGNED_INT, 0);
+		vertex_buffer::gl_unbind( scene, GL_ELEMENT_ARRAY_BUFFER_ARB);
+	}
+	else {
+		glVertexPointer( 3, GL_FLOAT, 0, &tube_pos[skipped]);
+		glNormalPointer( GL_FLOAT, 0, &tube_normal[skipped]);
+		if (!mono && scene.anaglyph)
+			glColorPointer( 3, GL_FLOAT, sizeof(rgb), &tcolor[0].red);
+		else if (!mono)
+			glColorPointer( 3, GL_FLOAT, 0, &tube_color[skipped]);
+		glDrawElements( GL_TRIANGLES, tube_indices.size(), GL_UNSIGNED_INT, &tube_indices[0]);
+	}
+
+	if (!mono)
+		glDisableClientState( GL_COLOR_ARRAY);
+}
 
-	if (pcount < 2) return;
+void
+curve::drop_corners( size_t dropped)
+{
+	// Only the open tube through every point is kept.  The new first corner
+	// keeps its ring and joint, which were found from the points before it.
+	if (!selected.empty() || tube_closed || dropped + 2 > tube_corners) {
+		tube_corners = 0;
+		return;
+	}
+	tube_start.erase( tube_start.begin(), tube_start.begin() + dropped*sides);
+	tube_start_normal.erase( tube_start_normal.begin(),
+		tube_start_normal.begin() + dropped*sides);
+	tube_dir.erase( tube_dir.begin(), tube_dir.begin() + dropped);
+	tube_bisector.erase( tube_bisector.begin(), tube_bisector.begin() + dropped);
+	tube_sectheta.erase( tube_sectheta.begin(), tube_sectheta.begin() + dropped);
+	tube_adot.erase( tube_adot.begin(), tube_adot.begin() + dropped);
+	tube_corners -= dropped;
+
+	// Each corner has two rings, and the one ending the segment before the
+	// new first corner becomes its cap.
+	tube_skip += 2*dropped*sides;
+	const size_t vertices = tube_pos.size() / 3 - tube_skip;
+	if (tube_skip > vertices) {
+		tube_pos.erase( tube_pos.begin(), tube_pos.begin() + 3*tube_skip);
+		tube_normal.erase( tube_normal.begin(), tube_normal.begin() + 3*tube_skip);
+		tube_color.erase( tube_color.begin(), tube_color.begin() + 3*tube_skip);
+		tube_skip = 0;
+		tube_moved.add( 0, vertices);
+	}
+	else
+		tube_moved.add( tube_skip, tube_skip + sides);
+
+	const vector current( pos.data( 0));
+	const double* c = color.data( 0);
+	for (size_t a = 0; a < sides; ++a) {
+		put( tube_pos, tube_skip + a, current);
+		put( tube_normal, tube_skip + a, -tube_dir[0]);
+		put( tube_color, tube_skip + a, c);
+	}
+}
 
-	bool closed = vector(&spos[0]) == vector(&spos[(pcount-1)*3]);
+namespace {
 
-	size_t vcount = pcount*2 - closed;  // The number of vertices along each edge of the curve
-	std::vector<vector> projected( vcount*sides );
-	std::vector<vector> normals( vcount*sides );
-	std::vector<rgb> light( vcount*sides );
+// Re-tessellating fewer corners than this is not worth handing to the
+// worker threads.
+const size_t parallel_corners = 1024;
 
-	// pos and color iterators
-	const double* v_i = spos;
-	const float* c_i = tcolor;
-	size_t i = closed ? 0 : sides;
-	bool mono = adjust_colors( scene, tcolor, pcount);
+} // !namespace (anonymous)
 
-	for (size_t corner=0; corner < pcount; ++corner, v_i += 3, c_i += 3) {
-		vector current( &v_i[0] );
+bool
+curve::tessellate( size_t first, size_t n, size_t& first_ring)
+{
+	const bool closed = tube_closed;
+	// The ring of the first corner, after the cap of an open curve.
+	const size_t base = closed ? 0 : 1;
+	// The number of rings along the curve.
+	const size_t rings = 2*n - closed;
+	// A rebuild starts the vertex arrays over.
+	if (!first)
+		tube_skip = 0;
+	const size_t skip = tube_skip;
+
+	tube_start.resize( n*sides);
+	tube_start_normal.resize( n*sides);
+	tube_dir.resize( n);
+	tube_bisector.resize( n);
+	tube_sectheta.resize( n);
+	tube_adot.resize( n);
+	tube_pos.resize( 3*(skip + rings*sides));
+	tube_normal.resize( 3*(skip + rings*sides));
+	tube_color.resize( 3*(skip + rings*sides));
+
+	first_ring = first ? base + 2*first - 1 : 0;
+	vector lastA = first ? tube_dir[first-1] : vector(); // unit vector of previous segment
+	vector x, y; // the orientation of the first ring
+
+	// Walk the path to find the joints.  This is cheap, and the rings are
+	// built from the results below.
+	for (size_t k = first; k < n; ++k) {
+		vector current( pos.data( corner(k)));
 
 		vector next, A, bisecting_plane_normal;
-		double sectheta;
-		if (corner != pcount-1) {
-			next = vector( &v_i[3] ); // The next vector in spos
+		double sectheta = 0.0;
+		if (k != n-1) {
+			next = vector( pos.data( corner(k+1)));
 			A = (next - current).norm();
 			if (!A) {
-				if (corner == 0) {
-					const double* tv_i = v_i;
-					for (size_t tcorner=0; tcorner < pcount; ++tcorner, tv_i += 3) {
-						A = (vector( &tv_i[3] ) - current).norm();
-						if (!A) continue;
-					}
+				if (k == 0) {
+					for (size_t j = 2; j < n && !A; ++j)
+						A = (vector( pos.data( corner(j))) - current).norm();
 					if (!A) { // all the points of this curve are at the same location; abort
-						return;
+						tube_corners = 0;
+						return false;
 					}
 					lastA = A;
 				} else {
@@ -238,9 +589,9 @@ curve::thickline( const view& scene, double* spos, float* tcolor, size_t pcount,
 			if (sectheta) sectheta = 1.0 / sectheta;
 		}
 
-		if (corner == 0) {
-			vector y = vector(0,1,0);
-			vector x = A.cross(y).norm();
+		if (k == 0) {
+			y = vector(0,1,0);
+			x = A.cross(y).norm();
 			if (!x) {
 				x = A.cross( vector(0, 0, 1)).norm();
 			}
@@ -257,123 +608,180 @@ curve::thickline( const view& scene, double* spos, float* tcolor, size_t pcount,
 			}
 
 			// scale radii
-			x *= scaled_radius;
-			y *= scaled_radius;
+			x *= radius;
+			y *= radius;
+		}
+
+		tube_dir[k] = A;
+		tube_bisector[k] = bisecting_plane_normal;
+		tube_sectheta[k] = sectheta;
+		tube_adot[k] = A.dot(next - current);
+		lastA = A;
+	}
+
+	const bool parallel = n - first >= parallel_corners;
+	if (parallel)
+		parallel_for( sides, 1, boost::bind( &curve::tessellate_rings, this,
+			first, n, x, y, _1, _2));
+	else
+		tessellate_rings( first, n, x, y, 0, sides);
+
+	if (closed) {
+		// Connect the end of the curve to the start... can be ugly because the basis has gotten
+		//   twisted around!
+		const size_t s = 3*skip;
+		const size_t i = 3*(skip + (rings - 1)*sides);
+		std::copy( tube_pos.begin() + s, tube_pos.begin() + s + 3*sides, tube_pos.begin() + i);
+		std::copy( tube_normal.begin() + s, tube_normal.begin() + s + 3*sides, tube_normal.begin() + i);
+		std::copy( tube_color.begin() + s, tube_color.begin() + s + 3*sides, tube_color.begin() + i);
+	}
 
-			for (size_t a=0; a < sides; a++) {
+	// The joint at the first corner is against the cap or against a copy of
+	// itself, and is never smoothed.
+	const size_t first_joint = std::max( first, (size_t)1);
+	if (first_joint < n) {
+		if (parallel)
+			parallel_for( n - first_joint, parallel_corners/4, boost::bind(
+				&curve::smooth_joints, this, first_joint, _1, _2));
+		else
+			smooth_joints( first_joint, 0, n - first_joint);
+	}
+
+	// Two triangles for each side between each pair of neighboring rings.
+	// They depend only on the number of rings, so only new ones are added.
+	const size_t n_quads = sides*(rings - 1);
+	const size_t first_quad = std::min( tube_indices.size() / 6, n_quads);
+	tube_indices.resize( 6*n_quads);
+	if (parallel)
+		parallel_for( n_quads - first_quad, sides*parallel_corners/4, boost::bind(
+			&curve::tessellate_indices, this, first_quad, _1, _2));
+	else
+		tessellate_indices( first_quad, 0, n_quads - first_quad);
+
+	tube_corners = n;
+	return true;
+}
+
+void
+curve::tessellate_rings( size_t first, size_t n, vector x, vector y,
+	size_t begin, size_t end)
+{
+	const float *cost = curve_sc;
+	const float *sint = cost + sides;
+	const bool closed = tube_closed;
+	const size_t base = closed ? 0 : 1;
+	const size_t skip = tube_skip;
+	// Only read the arrays through const references, which never touch
+	// Python reference counts.
+	const arrayprim_array<double>& p = pos;
+	const arrayprim_array<double>& c = color;
+
+	for (size_t a = begin; a < end; ++a) {
+		for (size_t k = first; k < n; ++k) {
+			vector current( p.data( corner(k)));
+			const double* c_i = c.data( corner(k));
+			const vector& A = tube_dir[k];
+
+			if (k == 0) {
 				vector rel = x*sint[a] + y*cost[a]; // first point is "up"
 
-				normals[a+i] = rel.norm();
-				projected[a+i] = current + rel;
-				if (!mono) light[a+i] = rgb( c_i );
+				tube_start[a] = current + rel;
+				tube_start_normal[a] = rel.norm();
+				put( tube_pos, skip + base*sides + a, tube_start[a]);
+				put( tube_normal, skip + base*sides + a, tube_start_normal[a]);
+				put( tube_color, skip + base*sides + a, c_i);
 
 				if (!closed) {
 					// Cap start of curve
-					projected[a] = current;
-					normals[a] = -A;
-					if (!mono) light[a] = light[a+i];
+					put( tube_pos, skip + a, current);
+					put( tube_normal, skip + a, -A);
+					put( tube_color, skip + a, c_i);
 				}
+				continue;
 			}
 
-			i += sides;
-		} else {
-			double Adot = A.dot(next - current);
-			for (size_t a=0; a < sides; a++) {
-				vector prev_start = projected[i+a-sides];
-				vector rel = current - prev_start;
-				double t = rel.dot(lastA);
-				if (corner != pcount-1 && sectheta > 0.0) {
-					double t1 = (rel.dot(bisecting_plane_normal)) * sectheta;
-					t1 = std::max( t1, t - Adot );
-					t = std::max( 0.0, std::min( t, t1 ) );
-				}
-				vector prev_end = prev_start + t*lastA;
-
-				projected[i+a] = prev_end;
-				normals[i+a] = normals[i+a-sides];
-				if (!mono) light[i+a] = rgb( c_i );
-
-				if (corner != pcount-1) {
-					vector next_start = prev_end - 2*(prev_end-current).dot(bisecting_plane_normal)*bisecting_plane_normal;
-
-					rel = next_start - current;
-
-					projected[i+a+sides] = next_start;
-					normals[i+a+sides] = (rel - A.dot(next_start-current)*A).norm();
-					if (!mono) light[i+a+sides] = light[i+a];
-				} else if (!closed) {
-					// Cap end of curve
-					for (size_t a=0; a < sides; a++) {
-						projected[i+a+sides] = current;
-						normals[i+a+sides] = lastA;
-						if (!mono) light[i+a+sides] = light[a+i];
-					}
-				}
+			// The ring ending the previous segment, and the one starting the
+			// next segment (or the cap).
+			const vector& lastA = tube_dir[k-1];
+			const vector& bisecting_plane_normal = tube_bisector[k];
+			const double sectheta = tube_sectheta[k];
+			const size_t i = skip + (base + 2*k - 1)*sides;
+
+			vector prev_start = tube_start[(k-1)*sides + a];
+			vector rel = current - prev_start;
+			double t = rel.dot(lastA);
+			if (k != n-1 && sectheta > 0.0) {
+				double t1 = (rel.dot(bisecting_plane_normal)) * sectheta;
+				t1 = std::max( t1, t - tube_adot[k] );
+				t = std::max( 0.0, std::min( t, t1 ) );
+			}
+			vector prev_end = prev_start + t*lastA;
+
+			put( tube_pos, i+a, prev_end);
+			put( tube_normal, i+a, tube_start_normal[(k-1)*sides + a]);
+			put( tube_color, i+a, c_i);
+
+			if (k != n-1) {
+				vector next_start = prev_end - 2*(prev_end-current).dot(bisecting_plane_normal)*bisecting_plane_normal;
+
+				rel = next_start - current;
+
+				tube_start[k*sides + a] = next_start;
+				tube_start_normal[k*sides + a] = (rel - A.dot(next_start-current)*A).norm();
+				put( tube_pos, i+a+sides, next_start);
+				put( tube_normal, i+a+sides, tube_start_normal[k*sides + a]);
+				put( tube_color, i+a+sides, c_i);
+			} else if (!closed) {
+				// Cap end of curve
+				put( tube_pos, i+a+sides, current);
+				put( tube_normal, i+a+sides, lastA);
+				put( tube_color, i+a+sides, c_i);
 			}
-			i += 2*sides;
-		}
-		lastA = A;
-	}
-
-	if (closed) {
-		// Connect the end of the curve to the start... can be ugly because the basis has gotten
-		//   twisted around!
-		size_t i = (vcount - 1)*sides;
-		for(size_t a=0; a<sides; a++) {
-			projected[i+a] = projected[a];
-			normals[i+a] = normals[a];
-			if (!mono) light[i+a] = light[a];
 		}
 	}
+}
 
+void
+curve::smooth_joints( size_t first, size_t begin, size_t end)
+{
 	// Thick lines are often used to represent smooth curves, so we want
 	// to smooth the normals at the joints.  But that can make a sharp corner
 	// do odd things, so we smoothly disable the smoothing when the joint angle
 	// is too big.  This is somewhat arbitrary but seems to work well.
-	size_t prev_i = closed ? (vcount-1)*sides : 0;
-	for( i = closed ? 0 : sides; i < vcount*sides; i += 2*sides ) {
+	const size_t base = tube_closed ? 0 : 1;
+	for (size_t k = first + begin; k < first + end; ++k) {
+		const size_t i = tube_skip + (base + 2*k)*sides;
+		const size_t prev_i = i - sides;
 		for(size_t a=0; a<sides; a++) {
-			vector& n1 = normals[i+a];
-			vector& n2 = normals[prev_i+a];
+			vector n1 = get( tube_normal, i+a);
+			vector n2 = get( tube_normal, prev_i+a);
 			double smooth_amount = (n1.dot(n2) - .65) * 4.0;
 			smooth_amount = std::min(1.0, std::max(0.0, smooth_amount));
 			if (smooth_amount) {
 				vector n_smooth = (n1+n2).norm() * smooth_amount;
-				n1 = n1 * (1-smooth_amount) + n_smooth;
-				n2 = n2 * (1-smooth_amount) + n_smooth;
+				put( tube_normal, i+a, n1 * (1-smooth_amount) + n_smooth);
+				put( tube_normal, prev_i+a, n2 * (1-smooth_amount) + n_smooth);
 			}
 		}
-		prev_i = i + sides;
 	}
+}
 
-	gl_enable_client vertex_arrays( GL_VERTEX_ARRAY);
-	gl_enable_client normal_arrays( GL_NORMAL_ARRAY);
-	if (!mono) {
-		glEnableClientState( GL_COLOR_ARRAY);
-	}
-
-	int *ind = curve_slice;
-	for (size_t a=0; a < sides; a++) {
-		size_t ai = a;
-		if (a == sides-1) {
-			ind += 256; // upper portion of curve_slice indices, for the last side
-			ai = 0;
-		}
-
-		// List all the vertices for the ai-th side of the thick line:
-		for (size_t i = 0; i < vcount; i += 127u) {
-			glVertexPointer(3, GL_DOUBLE, sizeof( vector), &projected[i*sides + ai].x);
-			if (!mono)
-				glColorPointer(3, GL_FLOAT, sizeof( rgb), &light[(i*sides + ai)].red );
-			glNormalPointer( GL_DOUBLE, sizeof(vector), &normals[i*sides + ai].x);
-			if (vcount-i < 128)
-				glDrawElements(GL_TRIANGLE_STRIP, 2*(vcount-i), GL_UNSIGNED_INT, ind);
-			else
-				glDrawElements(GL_TRIANGLE_STRIP, 256u, GL_UNSIGNED_INT, ind);
-		}
+void
+curve::tessellate_indices( size_t first, size_t begin, size_t end)
+{
+	for (size_t q = first + begin; q < first + end; ++q) {
+		const size_t ring = q / sides;
+		const size_t a = q % sides;
+		GLuint v0 = ring*sides + a;
+		GLuint v1 = ring*sides + (a+1) % sides;
+		GLuint* i = &tube_indices[6*q];
+		i[0] = v0;
+		i[1] = v1;
+		i[2] = v0 + sides;
+		i[3] = v0 + sides;
+		i[4] = v1;
+		i[5] = v1 + sides;
 	}
-	if (!mono)
-		glDisableClientState( GL_COLOR_ARRAY);
 }
 
 void
@@ -381,70 +789,38 @@ curve::gl_render( const view& scene)
 {
 	if (degenerate())
 		return;
-	const size_t true_size = count;
-	// Set up the leading and trailing points for the joins.  See
-	// glePolyCylinder() for details.  The intent is to create joins that are
-	// perpendicular to the path at the last segment.  When the path appears
-	// to be closed, it should be rendered that way on-screen.
-	// The maximum number of points to display.
-	const int LINE_LENGTH = 1000;
-	// Data storage for the position and color data (plus room for 3 extra points)
-	double spos[3*(LINE_LENGTH+3)];
-	float tcolor[3*(LINE_LENGTH+3)]; // opacity not yet implemented for curves
-	float fstep = (float)(count-1)/(float)(LINE_LENGTH-1);
-	if (fstep < 1.0F) fstep = 1.0F;
-	size_t iptr=0, iptr3, pcount=0;
-
-	const double* p_i = pos.data();
-	const double* c_i = color.data();
-
-	// Choose which points to display
-	for (float fptr=0.0; iptr < count && pcount < LINE_LENGTH; fptr += fstep, iptr = (int) (fptr+.5), ++pcount) {
-		iptr3 = 3*iptr;
-		spos[3*pcount] = p_i[iptr3];
-		spos[3*pcount+1] = p_i[iptr3+1];
-		spos[3*pcount+2] = p_i[iptr3+2];
-		tcolor[3*pcount] = c_i[iptr3];
-		tcolor[3*pcount+1] = c_i[iptr3+1];
-		tcolor[3*pcount+2] = c_i[iptr3+2];
-	}
-
-	// Do scaling if necessary
-	double scaled_radius = radius;
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		scaled_radius = radius*scene.gcfvec[0];
-		for (size_t i = 0; i < pcount; ++i) {
-			spos[3*i] *= scene.gcfvec[0];
-			spos[3*i+1] *= scene.gcfvec[1];
-			spos[3*i+2] *= scene.gcfvec[2];
-		}
-	}
-
-	clear_gl_error();
 
-	if (radius == 0.0) {
-		glEnableClientState( GL_VERTEX_ARRAY);
-		glDisable( GL_LIGHTING);
-		// Assume monochrome.
-		if (antialias) {
-			glEnable( GL_LINE_SMOOTH);
-		}
-
-		glVertexPointer( 3, GL_DOUBLE, 0, spos);
-		bool mono = adjust_colors( scene, tcolor, pcount);
-		if (!mono) glColorPointer( 3, GL_FLOAT, 0, tcolor);
-		glDrawArrays( GL_LINE_STRIP, 0, pcount);
-		glDisableClientState( GL_VERTEX_ARRAY);
-		glDisableClientState( GL_COLOR_ARRAY);
-		glEnable( GL_LIGHTING);
-		if (antialias) {
-			glDisable( GL_LINE_SMOOTH);
-		}
+	// Dropping points from the front of the arrays (for retain) leaves the
+	// line's buffers valid, and the tube's rings around the other corners.
+	if (tube_dropped) {
+		drop_corners( tube_dropped);
+		tube_dropped = 0;
+		importance_valid = false;
 	}
-	else {
-		thickline( scene, spos, tcolor, pcount, scaled_radius);
+	size_t begin, end;
+	if (pos.take_dirty( begin, end)) {
+		line_pos_dirty.add( begin, end);
+		tube_dirty.add( begin - pos.offset(), end - pos.offset());
+		importance_valid = false;
+	}
+	if (color.take_dirty( begin, end)) {
+		line_color_dirty.add( begin, end);
+		tube_dirty.add( begin - color.offset(), end - color.offset());
+		update_mono( begin - color.offset(), end - color.offset());
 	}
+	bool reselected = update_selection( scene);
 
+	clear_gl_error();
+	{
+		// The points are in world coordinates, so scale them here rather than
+		// on the CPU.
+		gl_matrix_stackguard guard;
+		glScaled( scene.gcfvec[0], scene.gcfvec[1], scene.gcfvec[2]);
+		if (radius == 0.0)
+			render_line( scene);
+		else
+			render_tube( scene, reselected);
+	}
 	check_gl_error();
 }
 
@@ -478,8 +854,9 @@ curve::get_material_matrix( const view& v, tmatrix& out ) {
 	max_extent += vector(radius,radius,radius);
 
 	out.translate( vector(.5,.5,.5) );
-	out.scale( vector(1,1,1) * (.999 / (v.gcf * std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z)))) );
-	out.translate( -.5 * v.gcf * (min_extent + max_extent) );
+	// Object coordinates are world coordinates; the gcf is in the modelview.
+	out.scale( vector(1,1,1) * (.999 / std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z))) );
+	out.translate( -.5 * (min_extent + max_extent) );
 }
 
 } } // !namespace cvisual::python
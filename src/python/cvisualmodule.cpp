@@ -13,11 +13,13 @@
 #include <boost/python/module.hpp>
 #include <boost/python/numeric.hpp>
 #include <boost/python/def.hpp>
+#include <boost/python/dict.hpp>
 
 #define PY_ARRAY_UNIQUE_SYMBOL visual_PyArrayHandle
 //#include <numpy/arrayobject.h>
 
 #include "util/rate.hpp"
+#include "util/frame_scheduler.hpp"
 #include "util/errors.hpp"
 #include "python/num_util.hpp"
 #include "python/gil.hpp"
@@ -33,6 +35,7 @@ void wrap_primitive();
 void wrap_rgba();
 void wrap_vector();
 void wrap_arrayobjects();
+void wrap_collisions();
 
 void
 translate_std_out_of_range( std::out_of_range e)
@@ -57,6 +60,41 @@ py_rate( double freq)
 {
 	python::gil_release R;
 	rate(freq);
+	render_schedule.sync_step();
+}
+
+void
+set_frame_rate( double fps)
+{
+	render_schedule.set_frame_rate( fps);
+}
+
+double
+get_frame_rate()
+{
+	return render_schedule.get_frame_rate();
+}
+
+void
+set_rate_sync( bool sync)
+{
+	render_schedule.set_rate_sync( sync);
+}
+
+// frame_pacing(): how the rendering cycles have been keeping up.
+boost::python::dict
+get_frame_pacing()
+{
+	frame_pacing p = render_schedule.get_pacing();
+	boost::python::dict ret;
+	ret["frame_rate"] = p.frame_rate;
+	ret["paint"] = p.paint;
+	ret["swap"] = p.swap;
+	ret["cycle"] = p.cycle;
+	ret["interval"] = p.interval;
+	ret["frames"] = p.frames;
+	ret["dropped"] = p.dropped;
+	return ret;
 }
 
 namespace py = boost::python;
@@ -167,6 +205,15 @@ BOOST_PYTHON_MODULE( cvisual)
 
 	def( "rate", py_rate, "rate(arg) -> Limits the execution rate of a loop to arg"
 		" iterations per second.");
+	def( "set_frame_rate", set_frame_rate, "set_frame_rate(fps) -> Paces rendering"
+		" to fps frames per second.  0 restores the default, which adapts to the time"
+		" taken to paint; float('inf') renders as fast as possible.");
+	def( "get_frame_rate", get_frame_rate);
+	def( "set_rate_sync", set_rate_sync, "set_rate_sync(sync) -> If true, rate() also"
+		" waits until a frame has been drawn after it was called, so that every"
+		" iteration of the loop is drawn.");
+	def( "frame_pacing", get_frame_pacing, "frame_pacing() -> The smoothed paint, swap"
+		" and cycle times, and the counts of frames drawn and dropped.");
 
 	double_from_int();
 	float_from_int();
@@ -175,6 +222,7 @@ BOOST_PYTHON_MODULE( cvisual)
 	wrap_display_kernel();
 	wrap_primitive();
 	wrap_arrayobjects();
+	wrap_collisions();
 	python::init_numpy(); // initialize numpy
 }
 
@@ -7,15 +7,20 @@
 
 #include "util/errors.hpp"
 #include "util/gl_enable.hpp"
+#include "util/parallel.hpp"
 
 #include "python/slice.hpp"
 #include "python/extrusion.hpp"
+#include "pick_engine.hpp"
 
 #include <stdexcept>
 #include <cassert>
 #include <sstream>
 #include <iostream>
 
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
 // Recall that the default constructor for object() is a reference to None.
 
 namespace cvisual { namespace python {
@@ -24,11 +29,21 @@ using boost::python::object;
 using boost::python::make_tuple;
 using boost::python::tuple;
 
+namespace {
+
+// Extruding fewer side vertices than this is not worth handing to the worker
+// threads.
+const size_t parallel_vertices = 1 << 16;
+
+} // !namespace (anonymous)
+
 extrusion::extrusion()
 	: antialias( true), up(vector(0,1,0)), smooth(0.95),
 	  show_start_face(true), show_end_face(true), twosided(true),
 	  start(0), end(-1), initial_twist(0.0), center(vector(0,0,0)),
-	  first_normal(vector(0,0,0)), last_normal(vector(0,0,0))
+	  first_normal(vector(0,0,0)), last_normal(vector(0,0,0)),
+	  mesh_changed(true), mesh_closed(false), mesh_count(0), mesh_offset(0),
+	  mesh_uploaded(0)
 {
 	scale.set_length(1);
 	double* k = scale.data();
@@ -82,6 +97,7 @@ extrusion::set_contours( const numpy::array& _contours,  const numpy::array& _pc
 	// Maybe the following lock is unnecessary? Are we covered by the Python lock?
 	mutex set_contours_lock;
 	lock L(set_contours_lock); // block rendering while set_contours processes a shape change
+	mesh_changed = true;
 
 	// primitives.py sends to set_contours descriptions of the 2D surface; see extrusions.hpp
 	// We store the information in std::vector containers in flattened form.
@@ -186,6 +202,7 @@ extrusion::degenerate() const
 void
 extrusion::set_up( const vector& n_up) {
 	up = n_up;
+	mesh_changed = true;
 }
 
 shared_vector&
@@ -343,6 +360,7 @@ extrusion::appendpos_rgb_retain(const vector& n_pos, const double red, const dou
 void
 extrusion::set_scale( const double_array& n_scale)
 {
+	mesh_changed = true;
 	std::vector<npy_intp> dims = shape( n_scale );
 	if (dims.size() == 1 && !dims[0]) { // scale=() or [];  reset to size 1
 		scale[make_tuple(all(), slice(0,2))] = 1.0;
@@ -372,6 +390,7 @@ extrusion::set_scale( const double_array& n_scale)
 void
 extrusion::set_scale_d( const double n_scale)
 {
+	mesh_changed = true;
 	int npoints = count ? count : 1;
 	scale[make_tuple(slice(0,npoints), 0)] = n_scale;
 	scale[make_tuple(slice(0,npoints), 1)] = n_scale;
@@ -384,6 +403,7 @@ boost::python::object extrusion::get_scale() {
 void
 extrusion::set_xscale( const double_array& arg )
 {
+	mesh_changed = true;
 	if (shape(arg).size() != 1) throw std::invalid_argument("xscale must be a 1D array.");
 	set_length( shape(arg)[0] );
 	scale[make_tuple( all(), 0)] = arg;
@@ -392,6 +412,7 @@ extrusion::set_xscale( const double_array& arg )
 void
 extrusion::set_yscale( const double_array& arg )
 {
+	mesh_changed = true;
 	if (shape(arg).size() != 1) throw std::invalid_argument("yscale must be a 1D array.");
 	set_length( shape(arg)[0] );
 	scale[make_tuple( all(), 1)] = arg;
@@ -400,12 +421,14 @@ extrusion::set_yscale( const double_array& arg )
 void
 extrusion::set_xscale_d( const double arg )
 {
+	mesh_changed = true;
 	int npoints = count ? count : 1;
 	scale[make_tuple(slice(0,npoints), 0)] = arg;
 }
 
 void extrusion::set_yscale_d( const double arg )
 {
+	mesh_changed = true;
 	int npoints = count ? count : 1;
 	scale[make_tuple(slice(0,npoints), 1)] = arg;
 }
@@ -413,6 +436,7 @@ void extrusion::set_yscale_d( const double arg )
 void
 extrusion::set_twist( const double_array& n_twist)
 {
+	mesh_changed = true;
 	std::vector<npy_intp> dims = shape( n_twist );
 	if (dims.size() == 1 && !dims[0]) { // twist()
 		scale[make_tuple(all(), 2)] = 0.0;
@@ -443,6 +467,7 @@ extrusion::set_twist( const double_array& n_twist)
 void
 extrusion::set_twist_d( const double n_twist)
 {
+	mesh_changed = true;
 	int npoints = count ? count : 1;
 	scale[make_tuple(slice(0,npoints), 2)] = n_twist;
 }
@@ -453,6 +478,7 @@ boost::python::object extrusion::get_twist() {
 void
 extrusion::set_initial_twist(const double n_initial_twist) {
 	initial_twist = n_initial_twist;
+	mesh_changed = true;
 }
 
 double
@@ -463,6 +489,7 @@ extrusion::get_initial_twist(){
 void
 extrusion::set_start(const int n_start) {
 	start = n_start;
+	mesh_changed = true;
 }
 
 int
@@ -473,6 +500,7 @@ extrusion::get_start(){
 void
 extrusion::set_end(const int n_end){
 	end = n_end;
+	mesh_changed = true;
 }
 
 int
@@ -483,6 +511,7 @@ extrusion::get_end() {
 void
 extrusion::set_twosided(const bool n_twosided){
 	twosided = n_twosided;
+	mesh_changed = true;
 }
 
 bool
@@ -493,6 +522,7 @@ extrusion::get_twosided() {
 void
 extrusion::set_show_start_face(const bool n_show_start_face) {
 	show_start_face = n_show_start_face;
+	mesh_changed = true;
 }
 
 bool
@@ -503,6 +533,7 @@ extrusion::get_show_start_face(){
 void
 extrusion::set_show_end_face(const bool n_show_end_face){
 	show_end_face = n_show_end_face;
+	mesh_changed = true;
 }
 
 bool
@@ -513,6 +544,7 @@ extrusion::get_show_end_face() {
 void
 extrusion::set_smooth(const double n_smooth){
 	smooth = n_smooth;
+	mesh_changed = true;
 }
 
 double
@@ -520,33 +552,6 @@ extrusion::get_smooth() {
 	return smooth;
 }
 
-bool
-extrusion::monochrome(double* tcolor, size_t pcount)
-{
-	rgb first_color( tcolor[0], tcolor[1], tcolor[2]);
-	size_t nn;
-
-	for(nn=0; nn<pcount; nn++)  {
-		if (tcolor[nn*3] != first_color.red)
-			return false;
-		if (tcolor[nn*3+1] != first_color.green)
-			return false;
-		if (tcolor[nn*3+2] != first_color.blue)
-			return false;
-	}
-	return true;
-}
-
-void
-extrusion::gl_pick_render( const view& scene)
-{
-	// TODO: Should be able to pick an extrusion, presumably. Old comment about curves:
-	// Aack, I can't think of any obvious optimizations here.
-	// But since Visual 3 didn't permit picking of curves, omit for now.
-	// We can't afford it; serious impact on performance.
-	//gl_render( scene);
-}
-
 vector
 extrusion::get_center() const
 {
@@ -651,43 +656,6 @@ extrusion::grow_extent( extent& world)
 	world.add_body();
 }
 
-bool
-extrusion::adjust_colors( const view& scene, double* tcolor, size_t pcount)
-{
-	rgb rendered_color;
-	bool mono = monochrome(tcolor, pcount);
-	if (mono) {
-		// We can get away without using a color array.
-		rendered_color = rgb( tcolor[0], tcolor[1], tcolor[2]);
-		if (scene.anaglyph) {
-			if (scene.coloranaglyph)
-				rendered_color.desaturate().gl_set(opacity);
-			else
-				rendered_color.grayscale().gl_set(opacity);
-		}
-		else
-			rendered_color.gl_set(opacity);
-	}
-	else {
-		glEnableClientState( GL_COLOR_ARRAY);
-		if (scene.anaglyph) {
-			// Must desaturate or grayscale the color.
-
-			for (size_t i = 0; i < pcount; ++i) {
-				rendered_color = rgb( tcolor[3*i], tcolor[3*i+1], tcolor[3*i+2]);
-				if (scene.coloranaglyph)
-					rendered_color = rendered_color.desaturate();
-				else
-					rendered_color = rendered_color.grayscale();
-				tcolor[3*i] = rendered_color.red;
-				tcolor[3*i+1] = rendered_color.green;
-				tcolor[3*i+2] = rendered_color.blue;
-			}
-		}
-	}
-	return mono;
-}
-
 // There were unsolvable problems with rotate. See comments with intrude routine.
 /*
 void
@@ -710,34 +678,167 @@ extrusion::rotate( double angle, const vector& _axis, const vector& origin)
 }
 */
 
+void
+extrusion::update_mesh()
+{
+	size_t first = count; // the first point changed since the mesh was extruded
+	size_t begin, end;
+	if (pos.take_dirty( begin, end))
+		first = std::min( first, begin - pos.offset());
+	if (color.take_dirty( begin, end))
+		first = std::min( first, begin - color.offset());
+	if (scale.take_dirty( begin, end))
+		first = std::min( first, begin - scale.offset());
+
+	const bool moved = pos.offset() != mesh_offset; // points were dropped from the front
+	if (!mesh_changed && !moved && count == mesh_count && first >= count)
+		return;
+
+	// Points appended to an open path that is shown up to its last point only
+	// change the segment to the previous last point, and the end face.
+	size_t resume = 0;
+	if (!mesh_changed && !moved && !mesh_closed && mesh_count >= 3
+			&& count > mesh_count && first >= mesh_count
+			&& this->end == -1 && start >= 0 && size_t(start) + 3 <= mesh_count)
+		resume = mesh_count - 1;
+
+	size_t kept = extrude( mesh_pos, mesh_normals, mesh_colors, false, resume);
+	mesh_uploaded = std::min( mesh_uploaded, kept);
+	mesh_changed = false;
+	mesh_count = count;
+	mesh_offset = pos.offset();
+}
+
 void
 extrusion::gl_render( const view& scene)
 {
-	std::vector<vector> faces_pos;
-	std::vector<vector> faces_normals;
-	std::vector<vector> faces_colors;
+	update_mesh();
+	if (mesh_pos.empty())
+		return;
+
 	clear_gl_error();
-	gl_enable_client vertex_arrays( GL_VERTEX_ARRAY);
-	gl_enable_client normal_arrays( GL_NORMAL_ARRAY);
-	gl_enable_client colors( GL_COLOR_ARRAY);
-	gl_enable cull_face( GL_CULL_FACE);
-	extrude(scene, faces_pos, faces_normals, faces_colors, false);
-	glDisableClientState( GL_VERTEX_ARRAY);
-	glDisableClientState( GL_NORMAL_ARRAY);
-	glDisableClientState( GL_COLOR_ARRAY);
+	{
+		// The mesh is extruded in world coordinates, as for faces, and
+		// GL_NORMALIZE takes care of the normals.
+		gl_matrix_stackguard guard;
+		glScaled( scene.gcfvec[0], scene.gcfvec[1], scene.gcfvec[2]);
+
+		gl_enable_client vertex_arrays( GL_VERTEX_ARRAY);
+		gl_enable_client normal_arrays( GL_NORMAL_ARRAY);
+		gl_enable_client colors( GL_COLOR_ARRAY);
+		gl_enable cull_face( GL_CULL_FACE);
+
+		if (scene.glext.ARB_vertex_buffer_object)
+			gl_render_buffers( scene);
+		else
+			gl_render_arrays( scene);
+	}
 	check_gl_error();
 }
 
+bool
+extrusion::ray_intersect( const pick_ray& ray, pick_hit& hit)
+{
+	// Python may have changed the path since the last frame, so bring the
+	// mesh up to date, as gl_render() would.
+	update_mesh();
+	bool ret = false;
+	for (size_t i = 0; i + 2 < mesh_pos.size(); i += 3)
+		if (ray_triangle( ray.origin, ray.dir,
+				mesh_pos[i], mesh_pos[i+1], mesh_pos[i+2], hit.t))
+			ret = true;
+	return ret;
+}
+
+namespace {
+
+// The colors of the mesh for an anaglyph view.
+void
+anaglyph_colors( const view& scene, const std::vector<vector>& colors,
+	std::vector<rgb>& tcolor)
+{
+	tcolor.reserve( colors.size());
+	for (std::vector<vector>::const_iterator i = colors.begin(); i != colors.end(); ++i) {
+		if (scene.coloranaglyph)
+			tcolor.push_back( rgb( i->x, i->y, i->z).desaturate());
+		else
+			tcolor.push_back( rgb( i->x, i->y, i->z).grayscale());
+	}
+}
+
+// Copy vertices [begin, end) of data into buffer, as floats.  If the buffer
+// has to grow, all of them are copied instead.
+void
+upload_vectors( const view& scene, const std::vector<vector>& data,
+	size_t begin, vertex_buffer& buffer)
+{
+	size_t end = data.size();
+	if (buffer.reserve( scene, 3*end))
+		begin = 0;
+	if (begin >= end)
+		return;
+	std::vector<float> tmp;
+	tmp.reserve( 3*(end-begin));
+	for (size_t i = begin; i < end; ++i) {
+		tmp.push_back( data[i].x);
+		tmp.push_back( data[i].y);
+		tmp.push_back( data[i].z);
+	}
+	buffer.upload( scene, 3*begin, tmp.size(), &tmp[0]);
+}
+
+} // !namespace (anonymous)
+
+void
+extrusion::gl_render_buffers( const view& scene)
+{
+	upload_vectors( scene, mesh_pos, mesh_uploaded, mesh_pos_buffer);
+	upload_vectors( scene, mesh_normals, mesh_uploaded, mesh_normal_buffer);
+	upload_vectors( scene, mesh_colors, mesh_uploaded, mesh_color_buffer);
+	mesh_uploaded = mesh_pos.size();
+
+	mesh_pos_buffer.gl_bind( scene);
+	glVertexPointer( 3, GL_FLOAT, 0, 0);
+	mesh_normal_buffer.gl_bind( scene);
+	glNormalPointer( GL_FLOAT, 0, 0);
+
+	std::vector<rgb> tcolor;
+	if (scene.anaglyph) {
+		vertex_buffer::gl_unbind( scene);
+		anaglyph_colors( scene, mesh_colors, tcolor);
+		glColorPointer( 3, GL_FLOAT, 0, &tcolor[0]);
+	}
+	else {
+		mesh_color_buffer.gl_bind( scene);
+		glColorPointer( 3, GL_FLOAT, 0, 0);
+	}
+	vertex_buffer::gl_unbind( scene);
+
+	glDrawArrays( GL_TRIANGLES, 0, mesh_pos.size());
+}
+
+void
+extrusion::gl_render_arrays( const view& scene)
+{
+	glVertexPointer( 3, GL_DOUBLE, 0, &mesh_pos[0]);
+	glNormalPointer( GL_DOUBLE, 0, &mesh_normals[0]);
+
+	std::vector<rgb> tcolor;
+	if (scene.anaglyph) {
+		anaglyph_colors( scene, mesh_colors, tcolor);
+		glColorPointer( 3, GL_FLOAT, 0, &tcolor[0]);
+	}
+	else
+		glColorPointer( 3, GL_DOUBLE, 0, &mesh_colors[0]);
+
+	glDrawArrays( GL_TRIANGLES, 0, mesh_pos.size());
+}
+
 boost::python::object extrusion::_faces_render() {
-	// Mock up scene machinery:
-	gl_extensions glext;
-	double gcf = 1.0;
-	view scene( vector(0,0,1), vector(0,0,0), 400,
-		400, false, gcf, vector(gcf,gcf,gcf), false, glext);
 	std::vector<vector> faces_pos;
 	std::vector<vector> faces_normals;
 	std::vector<vector> faces_colors;
-	extrude( scene, faces_pos, faces_normals, faces_colors, true);
+	extrude( faces_pos, faces_normals, faces_colors, true);
 	std::vector<npy_intp> dimens(2);
 	size_t d = faces_pos.size(); // number of pos vectors (3*d doubles)
 	dimens[0] = 3*d; // make array of vectors 3d long (pos, normals, colors)
@@ -749,6 +850,32 @@ boost::python::object extrusion::_faces_render() {
 	return faces_data;
 }
 
+namespace {
+
+// Append the triangles of a triangle strip, keeping their winding.
+void
+strip_triangles(const std::vector<vector>& tristrip,
+		const std::vector<vector>& snormals,
+		const std::vector<vector>& endcolors,
+		std::vector<vector>& faces_pos,
+		std::vector<vector>& faces_normals,
+		std::vector<vector>& faces_colors)
+{
+	for (size_t n=0; n+2<tristrip.size(); n++) {
+		faces_normals.insert(faces_normals.end(), snormals.begin()+n, snormals.begin()+n+3);
+		faces_colors.insert(faces_colors.end(), endcolors.begin()+n, endcolors.begin()+n+3);
+		if (n % 2) { // if odd
+			faces_pos.push_back(tristrip[n]);
+			faces_pos.push_back(tristrip[n+2]);
+			faces_pos.push_back(tristrip[n+1]);
+		} else {
+			faces_pos.insert(faces_pos.end(), tristrip.begin()+n, tristrip.begin()+n+3);
+		}
+	}
+}
+
+} // !namespace (anonymous)
+
 void
 extrusion::render_end(const vector V, const vector current,
 		const double c11, const double c12, const double c21, const double c22,
@@ -757,7 +884,8 @@ extrusion::render_end(const vector V, const vector current,
 		std::vector<vector>& faces_normals,
 		std::vector<vector>& faces_colors, bool make_faces)
 {
-	// if (make_faces && show_first), make the first set of triangles else make the second set
+	// if (make_faces && show_first), make the first set of triangles else make the second set;
+	// if (!make_faces && twosided), make both
 
 	// Use the triangle strips in "strips" to paint an end of the extrusion
 	size_t npstrips = pstrips[0]; // number of triangle strips in the cross section
@@ -777,25 +905,8 @@ extrusion::render_end(const vector V, const vector current,
 			endcolors[n] = current_color;
 		}
 
-		if (!make_faces && (show_first || twosided)) {
-			glNormalPointer( GL_DOUBLE, 0, &snormals[0]);
-			glVertexPointer(3, GL_DOUBLE, 0, &tristrip[0]);
-			glColorPointer(3, GL_DOUBLE, 0, &endcolors[0]);
-			// nd doubles, nd/2 vertices
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, nd/2);
-		} else if (make_faces && show_first){
-			for (size_t pt=0, n=0; pt<(nd-4); pt+=2, n++) {
-				faces_normals.insert(faces_normals.end(), snormals.begin()+n, snormals.begin()+n+3);
-				faces_colors.insert(faces_colors.end(), endcolors.begin()+n, endcolors.begin()+n+3);
-				if (n % 2) { // if odd
-					faces_pos.push_back(tristrip[n]);
-					faces_pos.push_back(tristrip[n+2]);
-					faces_pos.push_back(tristrip[n+1]);
-				} else {
-					faces_pos.insert(faces_pos.end(), tristrip.begin()+n, tristrip.begin()+n+3);
-				}
-			}
-		}
+		if (show_first || (!make_faces && twosided))
+			strip_triangles(tristrip, snormals, endcolors, faces_pos, faces_normals, faces_colors);
 
 		// Make two-sided:
 		for (size_t pt=0, n=0; pt<nd; pt+=2, n++) {
@@ -815,22 +926,8 @@ extrusion::render_end(const vector V, const vector current,
 			snormals[n] = -V;
 		}
 
-		if (!make_faces && (!show_first || twosided)) {
-			// nd doubles, nd/2 vertices
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, nd/2);
-		} else if (make_faces && !show_first){
-			for (size_t pt=0, n=0; pt<(nd-4); pt+=2, n++) {
-				faces_normals.insert(faces_normals.end(), snormals.begin()+n, snormals.begin()+n+3);
-				faces_colors.insert(faces_colors.end(), endcolors.begin()+n, endcolors.begin()+n+3);
-				if (n % 2) { // if odd
-					faces_pos.push_back(tristrip[n]);
-					faces_pos.push_back(tristrip[n+2]);
-					faces_pos.push_back(tristrip[n+1]);
-				} else {
-					faces_pos.insert(faces_pos.end(), tristrip.begin()+n, tristrip.begin()+n+3);
-				}
-			}
-		}
+		if (!show_first || (!make_faces && twosided))
+			strip_triangles(tristrip, snormals, endcolors, faces_pos, faces_normals, faces_colors);
 	}
 }
 
@@ -910,11 +1007,10 @@ extrusion::render_end(const vector V, const vector current,
 }
 */
 
-void
-extrusion::extrude( const view& scene,
-		std::vector<vector>& faces_pos,
+size_t
+extrusion::extrude(std::vector<vector>& faces_pos,
 		std::vector<vector>& faces_normals,
-		std::vector<vector>& faces_colors, bool make_faces)
+		std::vector<vector>& faces_colors, bool make_faces, size_t resume)
 {
 	// TODO: A twist of 0.1 shows surface breaks, even with very small smooth....?
 
@@ -1007,14 +1103,22 @@ extrusion::extrude( const view& scene,
 	// As a result, the rotate method has been removed from extrusions. As with the other array
 	// objects (curve, points, faces, convex), put the extrusion in a frame and rotate the frame.
 
-	const int LINE_LENGTH = 1000; // The maximum number of points to display.
-	// Data storage for the position and color data (plus room for extra point in the case of a closed contour)
-	double spos[3*(LINE_LENGTH+3+3+3)]; // room for extra point if startcorner and endcorner in same step
-	double tcolor[3*(LINE_LENGTH+3+3+3)];
-	float tscale[3*(LINE_LENGTH+3+3+3)]; // scale factors, and twist
-	float fstep = (float)(count-1)/(float)(LINE_LENGTH-1);
-	if (fstep < 1.0F) fstep = 1.0F;
-	size_t iptr=0, iptr3, pcount=0;
+	// Paths are no longer decimated to a maximum number of points; the mesh is
+	// kept until the geometry changes, so even long paths are extruded rarely.
+	const size_t no_corner = (size_t)-1;
+	if (resume && (make_faces || resume >= mesh_corner.size() || mesh_corner[resume] == no_corner))
+		resume = 0;
+	if (!resume) {
+		faces_pos.clear();
+		faces_normals.clear();
+		faces_colors.clear();
+	}
+
+	// Data storage for the position and color data (plus room for an extra point in the case of a closed contour)
+	std::vector<double> spos(3*(count+2));
+	std::vector<double> tcolor(3*(count+2));
+	std::vector<float> tscale(3*(count+2)); // scale factors, and twist
+	size_t pcount=0;
 
 	const double* v_i = pos.data();
 	const double* cd_i = color.data();
@@ -1025,14 +1129,14 @@ extrusion::extrude( const view& scene,
 	} else {
 		if (start < 0) {
 			if (((int)count+start) < 0) {
-				return; // nothing to display
+				return 0; // nothing to display
 			} else {
 				startcorner = int(count)+start;
 			}
 		} else {
 			startcorner = start;
 		}
-		if (startcorner > count-1) return; // nothing to display
+		if (startcorner > count-1) return 0; // nothing to display
 	}
 
 	if (count == 0) {
@@ -1040,14 +1144,14 @@ extrusion::extrude( const view& scene,
 	} else {
 		if (end < 0) {
 			if (((int)count+end) < 0) {
-				return; // nothing to display
+				return 0; // nothing to display
 			} else {
 				endcorner = int(count)+end;
 			}
 		} else {
 			endcorner = end;
 		}
-		if (endcorner < startcorner) return; // nothing to display
+		if (endcorner < startcorner) return 0; // nothing to display
 	}
 
 	if (count < 1) {
@@ -1060,66 +1164,28 @@ extrusion::extrude( const view& scene,
 		tscale[1] = sd_i[1];
 		tscale[2] = sd_i[2];
 	} else {
-		size_t tstart = startcorner;
-		size_t tend = endcorner;
-		size_t stepsize = (int)(fstep+.5);
-		// Choose which points to display
-		for (float fptr=0.0; iptr < count && pcount < LINE_LENGTH; fptr += fstep, iptr = (int)(fptr+.5), ++pcount) {
-			size_t startoffset = 0;
-			size_t endoffset = 0;
-			// Make sure that startcorner is in the display set
-			if (stepsize > 1 && startcorner >= iptr && startcorner < iptr+stepsize) {
-				startoffset = startcorner-iptr;
-				tstart = pcount;
-			}
-
-			iptr3 = 3*(iptr+startoffset);
-			spos[3*pcount  ] = scene.gcf*v_i[iptr3];
-			spos[3*pcount+1] = scene.gcf*v_i[iptr3+1];
-			spos[3*pcount+2] = scene.gcf*v_i[iptr3+2];
-			tcolor[3*pcount  ] = cd_i[iptr3];
-			tcolor[3*pcount+1] = cd_i[iptr3+1];
-			tcolor[3*pcount+2] = cd_i[iptr3+2];
-			tscale[3*pcount  ] = sd_i[iptr3];
-			tscale[3*pcount+1] = sd_i[iptr3+1];
-			tscale[3*pcount+2] = sd_i[iptr3+2];
-
-			// Make sure that endcorner is in the display set
-			if (stepsize > 1 && endcorner >= iptr && endcorner < iptr+stepsize) {
-				endoffset = endcorner-iptr;
-				if (endcorner == startcorner) {
-					// Already have this point
-					tend = tstart;
-				} else if (iptr == count-1) {
-					tend = pcount;
-				} else {
-					iptr3 = 3*(iptr+endoffset);
-					spos[3*pcount  ] = scene.gcf*v_i[iptr3];
-					spos[3*pcount+1] = scene.gcf*v_i[iptr3+1];
-					spos[3*pcount+2] = scene.gcf*v_i[iptr3+2];
-					tcolor[3*pcount  ] = cd_i[iptr3];
-					tcolor[3*pcount+1] = cd_i[iptr3+1];
-					tcolor[3*pcount+2] = cd_i[iptr3+2];
-					tscale[3*pcount  ] = sd_i[iptr3];
-					tscale[3*pcount+1] = sd_i[iptr3+1];
-					tscale[3*pcount+2] = sd_i[iptr3+2];
-					pcount += 1;
-					tend = pcount;
-				}
-			}
+		pcount = count;
+		for (size_t i=0; i<3*count; i++) {
+			spos[i] = v_i[i];
+			tcolor[i] = cd_i[i];
+			tscale[i] = sd_i[i];
 		}
-		startcorner = tstart;
-		endcorner = tend;
+		if (endcorner > count-1) endcorner = count-1;
 	}
 
 	size_t ncontours = pcontours[0];
-	if (ncontours == 0) return;
+	if (ncontours == 0) return 0;
 	size_t npoints = contours.size()/2; // total number of 2D points in all contours
 
 	// 3 positions and normals per triangle, and the number of triangles = 2 times the number of points in the 2D shape,
-	// times 2 for front and back of each triangle. Allocate space to hold the largest contour:
-	size_t maxtriangles = 12*maxcontour;
-	std::vector<vector> tris(maxtriangles), normals(maxtriangles), tcolors(maxtriangles);
+	// times 2 for front and back of each triangle.
+	size_t segment_vertices = 0;
+	for (size_t c=0; c < ncontours; c++) {
+		size_t nd = 2*pcontours[2*c+2]; // number of doubles in this contour
+		segment_vertices += 6*(shape_closed ? nd/2 : nd/2-1);
+	}
+	if (!make_faces && twosided) segment_vertices *= 2;
+	std::vector<segment> segments;
 
 	vector xaxis, yaxis; // local unit-vector axes on the 2D shape
 	vector prevxaxis, prevyaxis; // local unit-vector axes on the 2D shape on preceding segment
@@ -1135,20 +1201,19 @@ extrusion::extrude( const view& scene,
 	// vector extcenter = vector(0,0,0); // the geometric center of the extrusion (apparently not used)
 
 	// pos and color iterators
-	v_i = spos;
-	const double* c_i = tcolor;
-	const float* s_i = tscale;
+	v_i = &spos[0];
+	const double* c_i = &tcolor[0];
+	const float* s_i = &tscale[0];
 
 	vector current_color = vector(tcolor[0], tcolor[1], tcolor[2]);
 	vector prev_color = current_color;
 	const vector initial_face_color = vector(c_i[0], c_i[1], c_i[2]);
 	const vector final_face_color = vector(c_i[3*(pcount-1)], c_i[3*(pcount-1)+1], c_i[3*(pcount-1)+2]);
 
-	if (!make_faces) bool mono = adjust_colors( scene, tcolor, pcount);
 	bool closed = false;
 	if (pcount > 2) {
 		double path_length = 0.0;
-		double* p=spos;
+		double* p=&spos[0];
 		for (size_t n=0; n<(pcount-1); n++, p+=3) {
 			path_length += (vector(&p[3]) - vector(&p[0])).mag();
 		}
@@ -1207,6 +1272,23 @@ extrusion::extrude( const view& scene,
 
 	size_t lastpoint = pcount-1;
 
+	// Closing the path changes the joint at its first point, so all of it is made again.
+	if (resume && closed) {
+		resume = 0;
+		faces_pos.clear();
+		faces_normals.clear();
+		faces_colors.clear();
+	}
+	const size_t kept = resume ? mesh_corner[resume] : 0;
+	if (!make_faces) {
+		faces_pos.resize(kept);
+		faces_normals.resize(kept);
+		faces_colors.resize(kept);
+		mesh_corner.resize(resume);
+		mesh_corner.resize(pcount+1, no_corner);
+		mesh_closed = closed;
+	}
+
 	if (make_faces) {
 		// Calculate the total number of triangles
 		// contours.size()/2 is number of vertices in the 2D shape
@@ -1229,6 +1311,8 @@ extrusion::extrude( const view& scene,
 
 	for (size_t corner = 0; corner <= endcorner; ++corner, v_i += 3, c_i += 3, s_i += 3) {
 		size_t icorner = corner;
+		const bool emit = icorner >= resume; // the triangles of earlier points were kept
+		if (!make_faces && emit) mesh_corner[icorner] = faces_pos.size();
 		current = vector(&v_i[0]);
 		current_color = vector(c_i[0], c_i[1], c_i[2]);
 
@@ -1376,8 +1460,6 @@ extrusion::extrude( const view& scene,
 		} else {
 			xrot = bisecting_plane_normal.cross(y)/axlecos; // make xrot a non-unit vector, in the plane of the joint, to correct for rotation about axle
 		}
-		xrot *= scene.gcf;
-		y *= scene.gcf;
 
 		// update xaxis and yaxis across the joint
 		if (icorner == 0) { // special handling due to initial setup of point 0
@@ -1415,7 +1497,7 @@ extrusion::extrude( const view& scene,
 				vector icolor = current_color;
 				if (startcorner == 0) icolor = initial_face_color;
 				rendered_initial_face = true;
-				render_end(-bisecting_plane_normal, current, c11, c12, c21, c22, xrot, y, icolor, true,
+				if (emit) render_end(-bisecting_plane_normal, current, c11, c12, c21, c22, xrot, y, icolor, true,
 						faces_pos, faces_normals, faces_colors, make_faces);
 			}
 
@@ -1426,14 +1508,14 @@ extrusion::extrude( const view& scene,
 				if (show_start) {
 					// Use pstrips to paint both sides of the first surface
 					if (startcorner == 0) {
-						render_end(prevxrot.cross(prevy).norm(), prev, prevc11, prevc12, prevc21, prevc22,
+						if (emit) render_end(prevxrot.cross(prevy).norm(), prev, prevc11, prevc12, prevc21, prevc22,
 								prevxrot, prevy, initial_face_color, true, faces_pos, faces_normals, faces_colors, make_faces);
 					} else {
 						if (startcorner <= corner) { // if starting at pos 1
-							render_end(-lastA.rotate(-2*alpha, y), current, c11, c12, c21, c22,
+							if (emit) render_end(-lastA.rotate(-2*alpha, y), current, c11, c12, c21, c22,
 									xrot, y, current_color, true, faces_pos, faces_normals, faces_colors, make_faces);
 						} else if (endcorner <= corner) { // if ending at pos 1
-							render_end(-bisecting_plane_normal, current, c11, c12, c21, c22,
+							if (emit) render_end(-bisecting_plane_normal, current, c11, c12, c21, c22,
 									xrot, y, current_color, true, faces_pos, faces_normals, faces_colors, make_faces);
 						}
 					}
@@ -1444,121 +1526,51 @@ extrusion::extrude( const view& scene,
 				vector lastnormal = -bisecting_plane_normal;
 				if (!closed && (corner == lastpoint) && prevsmoothed) {
 					lastnormal = lastnormal.rotate(lastalpha, y);
-					xrot = xrot.rotate(lastalpha,y).norm()*scene.gcf;
+					xrot = xrot.rotate(lastalpha,y).norm();
 				}
 				// Use pstrips to paint both sides of the last surface
 				vector icolor = current_color;
 				if (corner == lastpoint) icolor = final_face_color;
-				render_end(lastnormal, current, c11, c12, c21, c22,
+				if (emit) render_end(lastnormal, current, c11, c12, c21, c22,
 						xrot, y, icolor, false, faces_pos, faces_normals, faces_colors, make_faces);
 			}
 
-			if (corner > startcorner && corner <= endcorner) {
-
-				if (!make_faces) {
-					glVertexPointer(3, GL_DOUBLE, 0, &tris[0]);
-					glNormalPointer( GL_DOUBLE, 0, &normals[0]);
-					glColorPointer(3, GL_DOUBLE, 0, &tcolors[0]);
-				}
-
-				//vector color_old = prev_color; // color at previous location along the curve
-				//vector color_new = current_color; // color at current location along the curve
-				double v0x, v0y, v1x, v1y, prevv0x, prevv0y, prevv1x, prevv1y;
-				// The following nested for loops is (necessarily) the same as that used to build the normals2D array.
-				for (size_t c=0, nbase=0; c < ncontours; c++) {
-					size_t nd = 2*pcontours[2*c+2]; // number of doubles in this contour
-					size_t base = 2*pcontours[2*c+3]; // initial (x,y) = (contour[base], contour[base+1])
-					size_t b0, b1, b2, b3;
-					// Triangle order is
-					//    previous v0, current v1, current v0, previous v1, current v1, previous v0.
-					// Render front and back of each triangle.
-					for (size_t pt=0, i=0; pt<nd; pt+=2, i+=6, nbase+=4) {
-						if (pt == nd-2 && !shape_closed) break;
-						// Use modulo arithmetic here because last point is the first point, going around the sides of the extrusion
-						b0 = base+pt;
-						b1 = b0+1;
-						b2 = base+((pt+2)%nd);
-						b3 = base+((pt+3)%nd);
-						prevv0x = prevc11*contours[b0] + prevc12*contours[b1];
-						prevv0y = prevc21*contours[b0] + prevc22*contours[b1];
-						prevv1x = prevc11*contours[b2] + prevc12*contours[b3];
-						prevv1y = prevc21*contours[b2] + prevc22*contours[b3];
-						v0x =     c11*contours[b0]     + c12*contours[b1];
-						v0y =     c21*contours[b0]     + c22*contours[b1];
-						v1x =     c11*contours[b2]     + c12*contours[b3];
-						v1y =     c21*contours[b2]     + c22*contours[b3];
-
-						tris[i  ] = prev    + prevxrot*prevv0x + prevy*prevv0y;
-						tris[i+1] = prev    + prevxrot*prevv1x + prevy*prevv1y;
-						tris[i+2] = current +     xrot*v0x     + y*v0y;
-						tris[i+3] = tris[i+1];
-						tris[i+4] = current +     xrot*v1x     + y*v1y;
-						tris[i+5] = tris[i+2];
-
-						tcolors[i  ] = prev_color;
-						tcolors[i+1] = prev_color;
-						tcolors[i+2] = current_color;
-						tcolors[i+3] = tcolors[i+1];
-						tcolors[i+4] = current_color;
-						tcolors[i+5] = tcolors[i+2];
-
-						normals[i  ] = smoothing(     s_i[1]*xaxis*normals2D[nbase  ] +      s_i[0]*yaxis*normals2D[nbase+1],
-												 s_i[-2]*prevxaxis*normals2D[nbase  ] + s_i[-3]*prevyaxis*normals2D[nbase+1]);
-
-						normals[i+1] = smoothing(     s_i[1]*xaxis*normals2D[nbase+2] +      s_i[0]*yaxis*normals2D[nbase+3],
-												 s_i[-2]*prevxaxis*normals2D[nbase+2] + s_i[-3]*prevyaxis*normals2D[nbase+3]);
-
-						normals[i+2] = smoothing(     s_i[1]*xaxis*normals2D[nbase  ] +      s_i[0]*yaxis*normals2D[nbase+1],
-												 s_i[-2]*nextxaxis*normals2D[nbase  ] + s_i[-3]*nextyaxis*normals2D[nbase+1]);
-
-						normals[i+3] = normals[i+1]; // i+1 and i+3 are the same location
-
-						normals[i+4] = smoothing(     s_i[1]*xaxis*normals2D[nbase+2] +      s_i[0]*yaxis*normals2D[nbase+3],
-												 s_i[-2]*nextxaxis*normals2D[nbase+2] + s_i[-3]*nextyaxis*normals2D[nbase+3]);
-
-						normals[i+5] = normals[i+2]; // i+2 and i+5 are the same location
-
-						if (!make_faces && twosided) {
-							// vertices, normals, and colors for other side
-							tris[3*nd+i+1] = tris[i  ];
-							tris[3*nd+i  ] = tris[i+1];
-							tris[3*nd+i+2] = tris[i+2];
-							tris[3*nd+i+3] = tris[i+3];
-							tris[3*nd+i+5] = tris[i+4];
-							tris[3*nd+i+4] = tris[i+5];
-
-							normals[3*nd+i+1] = -normals[i  ];
-							normals[3*nd+i  ] = -normals[i+1];
-							normals[3*nd+i+2] = -normals[i+2];
-							normals[3*nd+i+3] = -normals[i+3];
-							normals[3*nd+i+5] = -normals[i+4];
-							normals[3*nd+i+4] = -normals[i+5];
-
-							tcolors[3*nd+i+1] = tcolors[i  ];
-							tcolors[3*nd+i  ] = tcolors[i+1];
-							tcolors[3*nd+i+2] = tcolors[i+2];
-							tcolors[3*nd+i+3] = tcolors[i+3];
-							tcolors[3*nd+i+5] = tcolors[i+4];
-							tcolors[3*nd+i+4] = tcolors[i+5];
-						}
-
-						if (make_faces) {
-							faces_pos.insert(faces_pos.end(), tris.begin()+i, tris.begin()+i+6);
-							faces_normals.insert(faces_normals.end(), normals.begin()+i, normals.begin()+i+6);
-							faces_colors.insert(faces_colors.end(), tcolors.begin()+i, tcolors.begin()+i+6);
-						}
-					}
-
-					if (!make_faces) {
-						// nd doubles, nd/2 vertices, 2 triangles per vertex,
-						//    3 points per triangle, 2 sides, so 6*nd vertices per extrusion segment
-						if (twosided) {
-							glDrawArrays(GL_TRIANGLES, 0, 6*nd);
-						} else {
-							glDrawArrays(GL_TRIANGLES, 0, 3*nd);
-						}
-					}
-				}
+			if (emit && corner > startcorner && corner <= endcorner) {
+				// The sides of the segment from prev to current only depend on
+				// the joints at its ends, so they are made after the whole path
+				// has been walked, into the place kept for them here.
+				segment seg;
+				seg.prev = prev;
+				seg.current = current;
+				seg.prevxrot = prevxrot;
+				seg.prevy = prevy;
+				seg.xrot = xrot;
+				seg.y = y;
+				seg.prevxaxis = prevxaxis;
+				seg.prevyaxis = prevyaxis;
+				seg.xaxis = xaxis;
+				seg.yaxis = yaxis;
+				seg.nextxaxis = nextxaxis;
+				seg.nextyaxis = nextyaxis;
+				seg.prev_color = prev_color;
+				seg.current_color = current_color;
+				seg.prevc11 = prevc11;
+				seg.prevc12 = prevc12;
+				seg.prevc21 = prevc21;
+				seg.prevc22 = prevc22;
+				seg.c11 = c11;
+				seg.c12 = c12;
+				seg.c21 = c21;
+				seg.c22 = c22;
+				seg.prevscalex = s_i[-3];
+				seg.prevscaley = s_i[-2];
+				seg.scalex = s_i[0];
+				seg.scaley = s_i[1];
+				seg.offset = faces_pos.size();
+				segments.push_back(seg);
+				faces_pos.resize(faces_pos.size() + segment_vertices);
+				faces_normals.resize(faces_normals.size() + segment_vertices);
+				faces_colors.resize(faces_colors.size() + segment_vertices);
 			}
 		}
 		prevx = x;
@@ -1578,6 +1590,117 @@ extrusion::extrude( const view& scene,
 		prev_color = vector(c_i[0], c_i[1], c_i[2]);
 		prevsmoothed = smoothed;
 	}
+
+	// Each segment writes only to its own place in the arrays, so long paths
+	// divide the segments between worker threads.
+	if (segments.size()*segment_vertices >= parallel_vertices)
+		parallel_for(segments.size(), 64, boost::bind(&extrusion::extrude_sides, this,
+				boost::cref(segments), &faces_pos, &faces_normals, &faces_colors, make_faces, _1, _2));
+	else
+		extrude_sides(segments, &faces_pos, &faces_normals, &faces_colors, make_faces, 0, segments.size());
+	return kept;
+}
+
+void
+extrusion::extrude_sides(const std::vector<segment>& segments,
+		std::vector<vector>* faces_pos,
+		std::vector<vector>* faces_normals,
+		std::vector<vector>* faces_colors, bool make_faces, size_t begin, size_t end)
+{
+	const size_t ncontours = pcontours[0];
+	const bool back = !make_faces && twosided;
+	for (size_t k=begin; k<end; k++) {
+		const segment& g = segments[k];
+		vector* tris = &(*faces_pos)[g.offset];
+		vector* normals = &(*faces_normals)[g.offset];
+		vector* tcolors = &(*faces_colors)[g.offset];
+
+		double v0x, v0y, v1x, v1y, prevv0x, prevv0y, prevv1x, prevv1y;
+		// The following nested for loops is (necessarily) the same as that used to build the normals2D array.
+		for (size_t c=0, nbase=0; c < ncontours; c++) {
+			size_t nd = 2*pcontours[2*c+2]; // number of doubles in this contour
+			size_t base = 2*pcontours[2*c+3]; // initial (x,y) = (contour[base], contour[base+1])
+			size_t b0, b1, b2, b3;
+			// Triangle order is
+			//    previous v0, current v1, current v0, previous v1, current v1, previous v0.
+			// Make front and back of each triangle.
+			for (size_t pt=0; pt<nd; pt+=2, nbase+=4) {
+				if (pt == nd-2 && !shape_closed) break;
+				// Use modulo arithmetic here because last point is the first point, going around the sides of the extrusion
+				b0 = base+pt;
+				b1 = b0+1;
+				b2 = base+((pt+2)%nd);
+				b3 = base+((pt+3)%nd);
+				prevv0x = g.prevc11*contours[b0] + g.prevc12*contours[b1];
+				prevv0y = g.prevc21*contours[b0] + g.prevc22*contours[b1];
+				prevv1x = g.prevc11*contours[b2] + g.prevc12*contours[b3];
+				prevv1y = g.prevc21*contours[b2] + g.prevc22*contours[b3];
+				v0x =     g.c11*contours[b0]     + g.c12*contours[b1];
+				v0y =     g.c21*contours[b0]     + g.c22*contours[b1];
+				v1x =     g.c11*contours[b2]     + g.c12*contours[b3];
+				v1y =     g.c21*contours[b2]     + g.c22*contours[b3];
+
+				tris[0] = g.prev    + g.prevxrot*prevv0x + g.prevy*prevv0y;
+				tris[1] = g.prev    + g.prevxrot*prevv1x + g.prevy*prevv1y;
+				tris[2] = g.current +     g.xrot*v0x     + g.y*v0y;
+				tris[3] = tris[1];
+				tris[4] = g.current +     g.xrot*v1x     + g.y*v1y;
+				tris[5] = tris[2];
+
+				tcolors[0] = g.prev_color;
+				tcolors[1] = g.prev_color;
+				tcolors[2] = g.current_color;
+				tcolors[3] = tcolors[1];
+				tcolors[4] = g.current_color;
+				tcolors[5] = tcolors[2];
+
+				normals[0] = smoothing(     g.scaley*g.xaxis*normals2D[nbase  ] +          g.scalex*g.yaxis*normals2D[nbase+1],
+									 g.prevscaley*g.prevxaxis*normals2D[nbase  ] + g.prevscalex*g.prevyaxis*normals2D[nbase+1]);
+
+				normals[1] = smoothing(     g.scaley*g.xaxis*normals2D[nbase+2] +          g.scalex*g.yaxis*normals2D[nbase+3],
+									 g.prevscaley*g.prevxaxis*normals2D[nbase+2] + g.prevscalex*g.prevyaxis*normals2D[nbase+3]);
+
+				normals[2] = smoothing(     g.scaley*g.xaxis*normals2D[nbase  ] +          g.scalex*g.yaxis*normals2D[nbase+1],
+									 g.prevscaley*g.nextxaxis*normals2D[nbase  ] + g.prevscalex*g.nextyaxis*normals2D[nbase+1]);
+
+				normals[3] = normals[1]; // 1 and 3 are the same location
+
+				normals[4] = smoothing(     g.scaley*g.xaxis*normals2D[nbase+2] +          g.scalex*g.yaxis*normals2D[nbase+3],
+									 g.prevscaley*g.nextxaxis*normals2D[nbase+2] + g.prevscalex*g.nextyaxis*normals2D[nbase+3]);
+
+				normals[5] = normals[2]; // 2 and 5 are the same location
+
+				if (back) {
+					// vertices, normals, and colors for other side
+					tris[7] = tris[0];
+					tris[6] = tris[1];
+					tris[8] = tris[2];
+					tris[9] = tris[3];
+					tris[11] = tris[4];
+					tris[10] = tris[5];
+
+					normals[7] = -normals[0];
+					normals[6] = -normals[1];
+					normals[8] = -normals[2];
+					normals[9] = -normals[3];
+					normals[11] = -normals[4];
+					normals[10] = -normals[5];
+
+					tcolors[7] = tcolors[0];
+					tcolors[6] = tcolors[1];
+					tcolors[8] = tcolors[2];
+					tcolors[9] = tcolors[3];
+					tcolors[11] = tcolors[4];
+					tcolors[10] = tcolors[5];
+				}
+
+				const size_t made = back ? 12 : 6;
+				tris += made;
+				normals += made;
+				tcolors += made;
+			}
+		}
+	}
 }
 
 void
@@ -3,6 +3,7 @@
 // See the file authors.txt for a complete list of contributors.
 
 #include "python/faces.hpp"
+#include "pick_engine.hpp"
 #include <boost/python/tuple.hpp>
 
 #include <map>
@@ -41,6 +42,7 @@ faces::append_rgb( const vector& nv_pos, const vector& nv_normal, float red, flo
 	n[0] = nv_normal.x;
 	n[1] = nv_normal.y;
 	n[2] = nv_normal.z;
+	normal.mark_dirty( count-1, count );
 }
 
 void
@@ -51,6 +53,7 @@ faces::append( const vector& nv_pos, const vector& nv_normal, const rgb& nv_colo
 	n[0] = nv_normal.x;
 	n[1] = nv_normal.y;
 	n[2] = nv_normal.z;
+	normal.mark_dirty( count-1, count );
 }
 
 void
@@ -61,6 +64,7 @@ faces::append( const vector& nv_pos, const vector& nv_normal)
 	n[0] = nv_normal.x;
 	n[1] = nv_normal.y;
 	n[2] = nv_normal.z;
+	normal.mark_dirty( count-1, count );
 }
 
 void
@@ -71,6 +75,7 @@ faces::append( const vector& nv_pos)
 	n[0] = 0.;
 	n[1] = 0.;
 	n[2] = 0.;
+	normal.mark_dirty( count-1, count );
 }
 
 // Define an ordering for the stl-sorting criteria.
@@ -121,6 +126,7 @@ faces::make_normals()
 		norm_i[1] = norm_i[4] = norm_i[7] = ny;
 		norm_i[2] = norm_i[5] = norm_i[8] = nz;
 	}
+	normal.mark_dirty();
 }
 
 void
@@ -170,6 +176,9 @@ faces::make_twosided()
 			color_i[icount+i+6+n] = color_i[i+3+n];
 		}
 	}
+	pos.mark_dirty();
+	normal.mark_dirty();
+	color.mark_dirty();
 }
 
 void
@@ -238,9 +247,11 @@ faces::smooth_d(const float cosangle)
 			similar.clear();
 		}
 	}
+	normal.mark_dirty();
 }
 
 boost::python::object faces::get_normal() {
+	normal.mark_dirty();
 	return normal[all()];
 }
 
@@ -258,7 +269,7 @@ void faces::set_normal( const double_array& n_normal)
 	}
 
 	normal[slice(0, count)] = n_normal;
-	double* norm_i = normal.data();
+	normal.mark_dirty();
 }
 
 void faces::set_normal_v( vector v)
@@ -268,6 +279,7 @@ void faces::set_normal_v( vector v)
 	// Broadcast the new normal across the array.
 	int npoints = count ? count : 1;
 	normal[slice(0, npoints)] = make_tuple( v.x, v.y, v.z);
+	normal.mark_dirty( 0, npoints );
 }
 
 void
@@ -276,62 +288,71 @@ faces::gl_render( const view& scene)
 	if (degenerate())
 		return;
 
-	std::vector<vector> spos;
-	std::vector<rgb> tcolor;
+	// The vertices are given in world coordinates.  Scaling them in the
+	// modelview matrix rather than on the CPU keeps the arrays usable as they
+	// are, and lets GL_NORMALIZE take care of the normals.
+	gl_matrix_stackguard guard;
+	glScaled( scene.gcfvec[0], scene.gcfvec[1], scene.gcfvec[2]);
 
 	gl_enable_client vertexes( GL_VERTEX_ARRAY);
 	gl_enable_client normals( GL_NORMAL_ARRAY);
 	gl_enable_client colors( GL_COLOR_ARRAY);
+	gl_enable cull_face( GL_CULL_FACE);
 
-	glNormalPointer( GL_DOUBLE, 0, normal.data() );
+	if (scene.glext.ARB_vertex_buffer_object)
+		gl_render_buffers( scene);
+	else
+		gl_render_arrays( scene);
+}
 
-	/*
-	// This attempt to minimize loop overhead made no difference in faces rendering speed
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		double gx = scene.gcfvec[0];
-		double gy = scene.gcfvec[1];
-		double gz = scene.gcfvec[2];
-		std::vector<vector> tmp( count);
-		spos.swap( tmp);
-		const double* p = pos.data();
-		double* s = &spos[0][0];
-		size_t i;
-		for (i=0; i<(3*(count-10)); ) { // reduce loop overhead to a minimum
-			s[i   ] = gx*p[i   ]; s[i+1 ] = gy*p[i+1 ]; s[i+2 ] = gz*p[i+2];
-			s[i+3 ] = gx*p[i+3 ]; s[i+4 ] = gy*p[i+4 ]; s[i+5 ] = gz*p[i+5];
-			s[i+6 ] = gx*p[i+6 ]; s[i+7 ] = gy*p[i+7 ]; s[i+8 ] = gz*p[i+8];
-			s[i+9 ] = gx*p[i+9 ]; s[i+10] = gy*p[i+10]; s[i+11] = gz*p[i+11];
-			s[i+12] = gx*p[i+12]; s[i+13] = gy*p[i+13]; s[i+14] = gz*p[i+14];
-			s[i+15] = gx*p[i+15]; s[i+16] = gy*p[i+16]; s[i+17] = gz*p[i+17];
-			s[i+18] = gx*p[i+18]; s[i+19] = gy*p[i+19]; s[i+20] = gz*p[i+20];
-			s[i+21] = gx*p[i+21]; s[i+22] = gy*p[i+22]; s[i+23] = gz*p[i+23];
-			s[i+24] = gx*p[i+24]; s[i+25] = gy*p[i+25]; s[i+26] = gz*p[i+26];
-			s[i+27] = gx*p[i+27]; s[i+28] = gy*p[i+28]; s[i+29] = gz*p[i+29];
-			i += 30;
-		}
-		for (; i<3*count;) {
-			s[i] = gx*p[i]; s[i+1] = gy*p[i+1]; s[i+2] = gz*p[i+2];
-			i += 3;
+void
+faces::gl_render_buffers( const view& scene)
+{
+	const size_t n = count - count%3;
+	size_t begin, end;
+	pos.take_dirty( begin, end);
+	upload_points( scene, pos, begin, end, pos_buffer);
+	normal.take_dirty( begin, end);
+	upload_points( scene, normal, begin, end, normal_buffer);
+
+	pos_buffer.gl_bind( scene);
+	glVertexPointer( 3, GL_FLOAT, 0, buffer_offset( pos));
+	normal_buffer.gl_bind( scene);
+	glNormalPointer( GL_FLOAT, 0, buffer_offset( normal));
+
+	// The anaglyph colors are derived each frame, and leave color_buffer
+	// with its changes still pending for the next normal frame.
+	std::vector<rgb> tcolor;
+	if (scene.anaglyph) {
+		vertex_buffer::gl_unbind( scene);
+		tcolor.reserve( n);
+		const double* color_i = color.data();
+		for (size_t i = 0; i < n; ++i, color_i += 3) {
+			if (scene.coloranaglyph)
+				tcolor.push_back( rgb(color_i).desaturate());
+			else
+				tcolor.push_back( rgb(color_i).grayscale());
 		}
-
-		glVertexPointer( 3, GL_DOUBLE, 0, s);
+		glColorPointer( 3, GL_FLOAT, 0, &tcolor[0]);
 	}
-	else
-		glVertexPointer( 3, GL_DOUBLE, 0, pos.data() );
-	*/
-
-	if (scene.gcf != 1.0 || (scene.gcfvec[0] != scene.gcfvec[1])) {
-		std::vector<vector> tmp( count);
-		spos.swap( tmp);
-		const double* pos_i = pos.data();
-		for (std::vector<vector>::iterator i = spos.begin(); i != spos.end(); ++i) {
-			*i = vector(pos_i).scale(scene.gcfvec);
-			pos_i += 3;
-		}
-		glVertexPointer( 3, GL_DOUBLE, 0, &*spos.begin());
+	else {
+		color.take_dirty( begin, end);
+		upload_points( scene, color, begin, end, color_buffer);
+		color_buffer.gl_bind( scene);
+		glColorPointer( 3, GL_FLOAT, 0, buffer_offset( color));
 	}
-	else
-		glVertexPointer( 3, GL_DOUBLE, 0, pos.data() );
+	vertex_buffer::gl_unbind( scene);
+
+	glDrawArrays( GL_TRIANGLES, 0, n);
+}
+
+void
+faces::gl_render_arrays( const view& scene)
+{
+	std::vector<rgb> tcolor;
+
+	glNormalPointer( GL_DOUBLE, 0, normal.data() );
+	glVertexPointer( 3, GL_DOUBLE, 0, pos.data() );
 
 	if (scene.anaglyph) {
 		std::vector<rgb> tmp( count);
@@ -349,17 +370,26 @@ faces::gl_render( const view& scene)
 	else
 		glColorPointer( 3, GL_DOUBLE, 0, color.data() );
 
-	gl_enable cull_face( GL_CULL_FACE);
 	for (size_t drawn = 0; drawn < count - count%3; drawn += 540) {
 		glDrawArrays( GL_TRIANGLES, drawn,
 			std::min( count - count%3 - drawn, (size_t)540));
 	}
 }
 
-void
-faces::gl_pick_render( const view& scene)
+bool
+faces::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	gl_render( scene);
+	if (degenerate())
+		return false;
+	bool ret = false;
+	const double* pos_i = pos.data();
+	const double* pos_end = pos.data( count - count%3 );
+	for ( ; pos_i < pos_end; pos_i += 9) {
+		if (ray_triangle( ray.origin, ray.dir,
+				vector(pos_i), vector(pos_i+3), vector(pos_i+6), hit.t))
+			ret = true;
+	}
+	return ret;
 }
 
 vector
@@ -406,8 +436,9 @@ faces::get_material_matrix( const view& v, tmatrix& out ) {
 		}
 
 	out.translate( vector(.5,.5,.5) );
-	out.scale( vector(1,1,1) * (.999 / (v.gcf * std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z)))) );
-	out.translate( -.5 * v.gcf * (min_extent + max_extent) );
+	// Object coordinates are world coordinates; the gcf is in the modelview.
+	out.scale( vector(1,1,1) * (.999 / std::max(max_extent.x-min_extent.x, std::max(max_extent.y-min_extent.y, max_extent.z-min_extent.z))) );
+	out.translate( -.5 * (min_extent + max_extent) );
 }
 
 } } // !namespace cvisual::python
@@ -0,0 +1,371 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+#include "python/particles.hpp"
+#include "python/slice.hpp"
+#include "sphere.hpp"
+#include "box.hpp"
+#include "pick_engine.hpp"
+#include "util/depth_sort.hpp"
+#include "util/errors.hpp"
+#include "util/gl_enable.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace cvisual { namespace python {
+
+using boost::python::make_tuple;
+using boost::python::object;
+
+particles::particles()
+	: particle_shape(SPHERE), radius(1), opacity(1), axis(3), radius_exposed(false)
+{
+	radius.data()[0] = 1.0;
+	opacity.data()[0] = 1.0;
+	double* axis_i = axis.data();
+	axis_i[0] = 1.0;
+	axis_i[1] = axis_i[2] = 0.0;
+}
+
+particles::particles( const particles& other)
+	: arrayprim_color(other), particle_shape(other.particle_shape),
+	radius(other.radius), opacity(other.opacity), axis(other.axis),
+	radius_exposed(false)
+{
+}
+
+void
+particles::set_length( size_t new_len)
+{
+	radius.set_length( new_len);
+	opacity.set_length( new_len);
+	axis.set_length( new_len);
+	arrayprim_color::set_length( new_len);
+}
+
+unsigned long
+particles::extent_version()
+{
+	// As for pos, Python may change the radii in place.
+	if (radius_exposed || radius.exposed())
+		extent_changed();
+	radius_exposed = false;
+	return arrayprim::extent_version();
+}
+
+void
+particles::set_shape( const std::string& n_shape)
+{
+	if (n_shape == "sphere")
+		particle_shape = SPHERE;
+	else if (n_shape == "box")
+		particle_shape = BOX;
+	else
+		throw std::invalid_argument( "Unrecognized shape type");
+	extent_changed();
+}
+
+std::string
+particles::get_shape()
+{
+	switch (particle_shape) {
+		case SPHERE:
+			return "sphere";
+		case BOX:
+			return "box";
+		default:
+			return "";
+	}
+}
+
+object
+particles::get_radius()
+{
+	radius_exposed = true;
+	radius.mark_dirty();
+	return radius[make_tuple( all(), 0)];
+}
+
+void
+particles::set_radius( const double_array& arg)
+{
+	if (shape(arg).size() != 1) throw std::invalid_argument("radius must be a 1D array.");
+	set_length( shape(arg)[0]);
+	radius[make_tuple( all(), 0)] = arg;
+	radius.mark_dirty();
+	extent_changed();
+}
+
+void
+particles::set_radius_d( double arg)
+{
+	int npoints = count ? count : 1;
+	radius[make_tuple( slice(0, npoints), 0)] = arg;
+	radius.mark_dirty( 0, npoints);
+	extent_changed();
+}
+
+object
+particles::get_opacity()
+{
+	opacity.mark_dirty();
+	return opacity[make_tuple( all(), 0)];
+}
+
+void
+particles::set_opacity( const double_array& arg)
+{
+	if (shape(arg).size() != 1) throw std::invalid_argument("opacity must be a 1D array.");
+	set_length( shape(arg)[0]);
+	opacity[make_tuple( all(), 0)] = arg;
+	opacity.mark_dirty();
+}
+
+void
+particles::set_opacity_d( double arg)
+{
+	int npoints = count ? count : 1;
+	opacity[make_tuple( slice(0, npoints), 0)] = arg;
+	opacity.mark_dirty( 0, npoints);
+}
+
+object
+particles::get_axis()
+{
+	axis.mark_dirty();
+	return axis[all()];
+}
+
+void
+particles::set_axis( const double_array& arg)
+{
+	std::vector<npy_intp> dims = shape(arg);
+	if (dims.size() == 1 && dims[0] == 3) {
+		// A single axis (or a vector), broadcast across the entire array.
+		int npoints = count ? count : 1;
+		axis[slice( 0, npoints)] = arg;
+		axis.mark_dirty( 0, npoints);
+		return;
+	}
+	if (dims.size() == 2 && dims[1] == 3) {
+		set_length( dims[0]);
+		axis[all()] = arg;
+		axis.mark_dirty();
+		return;
+	}
+	throw std::invalid_argument( "axis must be an Nx3 array");
+}
+
+bool
+particles::degenerate() const
+{
+	return count == 0;
+}
+
+tmatrix
+particles::placement( size_t i, double gcf) const
+{
+	tmatrix ret;
+	if (particle_shape == BOX) {
+		// The same orientation as primitive::model_world_transform(), with
+		// up along +y.
+		vector x_axis = vector( axis.data(i)).norm();
+		if (!x_axis.mag2())
+			x_axis = vector( 1, 0, 0);
+		vector z_axis = (std::fabs( x_axis.y) > 0.98)
+			? x_axis.cross( vector(-1, 0, 0)).norm()
+			: x_axis.cross( vector(0, 1, 0)).norm();
+		ret.x_column( x_axis);
+		ret.y_column( z_axis.cross( x_axis).norm());
+		ret.z_column( z_axis);
+	}
+	ret.w_column( vector( pos.data(i)) * gcf);
+	ret.w_row();
+	return ret;
+}
+
+void
+particles::outer_render( const view& v)
+{
+	gl_render( v);  //< no materials
+}
+
+void
+particles::gl_render( const view& scene)
+{
+	if (degenerate())
+		return;
+
+	clear_gl_error();
+
+	const bool boxes = particle_shape == BOX;
+	if (boxes)
+		box::init_mesh();
+	else
+		sphere::init_mesh();
+
+	// The unit models are a sphere of radius 1 and a cube of side 1.
+	const double model_scale = (boxes ? 2.0 : 1.0) * scene.gcf;
+
+	// Queue the opaque shapes, and set the translucent ones aside to be drawn
+	// in order.  When the transparent layer is blended, each pass draws only
+	// its own shapes, and the translucent ones in any order; see view::parts.
+	std::vector<size_t> blended;
+	depth.clear();
+	for (size_t i = 0; i < count; ++i) {
+		const double r = std::fabs( radius.data(i)[0]);
+		const double o = opacity.data(i)[0];
+		if (r == 0.0 || o <= 0.0)
+			continue;
+		if (o < 1.0) {
+			if (scene.parts == view::OPAQUE_PARTS)
+				continue;
+			blended.push_back( i);
+			if (scene.parts == view::ALL_PARTS)
+				depth.push_back( scene.forward.dot( vector( pos.data(i))));
+			continue;
+		}
+		if (scene.parts == view::TRANSLUCENT_PARTS)
+			continue;
+		const mesh* model = &box::batch_model;
+		if (!boxes) {
+			const double coverage = scene.pixel_coverage( vector( pos.data(i)), r);
+			model = &sphere::lod_mesh[sphere::get_lod( scene, coverage)];
+			if (sphere::impostor( scene, coverage)) {
+				batch.add_sphere( scene, model,
+					vector( pos.data(i)) * scene.gcf, r * scene.gcf,
+					rgb( color.data(i)));
+				continue;
+			}
+		}
+		tmatrix mwt = placement( i, scene.gcf);
+		mwt.scale( vector( r, r, r) * model_scale);
+		batch.add( scene, model, mwt, rgb( color.data(i)), 1.0f);
+	}
+	batch.gl_render( scene);
+
+	if (!blended.empty()) {
+		if (boxes && !box::model)
+			box::init_model( box::model, false);
+		else if (!boxes)
+			sphere::init_model();
+		if (scene.parts == view::ALL_PARTS)
+			depth_order( depth, order);
+		else {
+			order.resize( blended.size());
+			for (size_t k = 0; k < order.size(); ++k)
+				order[k] = k;
+		}
+
+		for (size_t k = 0; k < order.size(); ++k) {
+			const size_t i = blended[order[k]];
+			const double r = std::fabs( radius.data(i)[0]);
+
+			// Same as renderable::outer_render()
+			rgb c( color.data(i));
+			if (scene.anaglyph)
+				c = scene.coloranaglyph ? c.desaturate() : c.grayscale();
+			c.gl_set( opacity.data(i)[0]);
+
+			gl_matrix_stackguard guard;
+			tmatrix mwt = placement( i, scene.gcf);
+			mwt.scale( vector( r, r, r) * model_scale);
+			mwt.gl_mult();
+			if (boxes)
+				box::model.gl_render();
+			else {
+				// As in sphere::gl_render(), the inside and then the outside.
+				const int lod = sphere::get_lod( scene,
+					scene.pixel_coverage( vector( pos.data(i)), r));
+				gl_enable cull_face( GL_CULL_FACE);
+				glCullFace( GL_FRONT);
+				sphere::lod_cache[lod].gl_render();
+				glCullFace( GL_BACK);
+				sphere::lod_cache[lod].gl_render();
+			}
+		}
+	}
+	check_gl_error();
+}
+
+vector
+particles::get_center() const
+{
+	if (degenerate())
+		return vector();
+	vector ret;
+	const double* pos_i = pos.data();
+	for (size_t i = 0; i < count; i++, pos_i += 3)
+		ret += vector( pos_i);
+	ret /= count;
+	return ret;
+}
+
+bool
+particles::translucent()
+{
+	const double* opacity_i = opacity.data();
+	for (size_t i = 0; i < count; ++i)
+		if (opacity_i[i] < 1.0)
+			return true;
+	return false;
+}
+
+bool
+particles::mixed_opacity()
+{
+	const double* opacity_i = opacity.data();
+	for (size_t i = 0; i < count; ++i)
+		if (opacity_i[i] >= 1.0)
+			return true;
+	return false;
+}
+
+bool
+particles::ray_intersect( const pick_ray& ray, pick_hit& hit)
+{
+	if (degenerate())
+		return false;
+	bool ret = false;
+	for (size_t i = 0; i < count; ++i) {
+		const double r = std::fabs( radius.data(i)[0]);
+		if (r == 0.0 || opacity.data(i)[0] <= 0.0)
+			continue;
+		const vector center( pos.data(i));
+		if (particle_shape == SPHERE) {
+			if (ray_sphere( ray.origin, ray.dir, center, r, hit.t))
+				ret = true;
+			continue;
+		}
+		// Skip boxes whose bounding spheres are missed before turning the
+		// ray into the box's coordinates.
+		double t = hit.t;
+		if (!ray_sphere( ray.origin, ray.dir, center, r * std::sqrt(3.0), t)
+				&& (center - ray.origin).mag2() > 3*r*r)
+			continue;
+		// The rotation is orthonormal, so its inverse is its transpose.
+		const tmatrix mwt = placement( i, 1.0);
+		if (ray_box( mwt.times_inv( ray.origin), mwt.times_inv( ray.dir, 0.0),
+				vector( -r, -r, -r), vector( r, r, r), hit.t))
+			ret = true;
+	}
+	return ret;
+}
+
+void
+particles::grow_extent( extent& world)
+{
+	if (degenerate())
+		return;
+	// A box reaches out to the corners of its cube.
+	const double corner = (particle_shape == BOX) ? std::sqrt(3.0) : 1.0;
+	const double* pos_i = pos.data();
+	const double* radius_i = radius.data();
+	for (size_t i = 0; i < count; ++i, pos_i += 3)
+		world.add_sphere( vector( pos_i), std::fabs( radius_i[i]) * corner);
+	world.add_body();
+}
+
+} } // !namespace cvisual::python
@@ -1,4 +1,5 @@
 #include "python/points.hpp"
+#include "pick_engine.hpp"
 #include "python/num_util.hpp"
 #include "python/slice.hpp"
 #include "util/sorted_model.hpp"
@@ -24,6 +25,7 @@ points::points()
 
 void points::set_size( float size) {
 	this->size = size;
+	extent_changed();
 }
 
 void points::set_points_shape( const std::string& n_type)
@@ -60,6 +62,7 @@ void points::set_size_units( const std::string& n_type)
 	}
 	else
 		throw std::invalid_argument( "Unrecognized coordinate type");
+	extent_changed();
 }
 
 std::string points::get_size_units( void)
@@ -267,10 +270,29 @@ points::get_center() const
 	return ret;
 }
 
-void
-points::gl_pick_render( const view& scene)
+bool
+points::ray_intersect( const pick_ray& ray, pick_hit& hit)
 {
-	gl_render( scene);
+	if (degenerate())
+		return false;
+	bool ret = false;
+	const double* pos_i = pos.data();
+	const double* pos_end = pos.end();
+	for ( ; pos_i < pos_end; pos_i += 3) {
+		vector p = vector(pos_i) - ray.origin;
+		// The distance along the ray to the point nearest to the center.
+		double t = p.dot( ray.dir);
+		if (t < 0 || t >= hit.t)
+			continue;
+		double radius = (size_units == PIXELS)
+			? t * (ray.pixel * size * 0.5 + ray.tolerance)
+			: size * 0.5 + t * ray.tolerance;
+		if (p.dot(p) - t*t <= radius*radius) {
+			hit.t = t;
+			ret = true;
+		}
+	}
+	return ret;
 }
 
 void
@@ -10,6 +10,7 @@
 #include "python/faces.hpp"
 #include "python/convex.hpp"
 #include "python/points.hpp"
+#include "python/particles.hpp"
 
 #include "python/num_util.hpp"
 #include <boost/python/class.hpp>
@@ -97,6 +98,7 @@ wrap_arrayobjects()
 	class_<curve, bases<renderable> >( "curve")
 		.def( init<const curve&>())
 		.add_property( "radius", &curve::get_radius, &curve::set_radius)  // AKA thickness.
+		.add_property( "simplify", &curve::get_simplify, &curve::set_simplify)  // In pixels.
 		.def( "get_color", &curve::get_color)
 		.def( "set_color", &curve::set_color)
 		.def( "set_red", &curve::set_red_d)
@@ -213,6 +215,47 @@ wrap_arrayobjects()
 		;
 	}
 
+	{
+	using python::particles;
+
+	void (particles::*qappend_v_r)( const vector&, const rgb&, int ) = &particles::append;
+	void (particles::*qappend_v)( const vector&, int ) = &particles::append;
+
+	class_<particles, bases<renderable> >( "particles")
+		.def( init<const particles&>())
+		.add_property( "shape", &particles::get_shape, &particles::set_shape)
+		.def( "get_color", &particles::get_color)
+		.def( "set_color", &particles::set_color)
+		.def( "set_red", &particles::set_red_d)
+		.def( "set_red", &particles::set_red)
+		.def( "set_green", &particles::set_green_d)
+		.def( "set_green", &particles::set_green)
+		.def( "set_blue", &particles::set_blue_d)
+		.def( "set_blue", &particles::set_blue)
+		.def( "get_pos", &particles::get_pos)
+		.def( "set_pos", &particles::set_pos)
+		.def( "set_pos", &particles::set_pos_v)
+		.def( "set_x", &particles::set_x_d)
+		.def( "set_x", &particles::set_x)
+		.def( "set_y", &particles::set_y_d)
+		.def( "set_y", &particles::set_y)
+		.def( "set_z", &particles::set_z_d)
+		.def( "set_z", &particles::set_z)
+		.def( "get_radius", &particles::get_radius)
+		.def( "set_radius", &particles::set_radius_d)
+		.def( "set_radius", &particles::set_radius)
+		.def( "get_opacity", &particles::get_opacity)
+		.def( "set_opacity", &particles::set_opacity_d)
+		.def( "set_opacity", &particles::set_opacity)
+		.def( "get_axis", &particles::get_axis)
+		.def( "set_axis", &particles::set_axis)
+		.def( "append", qappend_v_r, (arg("pos"), arg("color"), arg("retain")=-1))
+		.def( "append", qappend_v, (arg("pos"), arg("retain")=-1))
+		.def( "append", &particles::append_rgb,
+			(arg("pos"), arg("red")=-1, arg("green")=-1, arg("blue")=-1, arg("retain")=-1))
+		;
+	}
+
 	{
 	using python::faces;
 
@@ -9,6 +9,7 @@
 #include "mouseobject.hpp"
 #include "util/errors.hpp"
 #include "python/gil.hpp"
+#include "python/num_util.hpp"
 #include <boost/bind.hpp>
 #include <boost/python/class.hpp>
 #include <boost/python/call_method.hpp>
@@ -16,6 +17,7 @@
 #include <boost/python/overloads.hpp>
 #include <boost/python/args.hpp>
 #include <boost/python/list.hpp>
+#include <boost/python/dict.hpp>
 #include <boost/python/make_function.hpp>
 #include <boost/python/def.hpp>
 #include <boost/python/manage_new_object.hpp>
@@ -23,6 +25,9 @@
 // Must include display.hpp late because on the Mac it includes Carbon.h
 // which defines "check" which causes trouble in boost/python/extract.hpp
 #include "display.hpp"
+#ifdef VPYTHON_HEADLESS
+#include "headless/offscreen_display.hpp"
+#endif
 
 namespace cvisual {
 
@@ -125,6 +130,140 @@ test_state( const mousebase* This)
 		return boost::python::object();
 }
 
+// scene.stats: one dictionary per recent rendering cycle, oldest first.
+boost::python::list
+get_stats( const display_kernel* This)
+{
+	std::vector<frame_stats> stats = This->get_stats();
+	boost::python::list ret;
+	for (std::vector<frame_stats>::const_iterator i = stats.begin(); i != stats.end(); ++i) {
+		boost::python::dict frame;
+		frame["start"] = i->start;
+		frame["cycle"] = i->cycle;
+		frame["gil_wait"] = i->gil_wait;
+		frame["extent"] = i->extent;
+		frame["snapshot"] = i->snapshot;
+		frame["sort"] = i->sort;
+		frame["opaque"] = i->opaque;
+		frame["transparent"] = i->transparent;
+		frame["screen"] = i->screen;
+		frame["pick"] = i->pick;
+		frame["swap"] = i->swap;
+		frame["total"] = i->total;
+		frame["objects"] = i->objects;
+		frame["transparent_objects"] = i->transparent_objects;
+		frame["screen_objects"] = i->screen_objects;
+		frame["culled"] = i->culled;
+		ret.append( frame);
+	}
+	return ret;
+}
+
+// The owner of a frame_array()'s pixels holds a shared_ptr to the frame.
+// Python 2.6 has no capsules, so it gets a CObject there.
+#if PY_VERSION_HEX < 0x02070000
+void
+release_frame( void* frame)
+{
+	delete static_cast<shared_ptr<frame_image>*>( frame);
+}
+
+PyObject*
+frame_owner( const shared_ptr<frame_image>& frame)
+{
+	return PyCObject_FromVoidPtr( new shared_ptr<frame_image>( frame),
+		&release_frame);
+}
+#else
+void
+release_frame( PyObject* capsule)
+{
+	delete static_cast<shared_ptr<frame_image>*>( PyCapsule_GetPointer( capsule, 0));
+}
+
+PyObject*
+frame_owner( const shared_ptr<frame_image>& frame)
+{
+	return PyCapsule_New( new shared_ptr<frame_image>( frame), 0, &release_frame);
+}
+#endif
+
+// A height by width by 4 array of the RGBA bytes of a frame, top row first,
+// which uses the frame's own pixels rather than a copy of them.
+boost::python::object
+frame_array( const shared_ptr<frame_image>& frame)
+{
+	npy_intp dims[3] = { frame->height, frame->width, 4 };
+	boost::python::handle<> ret( PyArray_SimpleNewFromData( 3, dims, NPY_UBYTE,
+		&frame->pixels[0]));
+	PyObject* owner = frame_owner( frame);
+	if (!owner)
+		boost::python::throw_error_already_set();
+#if !defined(NPY_API_VERSION) || NPY_API_VERSION < 7
+	// Older numpy has no PyArray_SetBaseObject(); the base is a plain field.
+	PyArray_BASE( (PyArrayObject*)ret.get()) = owner;
+#else
+	if (PyArray_SetBaseObject( (PyArrayObject*)ret.get(), owner) < 0)
+		boost::python::throw_error_already_set();
+#endif
+	return boost::python::object( ret);
+}
+
+// scene.capture()
+boost::python::object
+capture( display_kernel* This)
+{
+	return frame_array( This->capture());
+}
+
+// Passes each frame recorded to a Python callable, as a frame_array().  It is
+// called in the frame_writer's thread, so the renderer doesn't wait for it.
+class callback_sink : public frame_sink
+{
+	boost::python::object callback;
+ public:
+	callback_sink( boost::python::object c) : callback(c) {}
+	~callback_sink()
+	{
+		python::gil_lock gil;
+		callback = boost::python::object();
+	}
+
+	void write( const unsigned char* rgba, int width, int height)
+	{
+		shared_ptr<frame_image> frame( new frame_image);
+		frame->pixels.assign( rgba, rgba + (size_t)width * height * 4);
+		frame->width = width;
+		frame->height = height;
+		write_image( frame);
+	}
+
+	void write_image( const shared_ptr<frame_image>& frame)
+	{
+		python::gil_lock gil;
+		try {
+			callback( frame_array( frame));
+		}
+		catch (boost::python::error_already_set&) {
+			PyErr_Print();
+			throw std::runtime_error( "The function given to record() failed.");
+		}
+	}
+};
+
+// scene.record(), given a kind of frame_sink and its target, or a callable.
+void
+record( display_kernel* This, const std::string& kind, const std::string& target)
+{
+	This->record( frame_sink::create( kind, target));
+}
+
+void
+record_callback( display_kernel* This, boost::python::object callback)
+{
+	This->record( shared_ptr<frame_sink>( new callback_sink( callback)));
+}
+
 using namespace boost::python;
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( pick_overloads, display_kernel::pick,
 	2, 3)
@@ -158,6 +297,8 @@ wrap_display_kernel(void)
 		.add_property( "fov", &display_kernel::get_fov, &display_kernel::set_fov)
 		.add_property( "stereodepth", &display_kernel::get_stereodepth, &display_kernel::set_stereodepth)
 		.add_property( "lod", &display_kernel::get_lod, &display_kernel::set_lod)
+		.add_property( "impostors", &display_kernel::get_impostors,
+			&display_kernel::set_impostors)
 		.add_property( "uniform", &display_kernel::is_uniform,
 		 	&display_kernel::set_uniform)
 		.add_property( "background", &display_kernel::get_background,
@@ -170,9 +311,20 @@ wrap_display_kernel(void)
 			&display_kernel::set_autocenter)
 		.add_property( "stereo", &display_kernel::get_stereomode,
 			&display_kernel::set_stereomode)
+		.add_property( "transparency", &display_kernel::get_transparency,
+			&display_kernel::set_transparency)
 		.add_property( "show_rendertime",
 			&display_kernel::is_showing_rendertime,
 			&display_kernel::set_show_rendertime)
+		.add_property( "stats", &get_stats)
+		.def( "clear_stats", &display_kernel::clear_stats)
+		.def( "capture", &capture,
+			"Returns the next frame drawn, as a height by width by 4 array of "
+			"RGBA bytes, top row first.")
+		.def( "_record", &record)
+		.def( "_record", &record_callback)
+		.def( "stop_recording", &display_kernel::stop_recording,
+			"Writes the frames recorded but still pending, and stops recording.")
 		.add_property( "userspin", &display_kernel::spin_is_allowed,
 			&display_kernel::allow_spin)
 		.add_property( "userzoom", &display_kernel::zoom_is_allowed,
@@ -212,6 +364,7 @@ wrap_display_kernel(void)
 		.def( "_get_objects", &display_kernel::get_objects)
 
 		.def_readwrite( "enable_shaders", &display_kernel::enable_shaders)
+		.def_readwrite( "render_threads", &display_kernel::render_threads)
 		;
 
 	class_<py_base_display_kernel, py_display_kernel, bases<display_kernel>, noncopyable>
@@ -241,6 +394,20 @@ wrap_display_kernel(void)
 	py::class_<display, bases<display_kernel>, noncopyable>( "display")
 		;
 
+#ifdef VPYTHON_HEADLESS
+	py::class_<offscreen_display, bases<display_kernel>, noncopyable>( "offscreen_display")
+		.def( "render", &offscreen_display::render,
+			"Draws one frame, and sends it to the output, if there is one.")
+		.def( "set_output", &offscreen_display::set_output, args( "kind", "target"),
+			"Sends the frames drawn from now on to target, as kind 'raw' (a file of "
+			"RGBA bytes), 'png' (files named by a pattern such as 'frame%05d.png') or "
+			"'pipe' (the standard input of a shell command, in which {size}, {width} "
+			"and {height} are replaced with those of the frames).")
+		.def( "close_output", &offscreen_display::close_output,
+			"Writes any frames still pending, and closes the output.")
+		;
+#endif
+
 	py::def( "_set_dataroot", &display::set_dataroot);
 
 	py::to_python_converter<
@@ -19,12 +19,15 @@
 #include "frame.hpp"
 #include "light.hpp"
 #include "python/numeric_texture.hpp"
+#include "python/curve.hpp"
+#include "python/points.hpp"
 
 #include "python/wrap_vector.hpp"
 
 #include <boost/python/class.hpp>
 #include <boost/python/tuple.hpp>
 #include <boost/python/dict.hpp>
+#include <boost/python/def.hpp>
 #include <boost/python/extract.hpp>
 #include <boost/python/raw_function.hpp>
 
@@ -119,6 +122,43 @@ struct textures_from_list
 	}
 };
 
+// The counters of the font, layout and glyph caches shared by all labels.
+dict
+py_text_cache_stats()
+{
+	text_cache_stats s = font::get_cache_stats();
+	dict ret;
+	ret["font_hits"] = s.font_hits;
+	ret["font_misses"] = s.font_misses;
+	ret["layout_hits"] = s.layout_hits;
+	ret["layout_misses"] = s.layout_misses;
+	ret["glyph_hits"] = s.glyph_hits;
+	ret["glyph_misses"] = s.glyph_misses;
+	ret["fonts"] = s.fonts;
+	ret["glyphs"] = s.glyphs;
+	ret["atlas_pages"] = s.atlas_pages;
+	return ret;
+}
+
+// make_trail appends to the array primitive inside the trail object
+// directly, so find it here, where the array primitives are known.
+void
+set_trail_object( primitive& self, object trail)
+{
+	python::arrayprim* t = 0;
+	if (trail.ptr() != Py_None) {
+		extract<python::curve&> c( trail);
+		extract<python::points&> p( trail);
+		if (c.check())
+			t = &c();
+		else if (p.check())
+			t = &p();
+		else
+			throw std::invalid_argument( "trail_object must be a curve or points object.");
+	}
+	self.set_trail_object( t, trail);
+}
+
 void
 wrap_primitive()
 {
@@ -147,7 +187,9 @@ wrap_primitive()
 		.add_property( "blue", &primitive::get_blue, &primitive::set_blue)
 		.add_property( "opacity", &primitive::get_opacity, &primitive::set_opacity)
 		.add_property( "make_trail", &primitive::get_make_trail, &primitive::set_make_trail)
-		.add_property( "primitive_object", &primitive::get_primitive_object, &primitive::set_primitive_object)
+		.add_property( "trail_object", &primitive::get_trail_object, &set_trail_object)
+		.add_property( "retain", &primitive::get_retain, &primitive::set_retain)
+		.add_property( "interval", &primitive::get_interval, &primitive::set_interval)
 		 .def( "rotate", raw_function( &py_rotate<primitive>))
 		;
 
@@ -235,6 +277,8 @@ wrap_primitive()
 		.add_property( "space", &label::get_space, &label::set_space)
 		// .def( self_ns::str(self))
 		;
+	def( "text_cache_stats", &py_text_cache_stats, "text_cache_stats() -> The"
+		" hits and misses of the caches of fonts, text layouts and characters.");
 
 	class_<frame, bases<renderable> >( "frame")
 		.def( init<const frame&>())
@@ -18,6 +18,10 @@
 #include <boost/python/tuple.hpp>
 #include <boost/python/extract.hpp>
 #include "python/num_util.hpp"
+#include "util/parallel.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 
 
 
@@ -35,28 +39,6 @@ using py::allow_null;
 // Operations on Numeric arrays
 namespace {
 
-void
-validate_array( const array& arr)
-{
-	std::vector<npy_intp> dims = shape(arr);
-	if (type(arr) != NPY_DOUBLE) {
-		throw std::invalid_argument( "Array must be of type Float64.");
-	}
-	if (!iscontiguous(arr)) {
-		throw std::invalid_argument( "Array must be contiguous."
-			"(Did you pass a slice?)");
-	}
-	if (dims.size() != 2) {
-		if (dims.size() == 1 && dims[0] == 3)
-			return;
-		else
-			throw std::invalid_argument( "Array must be Nx3 in shape.");
-	}
-	if (dims[1] != 3) {
-		throw std::invalid_argument( "Array must be Nx3 in shape.");
-	}
-}
-
 // Numeric doens't support the Sequence protocol, so I have to use this hack
 // instead.
 // 2008/2/16 BAS asks, "What is the situation with numpy?" Should look into this.
@@ -70,6 +52,219 @@ length(boost::python::object seq)
 	return ret;
 }
 
+// Rows per chunk of work for parallel_for(); below twice this, the array
+// operations run in the calling thread.
+const size_t row_grain = 16384;
+
+/** The vectors in an array of shape Nx3, or of shape 3 for just one vector,
+	read in place.  Arrays of float64 or float32, in native byte order, are
+	used as they are, whatever their strides; anything else is converted to
+	float64 first.  A single vector has a row stride of 0, so that it can be
+	paired with every row of another array.
+*/
+struct vector_rows
+{
+	object owner; ///< Keeps the array, or the converted copy, alive.
+	const char* data;
+	npy_intp rows;
+	npy_intp row_stride; ///< In bytes.
+	npy_intp column_stride; ///< In bytes.
+	bool single; ///< True for a flat array of 3, or a vector.
+	bool single_precision; ///< True for float32.
+
+	explicit vector_rows( const array& arr);
+	explicit vector_rows( const vector& v);
+
+	template <typename T>
+	vector
+	at( npy_intp i) const
+	{
+		const char* row = data + i*row_stride;
+		return vector( *(const T*)row, *(const T*)(row + column_stride),
+			*(const T*)(row + 2*column_stride));
+	}
+};
+
+vector_rows::vector_rows( const array& arr)
+	: owner(arr)
+{
+	PyArrayObject* a = (PyArrayObject*)arr.ptr();
+	const int t = PyArray_TYPE(a);
+	if ((t != NPY_DOUBLE && t != NPY_FLOAT) || !PyArray_ISALIGNED(a)
+			|| !PyArray_ISNOTSWAPPED(a)) {
+		PyObject* converted = PyArray_FromAny( (PyObject*)a, PyArray_DescrFromType( NPY_DOUBLE),
+			0, 0, NPY_ALIGNED | NPY_NOTSWAPPED, NULL);
+		if (!converted)
+			boost::python::throw_error_already_set();
+		owner = object( py::handle<>( converted));
+		a = (PyArrayObject*)converted;
+	}
+	single_precision = PyArray_TYPE(a) == NPY_FLOAT;
+	data = PyArray_BYTES(a);
+	const npy_intp* dims = PyArray_DIMS(a);
+	const npy_intp* strides = PyArray_STRIDES(a);
+	if (PyArray_NDIM(a) == 1 && dims[0] == 3) {
+		single = true;
+		rows = 1;
+		row_stride = 0;
+		column_stride = strides[0];
+	}
+	else if (PyArray_NDIM(a) == 2 && dims[1] == 3) {
+		single = false;
+		rows = dims[0];
+		row_stride = strides[0];
+		column_stride = strides[1];
+	}
+	else
+		throw std::invalid_argument( "Array must be Nx3 in shape.");
+}
+
+vector_rows::vector_rows( const vector& v)
+	: data( (const char*)&v.x), rows(1), row_stride(0),
+	column_stride( (const char*)&v.y - (const char*)&v.x), single(true),
+	single_precision(false)
+{
+}
+
+// The operations, each writing one or three doubles for each row.
+struct mag_op
+{
+	static const int width = 1;
+	static void apply( const vector& v, double* out) { *out = v.mag(); }
+};
+
+struct mag2_op
+{
+	static const int width = 1;
+	static void apply( const vector& v, double* out) { *out = v.mag2(); }
+};
+
+struct norm_op
+{
+	static const int width = 3;
+	static void apply( const vector& v, double* out)
+	{
+		vector n = v.norm();
+		out[0] = n.x;
+		out[1] = n.y;
+		out[2] = n.z;
+	}
+};
+
+struct dot_op
+{
+	static const int width = 1;
+	static void apply( const vector& a, const vector& b, double* out)
+	{
+		*out = a.dot( b);
+	}
+};
+
+struct cross_op
+{
+	static const int width = 3;
+	static void apply( const vector& a, const vector& b, double* out)
+	{
+		vector c = a.cross( b);
+		out[0] = c.x;
+		out[1] = c.y;
+		out[2] = c.z;
+	}
+};
+
+// The loops, over the rows [begin, end).  They neither throw nor touch
+// Python objects, so that parallel_for() can run them in other threads.
+template <typename Op, typename T>
+void
+unary_chunk( const vector_rows* in, double* out, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; ++i)
+		Op::apply( in->template at<T>(i), out + Op::width*i);
+}
+
+template <typename Op, typename T1, typename T2>
+void
+binary_chunk( const vector_rows* in1, const vector_rows* in2, double* out,
+	size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; ++i)
+		Op::apply( in1->template at<T1>(i),
+			in2->template at<T2>(i), out + Op::width*i);
+}
+
+// The shape of the result of Op on rows rows, or the value for a single one.
+template <typename Op>
+object
+make_result( npy_intp rows, bool single, double* value, double** out)
+{
+	if (single) {
+		*out = value;
+		return object();
+	}
+	std::vector<npy_intp> dims( 1, rows);
+	if (Op::width == 3)
+		dims.push_back( 3);
+	array ret = makeNum( dims);
+	*out = (double*)data( ret);
+	return ret;
+}
+
+template <typename Op>
+object
+finish_result( object ret, const double* value)
+{
+	if (!ret.is_none())
+		return ret;
+	if (Op::width == 1)
+		return object( value[0]);
+	return object( vector( value[0], value[1], value[2]));
+}
+
+template <typename Op>
+object
+unary( const array& arr)
+{
+	vector_rows in( arr);
+	double value[3];
+	double* out = 0;
+	object ret = make_result<Op>( in.rows, in.single, value, &out);
+	if (in.single_precision)
+		parallel_for( in.rows, row_grain,
+			boost::bind( &unary_chunk<Op, float>, &in, out, _1, _2));
+	else
+		parallel_for( in.rows, row_grain,
+			boost::bind( &unary_chunk<Op, double>, &in, out, _1, _2));
+	return finish_result<Op>( ret, value);
+}
+
+// A single vector on either side is paired with every row of the other.
+template <typename Op>
+object
+binary( const vector_rows& in1, const vector_rows& in2)
+{
+	if (!in1.single && !in2.single && in1.rows != in2.rows)
+		throw std::invalid_argument( "Array shape mismatch.");
+	const npy_intp rows = in1.single ? in2.rows : in1.rows;
+	double value[3];
+	double* out = 0;
+	object ret = make_result<Op>( rows, in1.single && in2.single, value, &out);
+	boost::function<void (size_t, size_t)> job;
+	if (in1.single_precision) {
+		if (in2.single_precision)
+			job = boost::bind( &binary_chunk<Op, float, float>, &in1, &in2, out, _1, _2);
+		else
+			job = boost::bind( &binary_chunk<Op, float, double>, &in1, &in2, out, _1, _2);
+	}
+	else {
+		if (in2.single_precision)
+			job = boost::bind( &binary_chunk<Op, double, float>, &in1, &in2, out, _1, _2);
+		else
+			job = boost::bind( &binary_chunk<Op, double, double>, &in1, &in2, out, _1, _2);
+	}
+	parallel_for( rows, row_grain, job);
+	return finish_result<Op>( ret, value);
+}
+
 } // !namespace anonymous
 
 vector
@@ -90,158 +285,64 @@ tovector( py::object arr)
 	}
 }
 
+// These take an Nx3 array, and return an array of N results; or a flat array
+// of 3, and return a single result.
 object
 mag_a( const array& arr)
 {
-	validate_array( arr);
-	std::vector<npy_intp> dims = shape(arr);
-	// Magnitude of a flat 3-length array
-	if (dims.size() == 1 && dims[0] == 3) {
-		return object( vector(
-			extract<double>(arr[0]),
-			extract<double>(arr[1]),
-			extract<double>(arr[2])).mag());
-	}
-	std::vector<npy_intp> rdims(1);
-	rdims[0] = dims[0];
-	array ret = makeNum( rdims);
-	for (int i = 0; i< rdims[0]; ++i) {
-		ret[i] = tovector(arr[i]).mag();
-	}
-	return ret;
+	return unary<mag_op>( arr);
 }
 
 object
 mag2_a( const array& arr)
 {
-	validate_array( arr);
-	std::vector<npy_intp> dims = shape(arr);
-	if (dims.size() == 1 && dims[0] == 3) {
-		// Returns an object of type float.
-		return object( vector(
-			extract<double>(arr[0]),
-			extract<double>(arr[1]),
-			extract<double>(arr[2])).mag2());
-	}
-	std::vector<npy_intp> rdims(1);
-	rdims[0] = dims[0];
-	array ret = makeNum( rdims);
-	for (int i = 0; i < rdims[0]; ++i) {
-		ret[i] = tovector(arr[i]).mag2();
-	}
-	// Returns an object of type Numeric.array.
-	return ret;
+	return unary<mag2_op>( arr);
 }
 
 object
 norm_a( const array& arr)
 {
-	validate_array( arr);
-	std::vector<npy_intp> dims = shape(arr);
-	if (dims.size() == 1 && dims[0] == 3) {
-		// Returns a float
-		return object( vector(
-			extract<double>(arr[0]),
-			extract<double>(arr[1]),
-			extract<double>(arr[2])).norm());
-	}
-	array ret = makeNum(dims);
-	for (int i = 0; i < dims[0]; ++i) {
-		ret[i] = tovector(arr[i]).norm();
-	}
-	// Returns a Numeric.array
-	return ret;
+	return unary<norm_op>( arr);
 }
 
-array
+// These take two arrays of the same number of rows, or an array and a single
+// vector, which is paired with each of its rows.
+object
 dot_a( const array& arg1, const array& arg2)
 {
-	validate_array( arg1);
-	validate_array( arg2);
-	std::vector<npy_intp> dims1 = shape(arg1);
-	std::vector<npy_intp> dims2 = shape(arg2);
-	if (dims1 != dims2) {
-		throw std::invalid_argument( "Array shape mismatch.");
-	}
+	return binary<dot_op>( vector_rows( arg1), vector_rows( arg2));
+}
 
-	std::vector<npy_intp> dims_ret(1);
-	dims_ret[0] = dims1[0];
-	array ret = makeNum( dims_ret);
-	const double* arg1_i = (double*)data(arg1);
-	const double* arg2_i = (double*)data(arg2);
-	for ( int i = 0; i < dims1[0]; ++i, arg1_i +=3, arg2_i += 3) {
-		ret[i] = vector(arg1_i).dot( vector(arg2_i));
-	}
-	return ret;
+object
+dot_a_v( const array& arg1, const vector& arg2)
+{
+	return binary<dot_op>( vector_rows( arg1), vector_rows( arg2));
 }
 
-array
-cross_a_a( const array& arg1, const array& arg2)
+object
+dot_v_a( const vector& arg1, const array& arg2)
 {
-	validate_array( arg1);
-	validate_array( arg2);
-	std::vector<npy_intp> dims1 = shape(arg1);
-	std::vector<npy_intp> dims2 = shape(arg2);
-	if (dims1 != dims2) {
-		throw std::invalid_argument( "Array shape mismatch.");
-	}
+	return binary<dot_op>( vector_rows( arg1), vector_rows( arg2));
+}
 
-	array ret = makeNum( dims1);
-	const double* arg1_i = (double*)data(arg1);
-	const double* arg2_i = (double*)data(arg2);
-	double* ret_i = (double*)data(ret);
-	double* const ret_stop = ret_i + 3*dims1[0];
-	for ( ; ret_i < ret_stop; ret_i += 3, arg1_i += 3, arg2_i += 3) {
-		vector ret = vector(arg1_i).cross( vector( arg2_i));
-		ret_i[0] = ret.get_x();
-		ret_i[1] = ret.get_y();
-		ret_i[2] = ret.get_z();
-	}
-	return ret;
+object
+cross_a_a( const array& arg1, const array& arg2)
+{
+	return binary<cross_op>( vector_rows( arg1), vector_rows( arg2));
 }
 
-array
+object
 cross_a_v( const array& arg1, const vector& arg2)
 {
-	validate_array( arg1);
-	std::vector<npy_intp> dims = shape( arg1);
-	array ret = makeNum( dims);
-	const double* arg1_i = (double*)data( arg1);
-	double* ret_i = (double*)data( ret);
-	double* const ret_stop = ret_i + 3*dims[0];
-	for ( ; ret_i < ret_stop; ret_i += 3, arg1_i += 3) {
-		vector ret = vector( arg1_i).cross( arg2);
-		ret_i[0] = ret.get_x();
-		ret_i[1] = ret.get_y();
-		ret_i[2] = ret.get_z();
-
-	}
-	return ret;
+	return binary<cross_op>( vector_rows( arg1), vector_rows( arg2));
 }
 
-array
+object
 cross_v_a( const vector& arg1, const array& arg2)
 {
-	validate_array( arg2);
-	std::vector<npy_intp> dims = shape( arg2);
-	array ret = makeNum( dims);
-	const double* arg2_i = (double*)data( arg2);
-	double* ret_i = (double*)data( ret);
-	double* const ret_stop = ret_i + 3*dims[0];
-	for ( ; ret_i < ret_stop; ret_i += 3, arg2_i += 3) {
-		vector ret = arg1.cross( vector( arg2_i));
-		ret_i[0] = ret.get_x();
-		ret_i[1] = ret.get_y();
-		ret_i[2] = ret.get_z();
-
-	}
-	return ret;
-
+	return binary<cross_op>( vector_rows( arg1), vector_rows( arg2));
 }
 
-
-
-
 namespace {
 using namespace boost::python;
 BOOST_PYTHON_FUNCTION_OVERLOADS( free_rotate, rotate, 2, 3 )
@@ -330,6 +431,8 @@ wrap_vector()
 	// TODO: round out the set.
 	def( "mag", mag_a);
 	def( "dot", dot_a);
+	def( "dot", dot_a_v);
+	def( "dot", dot_v_a);
 	def( "cross", cross_a_a);
 	def( "cross", cross_a_v);
 	def( "cross", cross_v_a);
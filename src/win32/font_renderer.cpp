@@ -69,7 +69,11 @@ font_renderer::~font_renderer() {
 		DeleteObject( font_handle );
 }
 
-void font_renderer::gl_render_to_texture( const view&, const wstring& text, layout_texture& tx ) {
+bool font_renderer::composable() {
+	return true;
+}
+
+void font_renderer::gl_render_to_texture( const view&, const wstring& text, text_image& tx ) {
 	HDC dc = NULL;
 	HBITMAP bmp = NULL;
 	HFONT prevFont = NULL;
@@ -257,8 +257,8 @@ void display::paint() { // called by render_manager "paint_displays"
 			}
 			ShowCursor(cursor.visible);
 		}
-		render_scene();
 	}
+	render_scene(); // acquires the GIL only as needed
 
 	gl_end();
 }
@@ -0,0 +1,45 @@
+#ifndef VPYTHON_TESTS_CHECK_HPP
+#define VPYTHON_TESTS_CHECK_HPP
+
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+// Just enough of a harness for the tests here: CHECK reports a failed
+// condition and carries on, and main() returns check_status().
+
+#include <iostream>
+#include <cstdlib>
+
+namespace {
+
+int check_failures = 0;
+
+inline void
+check_failed( const char* file, int line, const char* condition)
+{
+	++check_failures;
+	std::cerr << file << ":" << line << ": check failed: " << condition
+		<< std::endl;
+}
+
+inline int
+check_status()
+{
+	return check_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Repeatable pseudorandom numbers in [lo, hi).
+inline double
+uniform( double lo, double hi)
+{
+	return lo + (hi - lo) * (std::rand() / (RAND_MAX + 1.0));
+}
+
+} // !namespace (anonymous)
+
+#define CHECK(condition) \
+	do { if (!(condition)) check_failed( __FILE__, __LINE__, #condition); } \
+	while (0)
+
+#endif // !defined VPYTHON_TESTS_CHECK_HPP
@@ -0,0 +1,79 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+// depth_order() must put items in the order a stable sort on decreasing
+// depth does, on both sides of the size at which it changes to a radix sort.
+
+#include "util/depth_sort.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace cvisual;
+
+namespace {
+
+struct deeper
+{
+	const std::vector<double>& depth;
+	deeper( const std::vector<double>& d) : depth(d) {}
+	bool operator()( size_t lhs, size_t rhs) const
+	{ return depth[lhs] > depth[rhs]; }
+};
+
+void
+check_order( const std::vector<double>& depth)
+{
+	std::vector<size_t> expected( depth.size());
+	for (size_t i = 0; i < expected.size(); ++i)
+		expected[i] = i;
+	std::stable_sort( expected.begin(), expected.end(), deeper(depth));
+
+	std::vector<size_t> order;
+	depth_order( depth, order);
+	CHECK( order == expected);
+}
+
+} // !namespace (anonymous)
+
+int
+main()
+{
+	std::srand( 1);
+	const size_t sizes[] = { 0, 1, 2, 255, 256, 257, 1000, 20000 };
+	for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; ++s) {
+		const size_t n = sizes[s];
+		std::vector<double> depth( n);
+
+		// Depths of both signs and widely different sizes.
+		for (size_t i = 0; i < n; ++i)
+			depth[i] = uniform( -1, 1) * std::pow( 10.0, uniform( -30, 30));
+		check_order( depth);
+
+		// Many equal depths, which must keep their relative order, among
+		// them zeros of both signs.
+		for (size_t i = 0; i < n; ++i)
+			depth[i] = (std::rand() % 8 - 4) * 0.5;
+		for (size_t i = 0; i < n; i += 7)
+			depth[i] = -0.0;
+		check_order( depth);
+
+		// Depths that share every byte but the last, so that only one pass
+		// of the radix sort does any work.
+		for (size_t i = 0; i < n; ++i)
+			depth[i] = 1.0 + (std::rand() % 200) * std::numeric_limits<double>::epsilon();
+		check_order( depth);
+
+		// Infinities sort beyond every finite depth.
+		if (n > 2) {
+			depth[0] = std::numeric_limits<double>::infinity();
+			depth[n/2] = -std::numeric_limits<double>::infinity();
+			check_order( depth);
+		}
+	}
+	return check_status();
+}
@@ -0,0 +1,191 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+// pick_engine must find the same body as testing every body in turn, for rays
+// that start outside of the scene, inside the bounds of its nodes, and inside
+// bodies, and must keep doing so as bodies move, vanish and reappear.
+
+#include "pick_engine.hpp"
+#include "renderable.hpp"
+#include "material.hpp"
+#include "util/extent.hpp"
+#include "check.hpp"
+
+#include <vector>
+
+using namespace cvisual;
+
+// renderable.cpp draws with materials, which a test that never draws does
+// not need.
+namespace cvisual {
+
+apply_material::apply_material( const view& v, material*, tmatrix&)
+	: v(v), sp( v, (shader_program*)0)
+{
+}
+
+apply_material::~apply_material()
+{
+}
+
+bool
+material::get_translucent()
+{
+	return false;
+}
+
+use_shader_program::use_shader_program( const view& v, shader_program*)
+	: v(v), oldProgram(-1), m_ok(false)
+{
+}
+
+use_shader_program::~use_shader_program()
+{
+}
+
+} // !namespace cvisual
+
+namespace {
+
+// A sphere that reports an empty extent, and cannot be hit, while hidden.
+class ball : public renderable
+{
+ public:
+	vector center;
+	double radius;
+	bool hidden;
+
+	ball( const vector& c, double r) : center(c), radius(r), hidden(false) {}
+
+	virtual void grow_extent( extent& e)
+	{
+		if (!hidden)
+			e.add_sphere( center, radius);
+	}
+	virtual bool ray_intersect( const pick_ray& ray, pick_hit& hit)
+	{
+		return !hidden && ray_sphere( ray.origin, ray.dir, center, radius, hit.t);
+	}
+	virtual vector get_center() const { return center; }
+};
+
+std::vector<shared_ptr<ball> > balls;
+
+vector
+random_point( double size)
+{
+	return vector( uniform( -size, size), uniform( -size, size),
+		uniform( -size, size));
+}
+
+vector
+random_dir()
+{
+	vector d;
+	do {
+		d = random_point( 1);
+	} while (d.mag2() < 0.01 || d.mag2() > 1);
+	return d.norm();
+}
+
+void
+check_pick( pick_engine& engine, const pick_ray& ray)
+{
+	shared_ptr<renderable> expected;
+	double t = 1e300;
+	for (size_t i = 0; i < balls.size(); ++i) {
+		pick_hit hit;
+		hit.t = t;
+		if (balls[i]->ray_intersect( ray, hit)) {
+			t = hit.t;
+			expected = balls[i];
+		}
+	}
+
+	vector pickpos;
+	shared_ptr<renderable> picked = engine.pick( ray, pickpos);
+	CHECK( picked == expected);
+	if (picked && picked == expected)
+		CHECK( (pickpos - ray.at( t)).mag() < 1e-9);
+}
+
+void
+add_all( pick_engine& engine)
+{
+	engine.clear();
+	for (size_t i = 0; i < balls.size(); ++i)
+		engine.add( balls[i]);
+}
+
+void
+check_picks( pick_engine& engine)
+{
+	for (int i = 0; i < 300; ++i) {
+		// From outside of everything, aimed into the scene.
+		vector origin = random_dir() * 40;
+		check_pick( engine, pick_ray( origin,
+			(random_point( 5) - origin).norm(), 0, 0));
+		// From among the bodies, so inside the bounds of many nodes, and
+		// often beyond the nearest hit in a node that contains the origin.
+		check_pick( engine, pick_ray( random_point( 10), random_dir(), 0, 0));
+	}
+	// From inside a body.
+	for (size_t i = 0; i < balls.size(); i += 7)
+		check_pick( engine, pick_ray( balls[i]->center, random_dir(), 0, 0));
+}
+
+} // !namespace (anonymous)
+
+int
+main()
+{
+	std::srand( 1);
+	pick_engine engine;
+
+	vector pickpos;
+	CHECK( !engine.pick( pick_ray( vector(), vector( 1, 0, 0), 0, 0), pickpos));
+
+	for (int i = 0; i < 500; ++i)
+		balls.push_back( shared_ptr<ball>(
+			new ball( random_point( 10), uniform( 0.05, 1.5))));
+	add_all( engine);
+	check_picks( engine);
+
+	// A ray starting inside a large body, in a node of small ones, must
+	// still find a small one in front of it.
+	balls.push_back( shared_ptr<ball>( new ball( vector( 0, 0, 0), 30)));
+	balls.push_back( shared_ptr<ball>( new ball( vector( 0, 0, 2), 0.5)));
+	add_all( engine);
+	check_pick( engine, pick_ray( vector( 0, 0, 0), vector( 0, 0, 1), 0, 0));
+	check_picks( engine);
+	balls.resize( 500);
+
+	// Moving bodies refits the hierarchy the next time the same bodies are
+	// added.
+	add_all( engine);
+	check_picks( engine);
+	for (int pass = 0; pass < 3; ++pass) {
+		for (size_t i = 0; i < balls.size(); i += 3)
+			balls[i]->center += random_point( 4);
+		add_all( engine);
+		check_picks( engine);
+	}
+
+	// Bodies that disappear and reappear.
+	for (size_t i = 0; i < balls.size(); i += 2)
+		balls[i]->hidden = true;
+	add_all( engine);
+	check_picks( engine);
+	for (size_t i = 0; i < balls.size(); i += 2)
+		balls[i]->hidden = false;
+	add_all( engine);
+	check_picks( engine);
+
+	// A different set of bodies.
+	balls.resize( 3);
+	add_all( engine);
+	check_picks( engine);
+
+	return check_status();
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2004 by Jonathan Brandmeyer and others.
+// See the file license.txt for complete license terms.
+// See the file authors.txt for a complete list of contributors.
+
+// The hull built by quickhull must be closed, consistently wound, and have
+// every point inside or on it, whether it is built at once or extended.
+
+#include "util/quickhull.hpp"
+#include "check.hpp"
+
+#include <vector>
+
+using namespace cvisual;
+
+namespace {
+
+void
+check_hull( const quickhull& hull)
+{
+	const std::vector<vector>& points = hull.get_points();
+	const std::vector<quickhull::face>& faces = hull.get_faces();
+	CHECK( faces.size() >= 4);
+
+	double scale = 0;
+	for (size_t i = 0; i < points.size(); ++i)
+		scale = std::max( scale, points[i].mag());
+	const double tolerance = scale * 1e-9;
+
+	for (size_t f = 0; f < faces.size(); ++f) {
+		const quickhull::face& face = faces[f];
+		CHECK( !face.removed);
+		CHECK( face.outside.empty());
+
+		// Each edge is shared with a neighbor that runs it the other way.
+		for (int e = 0; e < 3; ++e) {
+			CHECK( face.neighbor[e] < faces.size());
+			if (face.neighbor[e] >= faces.size())
+				continue;
+			const quickhull::face& n = faces[face.neighbor[e]];
+			const size_t a = face.corner[e], b = face.corner[(e+1)%3];
+			bool shared = false;
+			for (int ne = 0; ne < 3; ++ne)
+				if (n.corner[ne] == b && n.corner[(ne+1)%3] == a)
+					shared = n.neighbor[ne] == f;
+			CHECK( shared);
+		}
+
+		// The normal points out, so no point is in front of any face.
+		for (size_t p = 0; p < points.size(); ++p)
+			CHECK( face.normal.dot( points[p]) - face.d <= tolerance);
+	}
+
+	// A closed triangle mesh of genus 0: V - E + F == 2, where every face has
+	// three edges, each shared by two faces.
+	std::vector<bool> used( points.size());
+	size_t corners = 0;
+	for (size_t f = 0; f < faces.size(); ++f)
+		for (int c = 0; c < 3; ++c)
+			if (!used[faces[f].corner[c]]) {
+				used[faces[f].corner[c]] = true;
+				++corners;
+			}
+	CHECK( corners + faces.size() - 3 * faces.size() / 2 == 2);
+}
+
+// Points all over a sphere are all corners of their hull.
+void
+sphere_points( quickhull& hull, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		vector p( uniform( -1, 1), uniform( -1, 1), uniform( -1, 1));
+		if (p.mag() < 0.1) {
+			--i;
+			continue;
+		}
+		hull.push_back( p.norm() * 3 + vector( 1, -2, 5));
+	}
+}
+
+} // !namespace (anonymous)
+
+int
+main()
+{
+	std::srand( 1);
+	quickhull hull;
+
+	// A tetrahedron, with a point inside it that must not be a corner.
+	hull.push_back( vector( 0, 0, 0));
+	hull.push_back( vector( 1, 0, 0));
+	hull.push_back( vector( 0, 1, 0));
+	hull.push_back( vector( 0, 0, 1));
+	hull.push_back( vector( 0.1, 0.1, 0.1));
+	hull.build();
+	check_hull( hull);
+	CHECK( hull.get_faces().size() == 4);
+	for (size_t f = 0; f < hull.get_faces().size(); ++f)
+		for (int c = 0; c < 3; ++c)
+			CHECK( hull.get_faces()[f].corner[c] != 4);
+
+	// The corners of a cube, slightly perturbed so that no four are coplanar,
+	// and its center.
+	hull.clear();
+	for (int i = 0; i < 8; ++i)
+		hull.push_back( vector( i & 1, (i >> 1) & 1, (i >> 2) & 1)
+			+ vector( uniform( -1e-6, 1e-6), uniform( -1e-6, 1e-6), 0));
+	hull.push_back( vector( 0.5, 0.5, 0.5));
+	hull.build();
+	check_hull( hull);
+	CHECK( hull.get_faces().size() == 12);
+
+	// Random points in a box, where most are inside.
+	hull.clear();
+	for (int i = 0; i < 2000; ++i)
+		hull.push_back( vector( uniform( -4, 4), uniform( -1, 1), uniform( 0, 9)));
+	hull.build();
+	check_hull( hull);
+
+	// Points on a sphere, each a corner: V == 2 + F/2.
+	hull.clear();
+	sphere_points( hull, 500);
+	hull.build();
+	check_hull( hull);
+	CHECK( hull.get_faces().size() == 2 * 500 - 4);
+
+	// Extending a hull one batch at a time gives a hull of all the points.
+	hull.clear();
+	sphere_points( hull, 20);
+	hull.build();
+	for (int batch = 0; batch < 10; ++batch) {
+		for (int i = 0; i < 30; ++i)
+			hull.push_back( vector( uniform( -5, 5), uniform( -5, 5), uniform( -5, 5)));
+		sphere_points( hull, 10);
+		hull.extend();
+		check_hull( hull);
+	}
+
+	// Extending by points inside the hull changes nothing.
+	size_t faces = hull.get_faces().size();
+	hull.push_back( vector( 1, -2, 5));
+	hull.extend();
+	check_hull( hull);
+	CHECK( hull.get_faces().size() == faces);
+
+	return check_status();
+}
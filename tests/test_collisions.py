@@ -0,0 +1,70 @@
+# sphere_intercollisions must find exactly the pairs of spheres that overlap
+# or touch, in increasing order, whatever the number of threads.
+
+import unittest
+import numpy
+from vis import sphere_intercollisions
+
+def brute_force(pos, radius):
+    radius = numpy.resize(numpy.asarray(radius, dtype=numpy.float64), len(pos))
+    pairs = []
+    for i in range(len(pos)):
+        d = numpy.sqrt(((pos[i+1:] - pos[i])**2).sum(axis=1))
+        for j in numpy.nonzero(d <= radius[i+1:] + radius[i])[0]:
+            pairs.append((i, i + 1 + j))
+    return numpy.array(pairs, dtype=numpy.intp).reshape(len(pairs), 2)
+
+class CollisionTest(unittest.TestCase):
+    def assertPairs(self, pos, radius, threads=1):
+        result = sphere_intercollisions(pos, radius, threads)
+        self.assertEqual(result.dtype, numpy.intp)
+        self.assertEqual(result.tolist(), brute_force(pos, radius).tolist())
+        return result
+
+    def test_random(self):
+        rng = numpy.random.RandomState(1)
+        pos = rng.uniform(-20, 20, (1500, 3))
+        radius = rng.uniform(0.05, 1.0, 1500)
+        self.assertTrue(len(self.assertPairs(pos, radius)) > 0)
+        self.assertPairs(pos, [0.7])
+
+    def test_widely_varying_radii(self):
+        rng = numpy.random.RandomState(2)
+        pos = rng.uniform(-50, 50, (800, 3))
+        radius = rng.uniform(0.01, 0.2, 800)
+        radius[::100] = 15
+        self.assertPairs(pos, radius)
+
+    def test_threads(self):
+        rng = numpy.random.RandomState(3)
+        pos = rng.uniform(-30, 30, (5000, 3))
+        radius = rng.uniform(0.1, 0.8, 5000)
+        one = sphere_intercollisions(pos, radius, 1)
+        for threads in (2, 3, 8):
+            self.assertEqual(sphere_intercollisions(pos, radius, threads).tolist(),
+                             one.tolist())
+        self.assertEqual(one.tolist(), brute_force(pos, radius).tolist())
+
+    def test_touching(self):
+        pos = numpy.array([[0.0, 0, 0], [2.0, 0, 0], [4.5, 0, 0]])
+        self.assertEqual(sphere_intercollisions(pos, [1.0]).tolist(), [[0, 1]])
+        self.assertEqual(sphere_intercollisions(pos, [1.0, 1.0, 1.5]).tolist(),
+                         [[0, 1], [1, 2]])
+
+    def test_none(self):
+        self.assertEqual(sphere_intercollisions(numpy.zeros((0, 3)), [1.0]).shape,
+                         (0, 2))
+        self.assertEqual(sphere_intercollisions([[0, 0, 0]], [1.0]).shape, (0, 2))
+        pos = numpy.array([[0.0, 0, 0], [10.0, 0, 0]])
+        self.assertEqual(sphere_intercollisions(pos, [1.0]).shape, (0, 2))
+
+    def test_bad_arguments(self):
+        pos = numpy.zeros((3, 3))
+        self.assertRaises(ValueError, sphere_intercollisions, numpy.zeros((3, 2)), [1.0])
+        self.assertRaises(IndexError, sphere_intercollisions, pos, [1.0, 2.0])
+        self.assertRaises(ValueError, sphere_intercollisions, pos, [1.0], 0)
+        pos[1, 0] = numpy.inf
+        self.assertRaises(ValueError, sphere_intercollisions, pos, [1.0])
+
+if __name__ == '__main__':
+    unittest.main()
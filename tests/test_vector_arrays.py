@@ -0,0 +1,89 @@
+# The array forms of mag, mag2, norm, dot and cross must agree with numpy,
+# for rows of float64 and float32 in any layout, and for a single vector
+# paired with every row of an array.
+
+import unittest
+import numpy
+from vis import vector, mag, mag2, norm, dot, cross
+
+def reference_mag2(a):
+    return (a.astype(numpy.float64)**2).sum(axis=-1)
+
+class VectorArrayTest(unittest.TestCase):
+    def setUp(self):
+        rng = numpy.random.RandomState(1)
+        # More rows than one chunk of work, so that they may be split
+        # between threads.
+        self.a = rng.uniform(-10, 10, (40000, 3))
+        self.b = rng.uniform(-10, 10, (40000, 3))
+
+    def layouts(self, a):
+        """The same rows as float64, float32, Fortran order, a strided
+        view, and byte swapped."""
+        wide = numpy.zeros((a.shape[0], 7))
+        wide[:, 1:7:2] = a
+        return [a, a.astype(numpy.float32), numpy.asfortranarray(a),
+                wide[:, 1:7:2], a.astype(a.dtype.newbyteorder())]
+
+    def assertRowsClose(self, result, expected, dtype):
+        rtol = 1e-5 if dtype == numpy.float32 else 1e-12
+        self.assertEqual(result.shape, expected.shape)
+        self.assertTrue(numpy.allclose(result, expected, rtol=rtol, atol=0))
+
+    def test_unary(self):
+        for a in self.layouts(self.a):
+            wide = a.astype(numpy.float64)
+            m = numpy.sqrt(reference_mag2(wide))
+            self.assertRowsClose(mag(a), m, a.dtype)
+            self.assertRowsClose(mag2(a), reference_mag2(wide), a.dtype)
+            self.assertRowsClose(norm(a), wide / m[:, numpy.newaxis], a.dtype)
+
+    def test_binary(self):
+        for a in self.layouts(self.a):
+            for b in self.layouts(self.b):
+                wa, wb = a.astype(numpy.float64), b.astype(numpy.float64)
+                dtype = numpy.float32 if numpy.float32 in (a.dtype, b.dtype) \
+                    else numpy.float64
+                self.assertRowsClose(dot(a, b), (wa*wb).sum(axis=1), dtype)
+                self.assertRowsClose(cross(a, b), numpy.cross(wa, wb), dtype)
+
+    def test_single_vector(self):
+        v = vector(1.5, -2, 0.25)
+        nv = numpy.array([1.5, -2, 0.25])
+        for a in self.layouts(self.a):
+            wa = a.astype(numpy.float64)
+            self.assertRowsClose(dot(a, v), wa.dot(nv), a.dtype)
+            self.assertRowsClose(dot(v, a), wa.dot(nv), a.dtype)
+            self.assertRowsClose(cross(a, v), numpy.cross(wa, nv), a.dtype)
+            self.assertRowsClose(cross(v, a), numpy.cross(nv, wa), a.dtype)
+            self.assertRowsClose(dot(a, nv), wa.dot(nv), a.dtype)
+            self.assertRowsClose(cross(nv, a), numpy.cross(nv, wa), a.dtype)
+
+    def test_flat_array(self):
+        nv = numpy.array([3.0, 4.0, 12.0])
+        self.assertAlmostEqual(mag(nv), 13.0)
+        self.assertAlmostEqual(mag2(nv), 169.0)
+        self.assertAlmostEqual(dot(nv, nv), 169.0)
+        n = norm(nv)
+        self.assertAlmostEqual(mag(n), 1.0)
+        self.assertAlmostEqual(n[2], 12.0/13.0)
+
+    def test_small_and_empty(self):
+        for rows in (0, 1, 2, 5):
+            a = self.a[:rows]
+            self.assertRowsClose(mag2(a), reference_mag2(a), a.dtype)
+            self.assertRowsClose(cross(a, self.b[:rows]),
+                                 numpy.cross(a, self.b[:rows]).reshape(rows, 3),
+                                 a.dtype)
+
+    def test_integer_rows(self):
+        a = numpy.array([[1, 2, 2], [0, 3, 4]])
+        self.assertRowsClose(mag(a), numpy.array([3.0, 5.0]), numpy.float64)
+
+    def test_bad_shapes(self):
+        self.assertRaises(ValueError, mag, numpy.zeros((4, 2)))
+        self.assertRaises(ValueError, dot, self.a[:3], self.b[:4])
+        self.assertRaises(ValueError, cross, self.a[:3], self.b[:4])
+
+if __name__ == '__main__':
+    unittest.main()